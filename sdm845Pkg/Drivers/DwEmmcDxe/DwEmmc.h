@@ -19,35 +19,37 @@
 
 #include <Protocol/EmbeddedGpio.h>
 
-// DW MMC Registers
-#define DWEMMC_CTRL             ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x000)
-#define DWEMMC_PWREN            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x004)
-#define DWEMMC_CLKDIV           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x008)
-#define DWEMMC_CLKSRC           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x00c)
-#define DWEMMC_CLKENA           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x010)
-#define DWEMMC_TMOUT            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x014)
-#define DWEMMC_CTYPE            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x018)
-#define DWEMMC_BLKSIZ           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x01c)
-#define DWEMMC_BYTCNT           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x020)
-#define DWEMMC_INTMASK          ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x024)
-#define DWEMMC_CMDARG           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x028)
-#define DWEMMC_CMD              ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x02c)
-#define DWEMMC_RESP0            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x030)
-#define DWEMMC_RESP1            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x034)
-#define DWEMMC_RESP2            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x038)
-#define DWEMMC_RESP3            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x03c)
-#define DWEMMC_RINTSTS          ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x044)
-#define DWEMMC_STATUS           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x048)
-#define DWEMMC_FIFOTH           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x04c)
-#define DWEMMC_DEBNCE           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x064)
-#define DWEMMC_UHSREG           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x074)
-#define DWEMMC_BMOD             ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x080)
-#define DWEMMC_DBADDR           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x088)
-#define DWEMMC_IDSTS            ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x08c)
-#define DWEMMC_IDINTEN          ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x090)
-#define DWEMMC_DSCADDR          ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x094)
-#define DWEMMC_BUFADDR          ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x098)
-#define DWEMMC_CARDTHRCTL       ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0X100)
+// DW MMC registers, offsets from the base of the controller
+#define DWEMMC_CTRL             0x000
+#define DWEMMC_PWREN            0x004
+#define DWEMMC_CLKDIV           0x008
+#define DWEMMC_CLKSRC           0x00c
+#define DWEMMC_CLKENA           0x010
+#define DWEMMC_TMOUT            0x014
+#define DWEMMC_CTYPE            0x018
+#define DWEMMC_BLKSIZ           0x01c
+#define DWEMMC_BYTCNT           0x020
+#define DWEMMC_INTMASK          0x024
+#define DWEMMC_CMDARG           0x028
+#define DWEMMC_CMD              0x02c
+#define DWEMMC_RESP0            0x030
+#define DWEMMC_RESP1            0x034
+#define DWEMMC_RESP2            0x038
+#define DWEMMC_RESP3            0x03c
+#define DWEMMC_RINTSTS          0x044
+#define DWEMMC_STATUS           0x048
+#define DWEMMC_FIFOTH           0x04c
+#define DWEMMC_CDETECT          0x050
+#define DWEMMC_DEBNCE           0x064
+#define DWEMMC_UHSREG           0x074
+#define DWEMMC_BMOD             0x080
+#define DWEMMC_DBADDR           0x088
+#define DWEMMC_IDSTS            0x08c
+#define DWEMMC_IDINTEN          0x090
+#define DWEMMC_DSCADDR          0x094
+#define DWEMMC_BUFADDR          0x098
+#define DWEMMC_CARDTHRCTL       0x100
+#define DWEMMC_FIFO_DATA        0x200
 
 #define CMD_UPDATE_CLK                          0x80202000
 #define CMD_START_BIT                           (1 << 31)
@@ -91,6 +93,7 @@
 #define DWEMMC_INT_DTO                          (1 << 3)        /* Data trans over */
 #define DWEMMC_INT_CMD_DONE                     (1 << 2)
 #define DWEMMC_INT_RE                           (1 << 1)
+#define DWEMMC_INT_CD                           (1 << 0)        /* Card detect */
 
 #define DWEMMC_IDMAC_DES0_DIC                   (1 << 1)
 #define DWEMMC_IDMAC_DES0_LD                    (1 << 2)
@@ -105,6 +108,17 @@
 #define DWEMMC_IDMAC_FB                         (1 << 1)
 #define DWEMMC_IDMAC_ENABLE                     (1 << 7)
 
+/* bits in IDSTS */
+#define DWEMMC_IDSTS_TI                         (1 << 0)        /* Transmit done */
+#define DWEMMC_IDSTS_RI                         (1 << 1)        /* Receive done */
+#define DWEMMC_IDSTS_FBE                        (1 << 2)        /* Fatal bus error */
+#define DWEMMC_IDSTS_DU                         (1 << 4)        /* Descriptor unavailable */
+#define DWEMMC_IDSTS_CES                        (1 << 5)        /* Card error summary */
+#define DWEMMC_IDSTS_NIS                        (1 << 8)
+#define DWEMMC_IDSTS_AIS                        (1 << 9)
+#define DWEMMC_IDSTS_ERROR                      (DWEMMC_IDSTS_FBE | DWEMMC_IDSTS_DU | \
+                                                 DWEMMC_IDSTS_CES | DWEMMC_IDSTS_AIS)
+
 #define EMMC_FIX_RCA                            6
 
 /* bits in MMC0_CTRL */
@@ -116,13 +130,16 @@
 #define DWEMMC_CTRL_IDMAC_EN                    (1 << 25)
 #define DWEMMC_CTRL_RESET_ALL                   (DWEMMC_CTRL_RESET | DWEMMC_CTRL_FIFO_RESET | DWEMMC_CTRL_DMA_RESET)
 
+#define DWEMMC_STS_FIFO_EMPTY                   (1 << 2)
 #define DWEMMC_STS_DATA_BUSY                    (1 << 9)
+#define DWEMMC_STS_FIFO_COUNT(x)                (((x) >> 17) & 0x1fff)
 
-#define DWEMMC_FIFO_TWMARK(x)                   (x & 0xfff)
-#define DWEMMC_FIFO_RWMARK(x)                   ((x & 0x1ff) << 16)
-#define DWEMMC_DMA_BURST_SIZE(x)                ((x & 0x7) << 28)
+#define DWEMMC_FIFO_TWMARK(x)                   ((x) & 0xfff)
+#define DWEMMC_FIFO_RWMARK(x)                   (((x) & 0x1ff) << 16)
+#define DWEMMC_DMA_BURST_SIZE(x)                (((x) & 0x7) << 28)
+#define DWEMMC_GET_FIFO_DEPTH(x)                ((((x) >> 16) & 0xfff) + 1)
 
-#define DWEMMC_CARD_RD_THR(x)                   ((x & 0xfff) << 16)
+#define DWEMMC_CARD_RD_THR(x)                   (((x) & 0xfff) << 16)
 #define DWEMMC_CARD_RD_THR_EN                   (1 << 0)
 
 #endif  // __DWEMMC_H__
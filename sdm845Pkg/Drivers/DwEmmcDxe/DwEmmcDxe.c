@@ -18,6 +18,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/CacheMaintenanceLib.h>
 #include <Library/DebugLib.h>
+#include <Library/DmaBounceLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/IoLib.h>
 #include <Library/MemoryAllocationLib.h>
@@ -28,7 +29,10 @@
 #include <Library/CRULib.h>
 #include <Rk3399/Rk3399Cru.h>
 
+#include <Protocol/HardwareInterrupt.h>
 #include <Protocol/MmcHost.h>
+#include <Protocol/MmcHostDebug.h>
+#include <Protocol/MmcHostExt.h>
 
 #include "DwEmmc.h"
 #include <Rk3399/Rk3399.h>
@@ -41,6 +45,24 @@
 #define DWEMMC_BLOCK_SIZE               512
 #define DWEMMC_DMA_BUF_SIZE             (512 * 8)
 #define DWEMMC_MAX_DESC_PAGES           512
+#define DWEMMC_MAX_DESC                 (EFI_PAGES_TO_SIZE (DWEMMC_MAX_DESC_PAGES) / \
+                                         sizeof (DWEMMC_IDMAC_DESCRIPTOR))
+// One data command never covers more than the descriptor pool or the CMD23 count field
+#define DWEMMC_MAX_BLOCK_COUNT          MIN (DWEMMC_MAX_DESC * (DWEMMC_DMA_BUF_SIZE / DWEMMC_BLOCK_SIZE), \
+                                             MAX_UINT16)
+// Staging area for the parts of a buffer the IDMAC can not reach in place
+#define DWEMMC_BOUNCE_PAGES             32
+
+#define DWEMMC_CMD_TIMEOUT_US           1000000
+#define DWEMMC_BUSY_TIMEOUT_US          2000000
+
+// Fastest card clock the RK3399 sdmmc controller is rated for
+#define DWEMMC_MAX_BUS_CLOCK            150000000
+// CLKDIV divides by twice its value, 0 bypasses it
+#define DWEMMC_MAX_CLKDIV               255
+
+// Time the card-detect line has to be stable before the controller reports it
+#define DWEMMC_DEBOUNCE_MS              25
 
 typedef struct {
   UINT32                        Des0;
@@ -49,13 +71,62 @@ typedef struct {
   UINT32                        Des3;
 } DWEMMC_IDMAC_DESCRIPTOR;
 
-EFI_MMC_HOST_PROTOCOL     *gpMmcHost;
-DWEMMC_IDMAC_DESCRIPTOR   *gpIdmacDesc;
-EFI_GUID mDwEmmcDevicePathGuid = EFI_CALLER_ID_GUID;
-STATIC UINT32 mDwEmmcCommand;
-STATIC UINT32 mDwEmmcArgument;
+#define DWEMMC_HOST_SIGNATURE           SIGNATURE_32 ('d', 'w', 'm', 'c')
+#define DWEMMC_MAX_HOSTS                2
+
+//
+// State of one controller. Every protocol the driver installs is embedded
+// here so that the functions can get back to their controller from This.
+//
+typedef struct {
+  UINT32                        Signature;
+  EFI_HANDLE                    Handle;
+  UINTN                         Base;
+  // Input clock of the controller at reset, before the internal divider
+  UINT32                        ClockFrequency;
+  UINT32                        Interrupt;
+  // CRU clock feeding the controller
+  UINT32                        ClockId;
+  BOOLEAN                       NonRemovable;
+
+  EFI_MMC_HOST_PROTOCOL         MmcHost;
+  MMC_HOST_DEBUG_PROTOCOL       MmcHostDebug;
+  MMC_HOST_EXT_PROTOCOL         MmcHostExt;
+
+  DWEMMC_IDMAC_DESCRIPTOR       *IdmacDesc;
+  // DWEMMC_BOUNCE_PAGES below 4GB, the head of a transfer is staged in the
+  // first cache line and its tail in the second one
+  UINT8                         *Bounce;
+  // Data command held back until the buffer is known
+  UINT32                        Command;
+  UINT32                        Argument;
+  UINT32                        FifoDepth;
+  // Words the FIFO can always take once TXDR is raised
+  UINT32                        FifoBurst;
+  // Controller input clock after the internal divider, as requested from
+  // the CRU and as the CRU could provide it, 0 until first programmed
+  UINT32                        CiuRequest;
+  UINT32                        CiuRate;
+  // Card clock programmed in CLKDIV, 0 when the clock has to be set again
+  UINT32                        BusClock;
+  // Signaled on card-detect changes, NULL while nobody listens
+  EFI_EVENT                     CardDetectEvent;
+  MMC_HOST_COMMAND_LATENCY      Latency[MMC_HOST_DEBUG_MAX_COMMANDS];
+} DWEMMC_HOST;
+
+#define DWEMMC_HOST_FROM_MMC_HOST(a) \
+  CR (a, DWEMMC_HOST, MmcHost, DWEMMC_HOST_SIGNATURE)
+#define DWEMMC_HOST_FROM_MMC_HOST_DEBUG(a) \
+  CR (a, DWEMMC_HOST, MmcHostDebug, DWEMMC_HOST_SIGNATURE)
+#define DWEMMC_HOST_FROM_MMC_HOST_EXT(a) \
+  CR (a, DWEMMC_HOST, MmcHostExt, DWEMMC_HOST_SIGNATURE)
+
+STATIC DWEMMC_HOST *mDwEmmcHosts[DWEMMC_MAX_HOSTS];
+STATIC UINTN mDwEmmcHostCount;
+STATIC EFI_HARDWARE_INTERRUPT_PROTOCOL *mDwEmmcInterrupt;
 
 EFI_STATUS
+EFIAPI
 DwEmmcReadBlockData (
   IN EFI_MMC_HOST_PROTOCOL     *This,
   IN EFI_LBA                    Lba,
@@ -81,14 +152,23 @@ DwEmmcInitialize (
 }
 
 BOOLEAN
+EFIAPI
 DwEmmcIsCardPresent (
   IN EFI_MMC_HOST_PROTOCOL     *This
   )
 {
-  return TRUE;
+  DWEMMC_HOST  *Host;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+  if (Host->NonRemovable) {
+    return TRUE;
+  }
+  // The card-detect input is active low
+  return (MmioRead32 (Host->Base + DWEMMC_CDETECT) & BIT0) == 0;
 }
 
 BOOLEAN
+EFIAPI
 DwEmmcIsReadOnly (
   IN EFI_MMC_HOST_PROTOCOL     *This
   )
@@ -105,38 +185,107 @@ DwEmmcIsDmaSupported (
 }
 
 EFI_STATUS
+EFIAPI
 DwEmmcBuildDevicePath (
   IN EFI_MMC_HOST_PROTOCOL      *This,
   IN EFI_DEVICE_PATH_PROTOCOL   **DevicePath
   )
 {
   EFI_DEVICE_PATH_PROTOCOL *NewDevicePathNode;
-
-  NewDevicePathNode = CreateDeviceNode (HARDWARE_DEVICE_PATH, HW_VENDOR_DP, sizeof (VENDOR_DEVICE_PATH));
-  CopyGuid (& ((VENDOR_DEVICE_PATH*)NewDevicePathNode)->Guid, &mDwEmmcDevicePathGuid);
+  DWEMMC_HOST              *Host;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+
+  //
+  // The base address follows the GUID as vendor data, so that every
+  // controller driven by this module gets its own device path.
+  //
+  NewDevicePathNode = CreateDeviceNode (HARDWARE_DEVICE_PATH, HW_VENDOR_DP,
+                        sizeof (VENDOR_DEVICE_PATH) + sizeof (UINT64));
+  if (NewDevicePathNode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CopyGuid (& ((VENDOR_DEVICE_PATH*)NewDevicePathNode)->Guid, &gEfiCallerIdGuid);
+  WriteUnaligned64 ((UINT64 *)((VENDOR_DEVICE_PATH*)NewDevicePathNode + 1), Host->Base);
 
   *DevicePath = NewDevicePathNode;
   return EFI_SUCCESS;
 }
 
+/**
+  Convert a timeout into a performance counter value to poll against.
+
+**/
+STATIC
+UINT64
+DwEmmcGetDeadline (
+  IN UINT64                    TimeoutUs
+  )
+{
+  UINT64 Frequency;
+
+  Frequency = GetPerformanceCounterProperties (NULL, NULL);
+  return GetPerformanceCounter () + DivU64x32 (MultU64x64 (TimeoutUs, Frequency), 1000000);
+}
+
+/**
+  Wait until the controller can take a new command.
+
+  @param[in]  WaitData    Also wait for the card to release DAT0.
+  @param[in]  TimeoutUs   How long to wait in microseconds.
+
+  @retval EFI_SUCCESS     The controller is idle.
+  @retval EFI_TIMEOUT     The controller is still busy.
+
+**/
+STATIC
+EFI_STATUS
+DwEmmcWaitIdle (
+  IN DWEMMC_HOST               *Host,
+  IN BOOLEAN                   WaitData,
+  IN UINT64                    TimeoutUs
+  )
+{
+  UINT64 Deadline;
+  UINT32 Mask;
+
+  Mask = WaitData ? DWEMMC_STS_DATA_BUSY : 0;
+  if (!(MmioRead32 (Host->Base + DWEMMC_STATUS) & Mask) && !(MmioRead32 (Host->Base + DWEMMC_CMD) & CMD_START_BIT)) {
+    return EFI_SUCCESS;
+  }
+
+  Deadline = DwEmmcGetDeadline (TimeoutUs);
+  do {
+    if (!(MmioRead32 (Host->Base + DWEMMC_STATUS) & Mask) && !(MmioRead32 (Host->Base + DWEMMC_CMD) & CMD_START_BIT)) {
+      return EFI_SUCCESS;
+    }
+  } while (GetPerformanceCounter () < Deadline);
+
+  DEBUG ((DEBUG_ERROR, "%a(): timeout, DWEMMC_STATUS=0x%x DWEMMC_CMD=0x%x\n",
+    __func__, MmioRead32 (Host->Base + DWEMMC_STATUS), MmioRead32 (Host->Base + DWEMMC_CMD)));
+  return EFI_TIMEOUT;
+}
+
 EFI_STATUS
 DwEmmcUpdateClock (
-  VOID
+  IN DWEMMC_HOST               *Host
   )
 {
   UINT32 Data;
+  UINT64 Deadline;
 
   /* CMD_UPDATE_CLK */
   Data = BIT_CMD_WAIT_PRVDATA_COMPLETE | BIT_CMD_UPDATE_CLOCK_ONLY |
          BIT_CMD_START;
-  MmioWrite32 (DWEMMC_CMD, Data);
+  MmioWrite32 (Host->Base + DWEMMC_CMD, Data);
+  Deadline = DwEmmcGetDeadline (DWEMMC_CMD_TIMEOUT_US);
   while (1) {
-    Data = MmioRead32 (DWEMMC_CMD);
+    Data = MmioRead32 (Host->Base + DWEMMC_CMD);
     if (!(Data & CMD_START_BIT)) {
       break;
     }
-    Data = MmioRead32 (DWEMMC_RINTSTS);
-    if (Data & DWEMMC_INT_HLE) {
+    Data = MmioRead32 (Host->Base + DWEMMC_RINTSTS);
+    if ((Data & DWEMMC_INT_HLE) || (GetPerformanceCounter () >= Deadline)) {
       Print (L"failed to update mmc clock frequency\n");
       return EFI_DEVICE_ERROR;
     }
@@ -144,89 +293,155 @@ DwEmmcUpdateClock (
   return EFI_SUCCESS;
 }
 
+/**
+  Set the card clock.
+
+  The controller input clock stays at its default rate unless the card clock
+  is faster, in which case the CRU is asked for the card clock itself so that
+  the internal divider can be bypassed. Nothing is reprogrammed when the
+  clock is already set.
+
+  @param[in]  Host        The controller.
+  @param[in]  ClockFreq   The card clock in Hz, the result may be slower.
+
+  @retval EFI_SUCCESS     The card clock is running.
+  @retval EFI_NOT_FOUND   The divider can not get down to ClockFreq.
+  @retval Others          The controller did not take the new clock.
+
+**/
 EFI_STATUS
 DwEmmcSetClock (
+  IN DWEMMC_HOST               *Host,
   IN UINTN                     ClockFreq
   )
 {
-  UINT32 Divider, Rate, Data;
+  UINT32 Divider, CiuRequest;
   EFI_STATUS Status;
-  BOOLEAN Found = FALSE;
 
-  DEBUG ((DW_DBG, "%a():ClockFreq:%d\n", __func__, ClockFreq));
+  if (ClockFreq == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  for (Divider = 1; Divider < 256; Divider++) {
-    Rate = PcdGet32 (PcdDwEmmcDxeClockFrequencyInHz)/2;
-    if ((Rate / (2 * Divider)) <= ClockFreq) {
-      Found = TRUE;
-      break;
-    }
+  CiuRequest = Host->ClockFrequency / 2;
+  if (ClockFreq > CiuRequest) {
+    CiuRequest = MIN (ClockFreq, DWEMMC_MAX_BUS_CLOCK);
   }
-  if (Found == FALSE) {
-    return EFI_NOT_FOUND;
+  if ((ClockFreq == Host->BusClock) && (CiuRequest == Host->CiuRequest)) {
+    return EFI_SUCCESS;
   }
 
+  DEBUG ((DW_DBG, "%a():ClockFreq:%d\n", __func__, ClockFreq));
+
   // Wait until MMC is idle
-  do {
-    Data = MmioRead32 (DWEMMC_STATUS);
-  } while (Data & DWEMMC_STS_DATA_BUSY);
+  Status = DwEmmcWaitIdle (Host, TRUE, DWEMMC_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
   // Disable MMC clock first
-  MmioWrite32 (DWEMMC_CLKENA, 0);
-  Status = DwEmmcUpdateClock ();
-  ASSERT (!EFI_ERROR (Status));
+  Host->BusClock = 0;
+  MmioWrite32 (Host->Base + DWEMMC_CLKENA, 0);
+  MmioWrite32 (Host->Base + DWEMMC_CLKSRC, 0);
+
+  if (CiuRequest != Host->CiuRequest) {
+    // Only touch the CRU once the card clock is stopped
+    Status = DwEmmcUpdateClock (Host);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Host->CiuRate = rk3399_mmc_set_clk (Host->ClockId, CiuRequest);
+    Host->CiuRequest = CiuRequest;
+    DEBUG ((DW_DBG, "%a(): controller clock %d\n", __func__, Host->CiuRate));
+  }
 
-  MmioWrite32 (DWEMMC_CLKDIV, Divider);
-  Status = DwEmmcUpdateClock ();
-  ASSERT (!EFI_ERROR (Status));
+  if (Host->CiuRate <= ClockFreq) {
+    // Bypass the divider
+    Divider = 0;
+  } else {
+    Divider = (Host->CiuRate + 2 * ClockFreq - 1) / (2 * ClockFreq);
+    if (Divider > DWEMMC_MAX_CLKDIV) {
+      return EFI_NOT_FOUND;
+    }
+  }
+
+  MmioWrite32 (Host->Base + DWEMMC_CLKDIV, Divider);
+  Status = DwEmmcUpdateClock (Host);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
   // Enable MMC clock
-  MmioWrite32 (DWEMMC_CLKENA, 1);
-  MmioWrite32 (DWEMMC_CLKSRC, 0);
-  Status = DwEmmcUpdateClock ();
-  ASSERT (!EFI_ERROR (Status));
+  MmioWrite32 (Host->Base + DWEMMC_CLKENA, 1);
+  Status = DwEmmcUpdateClock (Host);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Host->BusClock = ClockFreq;
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
+EFIAPI
 DwEmmcNotifyState (
   IN EFI_MMC_HOST_PROTOCOL     *This,
   IN MMC_STATE                 State
   )
 {
+  DWEMMC_HOST *Host;
   UINT32      Data;
   EFI_STATUS  Status;
 
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
   switch (State) {
   case MmcInvalidState:
     return EFI_INVALID_PARAMETER;
   case MmcHwInitializationState:
-    MmioWrite32 (DWEMMC_PWREN, 1);
+    MmioWrite32 (Host->Base + DWEMMC_PWREN, 1);
 
     // If device already turn on then restart it
     Data = DWEMMC_CTRL_RESET_ALL;
-    MmioWrite32 (DWEMMC_CTRL, Data);
+    MmioWrite32 (Host->Base + DWEMMC_CTRL, Data);
     do {
       // Wait until reset operation finished
-      Data = MmioRead32 (DWEMMC_CTRL);
+      Data = MmioRead32 (Host->Base + DWEMMC_CTRL);
     } while (Data & DWEMMC_CTRL_RESET_ALL);
 
     // Setup clock that could not be higher than 400KHz.
-    Status = DwEmmcSetClock (400000);
+    Host->BusClock = 0;
+    Status = DwEmmcSetClock (Host, 400000);
     ASSERT (!EFI_ERROR (Status));
     // Wait clock stable
     MicroSecondDelay (100);
 
-    MmioWrite32 (DWEMMC_RINTSTS, ~0);
-    MmioWrite32 (DWEMMC_INTMASK, 0);
-    MmioWrite32 (DWEMMC_TMOUT, ~0);
-    MmioWrite32 (DWEMMC_IDINTEN, 0);
-    MmioWrite32 (DWEMMC_BMOD, DWEMMC_IDMAC_SWRESET);
+    MmioWrite32 (Host->Base + DWEMMC_RINTSTS, ~0);
+    MmioWrite32 (Host->Base + DWEMMC_INTMASK, 0);
+    if (Host->CardDetectEvent != NULL) {
+      // The reset dropped the card-detect interrupt, raise it again
+      MmioWrite32 (Host->Base + DWEMMC_INTMASK, DWEMMC_INT_CD);
+      MmioOr32 (Host->Base + DWEMMC_CTRL, DWEMMC_CTRL_INT_EN);
+    }
+    MmioWrite32 (Host->Base + DWEMMC_TMOUT, ~0);
+    MmioWrite32 (Host->Base + DWEMMC_IDINTEN, 0);
+    MmioWrite32 (Host->Base + DWEMMC_BMOD, DWEMMC_IDMAC_SWRESET);
 
-    MmioWrite32 (DWEMMC_BLKSIZ, DWEMMC_BLOCK_SIZE);
+    MmioWrite32 (Host->Base + DWEMMC_BLKSIZ, DWEMMC_BLOCK_SIZE);
     do {
-      Data = MmioRead32 (DWEMMC_BMOD);
+      Data = MmioRead32 (Host->Base + DWEMMC_BMOD);
     } while (Data & DWEMMC_IDMAC_SWRESET);
+
+    //
+    // The reset value of the RX watermark tells the FIFO depth. Let the IDMAC
+    // burst 8 words and move data once the FIFO is half full or half empty.
+    //
+    if (Host->FifoDepth == 0) {
+      Host->FifoDepth = DWEMMC_GET_FIFO_DEPTH (MmioRead32 (Host->Base + DWEMMC_FIFOTH));
+    }
+    MmioWrite32 (Host->Base + DWEMMC_FIFOTH, DWEMMC_DMA_BURST_SIZE (2) |
+                                             DWEMMC_FIFO_RWMARK (Host->FifoDepth / 2 - 1) |
+                                             DWEMMC_FIFO_TWMARK (Host->FifoDepth / 2));
+    // TXDR is raised while the FIFO holds no more than the TX watermark
+    Host->FifoBurst = Host->FifoDepth - Host->FifoDepth / 2;
     break;
   case MmcIdleState:
     break;
@@ -281,58 +496,115 @@ IsPendingWriteCommand (
   return FALSE;
 }
 
+STATIC
+VOID
+DwEmmcRecordLatency (
+  IN DWEMMC_HOST                *Host,
+  IN MMC_CMD                    MmcCmd,
+  IN UINT64                     ElapsedUs,
+  IN EFI_STATUS                 Status
+  )
+{
+  MMC_HOST_COMMAND_LATENCY  *Latency;
+  UINTN                     Bucket;
+
+  Latency = &Host->Latency[MMC_GET_INDX (MmcCmd) % MMC_HOST_DEBUG_MAX_COMMANDS];
+  Latency->Count++;
+  if (EFI_ERROR (Status)) {
+    Latency->Errors++;
+  }
+  Latency->TotalUs += ElapsedUs;
+  if (ElapsedUs > Latency->MaxUs) {
+    Latency->MaxUs = ElapsedUs;
+  }
+  for (Bucket = 0; Bucket < MMC_HOST_DEBUG_LATENCY_BUCKETS - 1; Bucket++) {
+    if (RShiftU64 (ElapsedUs, Bucket) == 0) {
+      break;
+    }
+  }
+  Latency->Buckets[Bucket]++;
+}
+
 EFI_STATUS
 SendCommand (
+  IN DWEMMC_HOST                *Host,
   IN MMC_CMD                    MmcCmd,
   IN UINT32                     Argument
   )
 {
   UINT32      Data, ErrMask;
+  UINT64      Start, Deadline;
+  EFI_STATUS  Status;
 
   DEBUG ((DW_DBG, "%a(): MmcCmd 0x%x(%d),Argument 0x%x \n", __func__, MmcCmd, MmcCmd&0x3f, Argument));
 
-  MicroSecondDelay(15000);
+  Start = GetPerformanceCounter ();
 
-  // Wait until MMC is idle
-  do {
-    Data = MmioRead32 (DWEMMC_STATUS);
-  } while (Data & DWEMMC_STS_DATA_BUSY);
+  //
+  // Only data commands and those asking for it wait for DAT0, so that CMD13
+  // can poll a card that is still busy after an R1b command.
+  //
+  Status = DwEmmcWaitIdle (Host,
+             (MmcCmd & (BIT_CMD_DATA_EXPECTED | BIT_CMD_WAIT_PRVDATA_COMPLETE)) != 0,
+             DWEMMC_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
 
-  MmioWrite32 (DWEMMC_RINTSTS, ~0);
-  MmioWrite32 (DWEMMC_CMDARG, Argument);
-  MmioWrite32 (DWEMMC_CMD, MmcCmd);
+  MmioWrite32 (Host->Base + DWEMMC_RINTSTS, ~DWEMMC_INT_CD);
+  MmioWrite32 (Host->Base + DWEMMC_CMDARG, Argument);
+  MmioWrite32 (Host->Base + DWEMMC_CMD, MmcCmd);
 
   ErrMask = DWEMMC_INT_EBE | DWEMMC_INT_HLE | DWEMMC_INT_RTO |
             DWEMMC_INT_RCRC | DWEMMC_INT_RE;
   ErrMask |= DWEMMC_INT_DCRC | DWEMMC_INT_DRT | DWEMMC_INT_SBE;
+  Status = EFI_TIMEOUT;
+  Deadline = DwEmmcGetDeadline (DWEMMC_CMD_TIMEOUT_US);
   do {
-    MicroSecondDelay(500);
-    Data = MmioRead32 (DWEMMC_RINTSTS);
+    Data = MmioRead32 (Host->Base + DWEMMC_RINTSTS);
 
     if (Data & ErrMask) {
       DEBUG ((DW_DBG, "%a(): EFI_DEVICE_ERROR DWEMMC_RINTSTS=0x%x MmcCmd 0x%x(%d),Argument 0x%x\n",
           __func__, Data, MmcCmd, MmcCmd&0x3f, Argument));
-      return EFI_DEVICE_ERROR;
+      Status = EFI_DEVICE_ERROR;
+      break;
     }
-    if (Data & DWEMMC_INT_DTO) {     // Transfer Done
+    if (Data & (DWEMMC_INT_CMD_DONE | DWEMMC_INT_DTO)) {
+      Status = EFI_SUCCESS;
       break;
     }
-  } while (!(Data & DWEMMC_INT_CMD_DONE));
+  } while (GetPerformanceCounter () < Deadline);
+
+Exit:
+  DwEmmcRecordLatency (Host, MmcCmd,
+    DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - Start), 1000),
+    Status);
+  if (EFI_ERROR (Status)) {
+    if (Status == EFI_TIMEOUT) {
+      DEBUG ((DEBUG_ERROR, "%a(): timeout, MmcCmd 0x%x(%d),Argument 0x%x\n",
+          __func__, MmcCmd, MmcCmd&0x3f, Argument));
+    }
+    return EFI_DEVICE_ERROR;
+  }
 
   DEBUG ((DW_DBG, "%a(): EFI_SUCCESS\n", __func__));
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
+EFIAPI
 DwEmmcSendCommand (
   IN EFI_MMC_HOST_PROTOCOL     *This,
   IN MMC_CMD                    MmcCmd,
   IN UINT32                     Argument
   )
 {
+  DWEMMC_HOST  *Host;
   UINT32       Cmd = 0;
   EFI_STATUS   Status = EFI_SUCCESS;
 
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+
   DEBUG ((DW_DBG, "%a(): MmcCmd 0x%x(%d),Argument 0x%x \n", __func__, MmcCmd, MmcCmd&0x3f, Argument));
 
   switch (MMC_GET_INDX(MmcCmd)) {
@@ -378,14 +650,14 @@ DwEmmcSendCommand (
            BIT_CMD_STOP_ABORT_CMD;
     break;
   case MMC_INDX(13):
-    Cmd = BIT_CMD_RESPONSE_EXPECT | BIT_CMD_CHECK_RESPONSE_CRC |
-           BIT_CMD_WAIT_PRVDATA_COMPLETE;
+    Cmd = BIT_CMD_RESPONSE_EXPECT | BIT_CMD_CHECK_RESPONSE_CRC;
     break;
   case MMC_INDX(16):
     Cmd = BIT_CMD_RESPONSE_EXPECT | BIT_CMD_CHECK_RESPONSE_CRC;
     break;
   case MMC_INDX(17):
   case MMC_INDX(18):
+  case MMC_INDX(21):
     Cmd = BIT_CMD_RESPONSE_EXPECT | BIT_CMD_CHECK_RESPONSE_CRC |
            BIT_CMD_DATA_EXPECTED | BIT_CMD_READ |
            BIT_CMD_WAIT_PRVDATA_COMPLETE;
@@ -416,24 +688,28 @@ DwEmmcSendCommand (
   Cmd |= MMC_GET_INDX(MmcCmd) | BIT_CMD_USE_HOLD_REG | BIT_CMD_START;
 
   if (IsPendingReadCommand (Cmd) || IsPendingWriteCommand (Cmd)) {
-    mDwEmmcCommand = Cmd;
-    mDwEmmcArgument = Argument;
+    Host->Command = Cmd;
+    Host->Argument = Argument;
   } else {
-    Status = SendCommand (Cmd, Argument);
+    Status = SendCommand (Host, Cmd, Argument);
   }
   return Status;
 }
 
 EFI_STATUS
+EFIAPI
 DwEmmcReceiveResponse (
   IN EFI_MMC_HOST_PROTOCOL     *This,
   IN MMC_RESPONSE_TYPE          Type,
   IN UINT32*                    Buffer
   )
 {
+  DWEMMC_HOST  *Host;
+
   if (Buffer == NULL) {
     return EFI_INVALID_PARAMETER;
   }
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
 
   if (   (Type == MMC_RESPONSE_TYPE_R1)
       || (Type == MMC_RESPONSE_TYPE_R1b)
@@ -441,38 +717,57 @@ DwEmmcReceiveResponse (
       || (Type == MMC_RESPONSE_TYPE_R6)
       || (Type == MMC_RESPONSE_TYPE_R7))
   {
-    Buffer[0] = MmioRead32 (DWEMMC_RESP0);
+    Buffer[0] = MmioRead32 (Host->Base + DWEMMC_RESP0);
   } else if (Type == MMC_RESPONSE_TYPE_R2) {
-    Buffer[0] = MmioRead32 (DWEMMC_RESP0);
-    Buffer[1] = MmioRead32 (DWEMMC_RESP1);
-    Buffer[2] = MmioRead32 (DWEMMC_RESP2);
-    Buffer[3] = MmioRead32 (DWEMMC_RESP3);
+    Buffer[0] = MmioRead32 (Host->Base + DWEMMC_RESP0);
+    Buffer[1] = MmioRead32 (Host->Base + DWEMMC_RESP1);
+    Buffer[2] = MmioRead32 (Host->Base + DWEMMC_RESP2);
+    Buffer[3] = MmioRead32 (Host->Base + DWEMMC_RESP3);
   }
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
+/**
+  Build the IDMAC descriptor chain describing a data transfer.
+
+  Every segment of the map is covered by descriptors of at most
+  DWEMMC_DMA_BUF_SIZE bytes, each one pointing at the next one in the pool.
+
+  @param[in]  Host         The controller.
+  @param[in]  IdmacDesc    Descriptor pool.
+  @param[in]  Map          The transfer buffer, as mapped by DwEmmcDmaMap().
+
+  @retval     The number of descriptors used.
+
+**/
+UINTN
 PrepareDmaData (
+  IN DWEMMC_HOST                *Host,
   IN DWEMMC_IDMAC_DESCRIPTOR*    IdmacDesc,
-  IN UINTN                      Length,
-  IN UINT32*                    Buffer
+  IN DMA_BOUNCE_MAP             *Map
   )
 {
-  UINTN  Cnt, Blks, Idx, LastIdx;
-
-  Cnt = (Length + DWEMMC_DMA_BUF_SIZE - 1) / DWEMMC_DMA_BUF_SIZE;
-  Blks = (Length + DWEMMC_BLOCK_SIZE - 1) / DWEMMC_BLOCK_SIZE;
-  Length = DWEMMC_BLOCK_SIZE * Blks;
-
-  for (Idx = 0; Idx < Cnt; Idx++) {
-    (IdmacDesc + Idx)->Des0 = DWEMMC_IDMAC_DES0_OWN | DWEMMC_IDMAC_DES0_CH |
-                              DWEMMC_IDMAC_DES0_DIC;
-    (IdmacDesc + Idx)->Des1 = DWEMMC_IDMAC_DES1_BS1(DWEMMC_DMA_BUF_SIZE);
-    /* Buffer Address */
-    (IdmacDesc + Idx)->Des2 = (UINT32)((UINTN)Buffer + DWEMMC_DMA_BUF_SIZE * Idx);
-    /* Next Descriptor Address */
-    (IdmacDesc + Idx)->Des3 = (UINT32)((UINTN)IdmacDesc +
-                                       (sizeof(DWEMMC_IDMAC_DESCRIPTOR) * (Idx + 1)));
+  UINTN   Cnt, Seg, LastIdx;
+  UINT32  Address, Remaining, Chunk;
+
+  Cnt = 0;
+  for (Seg = 0; Seg < Map->SegmentCount; Seg++) {
+    Address = (UINT32)Map->Segments[Seg].Address;
+    Remaining = (UINT32)Map->Segments[Seg].Length;
+    while (Remaining > 0) {
+      Chunk = MIN (Remaining, DWEMMC_DMA_BUF_SIZE);
+      (IdmacDesc + Cnt)->Des0 = DWEMMC_IDMAC_DES0_OWN | DWEMMC_IDMAC_DES0_CH |
+                                DWEMMC_IDMAC_DES0_DIC;
+      (IdmacDesc + Cnt)->Des1 = DWEMMC_IDMAC_DES1_BS1(Chunk);
+      /* Buffer Address */
+      (IdmacDesc + Cnt)->Des2 = Address;
+      /* Next Descriptor Address */
+      (IdmacDesc + Cnt)->Des3 = (UINT32)((UINTN)IdmacDesc +
+                                         (sizeof(DWEMMC_IDMAC_DESCRIPTOR) * (Cnt + 1)));
+      Address += Chunk;
+      Remaining -= Chunk;
+      Cnt++;
+    }
   }
   /* First Descriptor */
   IdmacDesc->Des0 |= DWEMMC_IDMAC_DES0_FS;
@@ -480,42 +775,224 @@ PrepareDmaData (
   LastIdx = Cnt - 1;
   (IdmacDesc + LastIdx)->Des0 |= DWEMMC_IDMAC_DES0_LD;
   (IdmacDesc + LastIdx)->Des0 &= ~(DWEMMC_IDMAC_DES0_DIC | DWEMMC_IDMAC_DES0_CH);
-  (IdmacDesc + LastIdx)->Des1 = DWEMMC_IDMAC_DES1_BS1(Length -
-                                                      (LastIdx * DWEMMC_DMA_BUF_SIZE));
   /* Set the Next field of Last Descriptor */
   (IdmacDesc + LastIdx)->Des3 = 0;
-  MmioWrite32 (DWEMMC_DBADDR, (UINT32)((UINTN)IdmacDesc));
+  MmioWrite32 (Host->Base + DWEMMC_DBADDR, (UINT32)((UINTN)IdmacDesc));
 
-  return EFI_SUCCESS;
+  return Cnt;
 }
 
 VOID
 StartDma (
-  UINTN    Length
+  IN DWEMMC_HOST                *Host,
+  IN UINTN                      Length
   )
 {
   UINT32 Data;
 
-  Data = MmioRead32 (DWEMMC_CTRL);
+  Data = MmioRead32 (Host->Base + DWEMMC_CTRL);
   Data |= DWEMMC_CTRL_INT_EN | DWEMMC_CTRL_DMA_EN | DWEMMC_CTRL_IDMAC_EN;
-  MmioWrite32 (DWEMMC_CTRL, Data);
-  Data = MmioRead32 (DWEMMC_BMOD);
+  MmioWrite32 (Host->Base + DWEMMC_CTRL, Data);
+  Data = MmioRead32 (Host->Base + DWEMMC_BMOD);
   Data |= DWEMMC_IDMAC_ENABLE | DWEMMC_IDMAC_FB;
-  MmioWrite32 (DWEMMC_BMOD, Data);
+  MmioWrite32 (Host->Base + DWEMMC_BMOD, Data);
 
-  MmioWrite32 (DWEMMC_BLKSIZ, DWEMMC_BLOCK_SIZE);
-  MmioWrite32 (DWEMMC_BYTCNT, Length);
+  MmioWrite32 (Host->Base + DWEMMC_BLKSIZ, DWEMMC_BLOCK_SIZE);
+  MmioWrite32 (Host->Base + DWEMMC_BYTCNT, Length);
 }
 
-#define FIFO_RESET	(0x1<<1)	/* Reset FIFO */
-#define FIFO_EMPTY	(0x1<<2)
-#define FIFO_RESET	(0x1<<1)	/* Reset FIFO */
-#define DWEMMC_MSHCI_FIFO           ((UINT32)PcdGet32 (PcdDwEmmcDxeBaseAddress) + 0x200)
+VOID
+StopDma (
+  IN DWEMMC_HOST                *Host
+  )
+{
+  UINT32 Data;
+
+  // The interrupt output stays on, it carries the card-detect interrupt
+  Data = MmioRead32 (Host->Base + DWEMMC_CTRL);
+  Data &= ~(DWEMMC_CTRL_DMA_EN | DWEMMC_CTRL_IDMAC_EN);
+  MmioWrite32 (Host->Base + DWEMMC_CTRL, Data);
+  Data = MmioRead32 (Host->Base + DWEMMC_BMOD);
+  Data &= ~(DWEMMC_IDMAC_ENABLE | DWEMMC_IDMAC_FB);
+  MmioWrite32 (Host->Base + DWEMMC_BMOD, Data);
+}
+
+#define INTMSK_HTO      (0x1<<10)
+
+/* Common flag combinations */
+#define MMC_DATA_ERROR_FLAGS (DWEMMC_INT_DRT | DWEMMC_INT_DCRC | DWEMMC_INT_FRUN | \
+	DWEMMC_INT_HLE | INTMSK_HTO | DWEMMC_INT_SBE  | \
+	DWEMMC_INT_EBE)
+
+/**
+  Map a data transfer for the IDMAC.
+
+  The IDMAC only takes word aligned 32-bit buffer addresses and moves whole
+  blocks. Only whole cache lines of the buffer are handed to it, so that cache
+  maintenance can not corrupt data sharing a line with the buffer: the
+  partial lines at its ends are staged in the bounce pages and the rest is
+  moved in place. A buffer the IDMAC can not reach is staged as a whole when
+  it fits in the bounce pages. Anything else goes through the FIFO.
+
+  @param[in]  Host         The controller.
+  @param[in]  Length       Length of the transfer in bytes.
+  @param[in]  Buffer       Source or destination buffer.
+  @param[in]  IsRead       TRUE if the data is moved from the card.
+  @param[out] Map          The transfer buffer as the IDMAC sees it.
+
+  @retval TRUE             The transfer can be handed to the IDMAC.
+  @retval FALSE            The transfer has to go through the FIFO.
+
+**/
+STATIC
+BOOLEAN
+DwEmmcDmaMap (
+  IN  DWEMMC_HOST               *Host,
+  IN  UINTN                     Length,
+  IN  UINT32*                   Buffer,
+  IN  BOOLEAN                   IsRead,
+  OUT DMA_BOUNCE_MAP            *Map
+  )
+{
+  if (!FeaturePcdGet (PcdDwEmmcDxeUseIdmac) || (Host->IdmacDesc == NULL)) {
+    return FALSE;
+  }
+  if ((Length == 0) || ((Length % DWEMMC_BLOCK_SIZE) != 0)) {
+    return FALSE;
+  }
+  // The staged parts may each start a descriptor of their own
+  if ((Length + DWEMMC_DMA_BUF_SIZE - 1) / DWEMMC_DMA_BUF_SIZE + DMA_BOUNCE_MAX_SEGMENTS - 1 >
+      DWEMMC_MAX_DESC) {
+    return FALSE;
+  }
+
+  return DmaBounceMap (Buffer, Length, IsRead, MAX_UINT32, Host->Bounce,
+           EFI_PAGES_TO_SIZE (DWEMMC_BOUNCE_PAGES), Map);
+}
 
+/**
+  Wait for the controller to finish the data phase of the pending command.
+
+  Waits for the card to release DAT0 and then resets the FIFO and the DMA
+  interface when requested, so the next data transfer starts from a clean
+  state.
+
+**/
+STATIC
 EFI_STATUS
-DwEmmcReadBlockData (
-  IN EFI_MMC_HOST_PROTOCOL     *This,
-  IN EFI_LBA                    Lba,
+DwEmmcPrepareTransfer (
+  IN DWEMMC_HOST                *Host,
+  IN UINT32                     ResetMask
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Data;
+  UINT64      Deadline;
+
+  Status = DwEmmcWaitIdle (Host, (Host->Command & BIT_CMD_WAIT_PRVDATA_COMPLETE) != 0,
+             DWEMMC_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Data = MmioRead32 (Host->Base + DWEMMC_CTRL);
+  MmioWrite32 (Host->Base + DWEMMC_CTRL, Data | ResetMask);
+  Deadline = DwEmmcGetDeadline (DWEMMC_CMD_TIMEOUT_US);
+  while (MmioRead32 (Host->Base + DWEMMC_CTRL) & ResetMask) {
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a():  CMD=%d SDC_SDC_ERROR\n", __func__, Host->Command&0x3f));
+      return EFI_DEVICE_ERROR;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Move the data of the pending command with the internal DMA controller.
+
+  @param[in]  Host         The controller.
+  @param[in]  Map          The transfer buffer, as mapped by DwEmmcDmaMap().
+
+**/
+STATIC
+EFI_STATUS
+DwEmmcDmaTransfer (
+  IN DWEMMC_HOST                *Host,
+  IN DMA_BOUNCE_MAP             *Map
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       DescCount;
+  UINT64      Deadline;
+  UINTN       Length;
+  UINT32      Data;
+  UINT32      IdSts;
+  BOOLEAN     IsRead;
+
+  Length = Map->Length;
+  IsRead = Map->IsRead;
+
+  Status = DwEmmcPrepareTransfer (Host, DWEMMC_CTRL_FIFO_RESET | DWEMMC_CTRL_DMA_RESET);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  DescCount = PrepareDmaData (Host, Host->IdmacDesc, Map);
+  WriteBackDataCacheRange (Host->IdmacDesc, DescCount * sizeof (DWEMMC_IDMAC_DESCRIPTOR));
+
+  MmioWrite32 (Host->Base + DWEMMC_IDSTS, ~0);
+  StartDma (Host, Length);
+
+  Status = SendCommand (Host, Host->Command, Host->Argument);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a(): Failed to send command, Command:%x, Argument:%x, Status:%r\n",
+      __func__, Host->Command, Host->Argument, Status));
+    goto Exit;
+  }
+
+  //
+  // Allow for a card that moves at least 4MB/s on top of the 1s data timeout.
+  //
+  Deadline = DwEmmcGetDeadline (DWEMMC_CMD_TIMEOUT_US + Length / 4);
+  for (;;) {
+    Data = MmioRead32 (Host->Base + DWEMMC_RINTSTS);
+    IdSts = MmioRead32 (Host->Base + DWEMMC_IDSTS);
+    if ((Data & MMC_DATA_ERROR_FLAGS) || (IdSts & DWEMMC_IDSTS_ERROR)) {
+      DEBUG ((DEBUG_ERROR, "%a(): EFI_DEVICE_ERROR DWEMMC_RINTSTS=0x%x DWEMMC_IDSTS=0x%x Length=%d\n",
+        __func__, Data, IdSts, Length));
+      Status = EFI_DEVICE_ERROR;
+      break;
+    }
+    //
+    // DTO only tells that the card is done. On reads the IDMAC may still be
+    // draining the FIFO into memory until it reports receive completion.
+    //
+    if ((Data & DWEMMC_INT_DTO) && (!IsRead || (IdSts & DWEMMC_IDSTS_RI))) {
+      break;
+    }
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a(): TimeOut! DWEMMC_RINTSTS=0x%x DWEMMC_IDSTS=0x%x Length=%d\n",
+        __func__, Data, IdSts, Length));
+      Status = EFI_TIMEOUT;
+      break;
+    }
+  }
+
+Exit:
+  StopDma (Host);
+  MmioWrite32 (Host->Base + DWEMMC_IDSTS, ~0);
+  DmaBounceUnmap (Map);
+  if (EFI_ERROR (Status)) {
+    DwEmmcPrepareTransfer (Host, DWEMMC_CTRL_FIFO_RESET | DWEMMC_CTRL_DMA_RESET);
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+DwEmmcReadBlockDataPio (
+  IN DWEMMC_HOST                *Host,
   IN UINTN                      Length,
   IN UINT32*                   Buffer
   )
@@ -523,61 +1000,51 @@ DwEmmcReadBlockData (
   EFI_STATUS	Status;
   UINT32		DataLen = Length>>2; //byte to word
   EFI_STATUS	ret = EFI_SUCCESS;
-  UINT32		Data;
   UINT32		TimeOut = 0;
-  UINT32		value = 0;
 
   DEBUG ((DW_DBG, "%a():\n", __func__));
 
-  if (mDwEmmcCommand & BIT_CMD_WAIT_PRVDATA_COMPLETE) {
-    do {
-      Data = MmioRead32 (DWEMMC_STATUS);
-    } while (Data & DWEMMC_STS_DATA_BUSY);
+  Status = DwEmmcWaitIdle (Host, (Host->Command & BIT_CMD_WAIT_PRVDATA_COMPLETE) != 0,
+             DWEMMC_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  if ((mDwEmmcCommand & BIT_CMD_STOP_ABORT_CMD) || (mDwEmmcCommand & BIT_CMD_DATA_EXPECTED)) {
-    if (!(MmioRead32 (DWEMMC_STATUS) & FIFO_EMPTY)) {
-      Data = MmioRead32 (DWEMMC_CTRL);
-      Data |= FIFO_RESET;
-      MmioWrite32 (DWEMMC_CTRL, Data);
-
-      TimeOut = 100000;
-      while (((value = MmioRead32 (DWEMMC_CTRL)) & (FIFO_RESET)) && (TimeOut > 0)) {
-        TimeOut--;
-      }
-      if (TimeOut == 0) {
-        DEBUG ((DEBUG_ERROR, "%a():  CMD=%d SDC_SDC_ERROR\n", __func__, mDwEmmcCommand&0x3f));
-        return EFI_DEVICE_ERROR;
+  if ((Host->Command & BIT_CMD_STOP_ABORT_CMD) || (Host->Command & BIT_CMD_DATA_EXPECTED)) {
+    if (!(MmioRead32 (Host->Base + DWEMMC_STATUS) & DWEMMC_STS_FIFO_EMPTY)) {
+      Status = DwEmmcPrepareTransfer (Host, DWEMMC_CTRL_FIFO_RESET);
+      if (EFI_ERROR (Status)) {
+        return Status;
       }
     }
   }
 
-  MmioWrite32 (DWEMMC_BLKSIZ, 512);
-  MmioWrite32 (DWEMMC_BYTCNT, Length);
+  MmioWrite32 (Host->Base + DWEMMC_BLKSIZ, 512);
+  MmioWrite32 (Host->Base + DWEMMC_BYTCNT, Length);
 
-  Status = SendCommand (mDwEmmcCommand, mDwEmmcArgument);
+  Status = SendCommand (Host, Host->Command, Host->Argument);
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "Failed to read data, mDwEmmcCommand:%x, mDwEmmcArgument:%x, Status:%r\n", mDwEmmcCommand, mDwEmmcArgument, Status));
+    DEBUG ((DEBUG_ERROR, "Failed to read data, Command:%x, Argument:%x, Status:%r\n", Host->Command, Host->Argument, Status));
     return EFI_DEVICE_ERROR;
   }
 
   DEBUG((DW_DBG, "Sdmmc::SdmmcReadBlockData  DataLen=%d\n", DataLen));
   TimeOut = 1000000;
   while (DataLen) {
-    if (MmioRead32(DWEMMC_RINTSTS) & (DWEMMC_INT_DRT | DWEMMC_INT_SBE | DWEMMC_INT_EBE | DWEMMC_INT_DCRC))  {
+    if (MmioRead32(Host->Base + DWEMMC_RINTSTS) & (DWEMMC_INT_DRT | DWEMMC_INT_SBE | DWEMMC_INT_EBE | DWEMMC_INT_DCRC))  {
       DEBUG ((DEBUG_ERROR, "%a(): EFI_DEVICE_ERROR DWEMMC_RINTSTS=0x%x DataLen=%d\n",
-        __func__, MmioRead32(DWEMMC_RINTSTS), DataLen));
+        __func__, MmioRead32(Host->Base + DWEMMC_RINTSTS), DataLen));
       return EFI_DEVICE_ERROR;
     }
 
-    while((!(MmioRead32(DWEMMC_STATUS) & FIFO_EMPTY)) && DataLen) {
-      *Buffer++ = MmioRead32(DWEMMC_MSHCI_FIFO);
+    while((!(MmioRead32(Host->Base + DWEMMC_STATUS) & DWEMMC_STS_FIFO_EMPTY)) && DataLen) {
+      *Buffer++ = MmioRead32(Host->Base + DWEMMC_FIFO_DATA);
       DataLen--;
       TimeOut = 1000000;
     }
 
     if (!DataLen) {
-      ret = (MmioRead32(DWEMMC_RINTSTS) & (DWEMMC_INT_DRT | DWEMMC_INT_SBE | DWEMMC_INT_EBE | DWEMMC_INT_DCRC))?
+      ret = (MmioRead32(Host->Base + DWEMMC_RINTSTS) & (DWEMMC_INT_DRT | DWEMMC_INT_SBE | DWEMMC_INT_EBE | DWEMMC_INT_DCRC))?
         EFI_DEVICE_ERROR : EFI_SUCCESS;
       DEBUG((DW_DBG, "%a(): DataLen end :%d\n", __func__, ret));
       break;
@@ -595,85 +1062,166 @@ DwEmmcReadBlockData (
   return ret;
 }
 
-#define MMC_GET_FCNT(x)		        (((x)>>17) & 0x1FF)
-#define INTMSK_HTO      (0x1<<10)
-
-/* Common flag combinations */
-#define MMC_DATA_ERROR_FLAGS (DWEMMC_INT_DRT | DWEMMC_INT_DCRC | DWEMMC_INT_FRUN | \
-	DWEMMC_INT_HLE | INTMSK_HTO | DWEMMC_INT_SBE  | \
-	DWEMMC_INT_EBE)
-
 EFI_STATUS
-DwEmmcWriteBlockData (
+EFIAPI
+DwEmmcReadBlockData (
   IN EFI_MMC_HOST_PROTOCOL     *This,
   IN EFI_LBA                    Lba,
   IN UINTN                      Length,
   IN UINT32*                    Buffer
   )
+{
+  DWEMMC_HOST     *Host;
+  DMA_BOUNCE_MAP  Map;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+  if (DwEmmcDmaMap (Host, Length, Buffer, TRUE, &Map)) {
+    return DwEmmcDmaTransfer (Host, &Map);
+  }
+  return DwEmmcReadBlockDataPio (Host, Length, Buffer);
+}
+
+/**
+  Push words into the FIFO, which must have room for all of them.
+
+  The FIFO is 32 bits wide on this controller so every store is a 32-bit
+  one, unrolled to keep the loop overhead off the bus.
+
+**/
+STATIC
+VOID
+DwEmmcWriteFifo (
+  IN DWEMMC_HOST                *Host,
+  IN CONST UINT32               *Buffer,
+  IN UINTN                      Count
+  )
+{
+  UINTN Fifo;
+
+  Fifo = Host->Base + DWEMMC_FIFO_DATA;
+  while (Count >= 4) {
+    MmioWrite32 (Fifo, Buffer[0]);
+    MmioWrite32 (Fifo, Buffer[1]);
+    MmioWrite32 (Fifo, Buffer[2]);
+    MmioWrite32 (Fifo, Buffer[3]);
+    Buffer += 4;
+    Count -= 4;
+  }
+  while (Count > 0) {
+    MmioWrite32 (Fifo, *Buffer++);
+    Count--;
+  }
+}
+
+STATIC
+EFI_STATUS
+DwEmmcWriteBlockDataPio (
+  IN DWEMMC_HOST                *Host,
+  IN UINTN                      Length,
+  IN UINT32*                    Buffer
+  )
 {
   UINT32 *DataBuffer = Buffer;
-  UINTN Count=0;
+  UINTN Count;
   UINTN Size32 = Length / 4;
-  UINT32 Mask;
+  UINT32 Mask = 0;
+  UINT64 Deadline;
   EFI_STATUS	Status;
-  UINT32		Data;
-  UINT32		TimeOut = 0;
-  UINT32		value = 0;
 
   DEBUG ((DW_DBG, "%a():\n", __func__));
 
-  if (mDwEmmcCommand & BIT_CMD_WAIT_PRVDATA_COMPLETE) {
-    do {
-      Data = MmioRead32 (DWEMMC_STATUS);
-    } while (Data & DWEMMC_STS_DATA_BUSY);
+  Status = DwEmmcWaitIdle (Host, (Host->Command & BIT_CMD_WAIT_PRVDATA_COMPLETE) != 0,
+             DWEMMC_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
 
-  if (!(((mDwEmmcCommand&0x3f) == 6) || ((mDwEmmcCommand&0x3f) == 51))) {
-    if ((mDwEmmcCommand & BIT_CMD_STOP_ABORT_CMD) || (mDwEmmcCommand & BIT_CMD_DATA_EXPECTED)) {
-      if (!(MmioRead32 (DWEMMC_STATUS) & FIFO_EMPTY)) {
-        Data = MmioRead32 (DWEMMC_CTRL);
-        Data |= FIFO_RESET;
-        MmioWrite32 (DWEMMC_CTRL, Data);
-
-        TimeOut = 100000;
-        while (((value = MmioRead32 (DWEMMC_CTRL)) & (FIFO_RESET)) && (TimeOut > 0)) {
-          TimeOut--;
-        }
-        if (TimeOut == 0) {
-          DEBUG ((DEBUG_ERROR, "%a():  CMD=%d SDC_SDC_ERROR\n", __func__, mDwEmmcCommand&0x3f));
-          return EFI_DEVICE_ERROR;
+  if (!(((Host->Command&0x3f) == 6) || ((Host->Command&0x3f) == 51))) {
+    if ((Host->Command & BIT_CMD_STOP_ABORT_CMD) || (Host->Command & BIT_CMD_DATA_EXPECTED)) {
+      if (!(MmioRead32 (Host->Base + DWEMMC_STATUS) & DWEMMC_STS_FIFO_EMPTY)) {
+        Status = DwEmmcPrepareTransfer (Host, DWEMMC_CTRL_FIFO_RESET);
+        if (EFI_ERROR (Status)) {
+          return Status;
         }
       }
     }
   }
 
-  MmioWrite32 (DWEMMC_BLKSIZ, 512);
-  MmioWrite32 (DWEMMC_BYTCNT, Length);
+  MmioWrite32 (Host->Base + DWEMMC_BLKSIZ, 512);
+  MmioWrite32 (Host->Base + DWEMMC_BYTCNT, Length);
 
-  Status = SendCommand (mDwEmmcCommand, mDwEmmcArgument);
+  Status = SendCommand (Host, Host->Command, Host->Argument);
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "Failed to write data, mDwEmmcCommand:%x, mDwEmmcArgument:%x, Status:%r\n", mDwEmmcCommand, mDwEmmcArgument, Status));
+    DEBUG ((DEBUG_ERROR, "Failed to write data, Command:%x, Argument:%x, Status:%r\n", Host->Command, Host->Argument, Status));
     return EFI_DEVICE_ERROR;
   }
 
-  for (Count = 0; Count < Size32; Count++) {
-    while(MMC_GET_FCNT(MmioRead32(DWEMMC_STATUS)) >32)
-    MicroSecondDelay(1);
-    MmioWrite32((DWEMMC_MSHCI_FIFO), *DataBuffer++);
+  //
+  // Refill the FIFO a burst at a time whenever it drains down to the TX
+  // watermark, the burst size is known so the FIFO count is never read.
+  //
+  Deadline = DwEmmcGetDeadline (DWEMMC_BUSY_TIMEOUT_US);
+  while (Size32 > 0) {
+    Mask = MmioRead32 (Host->Base + DWEMMC_RINTSTS);
+    if (Mask & MMC_DATA_ERROR_FLAGS) {
+      break;
+    }
+    if (!(Mask & DWEMMC_INT_TXDR)) {
+      if (GetPerformanceCounter () >= Deadline) {
+        break;
+      }
+      continue;
+    }
+
+    // Acknowledge first, the next drain to the watermark raises it again
+    MmioWrite32 (Host->Base + DWEMMC_RINTSTS, DWEMMC_INT_TXDR);
+    Count = MIN (Size32, Host->FifoBurst);
+    DwEmmcWriteFifo (Host, DataBuffer, Count);
+    DataBuffer += Count;
+    Size32 -= Count;
+    Deadline = DwEmmcGetDeadline (DWEMMC_BUSY_TIMEOUT_US);
   }
 
-  do {
-    Mask = MmioRead32(DWEMMC_RINTSTS);
-    if (Mask & (MMC_DATA_ERROR_FLAGS)) {
-      DEBUG((DEBUG_ERROR, "SdmmcWriteData error, RINTSTS = 0x%08x\n", Mask));
-      return EFI_DEVICE_ERROR;
-    }
-  } while (!(Mask & DWEMMC_INT_DTO));
+  if (Size32 == 0) {
+    Deadline = DwEmmcGetDeadline (DWEMMC_BUSY_TIMEOUT_US);
+    do {
+      Mask = MmioRead32 (Host->Base + DWEMMC_RINTSTS);
+      if ((Mask & (MMC_DATA_ERROR_FLAGS | DWEMMC_INT_DTO)) != 0) {
+        break;
+      }
+    } while (GetPerformanceCounter () < Deadline);
+  }
+
+  if ((Size32 != 0) || !(Mask & DWEMMC_INT_DTO) || (Mask & MMC_DATA_ERROR_FLAGS)) {
+    DEBUG ((DEBUG_ERROR, "SdmmcWriteData error, RINTSTS = 0x%08x, %d words left\n", Mask, (UINT32)Size32));
+    DwEmmcPrepareTransfer (Host, DWEMMC_CTRL_FIFO_RESET);
+    return (Mask & MMC_DATA_ERROR_FLAGS) ? EFI_DEVICE_ERROR : EFI_TIMEOUT;
+  }
 
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
+EFIAPI
+DwEmmcWriteBlockData (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN EFI_LBA                    Lba,
+  IN UINTN                      Length,
+  IN UINT32*                    Buffer
+  )
+{
+  DWEMMC_HOST     *Host;
+  DMA_BOUNCE_MAP  Map;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+  if (DwEmmcDmaMap (Host, Length, Buffer, FALSE, &Map)) {
+    return DwEmmcDmaTransfer (Host, &Map);
+  }
+  return DwEmmcWriteBlockDataPio (Host, Length, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
 DwEmmcSetIos (
   IN EFI_MMC_HOST_PROTOCOL      *This,
   IN  UINT32                    BusClockFreq,
@@ -681,11 +1229,14 @@ DwEmmcSetIos (
   IN  UINT32                    TimingMode
   )
 {
+  DWEMMC_HOST *Host;
   EFI_STATUS Status = EFI_SUCCESS;
   UINT32    Data;
 
+  Host = DWEMMC_HOST_FROM_MMC_HOST (This);
+
   if (TimingMode != EMMCBACKWARD) {
-    Data = MmioRead32 (DWEMMC_UHSREG);
+    Data = MmioRead32 (Host->Base + DWEMMC_UHSREG);
     switch (TimingMode) {
     case EMMCHS52DDR1V2:
     case EMMCHS52DDR1V8:
@@ -696,31 +1247,36 @@ DwEmmcSetIos (
       Data &= ~(1 << 16);
       break;
     default:
+      //
+      // The controller drives the SD slot, the HS200 and HS400 modes of
+      // an eMMC are left to the host of the eMMC.
+      //
       return EFI_UNSUPPORTED;
     }
-    MmioWrite32 (DWEMMC_UHSREG, Data);
+    MmioWrite32 (Host->Base + DWEMMC_UHSREG, Data);
   }
 
   switch (BusWidth) {
   case 1:
-    MmioWrite32 (DWEMMC_CTYPE, 0);
+    MmioWrite32 (Host->Base + DWEMMC_CTYPE, 0);
     break;
   case 4:
-    MmioWrite32 (DWEMMC_CTYPE, 1);
+    MmioWrite32 (Host->Base + DWEMMC_CTYPE, 1);
     break;
   case 8:
-    MmioWrite32 (DWEMMC_CTYPE, 1 << 16);
+    MmioWrite32 (Host->Base + DWEMMC_CTYPE, 1 << 16);
     break;
   default:
     return EFI_UNSUPPORTED;
   }
   if (BusClockFreq) {
-    Status = DwEmmcSetClock (BusClockFreq);
+    Status = DwEmmcSetClock (Host, BusClockFreq);
   }
   return Status;
 }
 
 BOOLEAN
+EFIAPI
 DwEmmcIsMultiBlock (
   IN EFI_MMC_HOST_PROTOCOL      *This
   )
@@ -728,7 +1284,175 @@ DwEmmcIsMultiBlock (
   return TRUE;
 }
 
-EFI_MMC_HOST_PROTOCOL gMciHost = {
+EFI_STATUS
+EFIAPI
+DwEmmcGetCommandLatency (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This,
+  IN  UINT32                    CommandIndex,
+  OUT MMC_HOST_COMMAND_LATENCY  *Latency
+  )
+{
+  DWEMMC_HOST  *Host;
+
+  if ((CommandIndex >= MMC_HOST_DEBUG_MAX_COMMANDS) || (Latency == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Host = DWEMMC_HOST_FROM_MMC_HOST_DEBUG (This);
+  CopyMem (Latency, &Host->Latency[CommandIndex], sizeof (MMC_HOST_COMMAND_LATENCY));
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwEmmcResetLatency (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This
+  )
+{
+  DWEMMC_HOST  *Host;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST_DEBUG (This);
+  ZeroMem (Host->Latency, sizeof (Host->Latency));
+  return EFI_SUCCESS;
+}
+
+VOID
+EFIAPI
+DwEmmcDumpLatency (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This
+  )
+{
+  DWEMMC_HOST               *Host;
+  MMC_HOST_COMMAND_LATENCY  *Latency;
+  UINTN                     Index;
+  UINTN                     Bucket;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST_DEBUG (This);
+  for (Index = 0; Index < MMC_HOST_DEBUG_MAX_COMMANDS; Index++) {
+    Latency = &Host->Latency[Index];
+    if (Latency->Count == 0) {
+      continue;
+    }
+    DEBUG ((DEBUG_INFO, "CMD%d: count %ld errors %ld avg %ldus max %ldus\n",
+      Index, Latency->Count, Latency->Errors,
+      DivU64x64Remainder (Latency->TotalUs, Latency->Count, NULL), Latency->MaxUs));
+    for (Bucket = 0; Bucket < MMC_HOST_DEBUG_LATENCY_BUCKETS; Bucket++) {
+      if (Latency->Buckets[Bucket] != 0) {
+        DEBUG ((DEBUG_INFO, "  %a%ldus: %d\n",
+          (Bucket == MMC_HOST_DEBUG_LATENCY_BUCKETS - 1) ? ">=" : "<",
+          (Bucket == MMC_HOST_DEBUG_LATENCY_BUCKETS - 1) ? LShiftU64 (1, Bucket - 1) : LShiftU64 (1, Bucket),
+          Latency->Buckets[Bucket]));
+      }
+    }
+  }
+}
+
+STATIC CONST MMC_HOST_DEBUG_PROTOCOL mDwEmmcHostDebugTemplate = {
+  MMC_HOST_DEBUG_PROTOCOL_REVISION,
+  DwEmmcGetCommandLatency,
+  DwEmmcResetLatency,
+  DwEmmcDumpLatency
+};
+
+VOID
+EFIAPI
+DwEmmcCardDetectInterrupt (
+  IN  HARDWARE_INTERRUPT_SOURCE   Source,
+  IN  EFI_SYSTEM_CONTEXT          SystemContext
+  )
+{
+  DWEMMC_HOST  *Host;
+  UINTN        Index;
+
+  for (Index = 0; Index < mDwEmmcHostCount; Index++) {
+    Host = mDwEmmcHosts[Index];
+    if (Host->Interrupt != Source) {
+      continue;
+    }
+    if ((MmioRead32 (Host->Base + DWEMMC_RINTSTS) & DWEMMC_INT_CD) != 0) {
+      MmioWrite32 (Host->Base + DWEMMC_RINTSTS, DWEMMC_INT_CD);
+      if (Host->CardDetectEvent != NULL) {
+        gBS->SignalEvent (Host->CardDetectEvent);
+      }
+    }
+  }
+  mDwEmmcInterrupt->EndOfInterrupt (mDwEmmcInterrupt, Source);
+}
+
+EFI_STATUS
+EFIAPI
+DwEmmcRegisterCardDetect (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  EFI_EVENT                 Event
+  )
+{
+  DWEMMC_HOST *Host;
+  EFI_STATUS  Status;
+  UINT32      Source;
+
+  Host = DWEMMC_HOST_FROM_MMC_HOST_EXT (This);
+  if (Host->NonRemovable) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Source = Host->Interrupt;
+  if (Event == NULL) {
+    if (Host->CardDetectEvent != NULL) {
+      MmioAnd32 (Host->Base + DWEMMC_INTMASK, ~DWEMMC_INT_CD);
+      mDwEmmcInterrupt->DisableInterruptSource (mDwEmmcInterrupt, Source);
+      mDwEmmcInterrupt->RegisterInterruptSource (mDwEmmcInterrupt, Source, NULL);
+      Host->CardDetectEvent = NULL;
+    }
+    return EFI_SUCCESS;
+  }
+
+  if ((Source == 0) || (Host->CardDetectEvent != NULL)) {
+    return EFI_UNSUPPORTED;
+  }
+  if (mDwEmmcInterrupt == NULL) {
+    Status = gBS->LocateProtocol (&gHardwareInterruptProtocolGuid, NULL, (VOID **)&mDwEmmcInterrupt);
+    if (EFI_ERROR (Status)) {
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  Status = mDwEmmcInterrupt->RegisterInterruptSource (mDwEmmcInterrupt, Source,
+                               DwEmmcCardDetectInterrupt);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+  Host->CardDetectEvent = Event;
+
+  // Let the controller filter out the contact bounce of the socket
+  MmioWrite32 (Host->Base + DWEMMC_DEBNCE, MIN (Host->ClockFrequency / 2 / 1000 * DWEMMC_DEBOUNCE_MS,
+                                                0xFFFFFF));
+  MmioWrite32 (Host->Base + DWEMMC_RINTSTS, DWEMMC_INT_CD);
+  MmioOr32 (Host->Base + DWEMMC_INTMASK, DWEMMC_INT_CD);
+  MmioOr32 (Host->Base + DWEMMC_CTRL, DWEMMC_CTRL_INT_EN);
+  mDwEmmcInterrupt->EnableInterruptSource (mDwEmmcInterrupt, Source);
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwEmmcWaitBusy (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  UINT64                    TimeoutUs
+  )
+{
+  // DATA_BUSY follows DAT0 of the card
+  return DwEmmcWaitIdle (DWEMMC_HOST_FROM_MMC_HOST_EXT (This), TRUE, TimeoutUs);
+}
+
+STATIC CONST MMC_HOST_EXT_PROTOCOL mDwEmmcHostExtTemplate = {
+  MMC_HOST_EXT_PROTOCOL_REVISION,
+  MMC_HOST_EXT_CAP_SET_BLOCK_COUNT,
+  DWEMMC_MAX_BLOCK_COUNT,
+  DwEmmcRegisterCardDetect,
+  DwEmmcWaitBusy
+};
+
+STATIC CONST EFI_MMC_HOST_PROTOCOL mDwEmmcHostTemplate = {
   MMC_HOST_PROTOCOL_REVISION,
   DwEmmcIsCardPresent,
   DwEmmcIsReadOnly,
@@ -747,33 +1471,17 @@ DwEmmcIomux (
   void
   )
 {
-  UINT32 PllRate;
-
   DEBUG ((DW_DBG, "%a():\n", __func__));
 
   CruWritel((0x1 << ( 10 + 16)) | (1 << 10), CRU_SOFTRSTS_CON(7));
   MicroSecondDelay(5);
   CruWritel((0x1 << ( 10 + 16)) | (0 << 10), CRU_SOFTRSTS_CON(7));
 
-  PllRate = rk3399_pll_get_rate(PLL_GPLL);
-  DEBUG ((DEBUG_ERROR, "%a(): GPLL PllRate=%d\n", __func__, PllRate));
-
-  if (PllRate == 800000000) {
-    /*
-     * Select GPLL for clk_sdmmc_pll_sel.
-     */
-    CruWritel((0x7 << ( 8 + 16)) | (0x1 << 8), CRU_CLKSELS_CON(16));
-    /*
-     * 100MHz = clk = clk_src / (clk_sddmmc_div_con + 1), clk_sddmmc_div_con == 3.
-     */
-    CruWritel((0x7f << ( 0 + 16)) | (0x7 << 0), CRU_CLKSELS_CON(16));
-    /*
-     * Ungate clk_sdmmc_src_en.
-     */
-    CruWritel((0x1 << ( 1 + 16)) | (0 << 1), CRU_CLKGATES_CON(6));
-  } else {
-    DEBUG ((DEBUG_ERROR, "%a(): GPLL != 800MHz, set sdmmc clock error!!!\n", __func__));
-  }
+  /*
+   * Ungate clk_sdmmc_src_en. The source and divider in CRU_CLKSELS_CON(16)
+   * are set by DwEmmcSetClock() from the GPLL rate found at run time.
+   */
+  CruWritel((0x1 << ( 1 + 16)) | (0 << 1), CRU_CLKGATES_CON(6));
 
   GrfWritel((0x3 << ( 8 + 16)) | (0x1 << 8) ,GRF_GPIO4B_IOMUX);
   GrfWritel((0x3 << ( 10 + 16)) | (0x1 << 10) ,GRF_GPIO4B_IOMUX);
@@ -787,33 +1495,118 @@ DwEmmcIomux (
   return EFI_SUCCESS;
 }
 
+/**
+  Create the context of one controller and publish its protocols on a new
+  handle.
+
+  @param[in]  Base            Base address of the controller registers.
+  @param[in]  ClockFrequency  Input clock of the controller in Hz.
+  @param[in]  ClockId         CRU clock feeding the controller.
+  @param[in]  Interrupt       Interrupt line of the controller, 0 if none.
+  @param[in]  NonRemovable    The card can not be removed.
+
+**/
+STATIC
 EFI_STATUS
-DwEmmcDxeInitialize (
-  IN EFI_HANDLE         ImageHandle,
-  IN EFI_SYSTEM_TABLE   *SystemTable
+DwEmmcCreateHost (
+  IN UINTN                      Base,
+  IN UINT32                     ClockFrequency,
+  IN UINT32                     ClockId,
+  IN UINT32                     Interrupt,
+  IN BOOLEAN                    NonRemovable
   )
 {
-  EFI_STATUS    Status;
-  EFI_HANDLE    Handle;
+  EFI_STATUS            Status;
+  DWEMMC_HOST           *Host;
+  EFI_PHYSICAL_ADDRESS  DescAddress;
+  EFI_PHYSICAL_ADDRESS  BounceAddress;
 
-  DwEmmcIomux();
+  if (mDwEmmcHostCount == DWEMMC_MAX_HOSTS) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-  Handle = NULL;
+  Host = AllocateZeroPool (sizeof (DWEMMC_HOST));
+  if (Host == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Host->Signature = DWEMMC_HOST_SIGNATURE;
+  Host->Base = Base;
+  Host->ClockFrequency = ClockFrequency;
+  Host->ClockId = ClockId;
+  Host->Interrupt = Interrupt;
+  Host->NonRemovable = NonRemovable;
+  CopyMem (&Host->MmcHost, &mDwEmmcHostTemplate, sizeof (EFI_MMC_HOST_PROTOCOL));
+  CopyMem (&Host->MmcHostDebug, &mDwEmmcHostDebugTemplate, sizeof (MMC_HOST_DEBUG_PROTOCOL));
+  CopyMem (&Host->MmcHostExt, &mDwEmmcHostExtTemplate, sizeof (MMC_HOST_EXT_PROTOCOL));
+  if (NonRemovable) {
+    Host->MmcHostExt.Capabilities |= MMC_HOST_EXT_CAP_NON_REMOVABLE;
+  }
 
-  gpIdmacDesc = (DWEMMC_IDMAC_DESCRIPTOR *)AllocatePages (DWEMMC_MAX_DESC_PAGES);
-  if (gpIdmacDesc == NULL) {
-    return EFI_BUFFER_TOO_SMALL;
+  //
+  // The IDMAC can only follow 32-bit descriptor addresses.
+  //
+  DescAddress = MAX_UINT32;
+  Status = gBS->AllocatePages (AllocateMaxAddress, EfiBootServicesData,
+                  DWEMMC_MAX_DESC_PAGES, &DescAddress);
+  if (EFI_ERROR (Status)) {
+    FreePool (Host);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Host->IdmacDesc = (DWEMMC_IDMAC_DESCRIPTOR *)(UINTN)DescAddress;
+
+  //
+  // Without bounce pages only cache line aligned buffers below 4GB can be
+  // moved by the IDMAC, the FIFO moves the others.
+  //
+  BounceAddress = MAX_UINT32;
+  Status = gBS->AllocatePages (AllocateMaxAddress, EfiBootServicesData,
+                  DWEMMC_BOUNCE_PAGES, &BounceAddress);
+  if (!EFI_ERROR (Status)) {
+    Host->Bounce = (UINT8 *)(UINTN)BounceAddress;
   }
 
-  DEBUG ((DEBUG_BLKIO, "DwEmmcDxeInitialize()\n"));
+  DEBUG ((DEBUG_BLKIO, "%a(): controller at 0x%lx\n", __func__, (UINT64)Base));
 
   //Publish Component Name, BlockIO protocol interfaces
   Status = gBS->InstallMultipleProtocolInterfaces (
-                  &Handle,
-                  &gEmbeddedMmcHostProtocolGuid,         &gMciHost,
+                  &Host->Handle,
+                  &gEmbeddedMmcHostProtocolGuid,         &Host->MmcHost,
+                  &gMmcHostDebugProtocolGuid,            &Host->MmcHostDebug,
+                  &gMmcHostExtProtocolGuid,              &Host->MmcHostExt,
                   NULL
                   );
-  ASSERT_EFI_ERROR (Status);
+  if (EFI_ERROR (Status)) {
+    if (Host->Bounce != NULL) {
+      gBS->FreePages (BounceAddress, DWEMMC_BOUNCE_PAGES);
+    }
+    gBS->FreePages (DescAddress, DWEMMC_MAX_DESC_PAGES);
+    FreePool (Host);
+    return Status;
+  }
 
+  mDwEmmcHosts[mDwEmmcHostCount++] = Host;
   return EFI_SUCCESS;
 }
+
+EFI_STATUS
+DwEmmcDxeInitialize (
+  IN EFI_HANDLE         ImageHandle,
+  IN EFI_SYSTEM_TABLE   *SystemTable
+  )
+{
+  EFI_STATUS            Status;
+
+  DwEmmcIomux();
+
+  DEBUG ((DEBUG_BLKIO, "DwEmmcDxeInitialize()\n"));
+
+  // The sdmmc controller drives the SD card slot
+  Status = DwEmmcCreateHost (PcdGet32 (PcdDwEmmcDxeBaseAddress),
+             PcdGet32 (PcdDwEmmcDxeClockFrequencyInHz),
+             SCLK_SDMMC,
+             PcdGet32 (PcdDwEmmcDxeInterrupt),
+             FeaturePcdGet (PcdDwEmmcDxeNonRemovable));
+  ASSERT_EFI_ERROR (Status);
+
+  return Status;
+}
@@ -0,0 +1,516 @@
+/** @file
+  Data path of the DesignWare MMC host driver
+
+  Checks the descriptor chains the driver builds for the IDMAC, the byte
+  counts it programs and the way it stages the buffers the IDMAC can not
+  move in place, against the register model of the controller.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+
+#include "DwEmmcDxeHostTest.h"
+
+// Largest buffer of one descriptor, DWEMMC_DMA_BUF_SIZE in the driver
+#define DW_EMMC_TEST_DESC_SIZE    4096
+// As ArmDataCacheLineLength() reports it
+#define DW_EMMC_TEST_CACHE_LINE   64
+// Bounce pages of the driver, DWEMMC_BOUNCE_PAGES
+#define DW_EMMC_TEST_BOUNCE_SIZE  EFI_PAGES_TO_SIZE (32)
+
+// Blocks the tests write to, above those a read of MaxBlockCount covers
+#define DW_EMMC_TEST_WRITE_LBA    0x12000
+
+#define DW_EMMC_TEST_FILL         0xA5
+
+//
+// Buffers of the running test case, freed when it ends
+//
+typedef struct {
+  UINT8                     *Low;
+  UINTN                     LowPages;
+  UINT8                     *High;
+  UINTN                     HighSize;
+} DW_EMMC_DMA_CONTEXT;
+
+STATIC DW_EMMC_DMA_CONTEXT  mDmaContext;
+
+STATIC
+UINT8 *
+DwEmmcDmaAllocateLow (
+  IN DW_EMMC_DMA_CONTEXT    *Context,
+  IN UINTN                  Size
+  )
+{
+  Context->LowPages = EFI_SIZE_TO_PAGES (Size);
+  Context->Low = SimAllocateLowPages (Context->LowPages);
+  if (Context->Low != NULL) {
+    SetMem (Context->Low, EFI_PAGES_TO_SIZE (Context->LowPages), DW_EMMC_TEST_FILL);
+  }
+  return Context->Low;
+}
+
+STATIC
+UINT8 *
+DwEmmcDmaAllocateHigh (
+  IN DW_EMMC_DMA_CONTEXT    *Context,
+  IN UINTN                  Size
+  )
+{
+  Context->HighSize = Size;
+  Context->High = SimHighMemoryMap (Size);
+  return Context->High;
+}
+
+STATIC
+VOID
+EFIAPI
+DwEmmcDmaTestStop (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  DW_EMMC_DMA_CONTEXT       *Dma;
+
+  Dma = Context;
+  if (Dma->Low != NULL) {
+    SimFreeLowPages (Dma->Low, Dma->LowPages);
+    Dma->Low = NULL;
+  }
+  if (Dma->High != NULL) {
+    SimMemoryUnmap (Dma->High, Dma->HighSize);
+    Dma->High = NULL;
+  }
+}
+
+/**
+  Check the chain the IDMAC walked in the last transfer: DescCount
+  descriptors covering Length bytes, each at most DW_EMMC_TEST_DESC_SIZE,
+  linked one after the other in the pool. Only the first one starts the
+  transfer, only the last one ends it and raises the interrupt.
+**/
+STATIC
+UNIT_TEST_STATUS
+DwEmmcDmaCheckChain (
+  IN UINTN                  Length,
+  IN UINTN                  DescCount
+  )
+{
+  DW_MMC_SIM                *Sim;
+  DW_MMC_SIM_DESCRIPTOR     *Desc;
+  UINTN                     Index;
+  UINTN                     Total;
+  UINT32                    Size;
+  UINT32                    Expected;
+  UINT32                    Pool;
+
+  Sim = gDwMmcSim;
+  UT_ASSERT_EQUAL (Sim->Errors, 0);
+  UT_ASSERT_TRUE (Sim->LastTransfer.Idmac);
+  UT_ASSERT_FALSE (Sim->LastTransfer.Failed);
+  UT_ASSERT_EQUAL (Sim->LastTransfer.ByteCount, Length);
+  UT_ASSERT_EQUAL (Sim->DescCount, DescCount);
+
+  Pool = Sim->Regs[DWEMMC_DBADDR / sizeof (UINT32)];
+  Total = 0;
+  for (Index = 0; Index < DescCount; Index++) {
+    Desc = &Sim->Desc[Index];
+    Expected = DWEMMC_IDMAC_DES0_OWN;
+    if (Index == 0) {
+      Expected |= DWEMMC_IDMAC_DES0_FS;
+    }
+    if (Index == DescCount - 1) {
+      Expected |= DWEMMC_IDMAC_DES0_LD;
+      UT_ASSERT_EQUAL (Desc->Des3, 0);
+    } else {
+      Expected |= DWEMMC_IDMAC_DES0_CH | DWEMMC_IDMAC_DES0_DIC;
+      UT_ASSERT_EQUAL (Desc->Des3, Pool + (Index + 1) * sizeof (DW_MMC_SIM_DESCRIPTOR));
+    }
+    UT_ASSERT_EQUAL (Desc->Des0, Expected);
+
+    Size = DWEMMC_IDMAC_DES1_BS1 (Desc->Des1);
+    UT_ASSERT_TRUE ((Size > 0) && (Size <= DW_EMMC_TEST_DESC_SIZE));
+    Total += Size;
+  }
+  UT_ASSERT_EQUAL (Total, Length);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A buffer below 4GB on a cache line boundary is moved in place, in
+  descriptors of DW_EMMC_TEST_DESC_SIZE bytes and a shorter last one.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestReadChain (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINTN                     Length;
+  UINT8                     *Buffer;
+  UNIT_TEST_STATUS          Result;
+
+  Length = 129 * 512;
+  Buffer = DwEmmcDmaAllocateLow (Context, Length);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 1000, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, 17);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_EQUAL (gDwMmcSim->LastTransfer.Index, 18);
+  UT_ASSERT_EQUAL (gDwMmcSim->LastTransfer.Argument, 1000);
+  UT_ASSERT_EQUAL (gDwMmcSim->Desc[0].Des2, (UINTN)Buffer);
+  UT_ASSERT_EQUAL (DWEMMC_IDMAC_DES1_BS1 (gDwMmcSim->Desc[16].Des1), 512);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 1000, 129, 0));
+  UT_ASSERT_EQUAL (gDwMmcSim->Commands[12], 1);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestWriteChain (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINTN                     Length;
+  UINT8                     *Buffer;
+  EFI_LBA                   Lba;
+  UNIT_TEST_STATUS          Result;
+
+  Lba = DW_EMMC_TEST_WRITE_LBA;
+  Length = 129 * 512;
+  Buffer = DwEmmcDmaAllocateLow (Context, Length);
+  UT_ASSERT_NOT_NULL (Buffer);
+  DwMmcSimFillPattern (Lba, 129, 0x11, Buffer);
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (TRUE, Lba, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, 17);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_EQUAL (gDwMmcSim->LastTransfer.Index, 25);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, 129, 0x11));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A single block is one descriptor, both first and last.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestSingleBlock (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  UNIT_TEST_STATUS          Result;
+
+  Buffer = DwEmmcDmaAllocateLow (Context, 64 * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  // A long chain first, the short one must not pick up any of it
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 1200, 64 * 512, Buffer));
+  Result = DwEmmcDmaCheckChain (64 * 512, 8);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 1300, 512, Buffer));
+  Result = DwEmmcDmaCheckChain (512, 1);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_EQUAL (gDwMmcSim->LastTransfer.Index, 17);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 1300, 1, 0));
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer + 512, 1201, 63, 0));
+  UT_ASSERT_EQUAL (gDwMmcSim->Commands[12], 1);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The partial cache lines at both ends of a buffer are staged in the bounce
+  pages, each in a descriptor of its own, and the rest is moved in place.
+  Nothing around the buffer is touched.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestUnaligned (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Page;
+  UINT8                     *Buffer;
+  UINTN                     Length;
+  UINTN                     Head;
+  UINTN                     Tail;
+  EFI_LBA                   Lba;
+  UNIT_TEST_STATUS          Result;
+
+  Length = 8 * 512;
+  Page = DwEmmcDmaAllocateLow (Context, Length + 2 * DW_EMMC_TEST_CACHE_LINE);
+  UT_ASSERT_NOT_NULL (Page);
+  Buffer = Page + 8;
+  Head = DW_EMMC_TEST_CACHE_LINE - 8;
+  Tail = 8;
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 2000, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, 3);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_EQUAL (DWEMMC_IDMAC_DES1_BS1 (gDwMmcSim->Desc[0].Des1), Head);
+  UT_ASSERT_EQUAL (DWEMMC_IDMAC_DES1_BS1 (gDwMmcSim->Desc[1].Des1), Length - Head - Tail);
+  UT_ASSERT_EQUAL (DWEMMC_IDMAC_DES1_BS1 (gDwMmcSim->Desc[2].Des1), Tail);
+  UT_ASSERT_EQUAL (gDwMmcSim->Desc[1].Des2, (UINTN)Buffer + Head);
+  UT_ASSERT_TRUE ((gDwMmcSim->Desc[0].Des2 < (UINTN)Page) ||
+                  (gDwMmcSim->Desc[0].Des2 >= (UINTN)Buffer + Length));
+  UT_ASSERT_TRUE ((gDwMmcSim->Desc[2].Des2 < (UINTN)Page) ||
+                  (gDwMmcSim->Desc[2].Des2 >= (UINTN)Buffer + Length));
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 2000, 8, 0));
+  UT_ASSERT_EQUAL (Page[7], DW_EMMC_TEST_FILL);
+  UT_ASSERT_EQUAL (Buffer[Length], DW_EMMC_TEST_FILL);
+
+  Lba = DW_EMMC_TEST_WRITE_LBA + 0x1000;
+  DwMmcSimFillPattern (Lba, 8, 0x22, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (TRUE, Lba, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, 3);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, 8, 0x22));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A buffer above 4GB that fits in the bounce pages is staged as a whole.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestStaged (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  UINTN                     Length;
+  UINTN                     Index;
+  EFI_LBA                   Lba;
+  UNIT_TEST_STATUS          Result;
+
+  Length = 32 * 512;
+  Buffer = DwEmmcDmaAllocateHigh (Context, Length);
+  if (Buffer == NULL) {
+    UT_LOG_WARNING ("No memory above 4GB on this host\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 3000, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, Length / DW_EMMC_TEST_DESC_SIZE);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  for (Index = 1; Index < gDwMmcSim->DescCount; Index++) {
+    UT_ASSERT_EQUAL (gDwMmcSim->Desc[Index].Des2, gDwMmcSim->Desc[0].Des2 + Index * DW_EMMC_TEST_DESC_SIZE);
+  }
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 3000, 32, 0));
+
+  Lba = DW_EMMC_TEST_WRITE_LBA + 0x2000;
+  DwMmcSimFillPattern (Lba, 32, 0x33, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (TRUE, Lba, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, Length / DW_EMMC_TEST_DESC_SIZE);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, 32, 0x33));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A buffer above 4GB larger than the bounce pages goes through the FIFO,
+  which the driver must neither overrun nor underrun.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestFifo (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  UINTN                     Length;
+  UINTN                     Blocks;
+  EFI_LBA                   Lba;
+
+  Length = 2 * DW_EMMC_TEST_BOUNCE_SIZE;
+  Blocks = Length / 512;
+  Buffer = DwEmmcDmaAllocateHigh (Context, Length);
+  if (Buffer == NULL) {
+    UT_LOG_WARNING ("No memory above 4GB on this host\n");
+    return UNIT_TEST_SKIPPED;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 4000, Length, Buffer));
+  UT_ASSERT_EQUAL (gDwMmcSim->Errors, 0);
+  UT_ASSERT_FALSE (gDwMmcSim->LastTransfer.Idmac);
+  UT_ASSERT_EQUAL (gDwMmcSim->LastTransfer.ByteCount, Length);
+  UT_ASSERT_FALSE (gDwMmcSim->DataActive);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 4000, Blocks, 0));
+
+  Lba = DW_EMMC_TEST_WRITE_LBA + 0x3000;
+  DwMmcSimFillPattern (Lba, Blocks, 0x44, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (TRUE, Lba, Length, Buffer));
+  UT_ASSERT_EQUAL (gDwMmcSim->Errors, 0);
+  UT_ASSERT_FALSE (gDwMmcSim->LastTransfer.Idmac);
+  UT_ASSERT_FALSE (gDwMmcSim->DataActive);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, Blocks, 0x44));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The largest transfer the driver reports fits in its descriptor pool and
+  in the 16-bit block count of CMD23.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestMaxBlockCount (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  UINTN                     Length;
+  UINTN                     DescCount;
+  UNIT_TEST_STATUS          Result;
+
+  UT_ASSERT_EQUAL (gDwMmcHostExt->MaxBlockCount, MAX_UINT16);
+  Length = gDwMmcHostExt->MaxBlockCount * 512;
+  DescCount = (Length + DW_EMMC_TEST_DESC_SIZE - 1) / DW_EMMC_TEST_DESC_SIZE;
+  Buffer = DwEmmcDmaAllocateLow (Context, Length);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 0, Length, Buffer));
+  Result = DwEmmcDmaCheckChain (Length, DescCount);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_EQUAL (DWEMMC_IDMAC_DES1_BS1 (gDwMmcSim->Desc[DescCount - 1].Des1),
+    Length - (DescCount - 1) * DW_EMMC_TEST_DESC_SIZE);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 0, gDwMmcHostExt->MaxBlockCount, 0));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  An IDMAC bus error fails the transfer, and the reset of the FIFO and of
+  the DMA interface leaves the controller ready for the next one.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestIdmacError (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  UINTN                     DmaResets;
+  UNIT_TEST_STATUS          Result;
+
+  Buffer = DwEmmcDmaAllocateLow (Context, 16 * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  gDwMmcSim->FailIdsts = DWEMMC_IDSTS_FBE;
+  DmaResets = gDwMmcSim->DmaResets;
+  UT_ASSERT_STATUS_EQUAL (DwEmmcTestTransfer (FALSE, 5000, 16 * 512, Buffer), EFI_DEVICE_ERROR);
+  UT_ASSERT_TRUE (gDwMmcSim->LastTransfer.Failed);
+  // One reset before the transfer and one after the error
+  UT_ASSERT_EQUAL (gDwMmcSim->DmaResets, DmaResets + 2);
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (FALSE, 5000, 16 * 512, Buffer));
+  Result = DwEmmcDmaCheckChain (16 * 512, 2);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (Buffer, 5000, 16, 0));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A data CRC error on a write fails it, and the card keeps its content.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcDmaTestDataCrcError (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  UINT8                     *Buffer;
+  EFI_LBA                   Lba;
+  UNIT_TEST_STATUS          Result;
+
+  Buffer = DwEmmcDmaAllocateLow (Context, 16 * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+  Lba = DW_EMMC_TEST_WRITE_LBA + 0x4000;
+  DwMmcSimFillPattern (Lba, 16, 0x55, Buffer);
+
+  gDwMmcSim->FailRintsts = DWEMMC_INT_DCRC;
+  UT_ASSERT_STATUS_EQUAL (DwEmmcTestTransfer (TRUE, Lba, 16 * 512, Buffer), EFI_DEVICE_ERROR);
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, 16, 0));
+
+  UT_ASSERT_NOT_EFI_ERROR (DwEmmcTestTransfer (TRUE, Lba, 16 * 512, Buffer));
+  Result = DwEmmcDmaCheckChain (16 * 512, 2);
+  if (Result != UNIT_TEST_PASSED) {
+    return Result;
+  }
+  UT_ASSERT_TRUE (DwEmmcTestCheckPattern (gDwMmcSim->Image + Lba * 512, Lba, 16, 0x55));
+  return UNIT_TEST_PASSED;
+}
+
+EFI_STATUS
+DwEmmcDmaTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "DesignWare MMC data path", "DwEmmcDxe.Dma", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Aligned read in place", "ReadChain",
+    DwEmmcDmaTestReadChain, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Aligned write in place", "WriteChain",
+    DwEmmcDmaTestWriteChain, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Single block after a long chain", "SingleBlock",
+    DwEmmcDmaTestSingleBlock, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Partial cache lines staged", "Unaligned",
+    DwEmmcDmaTestUnaligned, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Buffer above 4GB staged", "Staged",
+    DwEmmcDmaTestStaged, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Large buffer above 4GB through the FIFO", "Fifo",
+    DwEmmcDmaTestFifo, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Largest transfer", "MaxBlockCount",
+    DwEmmcDmaTestMaxBlockCount, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "IDMAC bus error", "IdmacError",
+    DwEmmcDmaTestIdmacError, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+  AddTestCase (Suite, "Data CRC error", "DataCrcError",
+    DwEmmcDmaTestDataCrcError, DwEmmcTestStart, DwEmmcDmaTestStop, &mDmaContext);
+
+  return EFI_SUCCESS;
+}
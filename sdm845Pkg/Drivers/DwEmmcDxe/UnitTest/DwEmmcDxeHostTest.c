@@ -0,0 +1,179 @@
+/** @file
+  Host-based tests of the DesignWare MMC host driver
+
+  The driver is started once, as on a board, and every test case begins
+  with the controller put back to its reset state and initialised again by
+  the driver. The card content is shared: it holds DwMmcSimFillPattern()
+  content with seed 0 except where a test wrote, and the tests write above
+  the blocks the others read.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "DwEmmcDxeHostTest.h"
+
+// Default speed eMMC timing, as MmcDxe leaves the identification
+#define DW_MMC_TEST_BUS_CLOCK     26000000
+
+EFI_MMC_HOST_PROTOCOL       *gDwMmcHost;
+MMC_HOST_EXT_PROTOCOL       *gDwMmcHostExt;
+
+BOOLEAN
+DwEmmcTestCheckPattern (
+  IN CONST VOID             *Buffer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN UINT32                 Seed
+  )
+{
+  VOID                      *Expected;
+  BOOLEAN                   Match;
+
+  Expected = AllocatePool (Blocks * 512);
+  if (Expected == NULL) {
+    return FALSE;
+  }
+  DwMmcSimFillPattern (Lba, Blocks, Seed, Expected);
+  Match = (CompareMem (Buffer, Expected, Blocks * 512) == 0);
+  FreePool (Expected);
+  return Match;
+}
+
+/**
+  Reset the controller model and let the driver initialise it again.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcTestStart (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  EFI_STATUS                Status;
+
+  DwMmcSimReset (gDwMmcSim);
+  Status = gDwMmcHost->NotifyState (gDwMmcHost, MmcHwInitializationState);
+  if (!EFI_ERROR (Status)) {
+    Status = gDwMmcHost->SetIos (gDwMmcHost, DW_MMC_TEST_BUS_CLOCK, 4, EMMCHS26);
+  }
+  if (EFI_ERROR (Status) || (gDwMmcSim->Errors != 0)) {
+    UT_LOG_ERROR ("Controller not initialised, Status=%r Errors=0x%x\n", Status, gDwMmcSim->Errors);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Move Length bytes from or to the card at Lba, the way MmcDxe does without
+  CMD23: the data command, its data and CMD12 after a multiple block one.
+**/
+EFI_STATUS
+DwEmmcTestTransfer (
+  IN     BOOLEAN            Write,
+  IN     EFI_LBA            Lba,
+  IN     UINTN              Length,
+  IN OUT VOID               *Buffer
+  )
+{
+  EFI_STATUS                Status;
+  EFI_STATUS                StopStatus;
+  MMC_CMD                   Cmd;
+  BOOLEAN                   MultiBlock;
+
+  MultiBlock = (Length > 512);
+  if (Write) {
+    Cmd = MultiBlock ? MMC_CMD25 : MMC_CMD24;
+  } else {
+    Cmd = MultiBlock ? MMC_CMD18 : MMC_CMD17;
+  }
+
+  Status = gDwMmcHost->SendCommand (gDwMmcHost, Cmd, (UINT32)Lba);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (Write) {
+    Status = gDwMmcHost->WriteBlockData (gDwMmcHost, Lba, Length, Buffer);
+  } else {
+    Status = gDwMmcHost->ReadBlockData (gDwMmcHost, Lba, Length, Buffer);
+  }
+  if (MultiBlock) {
+    StopStatus = gDwMmcHost->SendCommand (gDwMmcHost, MMC_CMD12, 0);
+    if (!EFI_ERROR (Status)) {
+      Status = StopStatus;
+    }
+  }
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+
+  Framework = NULL;
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  SimInitializeBootServices ();
+  if (DwMmcSimCreate (PcdGet32 (PcdDwEmmcDxeBaseAddress)) == NULL) {
+    DEBUG ((DEBUG_ERROR, "Can not set up the controller model\n"));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = DwEmmcDxeInitialize (gImageHandle, gST);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "DwEmmcDxeInitialize failed, Status=%r\n", Status));
+    return Status;
+  }
+  gDwMmcHost = SimGetProtocol (&gEmbeddedMmcHostProtocolGuid);
+  gDwMmcHostExt = SimGetProtocol (&gMmcHostExtProtocolGuid);
+  if ((gDwMmcHost == NULL) || (gDwMmcHostExt == NULL)) {
+    DEBUG ((DEBUG_ERROR, "The driver did not publish its protocols\n"));
+    return EFI_NOT_FOUND;
+  }
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "InitUnitTestFramework failed, Status=%r\n", Status));
+    goto EXIT;
+  }
+
+  Status = DwEmmcDmaTestAddSuite (Framework);
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ();
+}
@@ -0,0 +1,271 @@
+/** @file
+  Host-based tests of the DesignWare MMC host driver
+
+  The driver runs unmodified against DW_MMC_SIM, a register-level model of
+  the controller reached through a fake IoLib. The model executes the
+  commands written to CMD against a card image kept in memory, moves the
+  data through its FIFO or by walking the IDMAC descriptor chain from
+  DBADDR, and checks what the driver hands to the hardware on the way: the
+  descriptor flags and sizes, the byte count, the addresses the IDMAC can
+  reach and the cache maintenance of every range it touches.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __DWEMMC_DXE_HOST_TEST_H__
+#define __DWEMMC_DXE_HOST_TEST_H__
+
+#include <Uefi.h>
+
+#include <Library/UnitTestLib.h>
+
+#include <Protocol/MmcHost.h>
+#include <Protocol/MmcHostExt.h>
+
+#include "../DwEmmc.h"
+
+#define UNIT_TEST_APP_NAME        "DesignWare MMC Host Tests"
+#define UNIT_TEST_APP_VERSION     "1.0"
+
+//
+// Size of the card, enough for a transfer of the largest block count the
+// driver reports
+//
+#define DW_MMC_SIM_BLOCKS         (SIZE_64MB / 512)
+
+// Depth of the FIFO in words, as read back from the reset value of FIFOTH
+#define DW_MMC_SIM_FIFO_DEPTH     256
+
+// Memory below 4GB for the driver and the test buffers the IDMAC can reach
+#define DW_MMC_SIM_LOW_MEMORY     SIZE_64MB
+
+// Descriptors of one transfer kept for the tests to look at
+#define DW_MMC_SIM_MAX_DESC       8192
+
+// Cache maintenance ranges kept between two data transfers
+#define DW_MMC_SIM_CACHE_RANGES   16
+
+//
+// Rules of the hardware the driver broke, DW_MMC_SIM.Errors
+//
+#define DW_MMC_SIM_ERR_CHAIN      BIT0    // OWN, FS, LD or CH wrong, or the chain does not end
+#define DW_MMC_SIM_ERR_SIZE       BIT1    // A buffer size of 0, not a word multiple or above BS1
+#define DW_MMC_SIM_ERR_ADDRESS    BIT2    // An address the IDMAC can not reach or not word aligned
+#define DW_MMC_SIM_ERR_BYTE_COUNT BIT3    // The descriptors do not add up to BYTCNT
+#define DW_MMC_SIM_ERR_CACHE      BIT4    // A range moved by the IDMAC was not cleaned or invalidated
+#define DW_MMC_SIM_ERR_FIFO       BIT5    // FIFO overrun or underrun
+#define DW_MMC_SIM_ERR_BUSY       BIT6    // A command written during the data phase of another one
+
+//
+// IDMAC descriptor in chained mode, as the hardware reads it
+//
+typedef struct {
+  UINT32                    Des0;               // Flags
+  UINT32                    Des1;               // Buffer sizes
+  UINT32                    Des2;               // Buffer address
+  UINT32                    Des3;               // Next descriptor
+} DW_MMC_SIM_DESCRIPTOR;
+
+typedef struct {
+  UINTN                     Start;
+  UINTN                     End;
+} DW_MMC_SIM_RANGE;
+
+//
+// A data transfer, as seen by the card
+//
+typedef struct {
+  UINT32                    Index;              // Command index
+  UINT32                    Argument;
+  UINT32                    ByteCount;          // BYTCNT when the command was sent
+  BOOLEAN                   Idmac;              // Moved by the IDMAC, by the FIFO otherwise
+  UINTN                     DescCount;          // Descriptors walked by the IDMAC
+  BOOLEAN                   Failed;             // Ended with an injected error
+} DW_MMC_SIM_TRANSFER;
+
+typedef struct {
+  UINTN                     Base;               // Of the register window
+  UINT32                    Regs[DWEMMC_FIFO_DATA / sizeof (UINT32)];
+  UINT8                     *Image;             // DW_MMC_SIM_BLOCKS blocks
+
+  //
+  // Data phase of the last data command
+  //
+  BOOLEAN                   DataActive;
+  BOOLEAN                   DataWrite;
+  UINT64                    DataLba;
+  UINT32                    *Data;              // Staging of a FIFO transfer
+  UINTN                     DataWords;
+  UINTN                     FifoIn;             // Words put in the FIFO
+  UINTN                     FifoOut;            // and taken out of it
+
+  //
+  // Descriptors walked by the IDMAC in the last transfer, as the driver
+  // wrote them
+  //
+  DW_MMC_SIM_DESCRIPTOR     *Desc;              // DW_MMC_SIM_MAX_DESC entries
+  UINTN                     DescCount;
+
+  //
+  // Cache maintenance done by the driver since the last data transfer
+  //
+  DW_MMC_SIM_RANGE          Cleaned[DW_MMC_SIM_CACHE_RANGES];
+  UINTN                     CleanedCount;
+  DW_MMC_SIM_RANGE          Invalidated[DW_MMC_SIM_CACHE_RANGES];
+  UINTN                     InvalidatedCount;
+
+  //
+  // Counters and logs, cleared by DwMmcSimReset()
+  //
+  UINT32                    Errors;             // DW_MMC_SIM_ERR_*
+  UINT64                    Commands[64];       // By command index
+  UINTN                     FifoResets;
+  UINTN                     DmaResets;
+  UINTN                     TransferCount;
+  DW_MMC_SIM_TRANSFER       LastTransfer;
+
+  //
+  // Error injection, for the next data transfer only: the interrupt bits
+  // raised in RINTSTS and IDSTS instead of moving the data
+  //
+  UINT32                    FailRintsts;
+  UINT32                    FailIdsts;
+} DW_MMC_SIM;
+
+extern DW_MMC_SIM           *gDwMmcSim;
+
+//
+// Register model, DwMmcSim.c
+//
+DW_MMC_SIM *
+DwMmcSimCreate (
+  IN UINTN                  Base
+  );
+
+VOID
+DwMmcSimReset (
+  IN DW_MMC_SIM             *Sim
+  );
+
+VOID
+DwMmcSimFillPattern (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  UINT32                Seed,
+  OUT VOID                  *Buffer
+  );
+
+VOID
+DwMmcSimRecordCacheRange (
+  IN DW_MMC_SIM             *Sim,
+  IN BOOLEAN                Clean,
+  IN UINTN                  Address,
+  IN UINTN                  Length
+  );
+
+//
+// Boot services, timer, cache and clock libraries, DwMmcSimLib.c
+//
+VOID
+SimInitializeBootServices (
+  VOID
+  );
+
+VOID *
+SimGetProtocol (
+  IN EFI_GUID               *Protocol
+  );
+
+VOID
+SimAdvance (
+  IN UINT64                 Nanoseconds
+  );
+
+VOID *
+SimAllocateLowPages (
+  IN UINTN                  Pages
+  );
+
+VOID
+SimFreeLowPages (
+  IN VOID                   *Buffer,
+  IN UINTN                  Pages
+  );
+
+BOOLEAN
+SimIsLowMemory (
+  IN UINTN                  Address,
+  IN UINTN                  Length
+  );
+
+//
+// Memory below and above 4GB, DwMmcSimMemory.c. Kept apart as it is the only
+// part of the test built against the C library headers. Both return NULL
+// when the host can not provide such memory.
+//
+VOID *
+SimLowMemoryMap (
+  IN UINTN                  Size
+  );
+
+VOID *
+SimHighMemoryMap (
+  IN UINTN                  Size
+  );
+
+VOID
+SimMemoryUnmap (
+  IN VOID                   *Base,
+  IN UINTN                  Size
+  );
+
+//
+// Driver under test, DwEmmcDxeHostTest.c
+//
+extern EFI_MMC_HOST_PROTOCOL  *gDwMmcHost;
+extern MMC_HOST_EXT_PROTOCOL  *gDwMmcHostExt;
+
+EFI_STATUS
+DwEmmcDxeInitialize (
+  IN EFI_HANDLE             ImageHandle,
+  IN EFI_SYSTEM_TABLE       *SystemTable
+  );
+
+UNIT_TEST_STATUS
+EFIAPI
+DwEmmcTestStart (
+  IN UNIT_TEST_CONTEXT      Context
+  );
+
+EFI_STATUS
+DwEmmcTestTransfer (
+  IN     BOOLEAN            Write,
+  IN     EFI_LBA            Lba,
+  IN     UINTN              Length,
+  IN OUT VOID               *Buffer
+  );
+
+BOOLEAN
+DwEmmcTestCheckPattern (
+  IN CONST VOID             *Buffer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN UINT32                 Seed
+  );
+
+//
+// Test suites, one file each
+//
+EFI_STATUS
+DwEmmcDmaTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+#endif
@@ -0,0 +1,630 @@
+/** @file
+  Register-level model of the DesignWare MMC controller
+
+  The fake IoLib below routes the accesses to the register window of the
+  controller to DW_MMC_SIM and drops the other ones, the clock and pin setup
+  of the driver. Commands complete as soon as CMD is written. The card is
+  always in transfer state and addressed by sector, its blocks are kept in
+  memory.
+
+  Data moves the way the driver programmed it. With the IDMAC enabled the
+  model walks the descriptor chain from DBADDR at once and checks every
+  descriptor against the rules of the hardware before moving its buffer.
+  Otherwise the data goes through a FIFO of DW_MMC_SIM_FIFO_DEPTH words: the
+  card fills it up whenever STATUS is read during a read, and drains it down
+  to the TX watermark whenever RINTSTS is read during a write.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "DwEmmcDxeHostTest.h"
+
+// Cost of one register access
+#define DW_MMC_SIM_ACCESS_NS      100
+#define DW_MMC_SIM_WINDOW         SIZE_4KB
+
+// R1 of a card in transfer state, ready for data
+#define DW_MMC_SIM_R1_TRAN        ((4 << 9) | BIT8)
+
+// Largest buffer size of a descriptor, the width of BS1
+#define DW_MMC_SIM_MAX_BS1        0x1FFF
+
+DW_MMC_SIM                  *gDwMmcSim;
+
+#define REG(Sim, Offset)          ((Sim)->Regs[(Offset) / sizeof (UINT32)])
+
+VOID
+DwMmcSimFillPattern (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  UINT32                Seed,
+  OUT VOID                  *Buffer
+  )
+{
+  UINT32                    *Word;
+  UINTN                     Index;
+
+  Word = Buffer;
+  for ( ; Blocks > 0; Blocks--, Lba++) {
+    for (Index = 0; Index < 512 / sizeof (UINT32); Index++) {
+      *Word++ = ((UINT32)Lba * 0x9E3779B1) ^ ((UINT32)Index * 0x01000193) ^ Seed;
+    }
+  }
+}
+
+DW_MMC_SIM *
+DwMmcSimCreate (
+  IN UINTN                  Base
+  )
+{
+  DW_MMC_SIM                *Sim;
+
+  Sim = AllocateZeroPool (sizeof (DW_MMC_SIM));
+  if (Sim == NULL) {
+    return NULL;
+  }
+  Sim->Base = Base;
+  Sim->Image = AllocatePool (DW_MMC_SIM_BLOCKS * 512);
+  Sim->Desc = AllocatePool (DW_MMC_SIM_MAX_DESC * sizeof (DW_MMC_SIM_DESCRIPTOR));
+  if ((Sim->Image == NULL) || (Sim->Desc == NULL)) {
+    if (Sim->Image != NULL) {
+      FreePool (Sim->Image);
+    }
+    if (Sim->Desc != NULL) {
+      FreePool (Sim->Desc);
+    }
+    FreePool (Sim);
+    return NULL;
+  }
+  DwMmcSimFillPattern (0, DW_MMC_SIM_BLOCKS, 0, Sim->Image);
+  DwMmcSimReset (Sim);
+  gDwMmcSim = Sim;
+  return Sim;
+}
+
+STATIC
+VOID
+DwMmcSimEndData (
+  IN DW_MMC_SIM             *Sim
+  )
+{
+  if (Sim->Data != NULL) {
+    FreePool (Sim->Data);
+    Sim->Data = NULL;
+  }
+  Sim->DataActive = FALSE;
+}
+
+/**
+  Put the registers back to their reset values and clear the counters. The
+  card keeps its content.
+**/
+VOID
+DwMmcSimReset (
+  IN DW_MMC_SIM             *Sim
+  )
+{
+  DwMmcSimEndData (Sim);
+  Sim->CleanedCount = 0;
+  Sim->InvalidatedCount = 0;
+  ZeroMem (Sim->Regs, sizeof (Sim->Regs));
+  REG (Sim, DWEMMC_FIFOTH) = DWEMMC_FIFO_RWMARK (DW_MMC_SIM_FIFO_DEPTH - 1);
+
+  Sim->DescCount = 0;
+  Sim->Errors = 0;
+  ZeroMem (Sim->Commands, sizeof (Sim->Commands));
+  Sim->FifoResets = 0;
+  Sim->DmaResets = 0;
+  Sim->TransferCount = 0;
+  ZeroMem (&Sim->LastTransfer, sizeof (Sim->LastTransfer));
+  Sim->FailRintsts = 0;
+  Sim->FailIdsts = 0;
+}
+
+VOID
+DwMmcSimRecordCacheRange (
+  IN DW_MMC_SIM             *Sim,
+  IN BOOLEAN                Clean,
+  IN UINTN                  Address,
+  IN UINTN                  Length
+  )
+{
+  DW_MMC_SIM_RANGE          *Range;
+
+  //
+  // The oldest ranges go first, the driver only maintains the few ranges of
+  // the next transfer.
+  //
+  if (Clean) {
+    Range = &Sim->Cleaned[Sim->CleanedCount++ % DW_MMC_SIM_CACHE_RANGES];
+  } else {
+    Range = &Sim->Invalidated[Sim->InvalidatedCount++ % DW_MMC_SIM_CACHE_RANGES];
+  }
+  Range->Start = Address;
+  Range->End = Address + Length;
+}
+
+STATIC
+BOOLEAN
+DwMmcSimIsMaintained (
+  IN DW_MMC_SIM_RANGE       *Ranges,
+  IN UINTN                  Count,
+  IN UINTN                  Address,
+  IN UINTN                  Length
+  )
+{
+  UINTN                     Index;
+
+  for (Index = 0; Index < MIN (Count, DW_MMC_SIM_CACHE_RANGES); Index++) {
+    if ((Ranges[Index].Start <= Address) && (Address + Length <= Ranges[Index].End)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+STATIC
+VOID
+DwMmcSimFail (
+  IN DW_MMC_SIM             *Sim,
+  IN UINT32                 Error,
+  IN CONST CHAR8            *What,
+  IN UINTN                  Value
+  )
+{
+  DEBUG ((DEBUG_ERROR, "DW_MMC_SIM: CMD%d %a 0x%lx\n", Sim->LastTransfer.Index, What, (UINT64)Value));
+  Sim->Errors |= Error;
+}
+
+/**
+  Walk the descriptor chain from DBADDR and move the buffers it describes,
+  as the IDMAC does in chained mode.
+**/
+STATIC
+VOID
+DwMmcSimRunIdmac (
+  IN DW_MMC_SIM             *Sim,
+  IN UINT8                  *Card,
+  IN UINT32                 ByteCount
+  )
+{
+  DW_MMC_SIM_DESCRIPTOR     *Desc;
+  UINTN                     Address;
+  UINTN                     Buffer;
+  UINT32                    Size;
+  UINT32                    Moved;
+  UINT32                    Fault;
+
+  Moved = 0;
+  Fault = 0;
+  Sim->DescCount = 0;
+  for (Address = REG (Sim, DWEMMC_DBADDR); ; Address = Desc->Des3) {
+    if (((Address & (sizeof (UINT32) - 1)) != 0) ||
+        !SimIsLowMemory (Address, sizeof (DW_MMC_SIM_DESCRIPTOR))) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_ADDRESS, "descriptor out of reach", Address);
+      Fault = DWEMMC_IDSTS_FBE;
+      break;
+    }
+    if (Sim->DescCount == DW_MMC_SIM_MAX_DESC) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CHAIN, "chain does not end", Address);
+      Fault = DWEMMC_IDSTS_DU;
+      break;
+    }
+    Desc = (DW_MMC_SIM_DESCRIPTOR *)Address;
+    CopyMem (&Sim->Desc[Sim->DescCount++], Desc, sizeof (DW_MMC_SIM_DESCRIPTOR));
+    if (!DwMmcSimIsMaintained (Sim->Cleaned, Sim->CleanedCount, Address, sizeof (DW_MMC_SIM_DESCRIPTOR))) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CACHE, "descriptor not cleaned", Address);
+    }
+    if ((Desc->Des0 & DWEMMC_IDMAC_DES0_OWN) == 0) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CHAIN, "descriptor owned by the CPU", Address);
+      Fault = DWEMMC_IDSTS_DU;
+      break;
+    }
+    if (((Desc->Des0 & DWEMMC_IDMAC_DES0_FS) != 0) != (Sim->DescCount == 1)) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CHAIN, "first segment flag", Sim->DescCount - 1);
+    }
+
+    Size = Desc->Des1 & DW_MMC_SIM_MAX_BS1;
+    Buffer = Desc->Des2;
+    if ((Size == 0) || ((Size & (sizeof (UINT32) - 1)) != 0) || ((Desc->Des1 >> 13) != 0)) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_SIZE, "buffer size", Desc->Des1);
+    }
+    if (((Buffer & (sizeof (UINT32) - 1)) != 0) || !SimIsLowMemory (Buffer, Size)) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_ADDRESS, "buffer out of reach", Buffer);
+      Fault = DWEMMC_IDSTS_FBE;
+      break;
+    }
+    if (Moved + Size > ByteCount) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_BYTE_COUNT, "chain longer than BYTCNT", Moved + Size);
+      break;
+    }
+    if (Sim->DataWrite) {
+      if (!DwMmcSimIsMaintained (Sim->Cleaned, Sim->CleanedCount, Buffer, Size)) {
+        DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CACHE, "buffer not cleaned", Buffer);
+      }
+      CopyMem (Card + Moved, (VOID *)Buffer, Size);
+    } else {
+      if (!DwMmcSimIsMaintained (Sim->Invalidated, Sim->InvalidatedCount, Buffer, Size)) {
+        DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CACHE, "buffer not invalidated", Buffer);
+      }
+      CopyMem ((VOID *)Buffer, Card + Moved, Size);
+    }
+    Moved += Size;
+
+    // Handed back to the CPU
+    Desc->Des0 &= ~DWEMMC_IDMAC_DES0_OWN;
+    if ((Desc->Des0 & DWEMMC_IDMAC_DES0_LD) != 0) {
+      break;
+    }
+    if ((Desc->Des0 & DWEMMC_IDMAC_DES0_CH) == 0) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_CHAIN, "descriptor not chained", Address);
+      Fault = DWEMMC_IDSTS_DU;
+      break;
+    }
+  }
+  Sim->LastTransfer.DescCount = Sim->DescCount;
+
+  if (Fault != 0) {
+    REG (Sim, DWEMMC_IDSTS) |= Fault | DWEMMC_IDSTS_AIS;
+    return;
+  }
+  if (Moved != ByteCount) {
+    DwMmcSimFail (Sim, DW_MMC_SIM_ERR_BYTE_COUNT, "chain shorter than BYTCNT", Moved);
+  }
+  REG (Sim, DWEMMC_IDSTS) |= (Sim->DataWrite ? DWEMMC_IDSTS_TI : DWEMMC_IDSTS_RI) | DWEMMC_IDSTS_NIS;
+  REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_DTO;
+}
+
+STATIC
+VOID
+DwMmcSimStartData (
+  IN DW_MMC_SIM             *Sim,
+  IN UINT32                 Command,
+  IN UINT32                 Argument
+  )
+{
+  UINT32                    ByteCount;
+  UINT32                    BlockSize;
+  UINT8                     *Card;
+
+  ByteCount = REG (Sim, DWEMMC_BYTCNT);
+  BlockSize = REG (Sim, DWEMMC_BLKSIZ);
+
+  Sim->TransferCount++;
+  ZeroMem (&Sim->LastTransfer, sizeof (Sim->LastTransfer));
+  Sim->LastTransfer.Index = Command & 0x3F;
+  Sim->LastTransfer.Argument = Argument;
+  Sim->LastTransfer.ByteCount = ByteCount;
+  Sim->LastTransfer.Idmac = ((REG (Sim, DWEMMC_CTRL) & (DWEMMC_CTRL_DMA_EN | DWEMMC_CTRL_IDMAC_EN)) ==
+                             (DWEMMC_CTRL_DMA_EN | DWEMMC_CTRL_IDMAC_EN)) &&
+                            ((REG (Sim, DWEMMC_BMOD) & DWEMMC_IDMAC_ENABLE) != 0);
+
+  if ((ByteCount == 0) || (BlockSize != 512) || ((ByteCount % BlockSize) != 0)) {
+    DwMmcSimFail (Sim, DW_MMC_SIM_ERR_BYTE_COUNT, "BYTCNT", ByteCount);
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_EBE;
+    return;
+  }
+  if ((UINT64)Argument + ByteCount / 512 > DW_MMC_SIM_BLOCKS) {
+    Sim->LastTransfer.Failed = TRUE;
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_DRT;
+    return;
+  }
+  if (Sim->FailRintsts != 0) {
+    Sim->LastTransfer.Failed = TRUE;
+    REG (Sim, DWEMMC_RINTSTS) |= Sim->FailRintsts | DWEMMC_INT_DTO;
+    Sim->FailRintsts = 0;
+    DwMmcSimEndData (Sim);
+    return;
+  }
+
+  Sim->DataWrite = (Command & BIT_CMD_WRITE) != 0;
+  Sim->DataLba = Argument;
+  Card = Sim->Image + MultU64x32 (Argument, 512);
+
+  if (Sim->LastTransfer.Idmac) {
+    if (Sim->FailIdsts != 0) {
+      Sim->LastTransfer.Failed = TRUE;
+      REG (Sim, DWEMMC_IDSTS) |= Sim->FailIdsts | DWEMMC_IDSTS_AIS;
+      Sim->FailIdsts = 0;
+    } else {
+      DwMmcSimRunIdmac (Sim, Card, ByteCount);
+    }
+    //
+    // The next transfer has to maintain its own buffers again
+    //
+    Sim->CleanedCount = 0;
+    Sim->InvalidatedCount = 0;
+    DwMmcSimEndData (Sim);
+    return;
+  }
+
+  Sim->Data = AllocatePool (ByteCount);
+  ASSERT (Sim->Data != NULL);
+  Sim->DataActive = TRUE;
+  Sim->DataWords = ByteCount / sizeof (UINT32);
+  Sim->FifoIn = 0;
+  Sim->FifoOut = 0;
+  if (!Sim->DataWrite) {
+    CopyMem (Sim->Data, Card, ByteCount);
+  }
+}
+
+/**
+  Run a command written to CMD with the start bit set.
+**/
+STATIC
+VOID
+DwMmcSimCommand (
+  IN DW_MMC_SIM             *Sim,
+  IN UINT32                 Command
+  )
+{
+  UINT32                    Argument;
+
+  if ((Command & BIT_CMD_UPDATE_CLOCK_ONLY) != 0) {
+    return;
+  }
+
+  Argument = REG (Sim, DWEMMC_CMDARG);
+  Sim->Commands[Command & 0x3F]++;
+  if (Sim->DataActive) {
+    if ((Command & BIT_CMD_STOP_ABORT_CMD) == 0) {
+      DwMmcSimFail (Sim, DW_MMC_SIM_ERR_BUSY, "sent during a data phase", Command & 0x3F);
+    }
+    DwMmcSimEndData (Sim);
+  }
+
+  REG (Sim, DWEMMC_RESP0) = DW_MMC_SIM_R1_TRAN;
+  REG (Sim, DWEMMC_RESP1) = 0;
+  REG (Sim, DWEMMC_RESP2) = 0;
+  REG (Sim, DWEMMC_RESP3) = 0;
+  REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_CMD_DONE;
+
+  if ((Command & BIT_CMD_DATA_EXPECTED) != 0) {
+    DwMmcSimStartData (Sim, Command, Argument);
+  }
+}
+
+/**
+  The card takes everything above the TX watermark out of the FIFO, or all
+  of it once the driver has put in the whole transfer.
+**/
+STATIC
+VOID
+DwMmcSimDrainFifo (
+  IN DW_MMC_SIM             *Sim
+  )
+{
+  UINTN                     Watermark;
+
+  Watermark = REG (Sim, DWEMMC_FIFOTH) & 0xFFF;
+  if (Sim->FifoIn == Sim->DataWords) {
+    CopyMem (Sim->Image + MultU64x32 (Sim->DataLba, 512), Sim->Data, Sim->DataWords * sizeof (UINT32));
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_DTO;
+    DwMmcSimEndData (Sim);
+    return;
+  }
+  if (Sim->FifoIn - Sim->FifoOut > Watermark) {
+    Sim->FifoOut = Sim->FifoIn - Watermark;
+  }
+  REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_TXDR;
+}
+
+/**
+  The card fills the FIFO up with the next words of a read.
+**/
+STATIC
+VOID
+DwMmcSimFillFifo (
+  IN DW_MMC_SIM             *Sim
+  )
+{
+  Sim->FifoIn = MIN (Sim->DataWords, Sim->FifoOut + DW_MMC_SIM_FIFO_DEPTH);
+  if (Sim->FifoIn == Sim->DataWords) {
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_DTO;
+  }
+}
+
+STATIC
+UINT32
+DwMmcSimReadFifo (
+  IN DW_MMC_SIM             *Sim
+  )
+{
+  UINT32                    Value;
+
+  if (!Sim->DataActive || Sim->DataWrite || (Sim->FifoOut == Sim->FifoIn)) {
+    DwMmcSimFail (Sim, DW_MMC_SIM_ERR_FIFO, "FIFO underrun", Sim->FifoOut);
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_FRUN;
+    return 0;
+  }
+  Value = Sim->Data[Sim->FifoOut++];
+  if (Sim->FifoOut == Sim->DataWords) {
+    DwMmcSimEndData (Sim);
+  }
+  return Value;
+}
+
+STATIC
+VOID
+DwMmcSimWriteFifo (
+  IN DW_MMC_SIM             *Sim,
+  IN UINT32                 Value
+  )
+{
+  if (!Sim->DataActive || !Sim->DataWrite || (Sim->FifoIn == Sim->DataWords) ||
+      (Sim->FifoIn - Sim->FifoOut == DW_MMC_SIM_FIFO_DEPTH)) {
+    DwMmcSimFail (Sim, DW_MMC_SIM_ERR_FIFO, "FIFO overrun", Sim->FifoIn);
+    REG (Sim, DWEMMC_RINTSTS) |= DWEMMC_INT_FRUN;
+    return;
+  }
+  Sim->Data[Sim->FifoIn++] = Value;
+}
+
+STATIC
+UINT32
+DwMmcSimRead (
+  IN DW_MMC_SIM             *Sim,
+  IN UINTN                  Offset
+  )
+{
+  UINTN                     Level;
+
+  if (Offset >= DWEMMC_FIFO_DATA) {
+    return DwMmcSimReadFifo (Sim);
+  }
+
+  switch (Offset) {
+  case DWEMMC_STATUS:
+    if (Sim->DataActive && !Sim->DataWrite) {
+      DwMmcSimFillFifo (Sim);
+    }
+    Level = Sim->DataActive ? Sim->FifoIn - Sim->FifoOut : 0;
+    return (Level == 0 ? DWEMMC_STS_FIFO_EMPTY : 0) | ((UINT32)Level << 17);
+  case DWEMMC_RINTSTS:
+    if (Sim->DataActive && Sim->DataWrite) {
+      DwMmcSimDrainFifo (Sim);
+    }
+    break;
+  default:
+    break;
+  }
+  return Sim->Regs[Offset / sizeof (UINT32)];
+}
+
+STATIC
+VOID
+DwMmcSimWrite (
+  IN DW_MMC_SIM             *Sim,
+  IN UINTN                  Offset,
+  IN UINT32                 Value
+  )
+{
+  if (Offset >= DWEMMC_FIFO_DATA) {
+    DwMmcSimWriteFifo (Sim, Value);
+    return;
+  }
+
+  switch (Offset) {
+  case DWEMMC_CTRL:
+    // The reset bits clear themselves once the reset is done
+    if ((Value & DWEMMC_CTRL_FIFO_RESET) != 0) {
+      Sim->FifoResets++;
+      DwMmcSimEndData (Sim);
+    }
+    if ((Value & DWEMMC_CTRL_DMA_RESET) != 0) {
+      Sim->DmaResets++;
+    }
+    REG (Sim, DWEMMC_CTRL) = Value & ~DWEMMC_CTRL_RESET_ALL;
+    break;
+  case DWEMMC_BMOD:
+    REG (Sim, DWEMMC_BMOD) = Value & ~DWEMMC_IDMAC_SWRESET;
+    break;
+  case DWEMMC_RINTSTS:
+  case DWEMMC_IDSTS:
+    Sim->Regs[Offset / sizeof (UINT32)] &= ~Value;
+    break;
+  case DWEMMC_CMD:
+    REG (Sim, DWEMMC_CMD) = Value & ~CMD_START_BIT;
+    if ((Value & CMD_START_BIT) != 0) {
+      DwMmcSimCommand (Sim, Value);
+    }
+    break;
+  case DWEMMC_STATUS:
+  case DWEMMC_CDETECT:
+    break;
+  default:
+    Sim->Regs[Offset / sizeof (UINT32)] = Value;
+    break;
+  }
+}
+
+//
+// IoLib, only the 32-bit MMIO accesses the driver does
+//
+STATIC
+DW_MMC_SIM *
+DwMmcSimFromAddress (
+  IN UINTN                  Address
+  )
+{
+  SimAdvance (DW_MMC_SIM_ACCESS_NS);
+  if ((gDwMmcSim == NULL) || (Address < gDwMmcSim->Base) ||
+      (Address >= gDwMmcSim->Base + DW_MMC_SIM_WINDOW)) {
+    return NULL;
+  }
+  ASSERT ((Address & (sizeof (UINT32) - 1)) == 0);
+  return gDwMmcSim;
+}
+
+UINT32
+EFIAPI
+MmioRead32 (
+  IN UINTN                  Address
+  )
+{
+  DW_MMC_SIM                *Sim;
+
+  Sim = DwMmcSimFromAddress (Address);
+  return (Sim == NULL) ? 0 : DwMmcSimRead (Sim, Address - Sim->Base);
+}
+
+UINT32
+EFIAPI
+MmioWrite32 (
+  IN UINTN                  Address,
+  IN UINT32                 Value
+  )
+{
+  DW_MMC_SIM                *Sim;
+
+  Sim = DwMmcSimFromAddress (Address);
+  if (Sim != NULL) {
+    DwMmcSimWrite (Sim, Address - Sim->Base, Value);
+  }
+  return Value;
+}
+
+UINT32
+EFIAPI
+MmioOr32 (
+  IN UINTN                  Address,
+  IN UINT32                 OrData
+  )
+{
+  return MmioWrite32 (Address, MmioRead32 (Address) | OrData);
+}
+
+UINT32
+EFIAPI
+MmioAnd32 (
+  IN UINTN                  Address,
+  IN UINT32                 AndData
+  )
+{
+  return MmioWrite32 (Address, MmioRead32 (Address) & AndData);
+}
+
+UINT32
+EFIAPI
+MmioAndThenOr32 (
+  IN UINTN                  Address,
+  IN UINT32                 AndData,
+  IN UINT32                 OrData
+  )
+{
+  return MmioWrite32 (Address, (MmioRead32 (Address) & AndData) | OrData);
+}
@@ -0,0 +1,357 @@
+/** @file
+  Boot services, timer, cache, clock and UEFI library functions the
+  DesignWare MMC driver uses
+
+  Only what the driver needs to publish its protocols and allocate its
+  descriptor pool and bounce pages. Pages below 4GB come from one region
+  mapped at start, so the IDMAC model can tell which addresses it can reach.
+  Time is simulated, every register access and delay advances the clock the
+  driver polls. The cache maintenance calls are handed to the register model,
+  which checks them against the ranges the IDMAC moves.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include "DwEmmcDxeHostTest.h"
+
+// As on the Cortex-A53 and A72 of the RK3399
+#define SIM_CACHE_LINE            64
+#define SIM_PROTOCOLS             8
+
+typedef struct {
+  EFI_GUID                  *Guid;
+  VOID                      *Interface;
+} SIM_PROTOCOL;
+
+STATIC UINT64               mSimNow;
+STATIC UINT8                *mSimLowBase;
+STATIC UINTN                mSimLowTop;
+STATIC SIM_PROTOCOL         mSimProtocols[SIM_PROTOCOLS];
+STATIC UINTN                mSimProtocolCount;
+STATIC UINTN                mSimHandle;
+
+EFI_HANDLE                  gImageHandle;
+EFI_SYSTEM_TABLE            *gST;
+EFI_BOOT_SERVICES           *gBS;
+
+VOID
+SimAdvance (
+  IN UINT64                 Nanoseconds
+  )
+{
+  mSimNow += Nanoseconds;
+}
+
+//
+// TimerLib, the performance counter counts nanoseconds
+//
+UINTN
+EFIAPI
+MicroSecondDelay (
+  IN UINTN                  MicroSeconds
+  )
+{
+  SimAdvance (MultU64x32 (MicroSeconds, 1000));
+  return MicroSeconds;
+}
+
+UINTN
+EFIAPI
+NanoSecondDelay (
+  IN UINTN                  NanoSeconds
+  )
+{
+  SimAdvance (NanoSeconds);
+  return NanoSeconds;
+}
+
+UINT64
+EFIAPI
+GetPerformanceCounter (
+  VOID
+  )
+{
+  return mSimNow;
+}
+
+UINT64
+EFIAPI
+GetPerformanceCounterProperties (
+  OUT UINT64                *StartValue OPTIONAL,
+  OUT UINT64                *EndValue OPTIONAL
+  )
+{
+  if (StartValue != NULL) {
+    *StartValue = 0;
+  }
+  if (EndValue != NULL) {
+    *EndValue = MAX_UINT64;
+  }
+  return 1000000000;
+}
+
+UINT64
+EFIAPI
+GetTimeInNanoSecond (
+  IN UINT64                 Ticks
+  )
+{
+  return Ticks;
+}
+
+//
+// ArmLib and CacheMaintenanceLib
+//
+UINTN
+EFIAPI
+ArmDataCacheLineLength (
+  VOID
+  )
+{
+  return SIM_CACHE_LINE;
+}
+
+VOID *
+EFIAPI
+WriteBackDataCacheRange (
+  IN VOID                   *Address,
+  IN UINTN                  Length
+  )
+{
+  DwMmcSimRecordCacheRange (gDwMmcSim, TRUE, (UINTN)Address, Length);
+  return Address;
+}
+
+VOID *
+EFIAPI
+InvalidateDataCacheRange (
+  IN VOID                   *Address,
+  IN UINTN                  Length
+  )
+{
+  DwMmcSimRecordCacheRange (gDwMmcSim, FALSE, (UINTN)Address, Length);
+  return Address;
+}
+
+VOID *
+EFIAPI
+WriteBackInvalidateDataCacheRange (
+  IN VOID                   *Address,
+  IN UINTN                  Length
+  )
+{
+  DwMmcSimRecordCacheRange (gDwMmcSim, TRUE, (UINTN)Address, Length);
+  DwMmcSimRecordCacheRange (gDwMmcSim, FALSE, (UINTN)Address, Length);
+  return Address;
+}
+
+//
+// CRULib, the CRU provides any rate asked for
+//
+UINT32
+rk3399_mmc_set_clk (
+  UINT32                    clk_id,
+  UINT32                    hz
+  )
+{
+  return hz;
+}
+
+//
+// Memory below 4GB, handed out and given back in stack order
+//
+VOID *
+SimAllocateLowPages (
+  IN UINTN                  Pages
+  )
+{
+  VOID                      *Buffer;
+
+  if (mSimLowBase == NULL) {
+    mSimLowBase = SimLowMemoryMap (DW_MMC_SIM_LOW_MEMORY);
+    if (mSimLowBase == NULL) {
+      return NULL;
+    }
+  }
+  if (EFI_PAGES_TO_SIZE (Pages) > DW_MMC_SIM_LOW_MEMORY - mSimLowTop) {
+    return NULL;
+  }
+  Buffer = mSimLowBase + mSimLowTop;
+  mSimLowTop += EFI_PAGES_TO_SIZE (Pages);
+  return Buffer;
+}
+
+VOID
+SimFreeLowPages (
+  IN VOID                   *Buffer,
+  IN UINTN                  Pages
+  )
+{
+  ASSERT ((UINT8 *)Buffer + EFI_PAGES_TO_SIZE (Pages) == mSimLowBase + mSimLowTop);
+  mSimLowTop -= EFI_PAGES_TO_SIZE (Pages);
+}
+
+BOOLEAN
+SimIsLowMemory (
+  IN UINTN                  Address,
+  IN UINTN                  Length
+  )
+{
+  return (mSimLowBase != NULL) && (Address >= (UINTN)mSimLowBase) &&
+         (Address + Length <= (UINTN)mSimLowBase + mSimLowTop);
+}
+
+//
+// Boot services
+//
+STATIC
+EFI_STATUS
+EFIAPI
+SimAllocatePages (
+  IN     EFI_ALLOCATE_TYPE      Type,
+  IN     EFI_MEMORY_TYPE        MemoryType,
+  IN     UINTN                  Pages,
+  IN OUT EFI_PHYSICAL_ADDRESS   *Memory
+  )
+{
+  VOID                      *Buffer;
+
+  if ((Type != AllocateMaxAddress) || (*Memory < MAX_UINT32)) {
+    return EFI_UNSUPPORTED;
+  }
+  Buffer = SimAllocateLowPages (Pages);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  *Memory = (UINTN)Buffer;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimFreePages (
+  IN EFI_PHYSICAL_ADDRESS   Memory,
+  IN UINTN                  Pages
+  )
+{
+  SimFreeLowPages ((VOID *)(UINTN)Memory, Pages);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimInstallMultipleProtocolInterfaces (
+  IN OUT EFI_HANDLE         *Handle,
+  ...
+  )
+{
+  VA_LIST                   Args;
+  EFI_GUID                  *Guid;
+
+  VA_START (Args, Handle);
+  for (Guid = VA_ARG (Args, EFI_GUID *); Guid != NULL; Guid = VA_ARG (Args, EFI_GUID *)) {
+    ASSERT (mSimProtocolCount < SIM_PROTOCOLS);
+    mSimProtocols[mSimProtocolCount].Guid = Guid;
+    mSimProtocols[mSimProtocolCount].Interface = VA_ARG (Args, VOID *);
+    mSimProtocolCount++;
+  }
+  VA_END (Args);
+
+  if (*Handle == NULL) {
+    *Handle = &mSimHandle;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimLocateProtocol (
+  IN  EFI_GUID              *Protocol,
+  IN  VOID                  *Registration OPTIONAL,
+  OUT VOID                  **Interface
+  )
+{
+  *Interface = SimGetProtocol (Protocol);
+  return (*Interface == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
+STATIC EFI_BOOT_SERVICES    mSimBootServices = {
+  .AllocatePages                       = SimAllocatePages,
+  .FreePages                           = SimFreePages,
+  .InstallMultipleProtocolInterfaces   = SimInstallMultipleProtocolInterfaces,
+  .LocateProtocol                      = SimLocateProtocol
+};
+
+STATIC EFI_SYSTEM_TABLE     mSimSystemTable = {
+  .BootServices = &mSimBootServices
+};
+
+VOID
+SimInitializeBootServices (
+  VOID
+  )
+{
+  gBS = &mSimBootServices;
+  gST = &mSimSystemTable;
+  gImageHandle = &mSimHandle;
+}
+
+VOID *
+SimGetProtocol (
+  IN EFI_GUID               *Protocol
+  )
+{
+  UINTN                     Index;
+
+  for (Index = 0; Index < mSimProtocolCount; Index++) {
+    if (CompareGuid (mSimProtocols[Index].Guid, Protocol)) {
+      return mSimProtocols[Index].Interface;
+    }
+  }
+  return NULL;
+}
+
+//
+// UefiLib
+//
+
+/**
+  The console of the test is the debug output.
+**/
+UINTN
+EFIAPI
+Print (
+  IN CONST CHAR16           *Format,
+  ...
+  )
+{
+  VA_LIST                   Marker;
+  CHAR16                    Buffer[256];
+  UINTN                     Length;
+
+  VA_START (Marker, Format);
+  Length = UnicodeVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+
+  DEBUG ((DEBUG_INFO, "%s", Buffer));
+  return Length;
+}
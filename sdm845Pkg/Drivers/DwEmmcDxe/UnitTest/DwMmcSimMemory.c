@@ -0,0 +1,77 @@
+/** @file
+  Memory the IDMAC can reach and memory it can not
+
+  The IDMAC takes 32-bit addresses, the driver stages the buffers above 4GB
+  or moves them through the FIFO. The heap of a 64-bit host may be on either
+  side of 4GB, so the tests map both kinds of memory explicitly.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <sys/mman.h>
+
+#include "DwEmmcDxeHostTest.h"
+
+#define SIM_LOW_HINT              SIZE_1GB
+#define SIM_HIGH_HINT             0x1000000000ULL
+
+STATIC
+VOID *
+SimMemoryMap (
+  IN UINT64                 Hint,
+  IN UINTN                  Size,
+  IN BOOLEAN                Low
+  )
+{
+  VOID                      *Base;
+  int                       Flags;
+
+  Flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+  if (Low) {
+    Flags |= MAP_32BIT;
+  }
+#endif
+
+  Base = mmap ((VOID *)(UINTN)Hint, Size, PROT_READ | PROT_WRITE, Flags, -1, 0);
+  if (Base == MAP_FAILED) {
+    return NULL;
+  }
+  if (((UINT64)(UINTN)Base + Size - 1 <= MAX_UINT32) != Low) {
+    munmap (Base, Size);
+    return NULL;
+  }
+  return Base;
+}
+
+VOID *
+SimLowMemoryMap (
+  IN UINTN                  Size
+  )
+{
+  return SimMemoryMap (SIM_LOW_HINT, Size, TRUE);
+}
+
+VOID *
+SimHighMemoryMap (
+  IN UINTN                  Size
+  )
+{
+  return SimMemoryMap (SIM_HIGH_HINT, Size, FALSE);
+}
+
+VOID
+SimMemoryUnmap (
+  IN VOID                   *Base,
+  IN UINTN                  Size
+  )
+{
+  munmap (Base, Size);
+}
@@ -0,0 +1,28 @@
+/** @file
+  The part of ArmLib the DesignWare MMC driver uses
+
+  ArmPkg's ArmLib.h only builds for ARM targets. The host test provides
+  ArmDataCacheLineLength() itself and finds this header first.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __DWEMMC_DXE_HOST_TEST_ARM_LIB_H__
+#define __DWEMMC_DXE_HOST_TEST_ARM_LIB_H__
+
+#include <Base.h>
+
+UINTN
+EFIAPI
+ArmDataCacheLineLength (
+  VOID
+  );
+
+#endif
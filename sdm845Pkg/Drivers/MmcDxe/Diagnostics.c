@@ -18,10 +18,32 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/BaseLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
 
 #include "Mmc.h"
 
-#define DIAGNOSTIC_LOGBUFFER_MAXCHAR  1024
+#define DIAGNOSTIC_LOGBUFFER_MAXCHAR  2048
+
+// Sequential tests move the window in requests of this size
+#define MMC_BENCH_CHUNK_SIZE          SIZE_512KB
+// Random tests move 4KB at aligned offsets of the window
+#define MMC_BENCH_RANDOM_SIZE         SIZE_4KB
+#define MMC_BENCH_RANDOM_OPS          256
+
+typedef struct {
+  CONST CHAR16                *Name;
+  UINTN                       Transfer;
+  BOOLEAN                     Random;
+} MMC_BENCH_TEST;
+
+STATIC CONST MMC_BENCH_TEST mMmcBenchTests[] = {
+  { L"seqread",   MMC_IOBLOCKS_READ,  FALSE },
+  { L"randread",  MMC_IOBLOCKS_READ,  TRUE  },
+  { L"seqwrite",  MMC_IOBLOCKS_WRITE, FALSE },
+  { L"randwrite", MMC_IOBLOCKS_WRITE, TRUE  }
+};
 
 CHAR16* mLogBuffer = NULL;
 UINTN   mLogRemainChar = 0;
@@ -90,6 +112,34 @@ CompareBuffer (
   return TRUE;
 }
 
+/**
+  Move blocks between the card and Buffer, bypassing the block cache so that
+  the card itself is checked and measured.
+**/
+STATIC
+EFI_STATUS
+MmcDiagnosticTransfer (
+  IN     MMC_HOST_INSTANCE  *MmcHostInstance,
+  IN     UINTN              Transfer,
+  IN     EFI_LBA            Lba,
+  IN     UINTN              BufferSize,
+  IN OUT VOID               *Buffer
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_TPL                     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (MmcHostInstance);
+  Status = MmcIoBlocks (MmcHostInstance, MmcHostInstance->BlockIo.Media, Transfer,
+             MmcHostInstance->BlockIo.Media->MediaId, Lba, BufferSize, Buffer);
+  if (!EFI_ERROR (Status) && (Transfer == MMC_IOBLOCKS_WRITE)) {
+    MmcCacheInvalidate (MmcHostInstance);
+  }
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
 EFI_STATUS
 MmcReadWriteDataTest (
   MMC_HOST_INSTANCE *MmcHostInstance,
@@ -118,7 +168,7 @@ MmcReadWriteDataTest (
   ReadBuffer = AllocatePool (BufferSize);
 
   // Read (and save) buffer at a specific location
-  Status = MmcReadBlocks (&(MmcHostInstance->BlockIo), MmcHostInstance->BlockIo.Media->MediaId,Lba,BufferSize,BackBuffer);
+  Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_READ, Lba, BufferSize, BackBuffer);
   if (Status != EFI_SUCCESS) {
     DiagnosticLog (L"ERROR: Fail to Read Block (1)\n");
     return Status;
@@ -126,14 +176,14 @@ MmcReadWriteDataTest (
 
   // Write buffer at the same location
   GenerateRandomBuffer (WriteBuffer,BufferSize);
-  Status = MmcWriteBlocks (&(MmcHostInstance->BlockIo), MmcHostInstance->BlockIo.Media->MediaId,Lba,BufferSize,WriteBuffer);
+  Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_WRITE, Lba, BufferSize, WriteBuffer);
   if (Status != EFI_SUCCESS) {
     DiagnosticLog (L"ERROR: Fail to Write Block (1)\n");
     return Status;
   }
 
   // Read the buffer at the same location
-  Status = MmcReadBlocks (&(MmcHostInstance->BlockIo), MmcHostInstance->BlockIo.Media->MediaId,Lba,BufferSize,ReadBuffer);
+  Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_READ, Lba, BufferSize, ReadBuffer);
   if (Status != EFI_SUCCESS) {
     DiagnosticLog (L"ERROR: Fail to Read Block (2)\n");
     return Status;
@@ -146,14 +196,14 @@ MmcReadWriteDataTest (
   }
 
   // Restore content at the original location
-  Status = MmcWriteBlocks (&(MmcHostInstance->BlockIo), MmcHostInstance->BlockIo.Media->MediaId,Lba,BufferSize,BackBuffer);
+  Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_WRITE, Lba, BufferSize, BackBuffer);
   if (Status != EFI_SUCCESS) {
     DiagnosticLog (L"ERROR: Fail to Write Block (2)\n");
     return Status;
   }
 
   // Read the restored content
-  Status = MmcReadBlocks (&(MmcHostInstance->BlockIo), MmcHostInstance->BlockIo.Media->MediaId,Lba,BufferSize,ReadBuffer);
+  Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_READ, Lba, BufferSize, ReadBuffer);
   if (Status != EFI_SUCCESS) {
     DiagnosticLog (L"ERROR: Fail to Read Block (3)\n");
     return Status;
@@ -168,6 +218,295 @@ MmcReadWriteDataTest (
   return EFI_SUCCESS;
 }
 
+STATIC
+EFI_STATUS
+MmcBenchFlush (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_TPL                     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = MmcFlushDevice (MmcHostInstance);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+STATIC
+VOID
+MmcBenchSort (
+  IN OUT UINT64               *Values,
+  IN     UINTN                Count
+  )
+{
+  UINT64                      Value;
+  UINTN                       Index;
+  UINTN                       Hole;
+
+  for (Index = 1; Index < Count; Index++) {
+    Value = Values[Index];
+    for (Hole = Index; (Hole > 0) && (Values[Hole - 1] > Value); Hole--) {
+      Values[Hole] = Values[Hole - 1];
+    }
+    Values[Hole] = Value;
+  }
+}
+
+/**
+  Commands sent to the card to move a MB of data, status and stop commands
+  included.
+**/
+STATIC
+UINT64
+MmcCommandsPerMb (
+  IN UINT64                   Commands,
+  IN UINT64                   Bytes
+  )
+{
+  if (Bytes == 0) {
+    return 0;
+  }
+  return DivU64x64Remainder (MultU64x32 (Commands, SIZE_1MB), Bytes, NULL);
+}
+
+/**
+  Log the counters of the data path and the identification time.
+**/
+STATIC
+VOID
+MmcLogStatistics (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance
+  )
+{
+  MMC_STATISTICS              *Stats;
+  CHAR16                      Line[192];
+
+  Stats = &MmcHostInstance->Stats;
+  UnicodeSPrint (Line, sizeof (Line), L"MMC Driver Diagnostics - Identification: %ldus\n",
+    DivU64x32 (GetTimeInNanoSecond (Stats->IdentifyTicks), 1000));
+  DiagnosticLog (Line);
+  UnicodeSPrint (Line, sizeof (Line),
+    L"MMC Driver Diagnostics - Data path: %ldKB, %ld data and %ld status commands, %ld commands/MB, %ld errors\n",
+    DivU64x32 (Stats->BytesMoved, SIZE_1KB), Stats->DataCommands, Stats->StatusCommands,
+    MmcCommandsPerMb (Stats->DataCommands + Stats->StatusCommands, Stats->BytesMoved),
+    Stats->Errors);
+  DiagnosticLog (Line);
+}
+
+/**
+  Run one test over the window and log its result on a single line:
+
+    BENCH <test> ops=<n> bytes=<n> us=<n> kbps=<n> iops=<n> cmdpermb=<n> p50=<us> p90=<us> p99=<us> max=<us>
+
+  The total time of the write tests includes the final cache flush, the
+  percentiles are those of the individual requests. cmdpermb counts every
+  command sent to the card, status and stop commands included.
+**/
+STATIC
+EFI_STATUS
+MmcBenchRun (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN CONST MMC_BENCH_TEST     *Test,
+  IN EFI_LBA                  WindowLba,
+  IN UINTN                    WindowBlocks,
+  IN VOID                     *Buffer,
+  IN UINT64                   *Latencies
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_LBA                     Lba;
+  UINT64                      Seed;
+  UINT64                      Start;
+  UINT64                      OpStart;
+  UINT64                      TotalUs;
+  UINT64                      Bytes;
+  UINT64                      Commands;
+  UINTN                       BlockSize;
+  UINTN                       OpBlocks;
+  UINTN                       Ops;
+  UINTN                       Index;
+  CHAR16                      Line[192];
+
+  BlockSize = MmcHostInstance->BlockIo.Media->BlockSize;
+  if (Test->Random) {
+    OpBlocks = MMC_BENCH_RANDOM_SIZE / BlockSize;
+    Ops = MMC_BENCH_RANDOM_OPS;
+  } else {
+    OpBlocks = MIN (MMC_BENCH_CHUNK_SIZE / BlockSize, WindowBlocks);
+    Ops = WindowBlocks / OpBlocks;
+  }
+  if (Test->Transfer == MMC_IOBLOCKS_WRITE) {
+    GenerateRandomBuffer (Buffer, OpBlocks * BlockSize);
+  }
+
+  // The same sequence of offsets on every run, so that builds compare
+  Seed = 1;
+  Commands = MmcHostInstance->Stats.DataCommands + MmcHostInstance->Stats.StatusCommands;
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < Ops; Index++) {
+    if (Test->Random) {
+      Seed = MultU64x64 (Seed, 6364136223846793005ULL) + 1442695040888963407ULL;
+      Lba = WindowLba + ((UINT32)RShiftU64 (Seed, 33) % (WindowBlocks / OpBlocks)) * OpBlocks;
+    } else {
+      Lba = WindowLba + Index * OpBlocks;
+    }
+
+    OpStart = GetPerformanceCounter ();
+    Status = MmcDiagnosticTransfer (MmcHostInstance, Test->Transfer, Lba, OpBlocks * BlockSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      UnicodeSPrint (Line, sizeof (Line), L"BENCH %s error lba=%ld status=%r\n", Test->Name, Lba, Status);
+      DiagnosticLog (Line);
+      return Status;
+    }
+    Latencies[Index] = DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - OpStart), 1000);
+  }
+  if (Test->Transfer == MMC_IOBLOCKS_WRITE) {
+    Status = MmcBenchFlush (MmcHostInstance);
+    if (EFI_ERROR (Status)) {
+      UnicodeSPrint (Line, sizeof (Line), L"BENCH %s error flush status=%r\n", Test->Name, Status);
+      DiagnosticLog (Line);
+      return Status;
+    }
+  }
+  TotalUs = MAX (DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - Start), 1000), 1);
+  Bytes = MultU64x32 (Ops * OpBlocks, (UINT32)BlockSize);
+  Commands = MmcHostInstance->Stats.DataCommands + MmcHostInstance->Stats.StatusCommands - Commands;
+
+  MmcBenchSort (Latencies, Ops);
+  UnicodeSPrint (Line, sizeof (Line),
+    L"BENCH %s ops=%lu bytes=%ld us=%ld kbps=%ld iops=%ld cmdpermb=%ld p50=%ld p90=%ld p99=%ld max=%ld\n",
+    Test->Name, Ops, Bytes, TotalUs,
+    DivU64x64Remainder (MultU64x32 (Bytes, 1000000), MultU64x32 (TotalUs, SIZE_1KB), NULL),
+    DivU64x64Remainder (MultU64x32 (Ops, 1000000), TotalUs, NULL),
+    MmcCommandsPerMb (Commands, Bytes),
+    Latencies[(Ops - 1) * 50 / 100],
+    Latencies[(Ops - 1) * 90 / 100],
+    Latencies[(Ops - 1) * 99 / 100],
+    Latencies[Ops - 1]);
+  DiagnosticLog (Line);
+  return EFI_SUCCESS;
+}
+
+/**
+  Measure the throughput and the request latencies of the card over the
+  window set by PcdMmcBenchmarkLba and PcdMmcBenchmarkBlocks. The window is
+  saved before the write tests and written back afterwards.
+**/
+STATIC
+EFI_STATUS
+MmcBenchmark (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance
+  )
+{
+  EFI_BLOCK_IO_MEDIA          *Media;
+  EFI_STATUS                  Status;
+  EFI_STATUS                  RestoreStatus;
+  EFI_LBA                     WindowLba;
+  UINTN                       WindowBlocks;
+  UINTN                       ChunkBlocks;
+  UINTN                       Blocks;
+  UINTN                       Offset;
+  UINTN                       Index;
+  UINT8                       *Backup;
+  VOID                        *Buffer;
+  UINT64                      *Latencies;
+  CHAR16                      Line[160];
+
+  Media = MmcHostInstance->BlockIo.Media;
+  if (!Media->MediaPresent) {
+    DiagnosticLog (L"ERROR: No Media Present\n");
+    return EFI_NO_MEDIA;
+  }
+  if (Media->ReadOnly) {
+    DiagnosticLog (L"ERROR: Media is write protected\n");
+    return EFI_WRITE_PROTECTED;
+  }
+
+  // Whole 4KB units, moved to the end of the card when they do not fit
+  WindowBlocks = (UINTN)MIN ((UINT64)PcdGet32 (PcdMmcBenchmarkBlocks), Media->LastBlock + 1);
+  WindowBlocks -= WindowBlocks % (MMC_BENCH_RANDOM_SIZE / Media->BlockSize);
+  if (WindowBlocks == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  WindowLba = PcdGet64 (PcdMmcBenchmarkLba);
+  if (WindowLba + WindowBlocks > Media->LastBlock + 1) {
+    WindowLba = Media->LastBlock + 1 - WindowBlocks;
+  }
+  ChunkBlocks = MMC_BENCH_CHUNK_SIZE / Media->BlockSize;
+
+  Backup = AllocatePool (WindowBlocks * Media->BlockSize);
+  Buffer = AllocatePool (MMC_BENCH_CHUNK_SIZE);
+  Latencies = AllocatePool (MAX (WindowBlocks / MIN (ChunkBlocks, WindowBlocks), MMC_BENCH_RANDOM_OPS) * sizeof (UINT64));
+  if ((Backup == NULL) || (Buffer == NULL) || (Latencies == NULL)) {
+    DiagnosticLog (L"ERROR: Out of resources\n");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  UnicodeSPrint (Line, sizeof (Line), L"BENCH window lba=%ld blocks=%lu blocksize=%d identify_us=%ld\n",
+    WindowLba, WindowBlocks, Media->BlockSize,
+    DivU64x32 (GetTimeInNanoSecond (MmcHostInstance->Stats.IdentifyTicks), 1000));
+  DiagnosticLog (Line);
+
+  // Nothing is written unless the whole window could be saved
+  for (Offset = 0; Offset < WindowBlocks; Offset += Blocks) {
+    Blocks = MIN (ChunkBlocks, WindowBlocks - Offset);
+    Status = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_READ, WindowLba + Offset,
+               Blocks * Media->BlockSize, Backup + Offset * Media->BlockSize);
+    if (EFI_ERROR (Status)) {
+      DiagnosticLog (L"ERROR: Fail to save the window\n");
+      goto Exit;
+    }
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mMmcBenchTests); Index++) {
+    Status = MmcBenchRun (MmcHostInstance, &mMmcBenchTests[Index], WindowLba, WindowBlocks, Buffer, Latencies);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  // Put the original data back and check it
+  RestoreStatus = EFI_SUCCESS;
+  for (Offset = 0; Offset < WindowBlocks; Offset += Blocks) {
+    Blocks = MIN (ChunkBlocks, WindowBlocks - Offset);
+    RestoreStatus = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_WRITE, WindowLba + Offset,
+                      Blocks * Media->BlockSize, Backup + Offset * Media->BlockSize);
+    if (!EFI_ERROR (RestoreStatus)) {
+      RestoreStatus = MmcDiagnosticTransfer (MmcHostInstance, MMC_IOBLOCKS_READ, WindowLba + Offset,
+                        Blocks * Media->BlockSize, Buffer);
+    }
+    if (!EFI_ERROR (RestoreStatus) &&
+        !CompareBuffer (Buffer, Backup + Offset * Media->BlockSize, Blocks * Media->BlockSize)) {
+      RestoreStatus = EFI_VOLUME_CORRUPTED;
+    }
+    if (EFI_ERROR (RestoreStatus)) {
+      break;
+    }
+  }
+  if (!EFI_ERROR (RestoreStatus)) {
+    RestoreStatus = MmcBenchFlush (MmcHostInstance);
+  }
+  UnicodeSPrint (Line, sizeof (Line), L"BENCH restore status=%r\n", RestoreStatus);
+  DiagnosticLog (Line);
+  if (!EFI_ERROR (Status)) {
+    Status = RestoreStatus;
+  }
+
+Exit:
+  if (Backup != NULL) {
+    FreePool (Backup);
+  }
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+  if (Latencies != NULL) {
+    FreePool (Latencies);
+  }
+  return Status;
+}
+
 EFI_STATUS
 EFIAPI
 MmcDriverDiagnosticsRunDiagnostics (
@@ -184,6 +523,7 @@ MmcDriverDiagnosticsRunDiagnostics (
   LIST_ENTRY              *CurrentLink;
   MMC_HOST_INSTANCE       *MmcHostInstance;
   EFI_STATUS              Status;
+  CHAR16                  Line[160];
 
   if ((Language         == NULL) ||
       (ErrorType        == NULL) ||
@@ -223,6 +563,12 @@ MmcDriverDiagnosticsRunDiagnostics (
     return EFI_UNSUPPORTED;
   }
 
+  // The extended diagnostics measure the card instead of checking it
+  if (DiagnosticType == EfiDriverDiagnosticTypeExtended) {
+    DiagnosticLog (L"MMC Driver Diagnostics - Benchmark\n");
+    return MmcBenchmark (MmcHostInstance);
+  }
+
   // LBA=1 Size=BlockSize
   DiagnosticLog (L"MMC Driver Diagnostics - Test: First Block\n");
   Status = MmcReadWriteDataTest (MmcHostInstance, 1, MmcHostInstance->BlockIo.Media->BlockSize);
@@ -243,6 +589,11 @@ MmcDriverDiagnosticsRunDiagnostics (
   DiagnosticLog (L"MMC Driver Diagnostics - Test: First Block / 2 BlockSSize\n");
   Status = MmcReadWriteDataTest (MmcHostInstance, 1, 2 * MmcHostInstance->BlockIo.Media->BlockSize);
 
+  UnicodeSPrint (Line, sizeof (Line), L"MMC Driver Diagnostics - Block cache: %ld hits, %ld misses\n",
+    MmcHostInstance->Cache.Hits, MmcHostInstance->Cache.Misses);
+  DiagnosticLog (Line);
+  MmcLogStatistics (MmcHostInstance);
+
   return Status;
 }
 
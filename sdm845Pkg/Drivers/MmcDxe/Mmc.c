@@ -18,6 +18,7 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/DevicePathLib.h>
 
@@ -49,6 +50,20 @@ LIST_ENTRY  mMmcHostPool;
 
 EFI_EVENT gCheckCardsEvent;
 
+/**
+  Event signaled by the hosts when a card-detect line changes, and the
+  one-shot timer that lets the socket settle before the cards are checked
+**/
+STATIC EFI_EVENT mCardDetectEvent;
+STATIC EFI_EVENT mCardDebounceEvent;
+STATIC BOOLEAN   mCardPolling;
+
+STATIC EFI_EVENT mExitBootServicesEvent;
+
+#define MMC_CARD_POLL_PERIOD        (10 * 1000 * 200)   // 200 ms
+#define MMC_CARD_DEBOUNCE_TIME      (10 * 1000 * 50)    // 50 ms
+#define MMC_IDENTIFY_POLL_PERIOD    (10 * 1000 * 1)     // 1 ms
+
 /**
   Initialize the MMC Host Pool to support multiple MMC devices
 **/
@@ -82,6 +97,95 @@ RemoveMmcHost (
   RemoveEntryList (&(MmcHostInstance->Link));
 }
 
+/**
+  Publish BlockIo, BlockIo2 and EraseBlock once a card has been identified,
+  or tell the BlockIo consumers that the media changed.
+**/
+STATIC
+VOID
+MmcPublishBlockIo (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  EFI_STATUS          Status;
+
+  if (!MmcHostInstance->BlockIoInstalled) {
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                  &MmcHostInstance->MmcHandle,
+                  &gEfiBlockIoProtocolGuid,&MmcHostInstance->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid,&MmcHostInstance->BlockIo2,
+                  &gEfiEraseBlockProtocolGuid,&MmcHostInstance->EraseBlock,
+                  NULL
+                  );
+    if (EFI_ERROR(Status)) {
+      DEBUG ((EFI_D_ERROR, "MMC Card: Error installing BlockIo interfaces, Status=%r\n", Status));
+      return;
+    }
+    MmcHostInstance->BlockIoInstalled = TRUE;
+
+    // The card may show up after the platform connected the handles
+    gBS->ConnectController (MmcHostInstance->MmcHandle, NULL, NULL, TRUE);
+    return;
+  }
+
+  Status = gBS->ReinstallProtocolInterface (
+                (MmcHostInstance->MmcHandle),
+                &gEfiBlockIoProtocolGuid,
+                &(MmcHostInstance->BlockIo),
+                &(MmcHostInstance->BlockIo)
+                );
+
+  if (EFI_ERROR(Status)) {
+    Print(L"MMC Card: Error reinstalling BlockIo interface\n");
+  }
+
+  Status = gBS->ReinstallProtocolInterface (
+                (MmcHostInstance->MmcHandle),
+                &gEfiBlockIo2ProtocolGuid,
+                &(MmcHostInstance->BlockIo2),
+                &(MmcHostInstance->BlockIo2)
+                );
+
+  if (EFI_ERROR(Status)) {
+    Print(L"MMC Card: Error reinstalling BlockIo2 interface\n");
+  }
+}
+
+/**
+  Advance the identification of the card in a host by one step, and publish
+  the card once it is ready for data transfers.
+**/
+STATIC
+VOID
+EFIAPI
+MmcIdentifyCallback (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  )
+{
+  MMC_HOST_INSTANCE   *MmcHostInstance;
+  EFI_STATUS          Status;
+
+  MmcHostInstance = (MMC_HOST_INSTANCE *)Context;
+
+  Status = MmcIdentificationPoll (MmcHostInstance);
+  if (Status == EFI_NOT_READY) {
+    return;
+  }
+  gBS->SetTimer (MmcHostInstance->IdentifyEvent, TimerCancel, 0);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "MMC Card: Identification failed, Status=%r\n", Status));
+    return;
+  }
+
+  MmcHostInstance->BlockIo.Media->MediaPresent = TRUE;
+  MmcCacheInvalidate (MmcHostInstance);
+  MmcUpdateEraseGranularity (MmcHostInstance);
+  MmcPublishBlockIo (MmcHostInstance);
+  MmcInstallPartitions (MmcHostInstance);
+}
+
 MMC_HOST_INSTANCE* CreateMmcHostInstance (
   IN EFI_MMC_HOST_PROTOCOL* MmcHost
   )
@@ -111,26 +215,62 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
   MmcHostInstance->BlockIo.WriteBlocks = MmcWriteBlocks;
   MmcHostInstance->BlockIo.FlushBlocks = MmcFlushBlocks;
 
+  MmcHostInstance->BlockIo2.Media = MmcHostInstance->BlockIo.Media;
+  MmcHostInstance->BlockIo2.Reset = MmcResetEx;
+  MmcHostInstance->BlockIo2.ReadBlocksEx = MmcReadBlocksEx;
+  MmcHostInstance->BlockIo2.WriteBlocksEx = MmcWriteBlocksEx;
+  MmcHostInstance->BlockIo2.FlushBlocksEx = MmcFlushBlocksEx;
+
+  MmcHostInstance->EraseBlock.Revision = EFI_ERASE_BLOCK_PROTOCOL_REVISION;
+  MmcHostInstance->EraseBlock.EraseLengthGranularity = 1;
+  MmcHostInstance->EraseBlock.EraseBlocks = MmcEraseBlocks;
+  MmcHostInstance->SecureErase = FeaturePcdGet (PcdMmcSecureErase);
+
+  Status = MmcInitializeRequestQueue (MmcHostInstance);
+  if (EFI_ERROR (Status)) {
+    goto FREE_MEDIA;
+  }
+
+  // The driver works without the cache, only slower
+  Status = MmcCacheInitialize (MmcHostInstance);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_WARN, "MMC: No memory for the block cache\n"));
+  }
+
+  Status = MmcTraceInitialize (MmcHostInstance);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_WARN, "MMC: No memory for the command trace\n"));
+  }
+
   MmcHostInstance->MmcHost = MmcHost;
 
+  Status = gBS->CreateEvent (
+                EVT_NOTIFY_SIGNAL | EVT_TIMER,
+                TPL_CALLBACK,
+                MmcIdentifyCallback,
+                MmcHostInstance,
+                &MmcHostInstance->IdentifyEvent);
+  if (EFI_ERROR (Status)) {
+    goto FREE_EVENT;
+  }
+
   // Create DevicePath for the new MMC Host
   Status = MmcHost->BuildDevicePath (MmcHost, &NewDevicePathNode);
   if (EFI_ERROR (Status)) {
-    goto FREE_MEDIA;
+    goto FREE_EVENT;
   }
 
   DevicePath = (EFI_DEVICE_PATH_PROTOCOL *) AllocatePool (END_DEVICE_PATH_LENGTH);
   if (DevicePath == NULL) {
-    goto FREE_MEDIA;
+    goto FREE_EVENT;
   }
 
   SetDevicePathEndNode (DevicePath);
   MmcHostInstance->DevicePath = AppendDevicePathNode (DevicePath, NewDevicePathNode);
 
-  // Publish BlockIO protocol interface
+  // BlockIo is only published once a card has been identified
   Status = gBS->InstallMultipleProtocolInterfaces (
                 &MmcHostInstance->MmcHandle,
-                &gEfiBlockIoProtocolGuid,&MmcHostInstance->BlockIo,
                 &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
                 NULL
                 );
@@ -138,11 +278,30 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
     goto FREE_DEVICE_PATH;
   }
 
+  if (MmcHostInstance->TraceRing.Entries != NULL) {
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                  &MmcHostInstance->MmcHandle,
+                  &gMmcTraceProtocolGuid,&MmcHostInstance->Trace,
+                  NULL
+                  );
+    if (EFI_ERROR(Status)) {
+      MmcTraceFree (MmcHostInstance);
+    }
+  }
+
   return MmcHostInstance;
 
 FREE_DEVICE_PATH:
   FreePool(DevicePath);
 
+FREE_EVENT:
+  if (MmcHostInstance->IdentifyEvent != NULL) {
+    gBS->CloseEvent (MmcHostInstance->IdentifyEvent);
+  }
+  MmcCacheFree (MmcHostInstance);
+  MmcTraceFree (MmcHostInstance);
+  gBS->CloseEvent (MmcHostInstance->QueueEvent);
+
 FREE_MEDIA:
   FreePool(MmcHostInstance->BlockIo.Media);
 
@@ -152,16 +311,71 @@ FREE_INSTANCE:
   return NULL;
 }
 
+/**
+  Withdraw the partitions and the block interfaces of a host, so that its
+  instance can be freed.
+
+  @retval EFI_SUCCESS       Only the device path and the trace are left.
+  @retval EFI_DEVICE_ERROR  An interface is still in use and stays installed.
+**/
+STATIC
+EFI_STATUS
+MmcUnpublishBlockIo (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  EFI_STATUS          Status;
+
+  Status = MmcUninstallPartitions (MmcHostInstance);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (MmcHostInstance->BlockIoInstalled) {
+    gBS->DisconnectController (MmcHostInstance->MmcHandle, NULL, NULL);
+    Status = gBS->UninstallMultipleProtocolInterfaces (
+                  MmcHostInstance->MmcHandle,
+                  &gEfiBlockIoProtocolGuid,&MmcHostInstance->BlockIo,
+                  &gEfiBlockIo2ProtocolGuid,&MmcHostInstance->BlockIo2,
+                  &gEfiEraseBlockProtocolGuid,&MmcHostInstance->EraseBlock,
+                  NULL
+                  );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "MMC Card: Error uninstalling BlockIo interfaces, Status=%r\n", Status));
+      return EFI_DEVICE_ERROR;
+    }
+    MmcHostInstance->BlockIoInstalled = FALSE;
+  }
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS DestroyMmcHostInstance (
   IN MMC_HOST_INSTANCE* MmcHostInstance
   )
 {
   EFI_STATUS Status;
 
-  // Uninstall Protocol Interfaces
+  // Stop any identification in progress
+  gBS->CloseEvent (MmcHostInstance->IdentifyEvent);
+
+  // Complete the requests that never made it to the card
+  MmcAbortRequestQueue (MmcHostInstance);
+  gBS->CloseEvent (MmcHostInstance->QueueEvent);
+  MmcCacheFree (MmcHostInstance);
+
+  // Uninstall Protocol Interfaces, the block ones are already gone
+  ASSERT (!MmcHostInstance->BlockIoInstalled);
+  if (MmcHostInstance->TraceRing.Entries != NULL) {
+    Status = gBS->UninstallMultipleProtocolInterfaces (
+          MmcHostInstance->MmcHandle,
+          &gMmcTraceProtocolGuid,&MmcHostInstance->Trace,
+          NULL
+          );
+    ASSERT_EFI_ERROR (Status);
+    MmcTraceFree (MmcHostInstance);
+  }
   Status = gBS->UninstallMultipleProtocolInterfaces (
         MmcHostInstance->MmcHandle,
-        &gEfiBlockIoProtocolGuid,&(MmcHostInstance->BlockIo),
         &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
         NULL
         );
@@ -176,6 +390,50 @@ EFI_STATUS DestroyMmcHostInstance (
   return Status;
 }
 
+VOID
+EFIAPI
+MmcCardDetectNotify (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  )
+{
+  // Every new edge restarts the debounce period
+  gBS->SetTimer (mCardDebounceEvent, TimerRelative, MMC_CARD_DEBOUNCE_TIME);
+}
+
+/**
+  Choose how card insertion and removal are detected on a new host.
+
+  Soldered cards are found once by the initial check, hosts that can report
+  card-detect changes notify mCardDetectEvent, only the others are polled.
+**/
+STATIC
+VOID
+MmcStartCardDetection (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_HOST_EXT_PROTOCOL   *MmcHostExt;
+  EFI_STATUS              Status;
+
+  MmcHostExt = MmcHostInstance->MmcHostExt;
+  if (MmcHostExt != NULL) {
+    if ((MmcHostExt->Capabilities & MMC_HOST_EXT_CAP_NON_REMOVABLE) != 0) {
+      return;
+    }
+    Status = MmcHostExt->RegisterCardDetect (MmcHostExt, mCardDetectEvent);
+    if (!EFI_ERROR (Status)) {
+      return;
+    }
+  }
+
+  if (!mCardPolling) {
+    Status = gBS->SetTimer (gCheckCardsEvent, TimerPeriodic, MMC_CARD_POLL_PERIOD);
+    ASSERT_EFI_ERROR (Status);
+    mCardPolling = TRUE;
+  }
+}
+
 /**
   This function checks if the controller implement the Mmc Host and the Device Path Protocols
 **/
@@ -294,12 +552,28 @@ MmcDriverBindingStart (
   MmcHostInstance = CreateMmcHostInstance(MmcHost);
   if (MmcHostInstance != NULL) {
     // Add the handle to the pool
+    MmcHostInstance->Controller = Controller;
     InsertMmcHost (MmcHostInstance);
 
     MmcHostInstance->Initialized = FALSE;
 
-    // Detect card presence now
+    // The extension is optional, hosts without it keep the defaults
+    Status = gBS->OpenProtocol (
+                  Controller,
+                  &gMmcHostExtProtocolGuid,
+                  (VOID **) &MmcHostInstance->MmcHostExt,
+                  This->DriverBindingHandle,
+                  Controller,
+                  EFI_OPEN_PROTOCOL_GET_PROTOCOL
+                  );
+    if (EFI_ERROR (Status)) {
+      MmcHostInstance->MmcHostExt = NULL;
+    }
+
+    // Detect card presence now, the identification itself runs from a timer
     CheckCardsCallback (NULL, NULL);
+
+    MmcStartCardDetection (MmcHostInstance);
   }
 
   return EFI_SUCCESS;
@@ -320,22 +594,44 @@ MmcDriverBindingStop (
   EFI_STATUS          Status = EFI_SUCCESS;
   LIST_ENTRY          *CurrentLink;
   MMC_HOST_INSTANCE   *MmcHostInstance;
+  EFI_TPL             OldTpl;
 
   MMC_TRACE("MmcDriverBindingStop()");
 
-  // For each MMC instance
+  // For the MMC instance started on this controller
   CurrentLink = mMmcHostPool.ForwardLink;
-  while (CurrentLink != NULL && CurrentLink != &mMmcHostPool && (Status == EFI_SUCCESS)) {
+  while (CurrentLink != NULL && CurrentLink != &mMmcHostPool) {
     MmcHostInstance = MMC_HOST_INSTANCE_FROM_LINK(CurrentLink);
     ASSERT(MmcHostInstance != NULL);
+    CurrentLink = CurrentLink->ForwardLink;
+    if (MmcHostInstance->Controller != Controller) {
+      continue;
+    }
+
+    // Keep the identification and the queue from touching the card meanwhile
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    gBS->SetTimer (MmcHostInstance->IdentifyEvent, TimerCancel, 0);
+    MmcDrainRequestQueue (MmcHostInstance);
+    Status = MmcUnpublishBlockIo (MmcHostInstance);
+    gBS->RestoreTPL (OldTpl);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
 
     // Close gEmbeddedMmcHostProtocolGuid
     Status = gBS->CloseProtocol (
                 Controller,
-                &gEmbeddedMmcHostProtocolGuid,(VOID **) &MmcHostInstance->MmcHost,
-                This->DriverBindingHandle
+                &gEmbeddedMmcHostProtocolGuid,
+                This->DriverBindingHandle,
+                Controller
                 );
 
+    // Stop card-detect notifications
+    if ((MmcHostInstance->MmcHostExt != NULL) &&
+        ((MmcHostInstance->MmcHostExt->Capabilities & MMC_HOST_EXT_CAP_NON_REMOVABLE) == 0)) {
+      MmcHostInstance->MmcHostExt->RegisterCardDetect (MmcHostInstance->MmcHostExt, NULL);
+    }
+
     // Remove MMC Host Instance from the pool
     RemoveMmcHost (MmcHostInstance);
 
@@ -364,22 +660,27 @@ CheckCardsCallback (
 
     if (MmcHostInstance->MmcHost->IsCardPresent (MmcHostInstance->MmcHost) == !MmcHostInstance->Initialized) {
       MmcHostInstance->State = MmcHwInitializationState;
-      MmcHostInstance->BlockIo.Media->MediaPresent = !MmcHostInstance->Initialized;
+      MmcHostInstance->BlockIo.Media->MediaPresent = FALSE;
       MmcHostInstance->Initialized = !MmcHostInstance->Initialized;
-
-      if (MmcHostInstance->BlockIo.Media->MediaPresent) {
-        InitializeMmcDevice (MmcHostInstance);
-      }
-
-      Status = gBS->ReinstallProtocolInterface (
-                    (MmcHostInstance->MmcHandle),
-                    &gEfiBlockIoProtocolGuid,
-                    &(MmcHostInstance->BlockIo),
-                    &(MmcHostInstance->BlockIo)
-                    );
-
-      if (EFI_ERROR(Status)) {
-        Print(L"MMC Card: Error reinstalling BlockIo interface\n");
+      MmcHostInstance->TransferReady = FALSE;
+      MmcCacheInvalidate (MmcHostInstance);
+      // The partitions of the new card are published once it is identified
+      MmcUninstallPartitions (MmcHostInstance);
+
+      gBS->SetTimer (MmcHostInstance->IdentifyEvent, TimerCancel, 0);
+      MmcHostInstance->IdentifyStep = MmcIdentifyIdle;
+
+      if (MmcHostInstance->Initialized) {
+        // The media is published by MmcIdentifyCallback once the card is ready
+        Status = MmcStartIdentification (MmcHostInstance);
+        if (!EFI_ERROR (Status)) {
+          Status = gBS->SetTimer (MmcHostInstance->IdentifyEvent, TimerPeriodic, MMC_IDENTIFY_POLL_PERIOD);
+        }
+        if (EFI_ERROR (Status)) {
+          DEBUG ((EFI_D_ERROR, "MMC Card: Failed to start identification, Status=%r\n", Status));
+        }
+      } else if (MmcHostInstance->BlockIoInstalled) {
+        MmcPublishBlockIo (MmcHostInstance);
       }
     }
 
@@ -388,6 +689,31 @@ CheckCardsCallback (
 }
 
 
+/**
+  Commit what the cards still hold in their write caches before the OS takes
+  over the controllers.
+**/
+STATIC
+VOID
+EFIAPI
+MmcExitBootServicesCallback (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  )
+{
+  LIST_ENTRY          *CurrentLink;
+  MMC_HOST_INSTANCE   *MmcHostInstance;
+
+  CurrentLink = mMmcHostPool.ForwardLink;
+  while (CurrentLink != NULL && CurrentLink != &mMmcHostPool) {
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_LINK(CurrentLink);
+    if (MmcHostInstance->BlockIo.Media->MediaPresent) {
+      MmcFlushDevice (MmcHostInstance);
+    }
+    CurrentLink = CurrentLink->ForwardLink;
+  }
+}
+
 EFI_DRIVER_BINDING_PROTOCOL gMmcDriverBinding = {
   MmcDriverBindingSupported,
   MmcDriverBindingStart,
@@ -435,7 +761,8 @@ MmcDxeInitialize (
                 );
   ASSERT_EFI_ERROR (Status);
 
-  // Use a timer to detect if a card has been plugged in or removed
+  // Use a timer to detect if a card has been plugged in or removed, it is
+  // only armed once a host that can not report card-detect changes shows up
   Status = gBS->CreateEvent (
                 EVT_NOTIFY_SIGNAL | EVT_TIMER,
                 TPL_CALLBACK,
@@ -444,10 +771,28 @@ MmcDxeInitialize (
                 &gCheckCardsEvent);
   ASSERT_EFI_ERROR (Status);
 
-  Status = gBS->SetTimer(
-                gCheckCardsEvent,
-                TimerPeriodic,
-                (UINT64)(10*1000*200)); // 200 ms
+  Status = gBS->CreateEvent (
+                EVT_NOTIFY_SIGNAL | EVT_TIMER,
+                TPL_CALLBACK,
+                CheckCardsCallback,
+                NULL,
+                &mCardDebounceEvent);
+  ASSERT_EFI_ERROR (Status);
+
+  Status = gBS->CreateEvent (
+                EVT_NOTIFY_SIGNAL,
+                TPL_CALLBACK,
+                MmcCardDetectNotify,
+                NULL,
+                &mCardDetectEvent);
+  ASSERT_EFI_ERROR (Status);
+
+  Status = gBS->CreateEvent (
+                EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                TPL_CALLBACK,
+                MmcExitBootServicesCallback,
+                NULL,
+                &mExitBootServicesEvent);
   ASSERT_EFI_ERROR (Status);
 
   return Status;
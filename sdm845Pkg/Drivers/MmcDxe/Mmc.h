@@ -20,8 +20,12 @@
 
 #include <Protocol/DiskIo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DevicePath.h>
+#include <Protocol/EraseBlock.h>
 #include <Protocol/MmcHost.h>
+#include <Protocol/MmcHostExt.h>
+#include <Protocol/MmcTrace.h>
 
 #include <Library/UefiLib.h>
 #include <Library/DebugLib.h>
@@ -31,6 +35,7 @@
 
 #define MMC_IOBLOCKS_READ       0
 #define MMC_IOBLOCKS_WRITE      1
+#define MMC_IOBLOCKS_FLUSH      2
 
 #define MMC_OCR_POWERUP             0x80000000
 
@@ -59,6 +64,11 @@
 #define MMC_R0_STATE_TRAN       4
 #define MMC_R0_STATE_DATA       5
 
+#define SD_SCR_CMD_SUPPORT_CMD23            BIT1
+
+// CMD23 NUMBER_OF_BLOCKS, bits [15:0] of the argument
+#define MMC_CMD23_MAX_BLOCK_COUNT           0xFFFF
+
 #define EMMC_CMD6_ARG_ACCESS(x)             (((x) & 0x3) << 24)
 #define EMMC_CMD6_ARG_INDEX(x)              (((x) & 0xFF) << 16)
 #define EMMC_CMD6_ARG_VALUE(x)              (((x) & 0xFF) << 8)
@@ -322,22 +332,156 @@ typedef struct  {
   ECSD      ECSDData;                         // MMC V4 extended card specific
 } CARD_INFO;
 
+#define MMC_CACHE_LINE_SIZE         SIZE_4KB
+#define MMC_CACHE_LINE_UNUSED       MAX_UINT64
+
+typedef struct {
+  EFI_LBA                   Lba;                // First block held by the line
+  UINT64                    LastUse;
+  UINT8                     *Data;
+} MMC_CACHE_LINE;
+
+typedef struct {
+  UINTN                     LineCount;
+  UINTN                     LineBlocks;
+  MMC_CACHE_LINE            *Lines;
+  // Read-ahead is fetched here first, then spread over the victim lines
+  UINT8                     *Staging;
+  UINTN                     StagingLines;
+  UINT64                    UseCount;
+  // Block following the last read, to detect sequential access
+  EFI_LBA                   NextLba;
+  UINT64                    Hits;
+  UINT64                    Misses;
+} MMC_BLOCK_CACHE;
+
+//
+// Commands recorded for MMC_TRACE_PROTOCOL. Entries are only written at
+// TPL_CALLBACK, the slot is filled before Head moves past it so that a
+// reader can tell which of the entries it copied were overwritten meanwhile.
+//
+typedef struct {
+  MMC_TRACE_ENTRY           *Entries;
+  UINT32                    Mask;               // Capacity - 1
+  volatile UINT64           Head;               // Entries recorded since the last reset
+} MMC_TRACE_RING;
+
+//
+// Counters of the data path, reported by the driver diagnostics so that the
+// cost of the MMC stack can be measured on the board itself.
+//
+typedef struct {
+  UINT64                    DataCommands;       // CMD17, CMD18, CMD24 and CMD25
+  UINT64                    StatusCommands;     // CMD12, CMD13 and CMD23 sent around them
+  UINT64                    BytesMoved;
+  UINT64                    Errors;
+  // Performance counter when the identification started, and its duration
+  UINT64                    IdentifyStart;
+  UINT64                    IdentifyTicks;
+} MMC_STATISTICS;
+
+//
+// Progress of the card identification. The power-up polls run from a timer,
+// one command per tick, so that the cards of all the hosts come up side by
+// side while the rest of DXE keeps dispatching.
+//
+typedef enum {
+  MmcIdentifyIdle = 0,
+  MmcIdentifyEmmcPowerUp,                       // CMD1 until the OCR busy bit clears
+  MmcIdentifySdPowerUp,                         // ACMD41 (CMD1 for MMC) likewise
+  MmcIdentifyDone,
+  MmcIdentifyFailed
+} MMC_IDENTIFY_STEP;
+
+//
+// PARTITION_ACCESS values of PARTITION_CONFIG, selecting the hardware
+// partition of an eMMC that the data commands address
+//
+#define EMMC_PARTITION_USER         0
+#define EMMC_PARTITION_BOOT1        1
+#define EMMC_PARTITION_BOOT2        2
+#define EMMC_PARTITION_RPMB         3
+#define EMMC_PARTITION_GP1          4
+#define EMMC_PARTITION_MASK         0x7
+// The last partition switch failed, the next access has to switch again
+#define EMMC_PARTITION_UNKNOWN      0xFF
+
+// Boot and general purpose partitions, RPMB is not exposed
+#define MMC_HW_PARTITION_COUNT      6
+
+struct _MMC_HOST_INSTANCE;
+
+//
+// A boot or general purpose partition of an eMMC, published as a BlockIo
+// child of the user area
+//
+typedef struct {
+  UINTN                     Signature;
+  EFI_HANDLE                Handle;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_BLOCK_IO_PROTOCOL     BlockIo;
+  EFI_BLOCK_IO_MEDIA        Media;
+  UINT8                     Access;             // EMMC_PARTITION_*
+  struct _MMC_HOST_INSTANCE *MmcHostInstance;
+} MMC_PARTITION;
+
+#define MMC_PARTITION_SIGNATURE                     SIGNATURE_32('m', 'm', 'c', 'p')
+#define MMC_PARTITION_FROM_BLOCK_IO_THIS(a)         CR (a, MMC_PARTITION, BlockIo, MMC_PARTITION_SIGNATURE)
+#define MMC_PARTITION_FROM_MEDIA(a)                 CR (a, MMC_PARTITION, Media, MMC_PARTITION_SIGNATURE)
+
 typedef struct _MMC_HOST_INSTANCE {
   UINTN                     Signature;
   LIST_ENTRY                Link;
+  // The host controller the instance was started on
+  EFI_HANDLE                Controller;
   EFI_HANDLE                MmcHandle;
   EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
 
   MMC_STATE                 State;
   EFI_BLOCK_IO_PROTOCOL     BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL    BlockIo2;
+  EFI_ERASE_BLOCK_PROTOCOL  EraseBlock;
   CARD_INFO                 CardInfo;
   EFI_MMC_HOST_PROTOCOL     *MmcHost;
+  MMC_HOST_EXT_PROTOCOL     *MmcHostExt;
 
   BOOLEAN                   Initialized;
+  // The card accepts CMD23 ahead of CMD18/CMD25
+  BOOLEAN                   SetBlockCount;
+  // The card was last seen in the transfer state and ready for data
+  BOOLEAN                   TransferReady;
+  // Erases purge the blocks on cards that support it, see PcdMmcSecureErase
+  BOOLEAN                   SecureErase;
+
+  // BlockIo2 requests waiting for the host, processed by QueueEvent
+  LIST_ENTRY                RequestQueue;
+  EFI_EVENT                 QueueEvent;
+
+  MMC_BLOCK_CACHE           Cache;
+
+  // Card identification, advanced by IdentifyEvent
+  MMC_IDENTIFY_STEP         IdentifyStep;
+  UINTN                     IdentifyRetry;
+  BOOLEAN                   IdentifyHcs;
+  EFI_EVENT                 IdentifyEvent;
+  // BlockIo and BlockIo2 are only published once a card has been identified
+  BOOLEAN                   BlockIoInstalled;
+
+  // Hardware partition the card currently gives access to, EMMC_PARTITION_*
+  UINT8                     PartitionAccess;
+  MMC_PARTITION             *Partitions[MMC_HW_PARTITION_COUNT];
+
+  MMC_TRACE_RING            TraceRing;
+  MMC_TRACE_PROTOCOL        Trace;
+
+  MMC_STATISTICS            Stats;
 } MMC_HOST_INSTANCE;
 
 #define MMC_HOST_INSTANCE_SIGNATURE                 SIGNATURE_32('m', 'm', 'c', 'h')
 #define MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(a)     CR (a, MMC_HOST_INSTANCE, BlockIo, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(a)    CR (a, MMC_HOST_INSTANCE, BlockIo2, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_ERASE_BLOCK_THIS(a)  CR (a, MMC_HOST_INSTANCE, EraseBlock, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_TRACE_THIS(a)        CR (a, MMC_HOST_INSTANCE, Trace, MMC_HOST_INSTANCE_SIGNATURE)
 #define MMC_HOST_INSTANCE_FROM_LINK(a)              CR (a, MMC_HOST_INSTANCE, Link, MMC_HOST_INSTANCE_SIGNATURE)
 
 
@@ -473,6 +617,208 @@ MmcFlushBlocks (
   IN EFI_BLOCK_IO_PROTOCOL  *This
   );
 
+/**
+  Resets the block device hardware.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.Reset().
+  All the requests still waiting in the queue are completed with EFI_ABORTED.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  ExtendedVerification   Indicates that the driver may perform a more exhaustive
+                                 verification operation of the device during reset.
+
+  @retval EFI_SUCCESS            The block device was reset.
+  @retval EFI_DEVICE_ERROR       The block device is not functioning correctly and could not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  );
+
+/**
+  Reads the requested number of blocks from the device.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+  If Token is NULL or Token->Event is NULL the read is performed synchronously,
+  otherwise it is queued and Token->Event is signaled once it completed.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                The media ID that the read request is for.
+  @param  Lba                    The starting logical block address to read from on the device.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             The size of the Buffer in bytes.
+  @param  Buffer                 A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS            The read request was queued if Token->Event is not NULL,
+                                 or the data was read correctly from the device.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to perform the read operation.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER  The read request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  );
+
+/**
+  Writes a specified number of blocks to the device.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+  If Token is NULL or Token->Event is NULL the write is performed synchronously,
+  otherwise it is queued and Token->Event is signaled once it completed.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                The media ID that the write request is for.
+  @param  Lba                    The starting logical block address to be written.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             The size of the Buffer in bytes.
+  @param  Buffer                 Pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS            The write request was queued if Token->Event is not NULL,
+                                 or the data was written correctly to the device.
+  @retval EFI_WRITE_PROTECTED    The device cannot be written to.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to perform the write operation.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic
+                                 block size of the device.
+  @retval EFI_INVALID_PARAMETER  The write request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  );
+
+/**
+  Flushes all modified data to a physical block device.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+  A queued flush completes after every request that was queued before it.
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  Token                  A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS            The flush request was queued if Token->Event is not NULL,
+                                 or all outstanding data were written correctly to the device.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to write data.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be queued.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
+EFI_STATUS
+EFIAPI
+MmcEraseBlocks (
+  IN     EFI_ERASE_BLOCK_PROTOCOL *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  LBA,
+  IN OUT EFI_ERASE_BLOCK_TOKEN    *Token,
+  IN     UINTN                    Size
+  );
+
+VOID
+MmcUpdateEraseGranularity (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcCheckIoParameters (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  );
+
+EFI_STATUS
+MmcIoBlocks (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  );
+
+EFI_STATUS
+MmcWaitProgramming (
+  IN  MMC_HOST_INSTANCE       *MmcHostInstance,
+  IN  UINT64                  TimeoutUs,
+  OUT UINT32                  *Response
+  );
+
+EFI_STATUS
+MmcCacheIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  IN OUT VOID                 *Buffer
+  );
+
+EFI_STATUS
+MmcCacheInitialize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcCacheFree (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcCacheInvalidate (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcInitializeRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcDrainRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcAbortRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
 EFI_STATUS
 MmcNotifyState (
   IN MMC_HOST_INSTANCE      *MmcHostInstance,
@@ -480,8 +826,65 @@ MmcNotifyState (
   );
 
 EFI_STATUS
-InitializeMmcDevice (
-  IN  MMC_HOST_INSTANCE     *MmcHost
+MmcStartIdentification (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcIdentificationPoll (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+EmmcFlushCache (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcFlushDevice (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcSelectPartition (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance,
+  IN  UINT8                 Partition
+  );
+
+VOID
+MmcInstallPartitions (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcUninstallPartitions (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcTraceInitialize (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+VOID
+MmcTraceFree (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance
+  );
+
+UINT64
+MmcTraceStart (
+  VOID
+  );
+
+VOID
+MmcTraceRecord (
+  IN  MMC_HOST_INSTANCE     *MmcHostInstance,
+  IN  UINTN                 Cmd,
+  IN  UINTN                 Argument,
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Length,
+  IN  UINT64                StartTicks,
+  IN  EFI_STATUS            Status
   );
 
 VOID
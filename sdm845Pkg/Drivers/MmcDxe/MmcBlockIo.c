@@ -13,6 +13,9 @@
 **/
 
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
 
 #include "Mmc.h"
 
@@ -77,6 +80,9 @@ MmcReset (
     return EFI_SUCCESS;
   }
 
+  // Whatever the card holds now, it is read again from the card
+  MmcCacheInvalidate (MmcHostInstance);
+
   // If a card is not present then clear all media settings
   if (!MmcHostInstance->MmcHost->IsCardPresent (MmcHostInstance->MmcHost)) {
     MmcHostInstance->BlockIo.Media->MediaPresent = FALSE;
@@ -86,6 +92,7 @@ MmcReset (
 
     // Indicate that the driver requires initialization
     MmcHostInstance->State = MmcHwInitializationState;
+    MmcHostInstance->TransferReady = FALSE;
 
     return EFI_SUCCESS;
   }
@@ -124,12 +131,91 @@ MmcStopTransmission (
 }
 
 #define MMCI0_BLOCKLEN 512
-#define MMCI0_TIMEOUT  10000
+
+// Longest a card may take to program a write
+#define MMC_PROGRAMMING_TIMEOUT_US  2000000
+// Bounds of the interval between two CMD13 while the card is programming
+#define MMC_STATUS_POLL_MIN_US      16
+#define MMC_STATUS_POLL_MAX_US      4096
+
+/**
+  Wait for the card to finish programming a write or an erase and to return
+  to the transfer state. Response receives the last card status.
+
+  Hosts that see DAT0 wait for the card to release it, and a single CMD13
+  then confirms the state. Others poll CMD13 with an interval doubling
+  from MMC_STATUS_POLL_MIN_US, so that short programming times are not
+  rounded up while long ones do not flood the bus.
+**/
+EFI_STATUS
+MmcWaitProgramming (
+  IN  MMC_HOST_INSTANCE       *MmcHostInstance,
+  IN  UINT64                  TimeoutUs,
+  OUT UINT32                  *Response
+  )
+{
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  MMC_HOST_EXT_PROTOCOL   *MmcHostExt;
+  EFI_STATUS              Status;
+  UINT64                  Deadline;
+  UINTN                   DelayUs;
+
+  MmcHost = MmcHostInstance->MmcHost;
+  MmcHostExt = MmcHostInstance->MmcHostExt;
+  if ((MmcHostExt != NULL) && MMC_HOST_EXT_HAS_WAIT_BUSY (MmcHostExt)) {
+    Status = MmcHostExt->WaitBusy (MmcHostExt, TimeoutUs);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "%a(): Card still busy, Status=%r\n", __func__, Status));
+      return Status;
+    }
+  }
+
+  Deadline = GetPerformanceCounter () +
+             DivU64x32 (MultU64x64 (TimeoutUs, GetPerformanceCounterProperties (NULL, NULL)), 1000000);
+  DelayUs = MMC_STATUS_POLL_MIN_US;
+  for (;;) {
+    // Command 13 - Read status and wait for programming to complete (return to tran)
+    MmcHostInstance->Stats.StatusCommands++;
+    Status = MmcHost->SendCommand (MmcHost, MMC_CMD13, MmcHostInstance->CardInfo.RCA << 16);
+    if (!EFI_ERROR (Status)) {
+      Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+      if (!EFI_ERROR (Status) && (MMC_R0_CURRENTSTATE (Response) == MMC_R0_STATE_TRAN)) {
+        return EFI_SUCCESS;
+      }
+    }
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((EFI_D_ERROR, "%a(): Card still programming, Status=%r\n", __func__, Status));
+      return EFI_TIMEOUT;
+    }
+    MicroSecondDelay (DelayUs);
+    DelayUs = MIN (DelayUs * 2, MMC_STATUS_POLL_MAX_US);
+  }
+}
+
+/**
+  The argument of a data command at Lba, a block number for a sector
+  addressed card and a byte offset otherwise.
+**/
+STATIC
+UINTN
+MmcDataCommandArgument (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
+  IN EFI_LBA                  Lba
+  )
+{
+  if ((MmcHostInstance->CardInfo.OCRData.AccessMode & MMC_OCR_ACCESS_MASK) ==
+      MMC_OCR_ACCESS_SECTOR) {
+    return (UINTN)Lba;
+  }
+  return (UINTN)(Lba * Media->BlockSize);
+}
 
 STATIC
 EFI_STATUS
 MmcTransferBlock (
-  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
   IN UINTN                    Cmd,
   IN UINTN                    Transfer,
   IN UINT32                   MediaId,
@@ -140,22 +226,33 @@ MmcTransferBlock (
 {
   EFI_STATUS              Status;
   UINTN                   CmdArg;
-  INTN                    Timeout;
   UINT32                  Response[4];
-  MMC_HOST_INSTANCE       *MmcHostInstance;
   EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  UINTN                   BlockCount;
+  BOOLEAN                 SetBlockCount;
 
-  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
   MmcHost = MmcHostInstance->MmcHost;
-
-  //Set command argument based on the card access mode (Byte mode or Block mode)
-  if ((MmcHostInstance->CardInfo.OCRData.AccessMode & MMC_OCR_ACCESS_MASK) ==
-      MMC_OCR_ACCESS_SECTOR) {
-    CmdArg = Lba;
-  } else {
-    CmdArg = Lba * This->Media->BlockSize;
+  BlockCount = BufferSize / Media->BlockSize;
+  SetBlockCount = (BlockCount > 1) && MmcHostInstance->SetBlockCount &&
+                  (MmcHostInstance->MmcHostExt != NULL) &&
+                  ((MmcHostInstance->MmcHostExt->Capabilities & MMC_HOST_EXT_CAP_SET_BLOCK_COUNT) != 0);
+
+  // The card is only known to be ready again once this transfer completed
+  MmcHostInstance->TransferReady = FALSE;
+
+  if (SetBlockCount) {
+    // Command 23 - the card leaves the data state by itself after BlockCount blocks
+    MmcHostInstance->Stats.StatusCommands++;
+    Status = MmcHost->SendCommand (MmcHost, MMC_CMD23, BlockCount);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "%a(MMC_CMD23): Error %r\n", __func__, Status));
+      return Status;
+    }
   }
 
+  CmdArg = MmcDataCommandArgument (MmcHostInstance, Media, Lba);
+
+  MmcHostInstance->Stats.DataCommands++;
   Status = MmcHost->SendCommand (MmcHost, Cmd, CmdArg);
   if (EFI_ERROR (Status)) {
     DEBUG ((EFI_D_ERROR, "%a(MMC_CMD%d): Error %r\n", __func__, Cmd, Status));
@@ -167,6 +264,7 @@ MmcTransferBlock (
     Status = MmcHost->ReadBlockData (MmcHost, Lba, BufferSize, Buffer);
     if (EFI_ERROR (Status)) {
       DEBUG ((EFI_D_BLKIO, "%a(): Error Read Block Data and Status = %r\n", __func__, Status));
+      MmcHostInstance->Stats.StatusCommands++;
       MmcStopTransmission (MmcHost);
       return Status;
     }
@@ -180,31 +278,28 @@ MmcTransferBlock (
     Status = MmcHost->WriteBlockData (MmcHost, Lba, BufferSize, Buffer);
     if (EFI_ERROR (Status)) {
       DEBUG ((EFI_D_BLKIO, "%a(): Error Write Block Data and Status = %r\n", __func__, Status));
+      MmcHostInstance->Stats.StatusCommands++;
       MmcStopTransmission (MmcHost);
       return Status;
     }
   }
 
-  // Command 13 - Read status and wait for programming to complete (return to tran)
-  Timeout = MMCI0_TIMEOUT;
-  CmdArg = MmcHostInstance->CardInfo.RCA << 16;
-  Response[0] = 0;
-  while(!(Response[0] & MMC_R0_READY_FOR_DATA)
-        && (MMC_R0_CURRENTSTATE (Response) != MMC_R0_STATE_TRAN)
-        && Timeout--) {
-    Status = MmcHost->SendCommand (MmcHost, MMC_CMD13, CmdArg);
-    if (!EFI_ERROR (Status)) {
-      MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
-      if (Response[0] & MMC_R0_READY_FOR_DATA) {
-        break;  // Prevents delay once finished
-      }
+  // Open-ended multiple block transfers have to be stopped explicitly
+  if ((BlockCount > 1) && !SetBlockCount) {
+    MmcHostInstance->Stats.StatusCommands++;
+    Status = MmcHost->SendCommand (MmcHost, MMC_CMD12, 0);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_BLKIO, "%a(): Error and Status:%r\n", __func__, Status));
     }
   }
 
-  if (BufferSize > This->Media->BlockSize) {
-    Status = MmcHost->SendCommand (MmcHost, MMC_CMD12, 0);
+  // A read leaves the card in tran as soon as the last block was sent, only
+  // a write needs to wait for the card to finish programming.
+  Response[0] = MMC_R0_READY_FOR_DATA;
+  if (Transfer == MMC_IOBLOCKS_WRITE) {
+    Status = MmcWaitProgramming (MmcHostInstance, MMC_PROGRAMMING_TIMEOUT_US, Response);
     if (EFI_ERROR (Status)) {
-      DEBUG ((EFI_D_BLKIO, "%a(): Error and Status:%r\n", __func__, Status));
+      return EFI_DEVICE_ERROR;
     }
   }
 
@@ -213,59 +308,45 @@ MmcTransferBlock (
     DEBUG ((EFI_D_ERROR, "MmcIoBlocks() : Error MmcTransferState\n"));
     return Status;
   }
+
+  MmcHostInstance->TransferReady = (Response[0] & MMC_R0_READY_FOR_DATA) ||
+                                   (MMC_R0_CURRENTSTATE (Response) == MMC_R0_STATE_TRAN);
   return Status;
 }
 
 EFI_STATUS
-MmcIoBlocks (
-  IN EFI_BLOCK_IO_PROTOCOL    *This,
+MmcCheckIoParameters (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
   IN UINTN                    Transfer,
   IN UINT32                   MediaId,
   IN EFI_LBA                  Lba,
   IN UINTN                    BufferSize,
-  OUT VOID                    *Buffer
+  IN VOID                     *Buffer
   )
 {
-  UINT32                  Response[4];
-  EFI_STATUS              Status;
-  UINTN                   CmdArg;
-  INTN                    Timeout;
-  UINTN                   Cmd;
-  MMC_HOST_INSTANCE       *MmcHostInstance;
-  EFI_MMC_HOST_PROTOCOL   *MmcHost;
-  UINTN                   BytesRemainingToBeTransfered;
-  UINTN                   BlockCount;
-  UINTN                   ConsumeSize;
-
-  BlockCount = 1;
-  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
   ASSERT (MmcHostInstance != NULL);
-  MmcHost = MmcHostInstance->MmcHost;
-  ASSERT (MmcHost);
+  ASSERT (MmcHostInstance->MmcHost);
 
-  if (This->Media->MediaId != MediaId) {
+  if (Media->MediaId != MediaId) {
     return EFI_MEDIA_CHANGED;
   }
 
-  if ((MmcHost == NULL) || (Buffer == NULL)) {
+  if ((MmcHostInstance->MmcHost == NULL) || (Buffer == NULL)) {
     return EFI_INVALID_PARAMETER;
   }
 
   // Check if a Card is Present
-  if (!MmcHostInstance->BlockIo.Media->MediaPresent) {
+  if (!MmcHostInstance->BlockIo.Media->MediaPresent || !Media->MediaPresent) {
     return EFI_NO_MEDIA;
   }
 
-  if (MMC_HOST_HAS_ISMULTIBLOCK(MmcHost) && MmcHost->IsMultiBlock(MmcHost)) {
-    BlockCount = (BufferSize + This->Media->BlockSize - 1) / This->Media->BlockSize;
-  }
-
   // All blocks must be within the device
-  if ((Lba + (BufferSize / This->Media->BlockSize)) > (This->Media->LastBlock + 1)) {
+  if ((Lba + (BufferSize / Media->BlockSize)) > (Media->LastBlock + 1)) {
     return EFI_INVALID_PARAMETER;
   }
 
-  if ((Transfer == MMC_IOBLOCKS_WRITE) && (This->Media->ReadOnly == TRUE)) {
+  if ((Transfer == MMC_IOBLOCKS_WRITE) && (Media->ReadOnly == TRUE)) {
     return EFI_WRITE_PROTECTED;
   }
 
@@ -275,62 +356,142 @@ MmcIoBlocks (
   }
 
   // The buffer size must be an exact multiple of the block size
-  if ((BufferSize % This->Media->BlockSize) != 0) {
+  if ((BufferSize % Media->BlockSize) != 0) {
     return EFI_BAD_BUFFER_SIZE;
   }
 
   // Check the alignment
-  if ((This->Media->IoAlign > 2) && (((UINTN)Buffer & (This->Media->IoAlign - 1)) != 0)) {
+  if ((Media->IoAlign > 2) && (((UINTN)Buffer & (Media->IoAlign - 1)) != 0)) {
     return EFI_INVALID_PARAMETER;
   }
 
+  return EFI_SUCCESS;
+}
+
+/**
+  Transfer blocks between a buffer and the card.
+
+  Media is the one of the user area or of an eMMC hardware partition, the
+  card is switched to that partition first when another one is selected.
+
+**/
+EFI_STATUS
+MmcIoBlocks (
+  IN MMC_HOST_INSTANCE        *MmcHostInstance,
+  IN EFI_BLOCK_IO_MEDIA       *Media,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  UINT32                  Response[4];
+  EFI_STATUS              Status;
+  UINTN                   CmdArg;
+  INTN                    Timeout;
+  UINTN                   Cmd;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  UINTN                   BytesRemainingToBeTransfered;
+  UINTN                   BlockCount;
+  UINTN                   ConsumeSize;
+  UINT8                   Partition;
+  UINT64                  TraceStart;
+
+  Status = MmcCheckIoParameters (MmcHostInstance, Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Every hardware partition has its own media, the one of the instance is
+  // the user area
+  if (Media == MmcHostInstance->BlockIo.Media) {
+    Partition = EMMC_PARTITION_USER;
+  } else {
+    Partition = MMC_PARTITION_FROM_MEDIA (Media)->Access;
+  }
+  Status = MmcSelectPartition (MmcHostInstance, Partition);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  BlockCount = 1;
+  MmcHost = MmcHostInstance->MmcHost;
+
+  if (MMC_HOST_HAS_ISMULTIBLOCK(MmcHost) && MmcHost->IsMultiBlock(MmcHost)) {
+    BlockCount = (BufferSize + Media->BlockSize - 1) / Media->BlockSize;
+    // A single command can not move more than the host handles at once
+    if ((MmcHostInstance->MmcHostExt != NULL) &&
+        (MmcHostInstance->MmcHostExt->MaxBlockCount != 0) &&
+        (BlockCount > MmcHostInstance->MmcHostExt->MaxBlockCount)) {
+      BlockCount = MmcHostInstance->MmcHostExt->MaxBlockCount;
+    }
+    // No more than CMD23 can announce
+    if (MmcHostInstance->SetBlockCount && (BlockCount > MMC_CMD23_MAX_BLOCK_COUNT)) {
+      BlockCount = MMC_CMD23_MAX_BLOCK_COUNT;
+    }
+  }
+
   BytesRemainingToBeTransfered = BufferSize;
   while (BytesRemainingToBeTransfered > 0) {
 
-    // Check if the Card is in Ready status
-    CmdArg = MmcHostInstance->CardInfo.RCA << 16;
-    Response[0] = 0;
-    Timeout = 20;
-    while(   (!(Response[0] & MMC_R0_READY_FOR_DATA))
-          && (MMC_R0_CURRENTSTATE (Response) != MMC_R0_STATE_TRAN)
-          && Timeout--) {
-      Status = MmcHost->SendCommand (MmcHost, MMC_CMD13, CmdArg);
-      if (!EFI_ERROR (Status)) {
-        MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+    // Check if the Card is in Ready status, unless the previous transfer
+    // already left it there
+    if (!MmcHostInstance->TransferReady) {
+      CmdArg = MmcHostInstance->CardInfo.RCA << 16;
+      Response[0] = 0;
+      Timeout = 20;
+      while(   (!(Response[0] & MMC_R0_READY_FOR_DATA))
+            && (MMC_R0_CURRENTSTATE (Response) != MMC_R0_STATE_TRAN)
+            && Timeout--) {
+        MmcHostInstance->Stats.StatusCommands++;
+        Status = MmcHost->SendCommand (MmcHost, MMC_CMD13, CmdArg);
+        if (!EFI_ERROR (Status)) {
+          MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+        }
+      }
+
+      if (   (!(Response[0] & MMC_R0_READY_FOR_DATA))
+          && (MMC_R0_CURRENTSTATE (Response) != MMC_R0_STATE_TRAN)) {
+        DEBUG ((EFI_D_ERROR, "The Card is busy\n"));
+        return EFI_NOT_READY;
       }
     }
 
-    if (0 == Timeout) {
-      DEBUG ((EFI_D_ERROR, "The Card is busy\n"));
-      return EFI_NOT_READY;
+    ConsumeSize = BlockCount * Media->BlockSize;
+    if (BytesRemainingToBeTransfered < ConsumeSize) {
+      ConsumeSize = BytesRemainingToBeTransfered;
     }
 
+    // The last chunk of a split request may be a single block, which is
+    // neither counted by CMD23 nor stopped by CMD12
     if (Transfer == MMC_IOBLOCKS_READ) {
-      if (BlockCount == 1) {
+      if (ConsumeSize == Media->BlockSize) {
         // Read a single block
         Cmd = MMC_CMD17;
       } else {
-	// Read multiple blocks
-	Cmd = MMC_CMD18;
+        // Read multiple blocks
+        Cmd = MMC_CMD18;
       }
     } else {
-      if (BlockCount == 1) {
+      if (ConsumeSize == Media->BlockSize) {
         // Write a single block
         Cmd = MMC_CMD24;
       } else {
-	// Write multiple blocks
-	Cmd = MMC_CMD25;
+        // Write multiple blocks
+        Cmd = MMC_CMD25;
       }
     }
-
-    ConsumeSize = BlockCount * This->Media->BlockSize;
-    if (BytesRemainingToBeTransfered < ConsumeSize) {
-      ConsumeSize = BytesRemainingToBeTransfered;
-    }
-    Status = MmcTransferBlock (This, Cmd, Transfer, MediaId, Lba, ConsumeSize, Buffer);
+    TraceStart = MmcTraceStart ();
+    Status = MmcTransferBlock (MmcHostInstance, Media, Cmd, Transfer, MediaId, Lba, ConsumeSize, Buffer);
+    MmcTraceRecord (MmcHostInstance, Cmd, MmcDataCommandArgument (MmcHostInstance, Media, Lba),
+      Lba, ConsumeSize, TraceStart, Status);
     if (EFI_ERROR (Status)) {
       DEBUG ((EFI_D_ERROR, "%a(): Failed to transfer block and Status:%r\n", __func__, Status));
+      MmcHostInstance->Stats.Errors++;
+      return Status;
     }
+    MmcHostInstance->Stats.BytesMoved += ConsumeSize;
 
     BytesRemainingToBeTransfered -= ConsumeSize;
     if (BytesRemainingToBeTransfered > 0) {
@@ -342,6 +503,310 @@ MmcIoBlocks (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+MmcCacheInitialize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_BLOCK_CACHE         *Cache;
+  UINT8                   *Data;
+  UINTN                   Index;
+
+  Cache = &MmcHostInstance->Cache;
+  Cache->LineCount = PcdGet32 (PcdMmcBlockCacheLines);
+  if (Cache->LineCount == 0) {
+    return EFI_SUCCESS;
+  }
+  Cache->StagingLines = MIN (MAX (PcdGet32 (PcdMmcBlockCacheReadAhead), 1), Cache->LineCount);
+
+  Cache->Lines = AllocateZeroPool (Cache->LineCount * sizeof (MMC_CACHE_LINE));
+  Data = AllocatePages (EFI_SIZE_TO_PAGES (Cache->LineCount * MMC_CACHE_LINE_SIZE));
+  Cache->Staging = AllocatePages (EFI_SIZE_TO_PAGES (Cache->StagingLines * MMC_CACHE_LINE_SIZE));
+  if ((Cache->Lines == NULL) || (Data == NULL) || (Cache->Staging == NULL)) {
+    if (Data != NULL) {
+      FreePages (Data, EFI_SIZE_TO_PAGES (Cache->LineCount * MMC_CACHE_LINE_SIZE));
+    }
+    MmcCacheFree (MmcHostInstance);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    Cache->Lines[Index].Data = Data + Index * MMC_CACHE_LINE_SIZE;
+  }
+  MmcCacheInvalidate (MmcHostInstance);
+  return EFI_SUCCESS;
+}
+
+VOID
+MmcCacheFree (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_BLOCK_CACHE         *Cache;
+
+  Cache = &MmcHostInstance->Cache;
+  if (Cache->Lines != NULL) {
+    if (Cache->Lines[0].Data != NULL) {
+      FreePages (Cache->Lines[0].Data, EFI_SIZE_TO_PAGES (Cache->LineCount * MMC_CACHE_LINE_SIZE));
+    }
+    FreePool (Cache->Lines);
+  }
+  if (Cache->Staging != NULL) {
+    FreePages (Cache->Staging, EFI_SIZE_TO_PAGES (Cache->StagingLines * MMC_CACHE_LINE_SIZE));
+  }
+  ZeroMem (Cache, sizeof (MMC_BLOCK_CACHE));
+}
+
+/**
+  Drop every cached line, to be called whenever the media may have changed.
+
+**/
+VOID
+MmcCacheInvalidate (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_BLOCK_CACHE         *Cache;
+  UINTN                   Index;
+
+  Cache = &MmcHostInstance->Cache;
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    Cache->Lines[Index].Lba = MMC_CACHE_LINE_UNUSED;
+  }
+  Cache->NextLba = MMC_CACHE_LINE_UNUSED;
+  Cache->LineBlocks = MMC_CACHE_LINE_SIZE / MmcHostInstance->BlockIo.Media->BlockSize;
+}
+
+STATIC
+MMC_CACHE_LINE *
+MmcCacheLookup (
+  IN MMC_BLOCK_CACHE        *Cache,
+  IN EFI_LBA                LineLba,
+  IN BOOLEAN                Touch
+  )
+{
+  UINTN                   Index;
+
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    if (Cache->Lines[Index].Lba == LineLba) {
+      if (Touch) {
+        Cache->Lines[Index].LastUse = ++Cache->UseCount;
+      }
+      return &Cache->Lines[Index];
+    }
+  }
+  return NULL;
+}
+
+STATIC
+MMC_CACHE_LINE *
+MmcCacheVictim (
+  IN MMC_BLOCK_CACHE        *Cache
+  )
+{
+  MMC_CACHE_LINE          *Victim;
+  UINTN                   Index;
+
+  Victim = &Cache->Lines[0];
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    if (Cache->Lines[Index].Lba == MMC_CACHE_LINE_UNUSED) {
+      return &Cache->Lines[Index];
+    }
+    if (Cache->Lines[Index].LastUse < Victim->LastUse) {
+      Victim = &Cache->Lines[Index];
+    }
+  }
+  return Victim;
+}
+
+/**
+  Bring the lines written by a request in line with the card, either by
+  copying the new data into them or by dropping them.
+
+**/
+STATIC
+VOID
+MmcCacheUpdate (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer,
+  IN BOOLEAN                Invalidate
+  )
+{
+  MMC_BLOCK_CACHE         *Cache;
+  MMC_CACHE_LINE          *Line;
+  UINTN                   BlockSize;
+  EFI_LBA                 End;
+  EFI_LBA                 Start;
+  EFI_LBA                 Stop;
+  UINTN                   Index;
+
+  Cache = &MmcHostInstance->Cache;
+  BlockSize = MmcHostInstance->BlockIo.Media->BlockSize;
+  End = Lba + BufferSize / BlockSize;
+
+  for (Index = 0; Index < Cache->LineCount; Index++) {
+    Line = &Cache->Lines[Index];
+    if ((Line->Lba == MMC_CACHE_LINE_UNUSED) ||
+        (Line->Lba >= End) || (Line->Lba + Cache->LineBlocks <= Lba)) {
+      continue;
+    }
+    if (Invalidate) {
+      Line->Lba = MMC_CACHE_LINE_UNUSED;
+      continue;
+    }
+    Start = MAX (Lba, Line->Lba);
+    Stop = MIN (End, Line->Lba + Cache->LineBlocks);
+    CopyMem (Line->Data + (Start - Line->Lba) * BlockSize,
+             (UINT8 *)Buffer + (Start - Lba) * BlockSize,
+             (UINTN)(Stop - Start) * BlockSize);
+  }
+}
+
+/**
+  Read Count lines starting at LineLba with a single request and insert them
+  in place of the least recently used ones.
+
+**/
+STATIC
+EFI_STATUS
+MmcCacheFill (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                LineLba,
+  IN UINTN                  Count
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  MMC_BLOCK_CACHE         *Cache;
+  MMC_CACHE_LINE          *Line;
+  EFI_STATUS              Status;
+  UINTN                   Index;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
+  Cache = &MmcHostInstance->Cache;
+
+  Status = MmcIoBlocks (MmcHostInstance, This->Media, MMC_IOBLOCKS_READ, MediaId, LineLba,
+             Count * MMC_CACHE_LINE_SIZE, Cache->Staging);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Line = MmcCacheVictim (Cache);
+    Line->Lba = LineLba + Index * Cache->LineBlocks;
+    Line->LastUse = ++Cache->UseCount;
+    CopyMem (Line->Data, Cache->Staging + Index * MMC_CACHE_LINE_SIZE, MMC_CACHE_LINE_SIZE);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Transfer blocks through the block cache.
+
+  Small reads are served from 4KB lines, and a miss that continues the
+  previous read fetches several lines ahead at once. Larger reads go to
+  the card directly. Writes always go to the card, and the lines they cover
+  are then updated or dropped depending on PcdMmcBlockCacheWriteThrough.
+
+**/
+EFI_STATUS
+MmcCacheIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  IN OUT VOID                 *Buffer
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  MMC_BLOCK_CACHE         *Cache;
+  MMC_CACHE_LINE          *Line;
+  EFI_STATUS              Status;
+  EFI_LBA                 End;
+  EFI_LBA                 FirstLine;
+  EFI_LBA                 EndLine;
+  EFI_LBA                 LineLba;
+  EFI_LBA                 Start;
+  EFI_LBA                 Stop;
+  UINTN                   BlockSize;
+  UINTN                   Count;
+  UINTN                   Index;
+  BOOLEAN                 Sequential;
+  UINT8                   *Destination;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This);
+  Cache = &MmcHostInstance->Cache;
+  if ((Cache->LineCount == 0) || (Cache->LineBlocks == 0)) {
+    return MmcIoBlocks (MmcHostInstance, This->Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  }
+
+  if (Transfer == MMC_IOBLOCKS_WRITE) {
+    Status = MmcIoBlocks (MmcHostInstance, This->Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+    MmcCacheUpdate (MmcHostInstance, Lba, BufferSize, Buffer,
+      EFI_ERROR (Status) || !FeaturePcdGet (PcdMmcBlockCacheWriteThrough));
+    return Status;
+  }
+
+  Status = MmcCheckIoParameters (MmcHostInstance, This->Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  if (EFI_ERROR (Status) || (BufferSize == 0)) {
+    return Status;
+  }
+
+  BlockSize = This->Media->BlockSize;
+  End = Lba + BufferSize / BlockSize;
+  FirstLine = Lba - (Lba % Cache->LineBlocks);
+  EndLine = End + Cache->LineBlocks - 1;
+  EndLine -= EndLine % Cache->LineBlocks;
+
+  Sequential = (Lba == Cache->NextLba);
+  Cache->NextLba = End;
+
+  // Large requests gain nothing from the cache, and lines can not reach
+  // past the end of the device
+  if (((EndLine - FirstLine) / Cache->LineBlocks > Cache->StagingLines) ||
+      (EndLine > This->Media->LastBlock + 1)) {
+    return MmcIoBlocks (MmcHostInstance, This->Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  }
+
+  Destination = Buffer;
+  for (LineLba = FirstLine; LineLba < End; LineLba += Cache->LineBlocks) {
+    Line = MmcCacheLookup (Cache, LineLba, TRUE);
+    if (Line != NULL) {
+      Cache->Hits++;
+    } else {
+      Cache->Misses++;
+
+      // Fetch the rest of the request, or the read-ahead window when the
+      // access is sequential, without duplicating lines already cached
+      Count = Sequential ? Cache->StagingLines : (UINTN)((EndLine - LineLba) / Cache->LineBlocks);
+      Count = (UINTN)MIN (Count, (This->Media->LastBlock + 1 - LineLba) / Cache->LineBlocks);
+      for (Index = 1; Index < Count; Index++) {
+        if (MmcCacheLookup (Cache, LineLba + Index * Cache->LineBlocks, FALSE) != NULL) {
+          Count = Index;
+          break;
+        }
+      }
+
+      Status = MmcCacheFill (This, MediaId, LineLba, Count);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      Line = MmcCacheLookup (Cache, LineLba, TRUE);
+      ASSERT (Line != NULL);
+    }
+
+    Start = MAX (Lba, LineLba);
+    Stop = MIN (End, LineLba + Cache->LineBlocks);
+    CopyMem (Destination, Line->Data + (Start - LineLba) * BlockSize, (UINTN)(Stop - Start) * BlockSize);
+    Destination += (Stop - Start) * BlockSize;
+  }
+
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 EFIAPI
 MmcReadBlocks (
@@ -352,7 +817,16 @@ MmcReadBlocks (
   OUT VOID                    *Buffer
   )
 {
-  return MmcIoBlocks (This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  // Keep the BlockIo2 queue from using the host in the middle of the transfer,
+  // and let the requests queued before this one go first
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This));
+  Status = MmcCacheIoBlocks (This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
 }
 
 EFI_STATUS
@@ -365,7 +839,31 @@ MmcWriteBlocks (
   IN VOID                     *Buffer
   )
 {
-  return MmcIoBlocks (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This));
+  Status = MmcCacheIoBlocks (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Commit the writes held by the card. Must be called at TPL_CALLBACK.
+**/
+EFI_STATUS
+MmcFlushDevice (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  if (!MmcHostInstance->BlockIo.Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    return EFI_SUCCESS;
+  }
+  return EmmcFlushCache (MmcHostInstance);
 }
 
 EFI_STATUS
@@ -374,5 +872,12 @@ MmcFlushBlocks (
   IN EFI_BLOCK_IO_PROTOCOL  *This
   )
 {
-  return EFI_SUCCESS;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This));
+  Status = MmcFlushDevice (MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS (This));
+  gBS->RestoreTPL (OldTpl);
+  return Status;
 }
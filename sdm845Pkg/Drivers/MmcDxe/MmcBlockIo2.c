@@ -0,0 +1,320 @@
+/** @file
+  Block I/O 2 Protocol implementation for the MMC DXE driver
+
+  Requests that come with an event are queued on the host instance and
+  serviced one at a time from a timer callback, so the caller can go on with
+  other work until its event is signaled.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "Mmc.h"
+
+#define MMC_REQUEST_SIGNATURE       SIGNATURE_32('m', 'm', 'c', 'r')
+
+typedef struct {
+  UINTN                     Signature;
+  LIST_ENTRY                Link;
+  UINTN                     Transfer;
+  UINT32                    MediaId;
+  EFI_LBA                   Lba;
+  UINTN                     BufferSize;
+  VOID                      *Buffer;
+  EFI_BLOCK_IO2_TOKEN       *Token;
+} MMC_REQUEST;
+
+#define MMC_REQUEST_FROM_LINK(a)    CR (a, MMC_REQUEST, Link, MMC_REQUEST_SIGNATURE)
+
+STATIC
+VOID
+MmcCompleteRequest (
+  IN MMC_REQUEST            *Request,
+  IN EFI_STATUS             Status
+  )
+{
+  Request->Token->TransactionStatus = Status;
+  gBS->SignalEvent (Request->Token->Event);
+  FreePool (Request);
+}
+
+/**
+  Perform the request at the head of the queue.
+
+  Must be called at TPL_CALLBACK so that nothing else uses the host meanwhile.
+
+  @retval TRUE   A request was performed.
+  @retval FALSE  The queue was empty.
+
+**/
+STATIC
+BOOLEAN
+MmcServiceRequest (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_REQUEST           *Request;
+  EFI_STATUS            Status;
+
+  if (IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    return FALSE;
+  }
+
+  Request = MMC_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue));
+  RemoveEntryList (&Request->Link);
+
+  if (Request->Transfer == MMC_IOBLOCKS_FLUSH) {
+    Status = MmcFlushDevice (MmcHostInstance);
+  } else {
+    Status = MmcCacheIoBlocks (&MmcHostInstance->BlockIo, Request->Transfer, Request->MediaId,
+               Request->Lba, Request->BufferSize, Request->Buffer);
+  }
+  MmcCompleteRequest (Request, Status);
+  return TRUE;
+}
+
+/**
+  Timer callback servicing the queue.
+
+  Only one request is performed per tick, so that other callbacks get to run
+  between two transfers.
+
+**/
+STATIC
+VOID
+EFIAPI
+MmcRequestQueueCallback (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  )
+{
+  MMC_HOST_INSTANCE   *MmcHostInstance;
+
+  MmcHostInstance = (MMC_HOST_INSTANCE *)Context;
+  MmcServiceRequest (MmcHostInstance);
+  if (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    gBS->SetTimer (MmcHostInstance->QueueEvent, TimerRelative, 0);
+  }
+}
+
+EFI_STATUS
+MmcInitializeRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  InitializeListHead (&MmcHostInstance->RequestQueue);
+
+  return gBS->CreateEvent (
+                EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                TPL_CALLBACK,
+                MmcRequestQueueCallback,
+                MmcHostInstance,
+                &MmcHostInstance->QueueEvent
+                );
+}
+
+/**
+  Perform every queued request now, in order.
+
+  Blocking requests call it first so they are never reordered with requests
+  that were queued before them. Must be called at TPL_CALLBACK.
+
+**/
+VOID
+MmcDrainRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  while (MmcServiceRequest (MmcHostInstance));
+}
+
+/**
+  Complete every queued request with EFI_ABORTED.
+
+**/
+VOID
+MmcAbortRequestQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_REQUEST           *Request;
+  EFI_TPL               OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  while (!IsListEmpty (&MmcHostInstance->RequestQueue)) {
+    Request = MMC_REQUEST_FROM_LINK (GetFirstNode (&MmcHostInstance->RequestQueue));
+    RemoveEntryList (&Request->Link);
+    MmcCompleteRequest (Request, EFI_ABORTED);
+  }
+  gBS->RestoreTPL (OldTpl);
+}
+
+STATIC
+EFI_STATUS
+MmcQueueRequest (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN EFI_BLOCK_IO2_TOKEN    *Token,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  )
+{
+  MMC_REQUEST           *Request;
+  EFI_TPL               OldTpl;
+
+  Request = AllocateZeroPool (sizeof (MMC_REQUEST));
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Request->Signature  = MMC_REQUEST_SIGNATURE;
+  Request->Transfer   = Transfer;
+  Request->MediaId    = MediaId;
+  Request->Lba        = Lba;
+  Request->BufferSize = BufferSize;
+  Request->Buffer     = Buffer;
+  Request->Token      = Token;
+  Token->TransactionStatus = EFI_NOT_READY;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  InsertTailList (&MmcHostInstance->RequestQueue, &Request->Link);
+  gBS->SetTimer (MmcHostInstance->QueueEvent, TimerRelative, 0);
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+MmcIoBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINTN                  Transfer,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN OUT VOID                   *Buffer
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  if ((Token == NULL) || (Token->Event == NULL)) {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    MmcDrainRequestQueue (MmcHostInstance);
+    Status = MmcCacheIoBlocks (&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    gBS->RestoreTPL (OldTpl);
+    if (Token != NULL) {
+      Token->TransactionStatus = Status;
+    }
+    return Status;
+  }
+
+  // Report what can be told right away before the request is queued
+  Status = MmcCheckIoParameters (MmcHostInstance, MmcHostInstance->BlockIo.Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (BufferSize == 0) {
+    Token->TransactionStatus = EFI_SUCCESS;
+    gBS->SignalEvent (Token->Event);
+    return EFI_SUCCESS;
+  }
+
+  return MmcQueueRequest (MmcHostInstance, Transfer, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  MmcAbortRequestQueue (MmcHostInstance);
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = MmcReset (&MmcHostInstance->BlockIo, ExtendedVerification);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  OUT    VOID                   *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_READ, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  )
+{
+  return MmcIoBlocksEx (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS (This);
+
+  if (!This->Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+
+  if ((Token == NULL) || (Token->Event == NULL)) {
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    MmcDrainRequestQueue (MmcHostInstance);
+    Status = MmcFlushDevice (MmcHostInstance);
+    gBS->RestoreTPL (OldTpl);
+    if (Token != NULL) {
+      Token->TransactionStatus = Status;
+    }
+    return Status;
+  }
+
+  return MmcQueueRequest (MmcHostInstance, MMC_IOBLOCKS_FLUSH, This->Media->MediaId, 0, Token, 0, NULL);
+}
@@ -0,0 +1,425 @@
+/** @file
+  Erase Block Protocol implementation for the MMC DXE driver
+
+  The card erases the blocks itself, no data crosses the bus. Whole eMMC
+  erase groups are erased, the partial groups at either end of a range are
+  trimmed or discarded when the device can, and written with zeros when it
+  can not. SD cards erase at write block granularity.
+
+  With PcdMmcSecureErase set, an eMMC that supports it purges the blocks
+  instead: secure erase for the whole groups and secure trim for the edges,
+  never a discard that would leave the data in the device.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "Mmc.h"
+
+#define MMC_CMD32                       (MMC_INDX(32) | MMC_CMD_WAIT_RESPONSE)
+#define MMC_CMD33                       (MMC_INDX(33) | MMC_CMD_WAIT_RESPONSE)
+#define MMC_CMD35                       (MMC_INDX(35) | MMC_CMD_WAIT_RESPONSE)
+#define MMC_CMD36                       (MMC_INDX(36) | MMC_CMD_WAIT_RESPONSE)
+#define MMC_CMD38                       (MMC_INDX(38) | MMC_CMD_WAIT_RESPONSE)
+
+// CMD38 arguments
+#define EMMC_ERASE_ARG_ERASE            0x00000000
+#define EMMC_ERASE_ARG_TRIM             0x00000001
+#define EMMC_ERASE_ARG_DISCARD          0x00000003
+#define EMMC_ERASE_ARG_SECURE_ERASE     0x80000000
+#define EMMC_ERASE_ARG_SECURE_TRIM1     0x80000001
+#define EMMC_ERASE_ARG_SECURE_TRIM2     0x80008000
+#define EMMC_ERASE_ARG_SECURE           BIT31
+#define EMMC_ERASE_ARG_TRIM_MASK        0x00008001
+
+// SECURE_FEATURE_SUPPORT, the device supports secure erase and secure trim
+#define EMMC_SECURE_ER_EN               BIT0
+// SECURE_FEATURE_SUPPORT, the device supports TRIM
+#define EMMC_SEC_GB_CL_EN               BIT4
+// Discard came with eMMC 4.5
+#define EMMC_EXT_CSD_REV_4_5            6
+
+// Erase timeouts are multiples of 300ms per erase group, SD cards get 250ms per 4MB
+#define EMMC_ERASE_TIMEOUT_UNIT_MS      300
+#define SD_ERASE_TIMEOUT_UNIT_MS        250
+#define SD_ERASE_TIMEOUT_UNIT_BLOCKS    (SIZE_4MB / 512)
+#define MMC_ERASE_MIN_TIMEOUT_MS        1000
+
+// Largest zero write used for the edges of a range the card can not trim
+#define MMC_ERASE_ZERO_BLOCKS           256
+
+/**
+  Size in blocks of the unit the card erases, the one of the user area as set
+  by ERASE_GROUP_DEF for an eMMC.
+**/
+STATIC
+UINT32
+MmcEraseGroupBlocks (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  ECSD                    *ECSDData;
+  UINT32                  *Csd;
+  UINT32                  GroupSize;
+  UINT32                  GroupMult;
+
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    return 1;
+  }
+
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  if ((ECSDData->ERASE_GROUP_DEF & BIT0) && (ECSDData->HC_ERASE_GRP_SIZE != 0)) {
+    return ECSDData->HC_ERASE_GRP_SIZE * (SIZE_512KB / MmcHostInstance->BlockIo.Media->BlockSize);
+  }
+
+  // ERASE_GRP_SIZE [46:42] and ERASE_GRP_MULT [41:37] of the MMC CSD
+  Csd = (UINT32 *)&MmcHostInstance->CardInfo.CSDData;
+  GroupSize = (Csd[1] >> 10) & 0x1F;
+  GroupMult = (Csd[1] >> 5) & 0x1F;
+  return (GroupSize + 1) * (GroupMult + 1);
+}
+
+/**
+  Whether the erases should purge the blocks, and the card can.
+**/
+STATIC
+BOOLEAN
+MmcEraseSecure (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  return MmcHostInstance->SecureErase &&
+         (MmcHostInstance->CardInfo.CardType == EMMC_CARD) &&
+         ((MmcHostInstance->CardInfo.ECSDData.SECURE_FEATURE_SUPPORT & EMMC_SECURE_ER_EN) != 0);
+}
+
+/**
+  The CMD38 argument for the partial erase groups at the ends of a range, or
+  MAX_UINT32 when the card can only erase whole groups.
+**/
+STATIC
+UINT32
+MmcEraseEdgeArgument (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN BOOLEAN                Secure
+  )
+{
+  ECSD                    *ECSDData;
+
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    return EMMC_ERASE_ARG_ERASE;
+  }
+
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  if (Secure) {
+    return (ECSDData->SECURE_FEATURE_SUPPORT & EMMC_SEC_GB_CL_EN) ? EMMC_ERASE_ARG_SECURE_TRIM1 : MAX_UINT32;
+  }
+  // Unlike a discard, a trim leaves the blocks reading as erased
+  if (ECSDData->SECURE_FEATURE_SUPPORT & EMMC_SEC_GB_CL_EN) {
+    return EMMC_ERASE_ARG_TRIM;
+  }
+  if (ECSDData->EXT_CSD_REV >= EMMC_EXT_CSD_REV_4_5) {
+    return EMMC_ERASE_ARG_DISCARD;
+  }
+  return MAX_UINT32;
+}
+
+/**
+  Publish the erase granularity of the card that was just identified.
+**/
+VOID
+MmcUpdateEraseGranularity (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MmcHostInstance->EraseBlock.EraseLengthGranularity = MmcEraseGroupBlocks (MmcHostInstance);
+}
+
+/**
+  How long the card may stay busy erasing Blocks blocks, in milliseconds.
+**/
+STATIC
+UINTN
+MmcEraseTimeout (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT32                 Argument,
+  IN UINT64                 Blocks
+  )
+{
+  ECSD                    *ECSDData;
+  UINT64                  Groups;
+  UINT64                  Timeout;
+  UINT32                  Mult;
+
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    Timeout = DivU64x32 (Blocks + SD_ERASE_TIMEOUT_UNIT_BLOCKS - 1, SD_ERASE_TIMEOUT_UNIT_BLOCKS) *
+              SD_ERASE_TIMEOUT_UNIT_MS;
+  } else {
+    ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+    Groups = DivU64x32 (Blocks + MmcEraseGroupBlocks (MmcHostInstance) - 1, MmcEraseGroupBlocks (MmcHostInstance));
+    Mult = MAX (1, (Argument & EMMC_ERASE_ARG_TRIM_MASK) ? ECSDData->TRIM_MULT : ECSDData->ERASE_TIMEOUT_MULT);
+    // The secure variants take a multiple of the plain ones
+    if (Argument & EMMC_ERASE_ARG_SECURE) {
+      Mult *= MAX (1, (Argument & EMMC_ERASE_ARG_TRIM_MASK) ? ECSDData->SECURE_TRIM_MULT : ECSDData->SECURE_ERASE_MULT);
+    }
+    Timeout = Groups * EMMC_ERASE_TIMEOUT_UNIT_MS * Mult;
+  }
+  return (UINTN)MIN (MAX (Timeout, MMC_ERASE_MIN_TIMEOUT_MS), MAX_UINT32);
+}
+
+/**
+  Erase the blocks from Lba to Lba + Blocks - 1 with a single CMD38.
+**/
+STATIC
+EFI_STATUS
+MmcEraseRange (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks,
+  IN UINT32                 Argument
+  )
+{
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  EFI_STATUS              Status;
+  UINT32                  Response[4];
+  UINT64                  Start;
+  UINT64                  End;
+  UINT64                  TraceStart;
+  BOOLEAN                 IsEmmc;
+
+  MmcHost = MmcHostInstance->MmcHost;
+  IsEmmc = (MmcHostInstance->CardInfo.CardType == EMMC_CARD);
+
+  //Set command argument based on the card access mode (Byte mode or Block mode)
+  Start = Lba;
+  End = Lba + Blocks - 1;
+  if ((MmcHostInstance->CardInfo.OCRData.AccessMode & MMC_OCR_ACCESS_MASK) !=
+      MMC_OCR_ACCESS_SECTOR) {
+    Start = MultU64x32 (Start, MmcHostInstance->BlockIo.Media->BlockSize);
+    End = MultU64x32 (End, MmcHostInstance->BlockIo.Media->BlockSize);
+  }
+  if (End > MAX_UINT32) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  TraceStart = MmcTraceStart ();
+  Status = MmcHost->SendCommand (MmcHost, IsEmmc ? MMC_CMD35 : MMC_CMD32, (UINT32)Start);
+  if (!EFI_ERROR (Status)) {
+    Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcHost->SendCommand (MmcHost, IsEmmc ? MMC_CMD36 : MMC_CMD33, (UINT32)End);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "%a(): Failed to set the erase range, Status=%r\n", __func__, Status));
+    return Status;
+  }
+
+  // The hosts send CMD38 without waiting for the busy signal, which may last
+  // much longer than their own timeout, the erase timeout applies instead
+  Status = MmcHost->SendCommand (MmcHost, MMC_CMD38, Argument);
+  if (!EFI_ERROR (Status)) {
+    Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "%a(MMC_CMD38): Error, Status=%r\n", __func__, Status));
+    MmcTraceRecord (MmcHostInstance, MMC_CMD38, Argument, Lba, (UINTN)Blocks, TraceStart, Status);
+    return Status;
+  }
+
+  Status = MmcWaitProgramming (MmcHostInstance,
+             MultU64x32 (MmcEraseTimeout (MmcHostInstance, Argument, Blocks), 1000), Response);
+  MmcTraceRecord (MmcHostInstance, MMC_CMD38, Argument, Lba, (UINTN)Blocks, TraceStart, Status);
+  return Status;
+}
+
+/**
+  Clear the blocks of a partial erase group on a card that can not trim them.
+**/
+STATIC
+EFI_STATUS
+MmcEraseWriteZeros (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks
+  )
+{
+  EFI_BLOCK_IO_PROTOCOL   *BlockIo;
+  EFI_STATUS              Status;
+  VOID                    *Zeros;
+  UINTN                   Count;
+
+  BlockIo = &MmcHostInstance->BlockIo;
+  Zeros = AllocateZeroPool (MMC_ERASE_ZERO_BLOCKS * BlockIo->Media->BlockSize);
+  if (Zeros == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EFI_SUCCESS;
+  while ((Blocks > 0) && !EFI_ERROR (Status)) {
+    Count = (UINTN)MIN (Blocks, MMC_ERASE_ZERO_BLOCKS);
+    Status = MmcCacheIoBlocks (BlockIo, MMC_IOBLOCKS_WRITE, MediaId, Lba, Count * BlockIo->Media->BlockSize, Zeros);
+    Lba += Count;
+    Blocks -= Count;
+  }
+
+  FreePool (Zeros);
+  return Status;
+}
+
+/**
+  Clear the blocks of a partial erase group with EdgeArgument, as returned by
+  MmcEraseEdgeArgument().
+**/
+STATIC
+EFI_STATUS
+MmcEraseEdge (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks,
+  IN UINT32                 EdgeArgument
+  )
+{
+  EFI_STATUS              Status;
+
+  if (Blocks == 0) {
+    return EFI_SUCCESS;
+  }
+  if (EdgeArgument == MAX_UINT32) {
+    return MmcEraseWriteZeros (MmcHostInstance, MediaId, Lba, Blocks);
+  }
+
+  Status = MmcEraseRange (MmcHostInstance, Lba, Blocks, EdgeArgument);
+  // Step 1 only marks the blocks, step 2 purges them
+  if (!EFI_ERROR (Status) && (EdgeArgument == EMMC_ERASE_ARG_SECURE_TRIM1)) {
+    Status = MmcEraseRange (MmcHostInstance, Lba, Blocks, EMMC_ERASE_ARG_SECURE_TRIM2);
+  }
+  return Status;
+}
+
+/**
+  Erase a range that may start and end in the middle of an erase group. Must
+  be called at TPL_CALLBACK.
+**/
+STATIC
+EFI_STATUS
+MmcEraseDevice (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks
+  )
+{
+  EFI_STATUS              Status;
+  UINT32                  GroupBlocks;
+  BOOLEAN                 Secure;
+  UINT32                  EdgeArgument;
+  UINT64                  Head;
+  UINT64                  Middle;
+  UINT64                  Tail;
+
+  GroupBlocks = MmcEraseGroupBlocks (MmcHostInstance);
+  Secure = MmcEraseSecure (MmcHostInstance);
+  EdgeArgument = MmcEraseEdgeArgument (MmcHostInstance, Secure);
+
+  // Blocks before the first and after the last whole erase group
+  Head = (GroupBlocks - ModU64x32 (Lba, GroupBlocks)) % GroupBlocks;
+  Head = MIN (Head, Blocks);
+  Middle = Blocks - Head;
+  Tail = ModU64x32 (Middle, GroupBlocks);
+  Middle -= Tail;
+
+  // The cached lines would no longer match the card
+  MmcCacheInvalidate (MmcHostInstance);
+  MmcHostInstance->TransferReady = FALSE;
+
+  // The erase commands apply to the partition selected last
+  Status = MmcSelectPartition (MmcHostInstance, EMMC_PARTITION_USER);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  if (Middle > 0) {
+    Status = MmcEraseRange (MmcHostInstance, Lba + Head, Middle,
+               Secure ? EMMC_ERASE_ARG_SECURE_ERASE : EMMC_ERASE_ARG_ERASE);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcEraseEdge (MmcHostInstance, MediaId, Lba, Head, EdgeArgument);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcEraseEdge (MmcHostInstance, MediaId, Lba + Head + Middle, Tail, EdgeArgument);
+  }
+
+  if (EFI_ERROR (Status)) {
+    return (Status == EFI_INVALID_PARAMETER) ? Status : EFI_DEVICE_ERROR;
+  }
+  MmcHostInstance->TransferReady = TRUE;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcEraseBlocks (
+  IN     EFI_ERASE_BLOCK_PROTOCOL *This,
+  IN     UINT32                   MediaId,
+  IN     EFI_LBA                  LBA,
+  IN OUT EFI_ERASE_BLOCK_TOKEN    *Token,
+  IN     UINTN                    Size
+  )
+{
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_BLOCK_IO_MEDIA      *Media;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+  UINT64                  Blocks;
+
+  MmcHostInstance = MMC_HOST_INSTANCE_FROM_ERASE_BLOCK_THIS (This);
+  Media = MmcHostInstance->BlockIo.Media;
+
+  if (!Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+  if (Media->MediaId != MediaId) {
+    return EFI_MEDIA_CHANGED;
+  }
+  if (Media->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+  if ((Size % Media->BlockSize) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Blocks = Size / Media->BlockSize;
+  if ((LBA > Media->LastBlock) || (Blocks > Media->LastBlock - LBA + 1)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = EFI_SUCCESS;
+  if (Blocks > 0) {
+    // Let the BlockIo2 requests queued before this one go first
+    OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+    MmcDrainRequestQueue (MmcHostInstance);
+    Status = MmcEraseDevice (MmcHostInstance, MediaId, LBA, Blocks);
+    gBS->RestoreTPL (OldTpl);
+  }
+
+  if ((Token != NULL) && (Token->Event != NULL)) {
+    Token->TransactionStatus = Status;
+    gBS->SignalEvent (Token->Event);
+    return EFI_SUCCESS;
+  }
+  return Status;
+}
@@ -28,6 +28,9 @@ typedef union {
 #define EMMC_CARD_SIZE          512
 #define EMMC_ECSD_SIZE_OFFSET   53
 
+#define EXTCSD_FLUSH_CACHE      32
+#define EXTCSD_CACHE_CTRL       33
+#define EXTCSD_PARTITION_CONFIG 179
 #define EXTCSD_BUS_WIDTH        183
 #define EXTCSD_HS_TIMING        185
 
@@ -44,6 +47,9 @@ typedef union {
 
 #define EMMC_SWITCH_ERROR       (1 << 7)
 
+// The volatile cache came with eMMC 4.5
+#define EMMC_EXT_CSD_REV_4_5    6
+
 #define SD_BUS_WIDTH_1BIT       (1 << 0)
 #define SD_BUS_WIDTH_4BIT       (1 << 2)
 
@@ -115,13 +121,16 @@ EmmcSetEXTCSD (
   EMMC_DEVICE_STATE     State;
   EFI_STATUS Status;
   UINT32     Argument;
+  UINT64     TraceStart;
 
   Host  = MmcHostInstance->MmcHost;
   Argument = EMMC_CMD6_ARG_ACCESS(3) | EMMC_CMD6_ARG_INDEX(ExtCmdIndex) |
              EMMC_CMD6_ARG_VALUE(Value) | EMMC_CMD6_ARG_CMD_SET(1);
+  TraceStart = MmcTraceStart ();
   Status = Host->SendCommand (Host, MMC_CMD6, Argument);
   if (EFI_ERROR (Status)) {
     DEBUG ((EFI_D_ERROR, "EmmcSetEXTCSD(): Failed to send CMD6, Status=%r.\n", Status));
+    MmcTraceRecord (MmcHostInstance, MMC_CMD6, Argument, 0, 0, TraceStart, Status);
     return Status;
   }
   // Make sure device exiting prog mode
@@ -129,10 +138,11 @@ EmmcSetEXTCSD (
     Status = EmmcGetDeviceState (MmcHostInstance, &State);
     if (EFI_ERROR (Status)) {
       DEBUG ((EFI_D_ERROR, "EmmcSetEXTCSD(): Failed to get device state, Status=%r.\n", Status));
-      return Status;
+      break;
     }
   } while (State == EMMC_PRG_STATE);
-  return EFI_SUCCESS;
+  MmcTraceRecord (MmcHostInstance, MMC_CMD6, Argument, 0, 0, TraceStart, Status);
+  return Status;
 }
 
 STATIC
@@ -247,24 +257,16 @@ EmmcIdentificationMode (
 
 STATIC
 EFI_STATUS
-InitializeEmmcDevice (
+EmmcSwitchHighSpeed (
   IN  MMC_HOST_INSTANCE   *MmcHostInstance
   )
 {
   EFI_MMC_HOST_PROTOCOL *Host;
-  EFI_STATUS Status = EFI_SUCCESS;
-  ECSD       *ECSDData;
-  UINT32     BusClockFreq, Idx;
+  EFI_STATUS Status = EFI_UNSUPPORTED;
+  UINT32     BusClockFreq, BusWidth, Idx;
   UINT32     TimingMode[4] = {EMMCHS52DDR1V2, EMMCHS52DDR1V8, EMMCHS52, EMMCHS26};
 
   Host  = MmcHostInstance->MmcHost;
-  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
-  if (ECSDData->DEVICE_TYPE == EMMCBACKWARD)
-    return EFI_SUCCESS;
-
-  if (!MMC_HOST_HAS_SETIOS(Host)) {
-    return EFI_SUCCESS;
-  }
   Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_HS_TIMING, EMMC_TIMING_HS);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "InitializeEmmcDevice(): Failed to switch high speed mode, Status:%r.\n", Status));
@@ -272,21 +274,29 @@ InitializeEmmcDevice (
   }
 
   for (Idx = 0; Idx < 4; Idx++) {
+    if ((MmcHostInstance->CardInfo.ECSDData.DEVICE_TYPE & TimingMode[Idx]) == 0) {
+      continue;
+    }
     switch (TimingMode[Idx]) {
     case EMMCHS52DDR1V2:
     case EMMCHS52DDR1V8:
+      BusClockFreq = 52000000;
+      BusWidth = EMMC_BUS_WIDTH_DDR_8BIT;
+      break;
     case EMMCHS52:
       BusClockFreq = 52000000;
+      BusWidth = EMMC_BUS_WIDTH_8BIT;
       break;
     case EMMCHS26:
       BusClockFreq = 26000000;
+      BusWidth = EMMC_BUS_WIDTH_8BIT;
       break;
     default:
       return EFI_UNSUPPORTED;
     }
     Status = Host->SetIos (Host, BusClockFreq, 8, TimingMode[Idx]);
     if (!EFI_ERROR (Status)) {
-      Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_BUS_WIDTH, EMMC_BUS_WIDTH_DDR_8BIT);
+      Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_BUS_WIDTH, BusWidth);
       if (EFI_ERROR (Status)) {
         DEBUG ((DEBUG_ERROR, "InitializeEmmcDevice(): Failed to set EXTCSD bus width, Status:%r\n", Status));
       }
@@ -296,6 +306,259 @@ InitializeEmmcDevice (
   return Status;
 }
 
+/**
+  Switch the card to HS200 and let the host tune its sample point.
+
+  The host runs the CMD21 tuning sequence from SetIos() and fails the call
+  when it cannot find a working sample point.
+
+**/
+STATIC
+EFI_STATUS
+EmmcSwitchHs200 (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_MMC_HOST_PROTOCOL *Host;
+  EFI_STATUS Status;
+  UINT32     TimingMode;
+
+  Host  = MmcHostInstance->MmcHost;
+  if (MmcHostInstance->CardInfo.ECSDData.DEVICE_TYPE & EMMCHS200SDR1V8) {
+    TimingMode = EMMCHS200SDR1V8;
+  } else {
+    TimingMode = EMMCHS200SDR1V2;
+  }
+
+  // HS200 only runs on a 4 or 8 bit SDR bus
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_BUS_WIDTH, EMMC_BUS_WIDTH_8BIT);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = Host->SetIos (Host, 0, 8, EMMCBACKWARD);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_HS_TIMING, EMMC_TIMING_HS200);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  return Host->SetIos (Host, 200000000, 8, TimingMode);
+}
+
+/**
+  Move a card running HS200 to HS400.
+
+  The card has to go through HS timing to accept the DDR bus width, after
+  which the host is switched to HS400 at the HS200 clock.
+
+**/
+STATIC
+EFI_STATUS
+EmmcSwitchHs400 (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_MMC_HOST_PROTOCOL *Host;
+  EFI_STATUS Status;
+  UINT32     TimingMode;
+
+  Host  = MmcHostInstance->MmcHost;
+  if (MmcHostInstance->CardInfo.ECSDData.DEVICE_TYPE & EMMCHS400DDR1V8) {
+    TimingMode = EMMCHS400DDR1V8;
+  } else {
+    TimingMode = EMMCHS400DDR1V2;
+  }
+
+  Status = Host->SetIos (Host, 52000000, 8, EMMCHS52);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_HS_TIMING, EMMC_TIMING_HS);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_BUS_WIDTH, EMMC_BUS_WIDTH_DDR_8BIT);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_HS_TIMING, EMMC_TIMING_HS400);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  return Host->SetIos (Host, 200000000, 8, TimingMode);
+}
+
+/**
+  Bring a card back to legacy timing on a slow clock after a failed attempt
+  at HS200 or HS400, so that the next mode can be tried from a known state.
+
+**/
+STATIC
+EFI_STATUS
+EmmcResetTiming (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_MMC_HOST_PROTOCOL *Host;
+  EFI_STATUS Status;
+
+  Host  = MmcHostInstance->MmcHost;
+  Status = Host->SetIos (Host, 400000, 8, EMMCHS26);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_HS_TIMING, EMMC_TIMING_BACKWARD);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  return EmmcSetEXTCSD (MmcHostInstance, EXTCSD_BUS_WIDTH, EMMC_BUS_WIDTH_8BIT);
+}
+
+STATIC
+EFI_STATUS
+InitializeEmmcDevice (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_MMC_HOST_PROTOCOL *Host;
+  EFI_STATUS Status = EFI_SUCCESS;
+  ECSD       *ECSDData;
+
+  Host  = MmcHostInstance->MmcHost;
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  if (ECSDData->DEVICE_TYPE == EMMCBACKWARD)
+    return EFI_SUCCESS;
+
+  if (!MMC_HOST_HAS_SETIOS(Host)) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Try the fastest modes first and walk down the ladder whenever the host
+  // refuses a mode or cannot tune for it: HS400, HS200, then DDR52, HS52
+  // and HS26.
+  //
+  if (ECSDData->DEVICE_TYPE & (EMMCHS200SDR1V8 | EMMCHS200SDR1V2)) {
+    Status = EmmcSwitchHs200 (MmcHostInstance);
+    if (!EFI_ERROR (Status) &&
+        (ECSDData->DEVICE_TYPE & (EMMCHS400DDR1V8 | EMMCHS400DDR1V2))) {
+      Status = EmmcSwitchHs400 (MmcHostInstance);
+      if (!EFI_ERROR (Status)) {
+        DEBUG ((DEBUG_INFO, "InitializeEmmcDevice(): HS400\n"));
+        return EFI_SUCCESS;
+      }
+      DEBUG ((DEBUG_INFO, "InitializeEmmcDevice(): HS400 failed, Status:%r\n", Status));
+      Status = EmmcResetTiming (MmcHostInstance);
+      if (!EFI_ERROR (Status)) {
+        Status = EmmcSwitchHs200 (MmcHostInstance);
+      }
+    }
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "InitializeEmmcDevice(): HS200\n"));
+      return EFI_SUCCESS;
+    }
+    DEBUG ((DEBUG_INFO, "InitializeEmmcDevice(): HS200 failed, Status:%r\n", Status));
+    Status = EmmcResetTiming (MmcHostInstance);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EmmcSwitchHighSpeed (MmcHostInstance);
+}
+
+/**
+  Turn the volatile write cache of the eMMC on when it has one. Writes then
+  complete once they reach the cache, and MmcFlushBlocks() has to commit them.
+**/
+STATIC
+EFI_STATUS
+EmmcEnableCache (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  ECSD       *ECSDData;
+  UINT32     CacheSize;
+  EFI_STATUS Status;
+
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  if (ECSDData->EXT_CSD_REV < EMMC_EXT_CSD_REV_4_5) {
+    return EFI_UNSUPPORTED;
+  }
+  // In KiB
+  CacheSize = ECSDData->CACHE_SIZE[0] | (ECSDData->CACHE_SIZE[1] << 8) |
+              (ECSDData->CACHE_SIZE[2] << 16) | (ECSDData->CACHE_SIZE[3] << 24);
+  if (CacheSize == 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_CACHE_CTRL, 1);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "EmmcEnableCache(): Failed to enable the cache, Status=%r.\n", Status));
+    return Status;
+  }
+  DEBUG ((EFI_D_INFO, "EmmcEnableCache(): %dKB write cache\n", CacheSize));
+  MmcHostInstance->BlockIo.Media->WriteCaching = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Commit the content of the eMMC write cache to the flash.
+**/
+EFI_STATUS
+EmmcFlushCache (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_STATUS Status;
+
+  if (!MmcHostInstance->BlockIo.Media->WriteCaching) {
+    return EFI_SUCCESS;
+  }
+
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_FLUSH_CACHE, 1);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "EmmcFlushCache(): Failed to flush the cache, Status=%r.\n", Status));
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Give the following data commands access to a hardware partition of the
+  eMMC. The switch is only sent when another partition is selected.
+**/
+EFI_STATUS
+MmcSelectPartition (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance,
+  IN  UINT8               Partition
+  )
+{
+  ECSD       *ECSDData;
+  UINT8      Config;
+  EFI_STATUS Status;
+
+  if (Partition == MmcHostInstance->PartitionAccess) {
+    return EFI_SUCCESS;
+  }
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    return EFI_UNSUPPORTED;
+  }
+
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  Config = (ECSDData->PARTITION_CONFIG & ~EMMC_PARTITION_MASK) | Partition;
+  Status = EmmcSetEXTCSD (MmcHostInstance, EXTCSD_PARTITION_CONFIG, Config);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "MmcSelectPartition(): Failed to select partition %d, Status=%r.\n", Partition, Status));
+    MmcHostInstance->PartitionAccess = EMMC_PARTITION_UNKNOWN;
+    return Status;
+  }
+  ECSDData->PARTITION_CONFIG = Config;
+  MmcHostInstance->PartitionAccess = Partition;
+  return EFI_SUCCESS;
+}
+
 STATIC
 EFI_STATUS
 InitializeSdMmcDevice (
@@ -391,6 +654,7 @@ InitializeSdMmcDevice (
       return Status;
     }
     CopyMem (&Scr, Buffer, 8);
+    MmcHostInstance->SetBlockCount = (Scr.CMD_SUPPORT & SD_SCR_CMD_SUPPORT_CMD23) != 0;
     if (Scr.SD_SPEC == 2) {
       if (Scr.SD_SPEC3 == 1) {
 	if (Scr.SD_SPEC4 == 1) {
@@ -458,87 +722,80 @@ InitializeSdMmcDevice (
   return EFI_SUCCESS;
 }
 
-STATIC
+/**
+  Bring the host up and put the card back to the idle state. The power-up
+  of the card is then driven by MmcIdentificationPoll().
+**/
 EFI_STATUS
-EFIAPI
-MmcIdentificationMode (
+MmcStartIdentification (
   IN MMC_HOST_INSTANCE     *MmcHostInstance
   )
 {
   EFI_STATUS              Status;
-  UINT32                  Response[4];
-  UINTN                   Timeout;
-  UINTN                   CmdArg;
-  BOOLEAN                 IsHCS;
   EFI_MMC_HOST_PROTOCOL   *MmcHost;
-  OCR_RESPONSE            OcrResponse;
 
   MmcHost = MmcHostInstance->MmcHost;
-  CmdArg = 0;
-  IsHCS = FALSE;
-
   if (MmcHost == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
+  MmcHostInstance->SetBlockCount = FALSE;
+  MmcHostInstance->TransferReady = FALSE;
+  MmcHostInstance->BlockIo.Media->WriteCaching = FALSE;
+  // CMD0 brings an eMMC back to its user area
+  MmcHostInstance->PartitionAccess = EMMC_PARTITION_USER;
+  MmcHostInstance->IdentifyStep = MmcIdentifyFailed;
+  MmcHostInstance->Stats.IdentifyStart = GetPerformanceCounter ();
+
   // We can get into this function if we restart the identification mode
   if (MmcHostInstance->State == MmcHwInitializationState) {
     // Initialize the MMC Host HW
     Status = MmcNotifyState (MmcHostInstance, MmcHwInitializationState);
     if (EFI_ERROR (Status)) {
-      DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Error MmcHwInitializationState, Status=%r.\n", Status));
+      DEBUG ((EFI_D_ERROR, "MmcStartIdentification() : Error MmcHwInitializationState, Status=%r.\n", Status));
       return Status;
     }
   }
 
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD0, 0);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(MMC_CMD0): Error, Status=%r.\n", Status));
+    DEBUG ((EFI_D_ERROR, "MmcStartIdentification(MMC_CMD0): Error, Status=%r.\n", Status));
     return Status;
   }
   Status = MmcNotifyState (MmcHostInstance, MmcIdleState);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Error MmcIdleState, Status=%r.\n", Status));
+    DEBUG ((EFI_D_ERROR, "MmcStartIdentification() : Error MmcIdleState, Status=%r.\n", Status));
     return Status;
   }
 
-  // Send CMD1 to get OCR (MMC)
-  // This command only valid for MMC and eMMC
-  Timeout = MAX_RETRY_COUNT;
-  do {
-    Status = MmcHost->SendCommand (MmcHost, MMC_CMD1, EMMC_CMD1_CAPACITY_GREATER_THAN_2GB);
-    if (EFI_ERROR (Status))
-      break;
-    Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, (UINT32 *)&OcrResponse);
-    if (EFI_ERROR (Status)) {
-      DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive OCR, Status=%r.\n", Status));
-      return Status;
-    }
-    Timeout--;
-  } while (!OcrResponse.Ocr.PowerUp && (Timeout > 0));
-  if (Status == EFI_SUCCESS) {
-    if (!OcrResponse.Ocr.PowerUp) {
-      DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(MMC_CMD1): Card initialisation failure, Status=%r.\n", Status));
-      return EFI_DEVICE_ERROR;
-    }
-    OcrResponse.Ocr.PowerUp = 0;
-    if (OcrResponse.Raw == EMMC_CMD1_CAPACITY_GREATER_THAN_2GB) {
-      MmcHostInstance->CardInfo.OCRData.AccessMode = BIT1;
-    }
-    else {
-      MmcHostInstance->CardInfo.OCRData.AccessMode = 0x0;
-    }
-    // Check whether MMC or eMMC
-    if (OcrResponse.Raw == EMMC_CMD1_CAPACITY_GREATER_THAN_2GB ||
-        OcrResponse.Raw == EMMC_CMD1_CAPACITY_LESS_THAN_2GB) {
-      return EmmcIdentificationMode (MmcHostInstance, OcrResponse);
-    }
-  }
+  // Send CMD1 to get OCR (MMC), only MMC and eMMC answer it
+  MmcHostInstance->IdentifyStep = MmcIdentifyEmmcPowerUp;
+  MmcHostInstance->IdentifyRetry = MAX_RETRY_COUNT;
+  return EFI_SUCCESS;
+}
+
+/**
+  The card did not identify as an eMMC, check for an SD card and start its
+  power-up.
+**/
+STATIC
+EFI_STATUS
+MmcStartSdPowerUp (
+  IN MMC_HOST_INSTANCE     *MmcHostInstance
+  )
+{
+  EFI_STATUS              Status;
+  UINT32                  Response[4];
+  UINTN                   CmdArg;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+
+  MmcHost = MmcHostInstance->MmcHost;
+  MmcHostInstance->IdentifyHcs = FALSE;
 
   // Are we using SDIO ?
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD5, 0);
   if (Status == EFI_SUCCESS) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(MMC_CMD5): Error - SDIO not supported, Status=%r.\n", Status));
+    DEBUG ((EFI_D_ERROR, "MmcStartSdPowerUp(MMC_CMD5): Error - SDIO not supported, Status=%r.\n", Status));
     return EFI_UNSUPPORTED;
   }
 
@@ -547,10 +804,10 @@ MmcIdentificationMode (
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD8, CmdArg);
   if (Status == EFI_SUCCESS) {
     DEBUG ((EFI_D_ERROR, "Card is SD2.0 => Supports high capacity\n"));
-    IsHCS = TRUE;
+    MmcHostInstance->IdentifyHcs = TRUE;
     Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_R7, Response);
     if (EFI_ERROR (Status)) {
-      DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive response to CMD8, Status=%r.\n", Status));
+      DEBUG ((EFI_D_ERROR, "MmcStartSdPowerUp() : Failed to receive response to CMD8, Status=%r.\n", Status));
       return Status;
     }
     PrintResponseR1 (Response[0]);
@@ -564,85 +821,41 @@ MmcIdentificationMode (
   }
 
   // We need to wait for the MMC or SD card is ready => (gCardInfo.OCRData.PowerUp == 1)
-  Timeout = MAX_RETRY_COUNT;
-  while (Timeout > 0) {
-    // SD Card or MMC Card ? CMD55 indicates to the card that the next command is an application specific command
-    Status = MmcHost->SendCommand (MmcHost, MMC_CMD55, 0);
-    if (Status == EFI_SUCCESS) {
-      DEBUG ((EFI_D_INFO, "Card should be SD\n"));
-      if (IsHCS) {
-        MmcHostInstance->CardInfo.CardType = SD_CARD_2;
-      } else {
-        MmcHostInstance->CardInfo.CardType = SD_CARD;
-      }
-
-      // Note: The first time CmdArg will be zero
-      CmdArg = ((UINTN *) &(MmcHostInstance->CardInfo.OCRData))[0];
-      if (IsHCS) {
-        CmdArg |= BIT30;
-      }
-      Status = MmcHost->SendCommand (MmcHost, MMC_ACMD41, CmdArg);
-      if (!EFI_ERROR (Status)) {
-        Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, Response);
-        if (EFI_ERROR (Status)) {
-          DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive OCR, Status=%r.\n", Status));
-          return Status;
-        }
-        ((UINT32 *) &(MmcHostInstance->CardInfo.OCRData))[0] = Response[0];
-      }
-    } else {
-      DEBUG ((EFI_D_INFO, "Card should be MMC\n"));
-      MmcHostInstance->CardInfo.CardType = MMC_CARD;
-
-      Status = MmcHost->SendCommand (MmcHost, MMC_CMD1, 0x800000);
-      if (!EFI_ERROR (Status)) {
-        Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, Response);
-        if (EFI_ERROR (Status)) {
-          DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive OCR, Status=%r.\n", Status));
-          return Status;
-        }
-        ((UINT32 *) &(MmcHostInstance->CardInfo.OCRData))[0] = Response[0];
-      }
-    }
+  MmcHostInstance->IdentifyStep = MmcIdentifySdPowerUp;
+  MmcHostInstance->IdentifyRetry = MAX_RETRY_COUNT;
+  return EFI_SUCCESS;
+}
 
-    if (!EFI_ERROR (Status)) {
-      if (!MmcHostInstance->CardInfo.OCRData.PowerUp) {
-        gBS->Stall (1);
-        Timeout--;
-      } else {
-        if ((MmcHostInstance->CardInfo.CardType == SD_CARD_2) && (MmcHostInstance->CardInfo.OCRData.AccessMode & BIT1)) {
-          MmcHostInstance->CardInfo.CardType = SD_CARD_2_HIGH;
-          DEBUG ((EFI_D_ERROR, "High capacity card.\n"));
-        }
-        break;  // The MMC/SD card is ready. Continue the Identification Mode
-      }
-    } else {
-      gBS->Stall (1);
-      Timeout--;
-    }
-  }
+/**
+  Identify an SD or MMC card that has completed its power-up.
+**/
+STATIC
+EFI_STATUS
+MmcIdentifySdCard (
+  IN MMC_HOST_INSTANCE     *MmcHostInstance
+  )
+{
+  EFI_STATUS              Status;
+  UINT32                  Response[4];
+  UINTN                   CmdArg;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
 
-  if (Timeout == 0) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(): No Card\n"));
-    return EFI_NO_MEDIA;
-  } else {
-    PrintOCR (Response[0]);
-  }
+  MmcHost = MmcHostInstance->MmcHost;
 
   Status = MmcNotifyState (MmcHostInstance, MmcReadyState);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Error MmcReadyState\n"));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard() : Error MmcReadyState\n"));
     return Status;
   }
 
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD2, 0);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(MMC_CMD2): Error\n"));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard(MMC_CMD2): Error\n"));
     return Status;
   }
   Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_CID, Response);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive CID, Status=%r.\n", Status));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard() : Failed to receive CID, Status=%r.\n", Status));
     return Status;
   }
 
@@ -650,7 +863,7 @@ MmcIdentificationMode (
 
   Status = MmcHost->NotifyState (MmcHost, MmcIdentificationState);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Error MmcIdentificationState\n"));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard() : Error MmcIdentificationState\n"));
     return Status;
   }
 
@@ -662,13 +875,13 @@ MmcIdentificationMode (
   CmdArg = 1;
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD3, CmdArg);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode(MMC_CMD3): Error\n"));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard(MMC_CMD3): Error\n"));
     return Status;
   }
 
   Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_RCA, Response);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Failed to receive RCA, Status=%r.\n", Status));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard() : Failed to receive RCA, Status=%r.\n", Status));
     return Status;
   }
   PrintRCA (Response[0]);
@@ -681,34 +894,162 @@ MmcIdentificationMode (
   }
   Status = MmcNotifyState (MmcHostInstance, MmcStandByState);
   if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "MmcIdentificationMode() : Error MmcStandByState\n"));
+    DEBUG ((EFI_D_ERROR, "MmcIdentifySdCard() : Error MmcStandByState\n"));
     return Status;
   }
 
   return EFI_SUCCESS;
 }
 
+/**
+  One CMD1 poll of an eMMC power-up.
+**/
+STATIC
 EFI_STATUS
-InitializeMmcDevice (
-  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+MmcPollEmmcPowerUp (
+  IN MMC_HOST_INSTANCE     *MmcHostInstance
   )
 {
   EFI_STATUS              Status;
   EFI_MMC_HOST_PROTOCOL   *MmcHost;
-  UINTN                   BlockCount;
+  OCR_RESPONSE            OcrResponse;
 
-  BlockCount = 1;
   MmcHost = MmcHostInstance->MmcHost;
 
-  Status = MmcIdentificationMode (MmcHostInstance);
+  Status = MmcHost->SendCommand (MmcHost, MMC_CMD1, EMMC_CMD1_CAPACITY_GREATER_THAN_2GB);
   if (EFI_ERROR (Status)) {
-    DEBUG((EFI_D_ERROR, "InitializeMmcDevice(): Error in Identification Mode, Status=%r\n", Status));
+    return MmcStartSdPowerUp (MmcHostInstance);
+  }
+  Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, (UINT32 *)&OcrResponse);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "MmcPollEmmcPowerUp() : Failed to receive OCR, Status=%r.\n", Status));
+    return Status;
+  }
+
+  if (!OcrResponse.Ocr.PowerUp) {
+    if (--MmcHostInstance->IdentifyRetry == 0) {
+      DEBUG ((EFI_D_ERROR, "MmcPollEmmcPowerUp(MMC_CMD1): Card initialisation failure\n"));
+      return EFI_DEVICE_ERROR;
+    }
+    return EFI_SUCCESS;
+  }
+
+  OcrResponse.Ocr.PowerUp = 0;
+  if (OcrResponse.Raw == EMMC_CMD1_CAPACITY_GREATER_THAN_2GB) {
+    MmcHostInstance->CardInfo.OCRData.AccessMode = BIT1;
+  }
+  else {
+    MmcHostInstance->CardInfo.OCRData.AccessMode = 0x0;
+  }
+  // Check whether MMC or eMMC
+  if (OcrResponse.Raw == EMMC_CMD1_CAPACITY_GREATER_THAN_2GB ||
+      OcrResponse.Raw == EMMC_CMD1_CAPACITY_LESS_THAN_2GB) {
+    Status = EmmcIdentificationMode (MmcHostInstance, OcrResponse);
+    if (!EFI_ERROR (Status)) {
+      MmcHostInstance->IdentifyStep = MmcIdentifyDone;
+    }
     return Status;
   }
 
+  return MmcStartSdPowerUp (MmcHostInstance);
+}
+
+/**
+  One ACMD41 (CMD1 for MMC) poll of an SD or MMC power-up.
+**/
+STATIC
+EFI_STATUS
+MmcPollSdPowerUp (
+  IN MMC_HOST_INSTANCE     *MmcHostInstance
+  )
+{
+  EFI_STATUS              Status;
+  UINT32                  Response[4];
+  UINTN                   CmdArg;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+
+  MmcHost = MmcHostInstance->MmcHost;
+
+  // SD Card or MMC Card ? CMD55 indicates to the card that the next command is an application specific command
+  Status = MmcHost->SendCommand (MmcHost, MMC_CMD55, 0);
+  if (Status == EFI_SUCCESS) {
+    DEBUG ((EFI_D_INFO, "Card should be SD\n"));
+    if (MmcHostInstance->IdentifyHcs) {
+      MmcHostInstance->CardInfo.CardType = SD_CARD_2;
+    } else {
+      MmcHostInstance->CardInfo.CardType = SD_CARD;
+    }
+
+    // Note: The first time CmdArg will be zero
+    CmdArg = ((UINTN *) &(MmcHostInstance->CardInfo.OCRData))[0];
+    if (MmcHostInstance->IdentifyHcs) {
+      CmdArg |= BIT30;
+    }
+    Status = MmcHost->SendCommand (MmcHost, MMC_ACMD41, CmdArg);
+    if (!EFI_ERROR (Status)) {
+      Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, Response);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "MmcPollSdPowerUp() : Failed to receive OCR, Status=%r.\n", Status));
+        return Status;
+      }
+      ((UINT32 *) &(MmcHostInstance->CardInfo.OCRData))[0] = Response[0];
+    }
+  } else {
+    DEBUG ((EFI_D_INFO, "Card should be MMC\n"));
+    MmcHostInstance->CardInfo.CardType = MMC_CARD;
+
+    Status = MmcHost->SendCommand (MmcHost, MMC_CMD1, 0x800000);
+    if (!EFI_ERROR (Status)) {
+      Status = MmcHost->ReceiveResponse (MmcHost, MMC_RESPONSE_TYPE_OCR, Response);
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "MmcPollSdPowerUp() : Failed to receive OCR, Status=%r.\n", Status));
+        return Status;
+      }
+      ((UINT32 *) &(MmcHostInstance->CardInfo.OCRData))[0] = Response[0];
+    }
+  }
+
+  if (EFI_ERROR (Status) || !MmcHostInstance->CardInfo.OCRData.PowerUp) {
+    if (--MmcHostInstance->IdentifyRetry == 0) {
+      DEBUG ((EFI_D_ERROR, "MmcPollSdPowerUp(): No Card\n"));
+      return EFI_NO_MEDIA;
+    }
+    return EFI_SUCCESS;
+  }
+
+  // The MMC/SD card is ready. Continue the Identification Mode
+  if ((MmcHostInstance->CardInfo.CardType == SD_CARD_2) && (MmcHostInstance->CardInfo.OCRData.AccessMode & BIT1)) {
+    MmcHostInstance->CardInfo.CardType = SD_CARD_2_HIGH;
+    DEBUG ((EFI_D_ERROR, "High capacity card.\n"));
+  }
+  PrintOCR (Response[0]);
+
+  Status = MmcIdentifySdCard (MmcHostInstance);
+  if (!EFI_ERROR (Status)) {
+    MmcHostInstance->IdentifyStep = MmcIdentifyDone;
+  }
+  return Status;
+}
+
+/**
+  Switch an identified card to the transfer state and its fastest bus mode.
+**/
+STATIC
+EFI_STATUS
+MmcInitializeTransferMode (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_STATUS              Status;
+  EFI_MMC_HOST_PROTOCOL   *MmcHost;
+  UINTN                   BlockCount;
+
+  BlockCount = 1;
+  MmcHost = MmcHostInstance->MmcHost;
+
   Status = MmcNotifyState (MmcHostInstance, MmcTransferState);
   if (EFI_ERROR (Status)) {
-    DEBUG((EFI_D_ERROR, "InitializeMmcDevice(): Error MmcTransferState, Status=%r\n", Status));
+    DEBUG((EFI_D_ERROR, "MmcInitializeTransferMode(): Error MmcTransferState, Status=%r\n", Status));
     return Status;
   }
 
@@ -716,6 +1057,12 @@ InitializeMmcDevice (
     Status = InitializeSdMmcDevice (MmcHostInstance);
   } else {
     Status = InitializeEmmcDevice (MmcHostInstance);
+    // CMD23 is mandatory since MMC 3.1
+    MmcHostInstance->SetBlockCount = TRUE;
+    if (!EFI_ERROR (Status)) {
+      // The card works without its cache, only slower
+      EmmcEnableCache (MmcHostInstance);
+    }
   }
   if (EFI_ERROR (Status)) {
     return Status;
@@ -724,7 +1071,7 @@ InitializeMmcDevice (
   // Set Block Length
   Status = MmcHost->SendCommand (MmcHost, MMC_CMD16, MmcHostInstance->BlockIo.Media->BlockSize);
   if (EFI_ERROR (Status)) {
-    DEBUG((EFI_D_ERROR, "InitializeMmcDevice(MMC_CMD16): Error MmcHostInstance->BlockIo.Media->BlockSize: %d and Error = %r\n",
+    DEBUG((EFI_D_ERROR, "MmcInitializeTransferMode(MMC_CMD16): Error MmcHostInstance->BlockIo.Media->BlockSize: %d and Error = %r\n",
                         MmcHostInstance->BlockIo.Media->BlockSize, Status));
     return Status;
   }
@@ -733,10 +1080,53 @@ InitializeMmcDevice (
   if (MmcHostInstance->CardInfo.CardType == MMC_CARD) {
     Status = MmcHost->SendCommand (MmcHost, MMC_CMD23, BlockCount);
     if (EFI_ERROR (Status)) {
-      DEBUG((EFI_D_ERROR, "InitializeMmcDevice(MMC_CMD23): Error, Status=%r\n", Status));
+      DEBUG((EFI_D_ERROR, "MmcInitializeTransferMode(MMC_CMD23): Error, Status=%r\n", Status));
       return Status;
     }
   }
 
   return EFI_SUCCESS;
 }
+
+/**
+  Advance the identification started by MmcStartIdentification() by one step.
+
+  @retval EFI_SUCCESS     The card is identified and ready for data transfers.
+  @retval EFI_NOT_READY   The card is still powering up, poll again later.
+  @retval Others          The identification failed.
+
+**/
+EFI_STATUS
+MmcIdentificationPoll (
+  IN  MMC_HOST_INSTANCE   *MmcHostInstance
+  )
+{
+  EFI_STATUS              Status;
+
+  switch (MmcHostInstance->IdentifyStep) {
+  case MmcIdentifyEmmcPowerUp:
+    Status = MmcPollEmmcPowerUp (MmcHostInstance);
+    break;
+  case MmcIdentifySdPowerUp:
+    Status = MmcPollSdPowerUp (MmcHostInstance);
+    break;
+  case MmcIdentifyDone:
+    return EFI_SUCCESS;
+  default:
+    return EFI_DEVICE_ERROR;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (MmcHostInstance->IdentifyStep != MmcIdentifyDone) {
+      return EFI_NOT_READY;
+    }
+    Status = MmcInitializeTransferMode (MmcHostInstance);
+    MmcHostInstance->Stats.IdentifyTicks = GetPerformanceCounter () - MmcHostInstance->Stats.IdentifyStart;
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG((EFI_D_ERROR, "MmcIdentificationPoll(): Error in Identification Mode, Status=%r\n", Status));
+    MmcHostInstance->IdentifyStep = MmcIdentifyFailed;
+  }
+
+  return Status;
+}
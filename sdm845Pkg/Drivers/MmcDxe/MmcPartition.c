@@ -0,0 +1,351 @@
+/** @file
+  Hardware partitions of the eMMC
+
+  The boot and general purpose partitions are published as BlockIo devices
+  of their own, next to the user area. The card only gives access to one
+  partition at a time, MmcIoBlocks() switches PARTITION_CONFIG when a request
+  targets another partition than the one accessed last.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "Mmc.h"
+
+// PARTITION_SETTING_COMPLETED, the general purpose partitions are configured
+#define EMMC_PARTITION_SETTING_COMPLETED  BIT0
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcPartitionReset (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN BOOLEAN                  ExtendedVerification
+  )
+{
+  MMC_PARTITION           *Partition;
+  MMC_HOST_INSTANCE       *MmcHostInstance;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  Partition = MMC_PARTITION_FROM_BLOCK_IO_THIS (This);
+  MmcHostInstance = Partition->MmcHostInstance;
+  if (!Partition->Media.MediaPresent) {
+    return EFI_SUCCESS;
+  }
+
+  // Send the switch again whatever the card is believed to have selected
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (MmcHostInstance);
+  MmcHostInstance->PartitionAccess = EMMC_PARTITION_UNKNOWN;
+  Status = MmcSelectPartition (MmcHostInstance, Partition->Access);
+  gBS->RestoreTPL (OldTpl);
+  return EFI_ERROR (Status) ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+MmcPartitionIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINTN                    Transfer,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  IN OUT VOID                 *Buffer
+  )
+{
+  MMC_PARTITION           *Partition;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  Partition = MMC_PARTITION_FROM_BLOCK_IO_THIS (This);
+
+  // The partitions share the card with the user area, whose queued requests
+  // go first. Only the user area goes through the block cache.
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (Partition->MmcHostInstance);
+  Status = MmcIoBlocks (Partition->MmcHostInstance, This->Media, Transfer, MediaId, Lba, BufferSize, Buffer);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcPartitionReadBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  OUT VOID                    *Buffer
+  )
+{
+  return MmcPartitionIoBlocks (This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcPartitionWriteBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This,
+  IN UINT32                   MediaId,
+  IN EFI_LBA                  Lba,
+  IN UINTN                    BufferSize,
+  IN VOID                     *Buffer
+  )
+{
+  return MmcPartitionIoBlocks (This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcPartitionFlushBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL    *This
+  )
+{
+  MMC_PARTITION           *Partition;
+  EFI_STATUS              Status;
+  EFI_TPL                 OldTpl;
+
+  Partition = MMC_PARTITION_FROM_BLOCK_IO_THIS (This);
+
+  // The write cache is shared by all the partitions
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MmcDrainRequestQueue (Partition->MmcHostInstance);
+  Status = MmcFlushDevice (Partition->MmcHostInstance);
+  gBS->RestoreTPL (OldTpl);
+  return Status;
+}
+
+/**
+  Size in bytes of the boot or general purpose partition selected by Access,
+  0 when the card does not have it.
+**/
+STATIC
+UINT64
+MmcPartitionSize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT8                  Access
+  )
+{
+  ECSD                    *ECSDData;
+  UINT8                   *Multiplier;
+
+  ECSDData = &MmcHostInstance->CardInfo.ECSDData;
+  if (Access < EMMC_PARTITION_GP1) {
+    return MultU64x32 (ECSDData->BOOT_SIZE_MULTI, SIZE_128KB);
+  }
+
+  if ((ECSDData->PARTITION_SETTING_COMPLETED & EMMC_PARTITION_SETTING_COMPLETED) == 0) {
+    return 0;
+  }
+  Multiplier = &ECSDData->GP_SIZE_MULT[(Access - EMMC_PARTITION_GP1) * 3];
+  return MultU64x32 (
+           MultU64x32 (Multiplier[0] | (Multiplier[1] << 8) | (Multiplier[2] << 16),
+             ECSDData->HC_WP_GRP_SIZE * ECSDData->HC_ERASE_GRP_SIZE),
+           SIZE_512KB
+           );
+}
+
+/**
+  Describe the partition as found on the card currently in the host, Size
+  being 0 when the card does not have it.
+**/
+STATIC
+VOID
+MmcUpdatePartitionMedia (
+  IN MMC_PARTITION          *Partition,
+  IN UINT64                 Size
+  )
+{
+  EFI_BLOCK_IO_MEDIA      *Media;
+
+  Media = Partition->MmcHostInstance->BlockIo.Media;
+  Partition->Media.MediaId = Media->MediaId;
+  Partition->Media.BlockSize = Media->BlockSize;
+  Partition->Media.ReadOnly = Media->ReadOnly;
+  Partition->Media.MediaPresent = (Size != 0);
+  Partition->Media.LastBlock = (Size != 0) ? DivU64x32 (Size, Media->BlockSize) - 1 : 0;
+}
+
+STATIC
+MMC_PARTITION *
+MmcCreatePartition (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINT8                  Access,
+  IN UINT64                 Size
+  )
+{
+  MMC_PARTITION           *Partition;
+  CONTROLLER_DEVICE_PATH  *Node;
+
+  Partition = AllocateZeroPool (sizeof (MMC_PARTITION));
+  if (Partition == NULL) {
+    return NULL;
+  }
+
+  Partition->Signature = MMC_PARTITION_SIGNATURE;
+  Partition->Access = Access;
+  Partition->MmcHostInstance = MmcHostInstance;
+
+  CopyMem (&Partition->Media, MmcHostInstance->BlockIo.Media, sizeof (EFI_BLOCK_IO_MEDIA));
+  Partition->Media.RemovableMedia = FALSE;
+  Partition->Media.LogicalPartition = FALSE;
+  MmcUpdatePartitionMedia (Partition, Size);
+
+  Partition->BlockIo.Revision = EFI_BLOCK_IO_INTERFACE_REVISION;
+  Partition->BlockIo.Media = &Partition->Media;
+  Partition->BlockIo.Reset = MmcPartitionReset;
+  Partition->BlockIo.ReadBlocks = MmcPartitionReadBlocks;
+  Partition->BlockIo.WriteBlocks = MmcPartitionWriteBlocks;
+  Partition->BlockIo.FlushBlocks = MmcPartitionFlushBlocks;
+
+  // The user area path, followed by the number of the partition
+  Node = (CONTROLLER_DEVICE_PATH *)CreateDeviceNode (HARDWARE_DEVICE_PATH, HW_CONTROLLER_DP,
+                                     sizeof (CONTROLLER_DEVICE_PATH));
+  if (Node == NULL) {
+    FreePool (Partition);
+    return NULL;
+  }
+  Node->ControllerNumber = Access;
+  Partition->DevicePath = AppendDevicePathNode (MmcHostInstance->DevicePath, &Node->Header);
+  FreePool (Node);
+  if (Partition->DevicePath == NULL) {
+    FreePool (Partition);
+    return NULL;
+  }
+
+  return Partition;
+}
+
+/**
+  Publish the boot and general purpose partitions of an identified eMMC.
+**/
+VOID
+MmcInstallPartitions (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_PARTITION           *Partition;
+  EFI_STATUS              Status;
+  UINT64                  Size;
+  UINTN                   Index;
+  UINT8                   Access;
+
+  if (MmcHostInstance->CardInfo.CardType != EMMC_CARD) {
+    return;
+  }
+
+  for (Index = 0; Index < MMC_HW_PARTITION_COUNT; Index++) {
+    // Two boot partitions, then the general purpose ones
+    if (Index < 2) {
+      Access = (UINT8)(EMMC_PARTITION_BOOT1 + Index);
+    } else {
+      Access = (UINT8)(EMMC_PARTITION_GP1 + Index - 2);
+    }
+    Size = MmcPartitionSize (MmcHostInstance, Access);
+
+    // A partition still in use from the previous card keeps its slot, its
+    // consumers learn about the new media from MediaId
+    Partition = MmcHostInstance->Partitions[Index];
+    if (Partition != NULL) {
+      MmcUpdatePartitionMedia (Partition, Size);
+      Status = gBS->ReinstallProtocolInterface (
+                    Partition->Handle,
+                    &gEfiBlockIoProtocolGuid,
+                    &Partition->BlockIo,
+                    &Partition->BlockIo
+                    );
+      if (EFI_ERROR (Status)) {
+        DEBUG ((EFI_D_ERROR, "MMC Card: Error reinstalling partition %d, Status=%r\n", Access, Status));
+      }
+      continue;
+    }
+
+    if (Size == 0) {
+      continue;
+    }
+
+    Partition = MmcCreatePartition (MmcHostInstance, Access, Size);
+    if (Partition == NULL) {
+      DEBUG ((EFI_D_ERROR, "MMC Card: No memory for partition %d\n", Access));
+      continue;
+    }
+
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Partition->Handle,
+                  &gEfiDevicePathProtocolGuid,Partition->DevicePath,
+                  &gEfiBlockIoProtocolGuid,&Partition->BlockIo,
+                  NULL
+                  );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((EFI_D_ERROR, "MMC Card: Error installing partition %d, Status=%r\n", Access, Status));
+      FreePool (Partition->DevicePath);
+      FreePool (Partition);
+      continue;
+    }
+
+    DEBUG ((EFI_D_INFO, "MMC Card: Partition %d, %ldKB\n", Access, DivU64x32 (Size, SIZE_1KB)));
+    MmcHostInstance->Partitions[Index] = Partition;
+    gBS->ConnectController (Partition->Handle, NULL, NULL, TRUE);
+  }
+}
+
+/**
+  Withdraw the partitions published by MmcInstallPartitions().
+
+  @retval EFI_SUCCESS       All the partitions are gone.
+  @retval EFI_DEVICE_ERROR  A partition is still in use and stays installed.
+**/
+EFI_STATUS
+MmcUninstallPartitions (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_PARTITION           *Partition;
+  EFI_STATUS              Status;
+  EFI_STATUS              Result;
+  UINTN                   Index;
+
+  Result = EFI_SUCCESS;
+
+  for (Index = 0; Index < MMC_HW_PARTITION_COUNT; Index++) {
+    Partition = MmcHostInstance->Partitions[Index];
+    if (Partition == NULL) {
+      continue;
+    }
+
+    gBS->DisconnectController (Partition->Handle, NULL, NULL);
+    Status = gBS->UninstallMultipleProtocolInterfaces (
+                  Partition->Handle,
+                  &gEfiDevicePathProtocolGuid,Partition->DevicePath,
+                  &gEfiBlockIoProtocolGuid,&Partition->BlockIo,
+                  NULL
+                  );
+    if (EFI_ERROR (Status)) {
+      // Still in use, keep the partition reachable but without media
+      DEBUG ((EFI_D_ERROR, "MMC Card: Error uninstalling partition %d, Status=%r\n", Partition->Access, Status));
+      Partition->Media.MediaPresent = FALSE;
+      Partition->Media.MediaId++;
+      Result = EFI_DEVICE_ERROR;
+      continue;
+    }
+
+    FreePool (Partition->DevicePath);
+    FreePool (Partition);
+    MmcHostInstance->Partitions[Index] = NULL;
+  }
+  return Result;
+}
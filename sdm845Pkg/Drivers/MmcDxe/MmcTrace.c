@@ -0,0 +1,194 @@
+/** @file
+  Command trace of the MMC DXE driver
+
+  Every data, switch and erase command sent to a card is recorded with its
+  timing in a per-host ring, read back through MMC_TRACE_PROTOCOL. Recording
+  is compiled out unless PcdMmcTraceEnable is set, and then only costs two
+  reads of the performance counter and the copy of one entry.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+
+#include "Mmc.h"
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcTraceGetEntries (
+  IN     MMC_TRACE_PROTOCOL   *This,
+  IN OUT UINTN                *EntryCount,
+  OUT    MMC_TRACE_ENTRY      *Entries,
+  OUT    UINT64               *Recorded OPTIONAL
+  )
+{
+  MMC_TRACE_RING          *Ring;
+  UINT64                  Head;
+  UINT64                  First;
+  UINT64                  Lost;
+  UINTN                   Count;
+  UINTN                   Index;
+
+  if ((EntryCount == NULL) || ((Entries == NULL) && (*EntryCount != 0))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Ring = &MMC_HOST_INSTANCE_FROM_TRACE_THIS (This)->TraceRing;
+
+  Head = Ring->Head;
+  Count = (UINTN)MIN (MIN ((UINT64)*EntryCount, Head), (UINT64)This->Capacity);
+  First = Head - Count;
+  for (Index = 0; Index < Count; Index++) {
+    CopyMem (&Entries[Index], &Ring->Entries[(First + Index) & Ring->Mask], sizeof (MMC_TRACE_ENTRY));
+  }
+  MemoryFence ();
+
+  // The writer may have reused the oldest slots while they were copied. It
+  // fills slot Head & Mask before publishing Head + 1, so entry Head - Capacity
+  // may be torn already
+  Head = Ring->Head;
+  if (Head - First >= This->Capacity) {
+    Lost = MIN (Head - First - This->Capacity + 1, (UINT64)Count);
+    Count -= (UINTN)Lost;
+    CopyMem (Entries, &Entries[Lost], Count * sizeof (MMC_TRACE_ENTRY));
+  }
+
+  *EntryCount = Count;
+  if (Recorded != NULL) {
+    *Recorded = Head;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+MmcTraceReset (
+  IN  MMC_TRACE_PROTOCOL      *This
+  )
+{
+  EFI_TPL                 OldTpl;
+
+  // Keep the writer out while the ring is emptied
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  MMC_HOST_INSTANCE_FROM_TRACE_THIS (This)->TraceRing.Head = 0;
+  gBS->RestoreTPL (OldTpl);
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocate the trace ring of a host. Does nothing when tracing is disabled.
+
+**/
+EFI_STATUS
+MmcTraceInitialize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  MMC_TRACE_RING          *Ring;
+  UINT32                  Capacity;
+
+  if (!FeaturePcdGet (PcdMmcTraceEnable)) {
+    return EFI_SUCCESS;
+  }
+
+  // A power of two, so that the slot is found with a mask
+  Capacity = GetPowerOfTwo32 (MAX (PcdGet32 (PcdMmcTraceEntries), 1));
+
+  Ring = &MmcHostInstance->TraceRing;
+  Ring->Entries = AllocateZeroPool (Capacity * sizeof (MMC_TRACE_ENTRY));
+  if (Ring->Entries == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Ring->Mask = Capacity - 1;
+  Ring->Head = 0;
+
+  MmcHostInstance->Trace.Revision = MMC_TRACE_PROTOCOL_REVISION;
+  MmcHostInstance->Trace.Capacity = Capacity;
+  MmcHostInstance->Trace.Frequency = GetPerformanceCounterProperties (NULL, NULL);
+  MmcHostInstance->Trace.GetEntries = MmcTraceGetEntries;
+  MmcHostInstance->Trace.Reset = MmcTraceReset;
+  return EFI_SUCCESS;
+}
+
+VOID
+MmcTraceFree (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  )
+{
+  if (MmcHostInstance->TraceRing.Entries != NULL) {
+    FreePool (MmcHostInstance->TraceRing.Entries);
+    MmcHostInstance->TraceRing.Entries = NULL;
+  }
+}
+
+/**
+  Timestamp to pass to MmcTraceRecord() once the command completed.
+
+**/
+UINT64
+MmcTraceStart (
+  VOID
+  )
+{
+  if (!FeaturePcdGet (PcdMmcTraceEnable)) {
+    return 0;
+  }
+  return GetPerformanceCounter ();
+}
+
+/**
+  Record a command that completed. Must be called at TPL_CALLBACK.
+
+**/
+VOID
+MmcTraceRecord (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Cmd,
+  IN UINTN                  Argument,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Length,
+  IN UINT64                 StartTicks,
+  IN EFI_STATUS             Status
+  )
+{
+  MMC_TRACE_RING          *Ring;
+  MMC_TRACE_ENTRY         *Entry;
+  UINT64                  Head;
+
+  if (!FeaturePcdGet (PcdMmcTraceEnable)) {
+    return;
+  }
+
+  Ring = &MmcHostInstance->TraceRing;
+  if (Ring->Entries == NULL) {
+    return;
+  }
+
+  Head = Ring->Head;
+  Entry = &Ring->Entries[Head & Ring->Mask];
+  Entry->StartTicks = StartTicks;
+  Entry->EndTicks = GetPerformanceCounter ();
+  Entry->Lba = Lba;
+  Entry->Status = Status;
+  Entry->Argument = (UINT32)Argument;
+  Entry->Length = (UINT32)Length;
+  Entry->Command = (UINT8)MMC_GET_INDX (Cmd);
+  Entry->Partition = MmcHostInstance->PartitionAccess;
+
+  // Publish the entry only once it is complete
+  MemoryFence ();
+  Ring->Head = Head + 1;
+}
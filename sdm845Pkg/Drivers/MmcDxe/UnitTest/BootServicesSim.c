@@ -0,0 +1,988 @@
+/** @file
+  Boot services, timer and UEFI library functions the MMC DXE driver uses
+
+  Events, TPLs and the handle database behave as in the DXE core, closely
+  enough for the driver binding, the identification timer and the BlockIo2
+  queue to run as on a board. Time is simulated: TimerLib delays and the
+  commands of the simulated card only advance the clock, timer events fire
+  when a test lets time pass with SimRunTimers() or gBS->Stall().
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include "MmcDxeHostTest.h"
+
+// Period of the timer interrupt, as in the ARM generic timer driver
+#define SIM_TIMER_PERIOD_NS       1000000
+
+#define SIM_EVENT_SIGNATURE       SIGNATURE_32('s', 'e', 'v', 't')
+#define SIM_HANDLE_SIGNATURE      SIGNATURE_32('s', 'h', 'n', 'd')
+#define SIM_HANDLE_PROTOCOLS      16
+
+typedef struct {
+  UINTN                     Signature;
+  LIST_ENTRY                Link;
+  UINT32                    Type;
+  EFI_TPL                   NotifyTpl;
+  EFI_EVENT_NOTIFY          Notify;
+  VOID                      *Context;
+  BOOLEAN                   Signaled;
+  BOOLEAN                   Armed;
+  UINT64                    Due;
+  UINT64                    Period;
+} SIM_EVENT;
+
+typedef struct {
+  EFI_GUID                  *Guid;
+  VOID                      *Interface;
+  EFI_HANDLE                OpenedBy;           // Agent holding it BY_DRIVER
+} SIM_PROTOCOL;
+
+typedef struct {
+  UINTN                     Signature;
+  LIST_ENTRY                Link;
+  UINTN                     Count;
+  SIM_PROTOCOL              Protocols[SIM_HANDLE_PROTOCOLS];
+} SIM_HANDLE;
+
+STATIC UINT64               mSimNow;
+STATIC UINT64               mSimNextTick = SIM_TIMER_PERIOD_NS;
+STATIC EFI_TPL              mSimTpl = TPL_APPLICATION;
+STATIC LIST_ENTRY           mSimEvents;
+STATIC LIST_ENTRY           mSimHandles;
+
+STATIC EFI_GUID             mSimImageGuid = {
+  0x1b4a8e3c, 0x62f0, 0x4c5d, { 0xa7, 0x19, 0x3e, 0x80, 0xd4, 0x2b, 0x6c, 0x51 }
+};
+
+EFI_HANDLE                  gImageHandle;
+EFI_SYSTEM_TABLE            *gST;
+EFI_BOOT_SERVICES           *gBS;
+
+UINT64
+SimNow (
+  VOID
+  )
+{
+  return mSimNow;
+}
+
+VOID
+SimAdvance (
+  IN UINT64                 Nanoseconds
+  )
+{
+  mSimNow += Nanoseconds;
+}
+
+//
+// TimerLib, the performance counter counts nanoseconds
+//
+UINTN
+EFIAPI
+MicroSecondDelay (
+  IN UINTN                  MicroSeconds
+  )
+{
+  SimAdvance (MultU64x32 (MicroSeconds, 1000));
+  return MicroSeconds;
+}
+
+UINTN
+EFIAPI
+NanoSecondDelay (
+  IN UINTN                  NanoSeconds
+  )
+{
+  SimAdvance (NanoSeconds);
+  return NanoSeconds;
+}
+
+UINT64
+EFIAPI
+GetPerformanceCounter (
+  VOID
+  )
+{
+  return mSimNow;
+}
+
+UINT64
+EFIAPI
+GetPerformanceCounterProperties (
+  OUT UINT64                *StartValue OPTIONAL,
+  OUT UINT64                *EndValue OPTIONAL
+  )
+{
+  if (StartValue != NULL) {
+    *StartValue = 0;
+  }
+  if (EndValue != NULL) {
+    *EndValue = MAX_UINT64;
+  }
+  return 1000000000;
+}
+
+UINT64
+EFIAPI
+GetTimeInNanoSecond (
+  IN UINT64                 Ticks
+  )
+{
+  return Ticks;
+}
+
+//
+// Events and TPLs
+//
+STATIC
+SIM_EVENT *
+SimFindEvent (
+  IN EFI_EVENT              Event
+  )
+{
+  LIST_ENTRY                *Link;
+
+  for (Link = GetFirstNode (&mSimEvents); !IsNull (&mSimEvents, Link); Link = GetNextNode (&mSimEvents, Link)) {
+    if (Link == &((SIM_EVENT *)Event)->Link) {
+      return Event;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Run the notification functions of the signaled events above Tpl, highest
+  TPL first. The list is scanned again after each one, as a notification
+  function may signal, create or close events.
+**/
+STATIC
+VOID
+SimDispatch (
+  IN EFI_TPL                Tpl
+  )
+{
+  LIST_ENTRY                *Link;
+  SIM_EVENT                 *Event;
+  SIM_EVENT                 *Next;
+  EFI_TPL                   OldTpl;
+
+  for (;;) {
+    Next = NULL;
+    for (Link = GetFirstNode (&mSimEvents); !IsNull (&mSimEvents, Link); Link = GetNextNode (&mSimEvents, Link)) {
+      Event = BASE_CR (Link, SIM_EVENT, Link);
+      if (Event->Signaled && ((Event->Type & EVT_NOTIFY_SIGNAL) != 0) && (Event->NotifyTpl > Tpl) &&
+          ((Next == NULL) || (Event->NotifyTpl > Next->NotifyTpl))) {
+        Next = Event;
+      }
+    }
+    if (Next == NULL) {
+      return;
+    }
+
+    Next->Signaled = FALSE;
+    OldTpl = mSimTpl;
+    mSimTpl = Next->NotifyTpl;
+    Next->Notify (Next, Next->Context);
+    mSimTpl = OldTpl;
+  }
+}
+
+STATIC
+EFI_TPL
+EFIAPI
+SimRaiseTpl (
+  IN EFI_TPL                NewTpl
+  )
+{
+  EFI_TPL                   OldTpl;
+
+  OldTpl = mSimTpl;
+  ASSERT (NewTpl >= OldTpl);
+  mSimTpl = NewTpl;
+  return OldTpl;
+}
+
+STATIC
+VOID
+EFIAPI
+SimRestoreTpl (
+  IN EFI_TPL                OldTpl
+  )
+{
+  ASSERT (OldTpl <= mSimTpl);
+  mSimTpl = OldTpl;
+  SimDispatch (OldTpl);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimCreateEvent (
+  IN  UINT32                Type,
+  IN  EFI_TPL               NotifyTpl,
+  IN  EFI_EVENT_NOTIFY      NotifyFunction,
+  IN  VOID                  *NotifyContext,
+  OUT EFI_EVENT             *Event
+  )
+{
+  SIM_EVENT                 *NewEvent;
+
+  if (Event == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (((Type & (EVT_NOTIFY_SIGNAL | EVT_NOTIFY_WAIT)) != 0) &&
+      ((NotifyFunction == NULL) || (NotifyTpl <= TPL_APPLICATION) || (NotifyTpl >= TPL_HIGH_LEVEL))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  NewEvent = AllocateZeroPool (sizeof (SIM_EVENT));
+  if (NewEvent == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  NewEvent->Signature = SIM_EVENT_SIGNATURE;
+  NewEvent->Type = Type;
+  NewEvent->NotifyTpl = NotifyTpl;
+  NewEvent->Notify = NotifyFunction;
+  NewEvent->Context = NotifyContext;
+  InsertTailList (&mSimEvents, &NewEvent->Link);
+  *Event = NewEvent;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimSetTimer (
+  IN EFI_EVENT              Event,
+  IN EFI_TIMER_DELAY        Type,
+  IN UINT64                 TriggerTime
+  )
+{
+  SIM_EVENT                 *SimEvent;
+
+  SimEvent = SimFindEvent (Event);
+  if ((SimEvent == NULL) || ((SimEvent->Type & EVT_TIMER) == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SimEvent->Armed = FALSE;
+  SimEvent->Period = 0;
+  switch (Type) {
+  case TimerCancel:
+    return EFI_SUCCESS;
+  case TimerPeriodic:
+    // A period of 0 fires on every tick
+    SimEvent->Period = MAX (MultU64x32 (TriggerTime, 100), 1);
+    break;
+  case TimerRelative:
+    break;
+  default:
+    return EFI_INVALID_PARAMETER;
+  }
+  SimEvent->Due = mSimNow + MultU64x32 (TriggerTime, 100);
+  SimEvent->Armed = TRUE;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimSignalEvent (
+  IN EFI_EVENT              Event
+  )
+{
+  SIM_EVENT                 *SimEvent;
+
+  SimEvent = SimFindEvent (Event);
+  if (SimEvent == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SimEvent->Signaled = TRUE;
+  SimDispatch (mSimTpl);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimCloseEvent (
+  IN EFI_EVENT              Event
+  )
+{
+  SIM_EVENT                 *SimEvent;
+
+  SimEvent = SimFindEvent (Event);
+  if (SimEvent == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  RemoveEntryList (&SimEvent->Link);
+  SimEvent->Signature = 0;
+  FreePool (SimEvent);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimCheckEvent (
+  IN EFI_EVENT              Event
+  )
+{
+  SIM_EVENT                 *SimEvent;
+
+  SimEvent = SimFindEvent (Event);
+  if ((SimEvent == NULL) || ((SimEvent->Type & EVT_NOTIFY_SIGNAL) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (!SimEvent->Signaled && ((SimEvent->Type & EVT_NOTIFY_WAIT) != 0)) {
+    SimEvent->Notify (SimEvent, SimEvent->Context);
+  }
+  if (SimEvent->Signaled) {
+    SimEvent->Signaled = FALSE;
+    return EFI_SUCCESS;
+  }
+  return EFI_NOT_READY;
+}
+
+/**
+  Timer interrupt: signal the timer events due by now and dispatch the ones
+  above the current TPL.
+**/
+STATIC
+VOID
+SimTimerTick (
+  VOID
+  )
+{
+  LIST_ENTRY                *Link;
+  SIM_EVENT                 *Event;
+
+  for (Link = GetFirstNode (&mSimEvents); !IsNull (&mSimEvents, Link); Link = GetNextNode (&mSimEvents, Link)) {
+    Event = BASE_CR (Link, SIM_EVENT, Link);
+    if (!Event->Armed || (Event->Due > mSimNow)) {
+      continue;
+    }
+    if (Event->Period != 0) {
+      Event->Due += Event->Period;
+      if (Event->Due <= mSimNow) {
+        Event->Due = mSimNow + Event->Period;
+      }
+    } else {
+      Event->Armed = FALSE;
+    }
+    Event->Signaled = TRUE;
+  }
+  SimDispatch (mSimTpl);
+}
+
+/**
+  Let Microseconds pass, running the timer interrupts of the period. The
+  notification functions may advance the clock further.
+
+  @return The number of timer interrupts.
+**/
+UINTN
+SimRunTimers (
+  IN UINT64                 Microseconds
+  )
+{
+  UINT64                    End;
+  UINTN                     Ticks;
+
+  End = mSimNow + MultU64x32 (Microseconds, 1000);
+  Ticks = 0;
+  while (mSimNextTick <= End) {
+    mSimNow = MAX (mSimNow, mSimNextTick);
+    SimTimerTick ();
+    Ticks++;
+    while (mSimNextTick <= mSimNow) {
+      mSimNextTick += SIM_TIMER_PERIOD_NS;
+    }
+  }
+  mSimNow = MAX (mSimNow, End);
+  return Ticks;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimWaitForEvent (
+  IN  UINTN                 NumberOfEvents,
+  IN  EFI_EVENT             *Event,
+  OUT UINTN                 *Index
+  )
+{
+  UINTN                     Tries;
+  UINTN                     Entry;
+
+  if (mSimTpl != TPL_APPLICATION) {
+    return EFI_UNSUPPORTED;
+  }
+  // Ten seconds of simulated time, a test waiting longer is stuck
+  for (Tries = 0; Tries < 10000; Tries++) {
+    for (Entry = 0; Entry < NumberOfEvents; Entry++) {
+      if (SimCheckEvent (Event[Entry]) == EFI_SUCCESS) {
+        *Index = Entry;
+        return EFI_SUCCESS;
+      }
+    }
+    SimRunTimers (SIM_TIMER_PERIOD_NS / 1000);
+  }
+  return EFI_TIMEOUT;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimStall (
+  IN UINTN                  Microseconds
+  )
+{
+  SimRunTimers (Microseconds);
+  return EFI_SUCCESS;
+}
+
+//
+// Handle database
+//
+STATIC
+SIM_HANDLE *
+SimFindHandle (
+  IN EFI_HANDLE             Handle
+  )
+{
+  LIST_ENTRY                *Link;
+
+  for (Link = GetFirstNode (&mSimHandles); !IsNull (&mSimHandles, Link); Link = GetNextNode (&mSimHandles, Link)) {
+    if (Link == &((SIM_HANDLE *)Handle)->Link) {
+      return Handle;
+    }
+  }
+  return NULL;
+}
+
+STATIC
+SIM_PROTOCOL *
+SimFindProtocol (
+  IN SIM_HANDLE             *SimHandle,
+  IN EFI_GUID               *Guid
+  )
+{
+  UINTN                     Index;
+
+  for (Index = 0; Index < SimHandle->Count; Index++) {
+    if (CompareMem (SimHandle->Protocols[Index].Guid, Guid, sizeof (EFI_GUID)) == 0) {
+      return &SimHandle->Protocols[Index];
+    }
+  }
+  return NULL;
+}
+
+STATIC
+VOID
+SimRemoveProtocol (
+  IN SIM_HANDLE             *SimHandle,
+  IN SIM_PROTOCOL           *Protocol
+  )
+{
+  SimHandle->Count--;
+  CopyMem (Protocol, Protocol + 1, (UINT8 *)&SimHandle->Protocols[SimHandle->Count] - (UINT8 *)Protocol);
+  if (SimHandle->Count == 0) {
+    RemoveEntryList (&SimHandle->Link);
+    SimHandle->Signature = 0;
+    FreePool (SimHandle);
+  }
+}
+
+STATIC
+EFI_STATUS
+SimInstall (
+  IN OUT EFI_HANDLE         *Handle,
+  IN     UINTN              Count,
+  IN     EFI_GUID           **Guids,
+  IN     VOID               **Interfaces
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  UINTN                     Index;
+  UINTN                     Other;
+
+  if (Handle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (*Handle != NULL) {
+    SimHandle = SimFindHandle (*Handle);
+    if (SimHandle == NULL) {
+      return EFI_INVALID_PARAMETER;
+    }
+  } else {
+    SimHandle = NULL;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((SimHandle != NULL) && (SimFindProtocol (SimHandle, Guids[Index]) != NULL)) {
+      return EFI_INVALID_PARAMETER;
+    }
+    for (Other = 0; Other < Index; Other++) {
+      if (CompareMem (Guids[Other], Guids[Index], sizeof (EFI_GUID)) == 0) {
+        return EFI_INVALID_PARAMETER;
+      }
+    }
+  }
+  if (((SimHandle != NULL) ? SimHandle->Count : 0) + Count > SIM_HANDLE_PROTOCOLS) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (SimHandle == NULL) {
+    SimHandle = AllocateZeroPool (sizeof (SIM_HANDLE));
+    if (SimHandle == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    SimHandle->Signature = SIM_HANDLE_SIGNATURE;
+    InsertTailList (&mSimHandles, &SimHandle->Link);
+    *Handle = SimHandle;
+  }
+  for (Index = 0; Index < Count; Index++) {
+    SimHandle->Protocols[SimHandle->Count].Guid = Guids[Index];
+    SimHandle->Protocols[SimHandle->Count].Interface = Interfaces[Index];
+    SimHandle->Protocols[SimHandle->Count].OpenedBy = NULL;
+    SimHandle->Count++;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+SimUninstall (
+  IN EFI_HANDLE             Handle,
+  IN UINTN                  Count,
+  IN EFI_GUID               **Guids,
+  IN VOID                   **Interfaces
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  SIM_PROTOCOL              *Protocol;
+  UINTN                     Index;
+
+  SimHandle = SimFindHandle (Handle);
+  if (SimHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  // All or nothing, and nothing a driver still holds
+  for (Index = 0; Index < Count; Index++) {
+    Protocol = SimFindProtocol (SimHandle, Guids[Index]);
+    if ((Protocol == NULL) || (Protocol->Interface != Interfaces[Index])) {
+      return EFI_INVALID_PARAMETER;
+    }
+    if (Protocol->OpenedBy != NULL) {
+      return EFI_ACCESS_DENIED;
+    }
+  }
+  for (Index = 0; Index < Count; Index++) {
+    // The last removal frees the handle
+    Protocol = SimFindProtocol (SimHandle, Guids[Index]);
+    SimRemoveProtocol (SimHandle, Protocol);
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimInstallProtocolInterface (
+  IN OUT EFI_HANDLE         *Handle,
+  IN     EFI_GUID           *Protocol,
+  IN     EFI_INTERFACE_TYPE InterfaceType,
+  IN     VOID               *Interface
+  )
+{
+  return SimInstall (Handle, 1, &Protocol, &Interface);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimUninstallProtocolInterface (
+  IN EFI_HANDLE             Handle,
+  IN EFI_GUID               *Protocol,
+  IN VOID                   *Interface
+  )
+{
+  return SimUninstall (Handle, 1, &Protocol, &Interface);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimInstallMultipleProtocolInterfaces (
+  IN OUT EFI_HANDLE         *Handle,
+  ...
+  )
+{
+  VA_LIST                   Args;
+  EFI_GUID                  *Guids[SIM_HANDLE_PROTOCOLS];
+  VOID                      *Interfaces[SIM_HANDLE_PROTOCOLS];
+  EFI_GUID                  *Guid;
+  UINTN                     Count;
+
+  Count = 0;
+  VA_START (Args, Handle);
+  for (Guid = VA_ARG (Args, EFI_GUID *); Guid != NULL; Guid = VA_ARG (Args, EFI_GUID *)) {
+    if (Count == SIM_HANDLE_PROTOCOLS) {
+      VA_END (Args);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Guids[Count] = Guid;
+    Interfaces[Count] = VA_ARG (Args, VOID *);
+    Count++;
+  }
+  VA_END (Args);
+  return SimInstall (Handle, Count, Guids, Interfaces);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimUninstallMultipleProtocolInterfaces (
+  IN EFI_HANDLE             Handle,
+  ...
+  )
+{
+  VA_LIST                   Args;
+  EFI_GUID                  *Guids[SIM_HANDLE_PROTOCOLS];
+  VOID                      *Interfaces[SIM_HANDLE_PROTOCOLS];
+  EFI_GUID                  *Guid;
+  UINTN                     Count;
+
+  Count = 0;
+  VA_START (Args, Handle);
+  for (Guid = VA_ARG (Args, EFI_GUID *); Guid != NULL; Guid = VA_ARG (Args, EFI_GUID *)) {
+    if (Count == SIM_HANDLE_PROTOCOLS) {
+      VA_END (Args);
+      return EFI_INVALID_PARAMETER;
+    }
+    Guids[Count] = Guid;
+    Interfaces[Count] = VA_ARG (Args, VOID *);
+    Count++;
+  }
+  VA_END (Args);
+  return SimUninstall (Handle, Count, Guids, Interfaces);
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimReinstallProtocolInterface (
+  IN EFI_HANDLE             Handle,
+  IN EFI_GUID               *Protocol,
+  IN VOID                   *OldInterface,
+  IN VOID                   *NewInterface
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  SIM_PROTOCOL              *SimProtocol;
+
+  SimHandle = SimFindHandle (Handle);
+  if (SimHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SimProtocol = SimFindProtocol (SimHandle, Protocol);
+  if ((SimProtocol == NULL) || (SimProtocol->Interface != OldInterface)) {
+    return EFI_NOT_FOUND;
+  }
+  SimProtocol->Interface = NewInterface;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimHandleProtocol (
+  IN  EFI_HANDLE            Handle,
+  IN  EFI_GUID              *Protocol,
+  OUT VOID                  **Interface
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  SIM_PROTOCOL              *SimProtocol;
+
+  SimHandle = SimFindHandle (Handle);
+  if ((SimHandle == NULL) || (Interface == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SimProtocol = SimFindProtocol (SimHandle, Protocol);
+  if (SimProtocol == NULL) {
+    *Interface = NULL;
+    return EFI_UNSUPPORTED;
+  }
+  *Interface = SimProtocol->Interface;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimOpenProtocol (
+  IN  EFI_HANDLE            Handle,
+  IN  EFI_GUID              *Protocol,
+  OUT VOID                  **Interface OPTIONAL,
+  IN  EFI_HANDLE            AgentHandle,
+  IN  EFI_HANDLE            ControllerHandle,
+  IN  UINT32                Attributes
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  SIM_PROTOCOL              *SimProtocol;
+
+  SimHandle = SimFindHandle (Handle);
+  if (SimHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SimProtocol = SimFindProtocol (SimHandle, Protocol);
+  if (SimProtocol == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Attributes & EFI_OPEN_PROTOCOL_BY_DRIVER) != 0) {
+    if (SimProtocol->OpenedBy == AgentHandle) {
+      if (Interface != NULL) {
+        *Interface = SimProtocol->Interface;
+      }
+      return EFI_ALREADY_STARTED;
+    }
+    if (SimProtocol->OpenedBy != NULL) {
+      return EFI_ACCESS_DENIED;
+    }
+    SimProtocol->OpenedBy = AgentHandle;
+  }
+  if ((Interface != NULL) && (Attributes != EFI_OPEN_PROTOCOL_TEST_PROTOCOL)) {
+    *Interface = SimProtocol->Interface;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimCloseProtocol (
+  IN EFI_HANDLE             Handle,
+  IN EFI_GUID               *Protocol,
+  IN EFI_HANDLE             AgentHandle,
+  IN EFI_HANDLE             ControllerHandle
+  )
+{
+  SIM_HANDLE                *SimHandle;
+  SIM_PROTOCOL              *SimProtocol;
+
+  SimHandle = SimFindHandle (Handle);
+  if (SimHandle == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  SimProtocol = SimFindProtocol (SimHandle, Protocol);
+  if (SimProtocol == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  if (SimProtocol->OpenedBy == AgentHandle) {
+    SimProtocol->OpenedBy = NULL;
+  }
+  return EFI_SUCCESS;
+}
+
+//
+// No other driver takes the children of the MMC driver
+//
+STATIC
+EFI_STATUS
+EFIAPI
+SimConnectController (
+  IN EFI_HANDLE               ControllerHandle,
+  IN EFI_HANDLE               *DriverImageHandle OPTIONAL,
+  IN EFI_DEVICE_PATH_PROTOCOL *RemainingDevicePath OPTIONAL,
+  IN BOOLEAN                  Recursive
+  )
+{
+  return (SimFindHandle (ControllerHandle) != NULL) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+SimDisconnectController (
+  IN EFI_HANDLE             ControllerHandle,
+  IN EFI_HANDLE             DriverImageHandle OPTIONAL,
+  IN EFI_HANDLE             ChildHandle OPTIONAL
+  )
+{
+  return (SimFindHandle (ControllerHandle) != NULL) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+STATIC EFI_BOOT_SERVICES    mSimBootServices = {
+  .RaiseTPL                            = SimRaiseTpl,
+  .RestoreTPL                          = SimRestoreTpl,
+  .CreateEvent                         = SimCreateEvent,
+  .SetTimer                            = SimSetTimer,
+  .WaitForEvent                        = SimWaitForEvent,
+  .SignalEvent                         = SimSignalEvent,
+  .CloseEvent                          = SimCloseEvent,
+  .CheckEvent                          = SimCheckEvent,
+  .InstallProtocolInterface            = SimInstallProtocolInterface,
+  .ReinstallProtocolInterface          = SimReinstallProtocolInterface,
+  .UninstallProtocolInterface          = SimUninstallProtocolInterface,
+  .HandleProtocol                      = SimHandleProtocol,
+  .Stall                               = SimStall,
+  .OpenProtocol                        = SimOpenProtocol,
+  .CloseProtocol                       = SimCloseProtocol,
+  .ConnectController                   = SimConnectController,
+  .DisconnectController                = SimDisconnectController,
+  .InstallMultipleProtocolInterfaces   = SimInstallMultipleProtocolInterfaces,
+  .UninstallMultipleProtocolInterfaces = SimUninstallMultipleProtocolInterfaces
+};
+
+STATIC EFI_SYSTEM_TABLE     mSimSystemTable = {
+  .BootServices = &mSimBootServices
+};
+
+VOID
+SimInitializeBootServices (
+  VOID
+  )
+{
+  EFI_STATUS                Status;
+
+  InitializeListHead (&mSimEvents);
+  InitializeListHead (&mSimHandles);
+  gBS = &mSimBootServices;
+  gST = &mSimSystemTable;
+
+  gImageHandle = NULL;
+  Status = SimInstallProtocolInterface (&gImageHandle, &mSimImageGuid, EFI_NATIVE_INTERFACE, NULL);
+  ASSERT_EFI_ERROR (Status);
+}
+
+VOID *
+SimGetProtocol (
+  IN EFI_HANDLE             Handle,
+  IN EFI_GUID               *Protocol
+  )
+{
+  VOID                      *Interface;
+
+  if (EFI_ERROR (SimHandleProtocol (Handle, Protocol, &Interface))) {
+    return NULL;
+  }
+  return Interface;
+}
+
+//
+// UefiLib
+//
+EFI_STATUS
+EFIAPI
+EfiLibInstallDriverBindingComponentName2 (
+  IN CONST EFI_HANDLE                   ImageHandle,
+  IN CONST EFI_SYSTEM_TABLE             *SystemTable,
+  IN EFI_DRIVER_BINDING_PROTOCOL        *DriverBinding,
+  IN EFI_HANDLE                         DriverBindingHandle,
+  IN CONST EFI_COMPONENT_NAME_PROTOCOL  *ComponentName OPTIONAL,
+  IN CONST EFI_COMPONENT_NAME2_PROTOCOL *ComponentName2 OPTIONAL
+  )
+{
+  EFI_STATUS                Status;
+
+  DriverBinding->ImageHandle = ImageHandle;
+  DriverBinding->DriverBindingHandle = DriverBindingHandle;
+
+  Status = SimInstallProtocolInterface (&DriverBinding->DriverBindingHandle,
+             &gEfiDriverBindingProtocolGuid, EFI_NATIVE_INTERFACE, DriverBinding);
+  if (!EFI_ERROR (Status) && (ComponentName != NULL)) {
+    Status = SimInstallProtocolInterface (&DriverBinding->DriverBindingHandle,
+               &gEfiComponentNameProtocolGuid, EFI_NATIVE_INTERFACE, (VOID *)ComponentName);
+  }
+  if (!EFI_ERROR (Status) && (ComponentName2 != NULL)) {
+    Status = SimInstallProtocolInterface (&DriverBinding->DriverBindingHandle,
+               &gEfiComponentName2ProtocolGuid, EFI_NATIVE_INTERFACE, (VOID *)ComponentName2);
+  }
+  return Status;
+}
+
+/**
+  The languages of a string table entry are a ';' separated list.
+**/
+EFI_STATUS
+EFIAPI
+LookupUnicodeString2 (
+  IN CONST CHAR8                     *Language,
+  IN CONST CHAR8                     *SupportedLanguages,
+  IN CONST EFI_UNICODE_STRING_TABLE  *UnicodeStringTable,
+  OUT CHAR16                         **UnicodeString,
+  IN BOOLEAN                         Iso639Language
+  )
+{
+  CONST CHAR8               *Entry;
+  UINTN                     Length;
+
+  if ((Language == NULL) || (UnicodeString == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((SupportedLanguages == NULL) || (UnicodeStringTable == NULL)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Length = AsciiStrLen (Language);
+  for ( ; UnicodeStringTable->Language != NULL; UnicodeStringTable++) {
+    for (Entry = UnicodeStringTable->Language; *Entry != '\0'; ) {
+      if ((AsciiStrnCmp (Entry, Language, Length) == 0) &&
+          ((Entry[Length] == '\0') || (Entry[Length] == ';'))) {
+        *UnicodeString = UnicodeStringTable->UnicodeString;
+        return EFI_SUCCESS;
+      }
+      while ((*Entry != '\0') && (*Entry != ';')) {
+        Entry++;
+      }
+      if (*Entry == ';') {
+        Entry++;
+      }
+    }
+  }
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  The console of the test is the debug output.
+**/
+UINTN
+EFIAPI
+Print (
+  IN CONST CHAR16           *Format,
+  ...
+  )
+{
+  VA_LIST                   Marker;
+  CHAR16                    Buffer[256];
+  UINTN                     Length;
+
+  VA_START (Marker, Format);
+  Length = UnicodeVSPrint (Buffer, sizeof (Buffer), Format, Marker);
+  VA_END (Marker);
+
+  DEBUG ((DEBUG_INFO, "%s", Buffer));
+  return Length;
+}
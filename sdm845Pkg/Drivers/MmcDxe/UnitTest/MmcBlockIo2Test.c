@@ -0,0 +1,410 @@
+/** @file
+  Block I/O 2 request queue against the simulated host
+
+  The requests are queued with events whose notification functions record
+  the order they complete in. The simulated timer interrupt services the
+  queue, one request per tick.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "MmcDxeHostTest.h"
+
+#define QUEUE_TEST_LBA            0x8000
+#define QUEUE_TEST_REQUESTS       8
+#define QUEUE_TEST_REQUEST_SIZE   SIZE_128KB
+
+typedef struct {
+  EFI_BLOCK_IO2_TOKEN       Token;
+  UINTN                     Completed;          // Position in the completion order, 0 while pending
+  UINT8                     *Buffer;
+} QUEUE_TEST_REQUEST;
+
+STATIC UINTN                mQueueCompletions;
+
+STATIC
+VOID
+EFIAPI
+QueueTestNotify (
+  IN EFI_EVENT              Event,
+  IN VOID                   *Context
+  )
+{
+  QUEUE_TEST_REQUEST        *Request;
+
+  Request = Context;
+  Request->Completed = ++mQueueCompletions;
+}
+
+/**
+  Create the events and buffers of Count requests.
+**/
+STATIC
+BOOLEAN
+QueueTestCreate (
+  OUT QUEUE_TEST_REQUEST    *Requests,
+  IN  UINTN                 Count
+  )
+{
+  UINTN                     Index;
+  EFI_STATUS                Status;
+
+  mQueueCompletions = 0;
+  ZeroMem (Requests, Count * sizeof (*Requests));
+  for (Index = 0; Index < Count; Index++) {
+    Status = gBS->CreateEvent (EVT_NOTIFY_SIGNAL, TPL_CALLBACK, QueueTestNotify, &Requests[Index],
+                    &Requests[Index].Token.Event);
+    Requests[Index].Buffer = AllocateZeroPool (QUEUE_TEST_REQUEST_SIZE);
+    if (EFI_ERROR (Status) || (Requests[Index].Buffer == NULL)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+STATIC
+VOID
+QueueTestDestroy (
+  IN QUEUE_TEST_REQUEST     *Requests,
+  IN UINTN                  Count
+  )
+{
+  UINTN                     Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    if (Requests[Index].Token.Event != NULL) {
+      gBS->CloseEvent (Requests[Index].Token.Event);
+    }
+    if (Requests[Index].Buffer != NULL) {
+      FreePool (Requests[Index].Buffer);
+    }
+  }
+}
+
+/**
+  Run timer ticks until Count requests completed or the time is up.
+**/
+STATIC
+UINTN
+QueueTestWait (
+  IN UINTN                  Count
+  )
+{
+  UINTN                     Ticks;
+
+  for (Ticks = 0; (mQueueCompletions < Count) && (Ticks < 1000); Ticks++) {
+    SimRunTimers (1000);
+  }
+  return Ticks;
+}
+
+/**
+  Queued reads come back in order, one per timer tick, and the caller has
+  the CPU while they are pending.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+QueueOrder (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO2_PROTOCOL    *BlockIo2;
+  QUEUE_TEST_REQUEST        Requests[QUEUE_TEST_REQUESTS];
+  EFI_STATUS                Status;
+  UINTN                     Index;
+  UINTN                     Done;
+  EFI_LBA                   Lba;
+
+  Test = Context;
+  BlockIo2 = &Test->Instance->BlockIo2;
+  UT_ASSERT_TRUE (QueueTestCreate (Requests, QUEUE_TEST_REQUESTS));
+
+  MmcSimResetCounters (Test->Sim);
+  for (Index = 0; Index < QUEUE_TEST_REQUESTS; Index++) {
+    // Backwards through the card, the queue must not sort them
+    Lba = QUEUE_TEST_LBA + (QUEUE_TEST_REQUESTS - 1 - Index) * (QUEUE_TEST_REQUEST_SIZE / 512);
+    Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, Lba, &Requests[Index].Token,
+                         QUEUE_TEST_REQUEST_SIZE, Requests[Index].Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_STATUS_EQUAL (Requests[Index].Token.TransactionStatus, EFI_NOT_READY);
+  }
+  UT_ASSERT_EQUAL (MmcSimCommandCount (Test->Sim), 0);
+
+  for (Done = 1; Done <= QUEUE_TEST_REQUESTS; Done++) {
+    SimRunTimers (1000);
+    UT_ASSERT_EQUAL (mQueueCompletions, Done);
+  }
+
+  for (Index = 0; Index < QUEUE_TEST_REQUESTS; Index++) {
+    Lba = QUEUE_TEST_LBA + (QUEUE_TEST_REQUESTS - 1 - Index) * (QUEUE_TEST_REQUEST_SIZE / 512);
+    UT_ASSERT_EQUAL (Requests[Index].Completed, Index + 1);
+    UT_ASSERT_NOT_EFI_ERROR (Requests[Index].Token.TransactionStatus);
+    UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[Index].Buffer, Lba, QUEUE_TEST_REQUEST_SIZE / 512, 0));
+  }
+  UT_ASSERT_TRUE (IsListEmpty (&Test->Instance->RequestQueue));
+
+  QueueTestDestroy (Requests, QUEUE_TEST_REQUESTS);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A blocking read first performs the requests queued before it, so it sees
+  the data of a queued write.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+QueueBlockingDrains (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO2_PROTOCOL    *BlockIo2;
+  EFI_BLOCK_IO_PROTOCOL     *BlockIo;
+  QUEUE_TEST_REQUEST        Requests[2];
+  EFI_BLOCK_IO2_TOKEN       Token;
+  EFI_STATUS                Status;
+
+  Test = Context;
+  BlockIo2 = &Test->Instance->BlockIo2;
+  BlockIo = &Test->Instance->BlockIo;
+  UT_ASSERT_TRUE (QueueTestCreate (Requests, 2));
+
+  MmcSimFillPattern (QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 8, Requests[0].Buffer);
+  Status = BlockIo2->WriteBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[0].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[0].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // Through Block I/O
+  Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE,
+                      Requests[1].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Requests[0].Completed, 1);
+  UT_ASSERT_NOT_EFI_ERROR (Requests[0].Token.TransactionStatus);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[1].Buffer, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 8));
+
+  // Through Block I/O 2 with a token without an event
+  MmcSimFillPattern (QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 9, Requests[0].Buffer);
+  Status = BlockIo2->WriteBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[0].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[0].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  ZeroMem (&Token, sizeof (Token));
+  Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[1].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_NOT_EFI_ERROR (Token.TransactionStatus);
+  UT_ASSERT_EQUAL (Requests[0].Completed, 2);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[1].Buffer, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 9));
+  UT_ASSERT_TRUE (IsListEmpty (&Test->Instance->RequestQueue));
+
+  UT_ASSERT_TRUE (MmcSimReadImage (QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, Requests[1].Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[1].Buffer, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 9));
+
+  QueueTestDestroy (Requests, 2);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  ResetEx() completes the pending requests with EFI_ABORTED without
+  touching the card, the queue works again afterwards.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+QueueResetAborts (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO2_PROTOCOL    *BlockIo2;
+  QUEUE_TEST_REQUEST        Requests[4];
+  EFI_STATUS                Status;
+  UINTN                     Index;
+
+  Test = Context;
+  BlockIo2 = &Test->Instance->BlockIo2;
+  UT_ASSERT_TRUE (QueueTestCreate (Requests, 4));
+
+  MmcSimResetCounters (Test->Sim);
+  for (Index = 0; Index < 3; Index++) {
+    Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[Index].Token,
+                         QUEUE_TEST_REQUEST_SIZE, Requests[Index].Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  Status = BlockIo2->Reset (BlockIo2, FALSE);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (mQueueCompletions, 3);
+  for (Index = 0; Index < 3; Index++) {
+    UT_ASSERT_STATUS_EQUAL (Requests[Index].Token.TransactionStatus, EFI_ABORTED);
+  }
+  UT_ASSERT_EQUAL (Test->Sim->Commands[17] + Test->Sim->Commands[18], 0);
+  UT_ASSERT_TRUE (IsListEmpty (&Test->Instance->RequestQueue));
+
+  // Nothing is left to fire on the next ticks
+  SimRunTimers (5000);
+  UT_ASSERT_EQUAL (mQueueCompletions, 3);
+
+  Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[3].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[3].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  QueueTestWait (4);
+  UT_ASSERT_EQUAL (Requests[3].Completed, 4);
+  UT_ASSERT_NOT_EFI_ERROR (Requests[3].Token.TransactionStatus);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[3].Buffer, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 0));
+
+  QueueTestDestroy (Requests, 4);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A queued flush runs behind the writes queued before it and flushes the
+  cache of the card. An empty request completes at once, a request that
+  can not be performed fails right away and is not queued.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+QueueFlushAndImmediate (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO2_PROTOCOL    *BlockIo2;
+  QUEUE_TEST_REQUEST        Requests[4];
+  EFI_STATUS                Status;
+  UINTN                     Entry;
+  UINTN                     Flush;
+
+  Test = Context;
+  BlockIo2 = &Test->Instance->BlockIo2;
+  UT_ASSERT_TRUE (QueueTestCreate (Requests, 4));
+
+  MmcSimResetCounters (Test->Sim);
+  MmcSimFillPattern (QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 10, Requests[0].Buffer);
+  Status = BlockIo2->WriteBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[0].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[0].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = BlockIo2->FlushBlocksEx (BlockIo2, &Requests[1].Token);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_STATUS_EQUAL (Requests[1].Token.TransactionStatus, EFI_NOT_READY);
+
+  QueueTestWait (2);
+  UT_ASSERT_EQUAL (Requests[0].Completed, 1);
+  UT_ASSERT_EQUAL (Requests[1].Completed, 2);
+  UT_ASSERT_NOT_EFI_ERROR (Requests[1].Token.TransactionStatus);
+
+  // CMD6 to FLUSH_CACHE after the CMD25 of the write
+  Entry = MmcSimFindCommand (Test->Sim, 25, 0);
+  UT_ASSERT_NOT_EQUAL (Entry, MAX_UINTN);
+  for (Flush = MmcSimFindCommand (Test->Sim, 6, Entry); Flush != MAX_UINTN; Flush = MmcSimFindCommand (Test->Sim, 6, Flush + 1)) {
+    if (((Test->Sim->Log[Flush].Argument >> 16) & 0xFF) == OFFSET_OF (ECSD, FLUSH_CACHE)) {
+      break;
+    }
+  }
+  UT_ASSERT_NOT_EQUAL (Flush, MAX_UINTN);
+
+  // Nothing to transfer, signaled before ReadBlocksEx() returns
+  Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[2].Token,
+                       0, Requests[2].Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Requests[2].Completed, 3);
+  UT_ASSERT_NOT_EFI_ERROR (Requests[2].Token.TransactionStatus);
+
+  // Past the end of the card
+  Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, BlockIo2->Media->LastBlock, &Requests[3].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[3].Buffer);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId + 1, QUEUE_TEST_LBA, &Requests[3].Token,
+                       QUEUE_TEST_REQUEST_SIZE, Requests[3].Buffer);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_MEDIA_CHANGED);
+  SimRunTimers (5000);
+  UT_ASSERT_EQUAL (Requests[3].Completed, 0);
+  UT_ASSERT_TRUE (IsListEmpty (&Test->Instance->RequestQueue));
+
+  QueueTestDestroy (Requests, 4);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Stopping the driver performs the pending requests before the block
+  interfaces go away.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+QueueStopDrains (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO2_PROTOCOL    *BlockIo2;
+  QUEUE_TEST_REQUEST        Requests[2];
+  EFI_STATUS                Status;
+  UINTN                     Index;
+
+  Test = Context;
+  BlockIo2 = &Test->Instance->BlockIo2;
+  UT_ASSERT_TRUE (QueueTestCreate (Requests, 2));
+
+  for (Index = 0; Index < 2; Index++) {
+    Status = BlockIo2->ReadBlocksEx (BlockIo2, BlockIo2->Media->MediaId, QUEUE_TEST_LBA, &Requests[Index].Token,
+                         QUEUE_TEST_REQUEST_SIZE, Requests[Index].Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+  }
+
+  Status = gMmcDriverBinding.Stop (&gMmcDriverBinding, Test->Sim->Controller, 0, NULL);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Test->Instance = NULL;
+  UT_ASSERT_EQUAL (mQueueCompletions, 2);
+  for (Index = 0; Index < 2; Index++) {
+    UT_ASSERT_EQUAL (Requests[Index].Completed, Index + 1);
+    UT_ASSERT_NOT_EFI_ERROR (Requests[Index].Token.TransactionStatus);
+    UT_ASSERT_TRUE (MmcTestCheckPattern (Requests[Index].Buffer, QUEUE_TEST_LBA, QUEUE_TEST_REQUEST_SIZE / 512, 0));
+  }
+  SimRunTimers (5000);
+
+  QueueTestDestroy (Requests, 2);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC MMC_TEST_CONTEXT  mQueueDefault = { NULL, FALSE };
+
+EFI_STATUS
+MmcBlockIo2TestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Block I/O 2 request queue", "MmcDxe.BlockIo2", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Requests complete in order, one per tick", "Order",
+    QueueOrder, MmcTestStart, MmcTestStop, &mQueueDefault);
+  AddTestCase (Suite, "Blocking requests drain the queue", "BlockingDrains",
+    QueueBlockingDrains, MmcTestStart, MmcTestStop, &mQueueDefault);
+  AddTestCase (Suite, "ResetEx aborts pending requests", "ResetAborts",
+    QueueResetAborts, MmcTestStart, MmcTestStop, &mQueueDefault);
+  AddTestCase (Suite, "Queued flush and immediate completion", "FlushAndImmediate",
+    QueueFlushAndImmediate, MmcTestStart, MmcTestStop, &mQueueDefault);
+  AddTestCase (Suite, "Stop performs pending requests", "StopDrains",
+    QueueStopDrains, MmcTestStart, MmcTestStop, &mQueueDefault);
+  return EFI_SUCCESS;
+}
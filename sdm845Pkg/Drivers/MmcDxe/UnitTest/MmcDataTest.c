@@ -0,0 +1,574 @@
+/** @file
+  Data path, block cache and error recovery against the simulated host
+
+  The benchmark cases report the commands per MB and the throughput the
+  simulated card sees, with the same BENCH prefix as the extended driver
+  diagnostics, and fail when the driver needs clearly more commands than
+  the transfer sizes call for.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+
+#include "MmcDxeHostTest.h"
+
+#define DATA_TEST_LBA             0x8000
+#define DATA_TEST_SIZE            SIZE_8MB
+#define DATA_TEST_REQUEST_SIZE    SIZE_1MB
+#define DATA_TEST_RANDOM_OPS      256
+
+STATIC
+EFI_STATUS
+DataTestIo (
+  IN     MMC_TEST_CONTEXT   *Test,
+  IN     BOOLEAN            Write,
+  IN     EFI_LBA            Lba,
+  IN     UINTN              Size,
+  IN OUT VOID               *Buffer
+  )
+{
+  EFI_BLOCK_IO_PROTOCOL     *BlockIo;
+
+  BlockIo = &Test->Instance->BlockIo;
+  if (Write) {
+    return BlockIo->WriteBlocks (BlockIo, BlockIo->Media->MediaId, Lba, Size, Buffer);
+  }
+  return BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, Lba, Size, Buffer);
+}
+
+/**
+  Move DATA_TEST_SIZE from DATA_TEST_LBA in 1MB requests and report the
+  commands per MB and the throughput.
+**/
+STATIC
+UNIT_TEST_STATUS
+DataTestSequential (
+  IN MMC_TEST_CONTEXT       *Test,
+  IN BOOLEAN                Write,
+  IN UINT64                 MaxCommandsPerMb
+  )
+{
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UINTN                     Offset;
+  UINT64                    Start;
+  UINT64                    ElapsedUs;
+  UINT64                    Commands;
+  UINT64                    StatusCommands;
+  BOOLEAN                   Match;
+
+  Buffer = AllocatePool (DATA_TEST_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+  if (Write) {
+    MmcSimFillPattern (DATA_TEST_LBA, DATA_TEST_SIZE / 512, 1, Buffer);
+  }
+
+  MmcSimResetCounters (Test->Sim);
+  StatusCommands = Test->Instance->Stats.StatusCommands;
+  Start = SimNow ();
+  Status = EFI_SUCCESS;
+  for (Offset = 0; !EFI_ERROR (Status) && (Offset < DATA_TEST_SIZE); Offset += DATA_TEST_REQUEST_SIZE) {
+    Status = DataTestIo (Test, Write, DATA_TEST_LBA + Offset / 512, DATA_TEST_REQUEST_SIZE, Buffer + Offset);
+  }
+  ElapsedUs = MmcTestElapsedUs (Start);
+  Commands = MmcSimCommandCount (Test->Sim);
+  StatusCommands = Test->Instance->Stats.StatusCommands - StatusCommands;
+
+  if (Write) {
+    Match = MmcSimReadImage (DATA_TEST_LBA, DATA_TEST_SIZE / 512, Buffer) &&
+            MmcTestCheckPattern (Buffer, DATA_TEST_LBA, DATA_TEST_SIZE / 512, 1);
+  } else {
+    Match = MmcTestCheckPattern (Buffer, DATA_TEST_LBA, DATA_TEST_SIZE / 512, 0);
+  }
+  FreePool (Buffer);
+
+  UT_LOG_INFO ("BENCH seq_%a commands=%ld status_commands=%ld commands_per_mb=%ld kb_per_s=%ld\n",
+    Write ? "write" : "read", Commands, StatusCommands, Commands / (DATA_TEST_SIZE / SIZE_1MB),
+    DivU64x64Remainder (MultU64x32 (DATA_TEST_SIZE / SIZE_1KB, 1000000), MAX (ElapsedUs, 1), NULL));
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (Match);
+  // Plus the CMD13 of the first transfer after the identification
+  UT_ASSERT_TRUE (Commands <= MaxCommandsPerMb * (DATA_TEST_SIZE / SIZE_1MB) + 1);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A 512KB read is CMD23 and CMD18, the card stays in the transfer state.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataSequentialRead (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return DataTestSequential (Context, FALSE, 4);
+}
+
+/**
+  A 512KB write adds a CMD13 after the busy wait to check the card is back
+  in the transfer state.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataSequentialWrite (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return DataTestSequential (Context, TRUE, 6);
+}
+
+STATIC
+VOID
+ConfigureNoWaitBusy (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->HasWaitBusy = FALSE;
+}
+
+/**
+  Without WaitBusy() the driver polls CMD13 with a backoff, the number of
+  polls per write has to stay small.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataWriteWithoutWaitBusy (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UINT64                    Writes;
+
+  Test = Context;
+  Buffer = AllocatePool (DATA_TEST_REQUEST_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+  MmcSimFillPattern (DATA_TEST_LBA, DATA_TEST_REQUEST_SIZE / 512, 2, Buffer);
+
+  MmcSimResetCounters (Test->Sim);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA, DATA_TEST_REQUEST_SIZE, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Writes = Test->Sim->Commands[25];
+  UT_LOG_INFO ("BENCH poll writes=%ld cmd13=%ld\n", Writes, Test->Sim->Commands[13]);
+
+  // The card is busy about 2.3ms per 512KB, a 16us to 4ms backoff finds
+  // it ready within a dozen polls
+  UT_ASSERT_EQUAL (Writes, DATA_TEST_REQUEST_SIZE / SIZE_512KB);
+  UT_ASSERT_TRUE (Test->Sim->Commands[13] <= Writes * 12);
+
+  ZeroMem (Buffer, DATA_TEST_REQUEST_SIZE);
+  UT_ASSERT_TRUE (MmcSimReadImage (DATA_TEST_LBA, DATA_TEST_REQUEST_SIZE / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, DATA_TEST_REQUEST_SIZE / 512, 2));
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The statistics of the driver diagnostics count what the card sees.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataStatistics (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_STATISTICS            Before;
+  MMC_STATISTICS            *After;
+  MMC_SIM                   *Sim;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Sim = Test->Sim;
+  Buffer = AllocatePool (SIZE_256KB);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  CopyMem (&Before, &Test->Instance->Stats, sizeof (Before));
+  MmcSimResetCounters (Sim);
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, SIZE_256KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA + SIZE_1MB / 512, SIZE_256KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA + SIZE_2MB / 512, 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  FreePool (Buffer);
+
+  After = &Test->Instance->Stats;
+  UT_ASSERT_EQUAL (After->DataCommands - Before.DataCommands,
+    Sim->Commands[17] + Sim->Commands[18] + Sim->Commands[24] + Sim->Commands[25]);
+  UT_ASSERT_EQUAL (After->StatusCommands - Before.StatusCommands,
+    Sim->Commands[12] + Sim->Commands[13] + Sim->Commands[23]);
+  UT_ASSERT_EQUAL (After->BytesMoved - Before.BytesMoved, Sim->BytesRead + Sim->BytesWritten);
+  UT_ASSERT_EQUAL (After->Errors, Before.Errors);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The benchmark of the extended driver diagnostics runs through and puts
+  its window back.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataBenchmarkDiagnostics (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_STATUS                Status;
+  EFI_GUID                  *ErrorType;
+  UINTN                     BufferSize;
+  CHAR16                    *Buffer;
+  UINT8                     *Window;
+  UINTN                     WindowBlocks;
+  EFI_LBA                   WindowLba;
+  BOOLEAN                   Restored;
+
+  Test = Context;
+  Buffer = NULL;
+  Status = gMmcDriverDiagnostics2.RunDiagnostics (&gMmcDriverDiagnostics2, Test->Instance->MmcHandle, NULL,
+                                    EfiDriverDiagnosticTypeExtended, "en", &ErrorType, &BufferSize, &Buffer);
+  UT_ASSERT_NOT_NULL (Buffer);
+  UT_LOG_INFO ("%s", Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (StrStr (Buffer, L"BENCH restore status=Success") != NULL);
+  FreePool (Buffer);
+
+  // The window is moved to the end of the card when it does not fit
+  WindowBlocks = PcdGet32 (PcdMmcBenchmarkBlocks);
+  WindowLba = MIN (PcdGet64 (PcdMmcBenchmarkLba), MMC_SIM_IMAGE_BLOCKS - WindowBlocks);
+  Window = AllocatePool (WindowBlocks * 512);
+  UT_ASSERT_NOT_NULL (Window);
+  Restored = MmcSimReadImage (WindowLba, WindowBlocks, Window) &&
+             MmcTestCheckPattern (Window, WindowLba, WindowBlocks, 0);
+  FreePool (Window);
+  UT_ASSERT_TRUE (Restored);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The standard driver diagnostics read back what they wrote from the card,
+  not from the block cache: five tests of three reads and two writes each.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DataStandardDiagnostics (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_STATUS                Status;
+  EFI_GUID                  *ErrorType;
+  UINTN                     BufferSize;
+  CHAR16                    *Buffer;
+  UINT8                     Block[512];
+
+  Test = Context;
+  Buffer = NULL;
+  MmcSimResetCounters (Test->Sim);
+  Status = gMmcDriverDiagnostics2.RunDiagnostics (&gMmcDriverDiagnostics2, Test->Instance->MmcHandle, NULL,
+                                    EfiDriverDiagnosticTypeStandard, "en", &ErrorType, &BufferSize, &Buffer);
+  UT_ASSERT_NOT_NULL (Buffer);
+  UT_LOG_INFO ("%s", Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (StrStr (Buffer, L"ERROR") == NULL);
+  UT_ASSERT_TRUE (StrStr (Buffer, L"misses\n") != NULL);
+  FreePool (Buffer);
+
+  UT_ASSERT_EQUAL (Test->Sim->Commands[17] + Test->Sim->Commands[18], 5 * 3);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[24] + Test->Sim->Commands[25], 5 * 2);
+  UT_ASSERT_TRUE (MmcSimReadImage (1, 1, Block));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Block, 1, 1, 0));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Reading the same 64KB twice in 4KB requests only reaches the card once.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CacheSecondPass (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+  UINTN                     Pass;
+  UINTN                     Offset;
+  UINT64                    DataCommands[2];
+
+  Test = Context;
+  for (Pass = 0; Pass < 2; Pass++) {
+    MmcSimResetCounters (Test->Sim);
+    for (Offset = 0; Offset < SIZE_64KB; Offset += sizeof (Buffer)) {
+      Status = DataTestIo (Test, FALSE, DATA_TEST_LBA + Offset / 512, sizeof (Buffer), Buffer);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+      UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA + Offset / 512, sizeof (Buffer) / 512, 0));
+    }
+    DataCommands[Pass] = Test->Sim->Commands[17] + Test->Sim->Commands[18];
+  }
+
+  UT_LOG_INFO ("BENCH cache first_pass=%ld second_pass=%ld\n", DataCommands[0], DataCommands[1]);
+  UT_ASSERT_TRUE (DataCommands[0] > 0);
+  UT_ASSERT_EQUAL (DataCommands[1], 0);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Sequential 4KB reads are served by the read-ahead, random ones cost a
+  data command each.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CacheSequentialRandom (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+  UINTN                     Index;
+  EFI_LBA                   Lba;
+  UINT32                    Seed;
+  UINT64                    Sequential;
+  UINT64                    Random;
+
+  Test = Context;
+  MmcSimResetCounters (Test->Sim);
+  for (Index = 0; Index < DATA_TEST_RANDOM_OPS; Index++) {
+    Lba = DATA_TEST_LBA + Index * (sizeof (Buffer) / 512);
+    Status = DataTestIo (Test, FALSE, Lba, sizeof (Buffer), Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, Lba, sizeof (Buffer) / 512, 0));
+  }
+  Sequential = Test->Sim->Commands[17] + Test->Sim->Commands[18];
+
+  MmcSimResetCounters (Test->Sim);
+  Seed = 12345;
+  for (Index = 0; Index < DATA_TEST_RANDOM_OPS; Index++) {
+    Seed = Seed * 1103515245 + 12345;
+    Lba = ((Seed >> 8) % (MMC_SIM_IMAGE_BLOCKS / 8)) * 8;
+    Status = DataTestIo (Test, FALSE, Lba, sizeof (Buffer), Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, Lba, sizeof (Buffer) / 512, 0));
+  }
+  Random = Test->Sim->Commands[17] + Test->Sim->Commands[18];
+
+  UT_LOG_INFO ("BENCH cache seq_4k_commands=%ld rand_4k_commands=%ld ops=%d\n",
+    Sequential, Random, DATA_TEST_RANDOM_OPS);
+  UT_ASSERT_TRUE (Sequential * 8 <= DATA_TEST_RANDOM_OPS);
+  UT_ASSERT_TRUE (Random >= DATA_TEST_RANDOM_OPS * 9 / 10);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A write goes through to the card and the cached copy follows it.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CacheWriteThrough (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  MmcSimFillPattern (DATA_TEST_LBA + 2, 1, 3, Buffer);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA + 2, 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcSimReadImage (DATA_TEST_LBA + 2, 1, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA + 2, 1, 3));
+
+  MmcSimResetCounters (Test->Sim);
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[17] + Test->Sim->Commands[18], 0);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, 2, 0));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer + 2 * 512, DATA_TEST_LBA + 2, 1, 3));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer + 3 * 512, DATA_TEST_LBA + 3, 5, 0));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A CRC error in the data phase of CMD18 stops the transfer with CMD12,
+  the next read works again.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ErrorReadData (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_64KB];
+  EFI_STATUS                Status;
+  UINT64                    Errors;
+  UINTN                     Entry;
+
+  Test = Context;
+  Errors = Test->Instance->Stats.Errors;
+  MmcSimResetCounters (Test->Sim);
+  Test->Sim->FailIndex = 18;
+  Test->Sim->FailData = TRUE;
+  Test->Sim->FailCount = 1;
+  Test->Sim->FailStatus = EFI_CRC_ERROR;
+
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_TRUE (EFI_ERROR (Status));
+  Entry = MmcSimFindCommand (Test->Sim, 18, 0);
+  UT_ASSERT_NOT_EQUAL (Entry, MAX_UINTN);
+  UT_ASSERT_NOT_EQUAL (MmcSimFindCommand (Test->Sim, 12, Entry), MAX_UINTN);
+  UT_ASSERT_EQUAL (Test->Instance->Stats.Errors, Errors + 1);
+  UT_ASSERT_EQUAL (Test->Sim->State, MmcSimTransfer);
+
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, sizeof (Buffer) / 512, 0));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A failed CMD25 leaves the card and the cached copy unchanged.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ErrorWriteCommand (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_64KB];
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  Test->Sim->FailIndex = 25;
+  Test->Sim->FailData = FALSE;
+  Test->Sim->FailCount = 1;
+  Test->Sim->FailStatus = EFI_DEVICE_ERROR;
+  MmcSimFillPattern (DATA_TEST_LBA, sizeof (Buffer) / 512, 4, Buffer);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_DEVICE_ERROR);
+
+  UT_ASSERT_TRUE (MmcSimReadImage (DATA_TEST_LBA, sizeof (Buffer) / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, sizeof (Buffer) / 512, 0));
+  Status = DataTestIo (Test, FALSE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, sizeof (Buffer) / 512, 0));
+
+  // The card took no harm, the same write goes through now
+  MmcSimFillPattern (DATA_TEST_LBA, sizeof (Buffer) / 512, 4, Buffer);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcSimReadImage (DATA_TEST_LBA, sizeof (Buffer) / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, sizeof (Buffer) / 512, 4));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A card that stays busy longer than the programming timeout fails the
+  write, and is used again once it is done.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ErrorProgrammingTimeout (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+  UINT32                    ProgramUs;
+
+  Test = Context;
+  ProgramUs = Test->Sim->ProgramUs;
+  Test->Sim->ProgramUs = 3000000;
+  MmcSimFillPattern (DATA_TEST_LBA, sizeof (Buffer) / 512, 5, Buffer);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_TRUE (EFI_ERROR (Status));
+  UT_ASSERT_EQUAL (Test->Sim->State, MmcSimProgramming);
+
+  SimAdvance (MultU64x32 (Test->Sim->ProgramUs, 1000));
+  Test->Sim->ProgramUs = ProgramUs;
+  MmcSimFillPattern (DATA_TEST_LBA, sizeof (Buffer) / 512, 6, Buffer);
+  Status = DataTestIo (Test, TRUE, DATA_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcSimReadImage (DATA_TEST_LBA, sizeof (Buffer) / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, DATA_TEST_LBA, sizeof (Buffer) / 512, 6));
+  return UNIT_TEST_PASSED;
+}
+
+STATIC MMC_TEST_CONTEXT  mDataDefault     = { NULL,                FALSE };
+STATIC MMC_TEST_CONTEXT  mDataNoWaitBusy  = { ConfigureNoWaitBusy, FALSE };
+
+EFI_STATUS
+MmcDataTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Data path and block cache", "MmcDxe.Data", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Sequential read commands per MB", "SequentialRead",
+    DataSequentialRead, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Sequential write commands per MB", "SequentialWrite",
+    DataSequentialWrite, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Write polling CMD13 without WaitBusy", "WriteNoWaitBusy",
+    DataWriteWithoutWaitBusy, MmcTestStart, MmcTestStop, &mDataNoWaitBusy);
+  AddTestCase (Suite, "Statistics match the commands sent", "Statistics",
+    DataStatistics, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Extended diagnostics benchmark", "Benchmark",
+    DataBenchmarkDiagnostics, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Standard diagnostics reach the card", "StandardDiagnostics",
+    DataStandardDiagnostics, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Second pass served by the cache", "CacheSecondPass",
+    CacheSecondPass, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Sequential and random 4KB reads", "CacheSequentialRandom",
+    CacheSequentialRandom, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Write-through keeps the cache coherent", "CacheWriteThrough",
+    CacheWriteThrough, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Data error on CMD18", "ErrorReadData",
+    ErrorReadData, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Command error on CMD25", "ErrorWriteCommand",
+    ErrorWriteCommand, MmcTestStart, MmcTestStop, &mDataDefault);
+  AddTestCase (Suite, "Programming timeout", "ErrorProgrammingTimeout",
+    ErrorProgrammingTimeout, MmcTestStart, MmcTestStop, &mDataDefault);
+  return EFI_SUCCESS;
+}
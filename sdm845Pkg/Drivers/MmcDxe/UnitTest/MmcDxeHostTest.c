@@ -0,0 +1,284 @@
+/** @file
+  Host-based tests of the MMC DXE driver
+
+  Every test case starts the driver on a fresh simulated host, lets the
+  identification run on the simulated timer and stops the driver again, so
+  that the cases are independent of each other. The disk image is shared:
+  it holds MmcSimFillPattern() content with seed 0, and the blocks a test
+  changes through the card are put back when the test ends.
+
+  Usage: MmcDxeHostTest [image]. Without an image a 64MB temporary file is
+  used, a given image keeps the content of its blocks outside the areas the
+  tests write.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "MmcDxeHostTest.h"
+
+// Longer than the 1000 CMD1 polls of the driver, one per timer tick
+#define MMC_TEST_IDENTIFY_TIMEOUT_US  3000000
+#define MMC_TEST_PATTERN_CHUNK        256
+
+/**
+  Write the seed 0 pattern over Blocks blocks of the image from Lba.
+**/
+STATIC
+BOOLEAN
+MmcTestStampImage (
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks
+  )
+{
+  VOID                      *Buffer;
+  UINTN                     Count;
+  BOOLEAN                   Success;
+
+  Buffer = AllocatePool (MMC_TEST_PATTERN_CHUNK * 512);
+  if (Buffer == NULL) {
+    return FALSE;
+  }
+  Success = TRUE;
+  for ( ; Success && (Blocks > 0); Lba += Count, Blocks -= Count) {
+    Count = (UINTN)MIN (Blocks, MMC_TEST_PATTERN_CHUNK);
+    MmcSimFillPattern (Lba, Count, 0, Buffer);
+    Success = MmcSimWriteImage (Lba, Count, Buffer);
+  }
+  FreePool (Buffer);
+  return Success;
+}
+
+BOOLEAN
+MmcTestCheckPattern (
+  IN CONST VOID             *Buffer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN UINT32                 Seed
+  )
+{
+  VOID                      *Expected;
+  BOOLEAN                   Match;
+
+  Expected = AllocatePool (Blocks * 512);
+  if (Expected == NULL) {
+    return FALSE;
+  }
+  MmcSimFillPattern (Lba, Blocks, Seed, Expected);
+  Match = (CompareMem (Buffer, Expected, Blocks * 512) == 0);
+  FreePool (Expected);
+  return Match;
+}
+
+UINT64
+MmcTestElapsedUs (
+  IN UINT64                 Start
+  )
+{
+  return DivU64x32 (SimNow () - Start, 1000);
+}
+
+STATIC
+MMC_HOST_INSTANCE *
+MmcTestFindInstance (
+  IN MMC_SIM                *Sim
+  )
+{
+  LIST_ENTRY                *Link;
+  MMC_HOST_INSTANCE         *Instance;
+
+  for (Link = GetFirstNode (&mMmcHostPool); !IsNull (&mMmcHostPool, Link); Link = GetNextNode (&mMmcHostPool, Link)) {
+    Instance = MMC_HOST_INSTANCE_FROM_LINK (Link);
+    if (Instance->MmcHost == &Sim->Host) {
+      return Instance;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Create the simulated host, configure it for the test case, start the
+  driver on it and wait for the identification to end.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+MmcTestStart (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_SIM                   *Sim;
+  MMC_HOST_INSTANCE         *Instance;
+  EFI_STATUS                Status;
+  UINT64                    Waited;
+
+  Test = Context;
+  Test->Sim = NULL;
+  Test->Instance = NULL;
+
+  Sim = MmcSimCreate ();
+  if (Sim == NULL) {
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+  if (Test->Configure != NULL) {
+    Test->Configure (Sim);
+  }
+  if (!Sim->HasWaitBusy) {
+    Sim->HostExt.WaitBusy = NULL;
+  }
+
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Sim->Controller,
+                  &gEmbeddedMmcHostProtocolGuid, &Sim->Host,
+                  &gMmcHostExtProtocolGuid, &Sim->HostExt,
+                  NULL
+                  );
+  if (EFI_ERROR (Status)) {
+    MmcSimDestroy (Sim);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+  Test->Sim = Sim;
+
+  Status = gMmcDriverBinding.Supported (&gMmcDriverBinding, Sim->Controller, NULL);
+  if (!EFI_ERROR (Status)) {
+    Status = gMmcDriverBinding.Start (&gMmcDriverBinding, Sim->Controller, NULL);
+  }
+  Instance = MmcTestFindInstance (Sim);
+  if (EFI_ERROR (Status) || (Instance == NULL)) {
+    UT_LOG_ERROR ("Driver did not start, Status=%r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+  Test->Instance = Instance;
+
+  for (Waited = 0; Waited < MMC_TEST_IDENTIFY_TIMEOUT_US; Waited += 1000) {
+    if ((Instance->IdentifyStep == MmcIdentifyDone) || (Instance->IdentifyStep == MmcIdentifyFailed)) {
+      break;
+    }
+    SimRunTimers (1000);
+  }
+
+  if (!Test->ExpectNoMedia && (!Instance->BlockIoInstalled || !Instance->BlockIo.Media->MediaPresent)) {
+    UT_LOG_ERROR ("Card not identified, step %d\n", Instance->IdentifyStep);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Stop the driver, remove the simulated host and put back the blocks the
+  test changed.
+**/
+VOID
+EFIAPI
+MmcTestStop (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_SIM                   *Sim;
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Sim = Test->Sim;
+  if (Sim == NULL) {
+    return;
+  }
+
+  if (Test->Instance != NULL) {
+    Status = gMmcDriverBinding.Stop (&gMmcDriverBinding, Sim->Controller, 0, NULL);
+    ASSERT_EFI_ERROR (Status);
+  }
+  Status = gBS->UninstallMultipleProtocolInterfaces (
+                  Sim->Controller,
+                  &gEmbeddedMmcHostProtocolGuid, &Sim->Host,
+                  &gMmcHostExtProtocolGuid, &Sim->HostExt,
+                  NULL
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  if (Sim->DirtyStart < Sim->DirtyEnd) {
+    MmcTestStampImage (Sim->DirtyStart, Sim->DirtyEnd - Sim->DirtyStart);
+  }
+  MmcSimDestroy (Sim);
+  Test->Sim = NULL;
+  Test->Instance = NULL;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+UefiTestMain (
+  IN CONST CHAR8            *ImagePath OPTIONAL
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+
+  Framework = NULL;
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  if (!SimImageOpen (ImagePath, MultU64x32 (MMC_SIM_IMAGE_BLOCKS, 512)) ||
+      !MmcTestStampImage (0, MMC_SIM_IMAGE_BLOCKS)) {
+    DEBUG ((DEBUG_ERROR, "Can not set up the disk image\n"));
+    return EFI_NOT_FOUND;
+  }
+
+  SimInitializeBootServices ();
+  Status = MmcDxeInitialize (gImageHandle, gST);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "MmcDxeInitialize failed, Status=%r\n", Status));
+    goto EXIT;
+  }
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "InitUnitTestFramework failed, Status=%r\n", Status));
+    goto EXIT;
+  }
+
+  Status = MmcIdentifyTestAddSuite (Framework);
+  if (!EFI_ERROR (Status)) {
+    Status = MmcDataTestAddSuite (Framework);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcTransferTestAddSuite (Framework);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcBlockIo2TestAddSuite (Framework);
+  }
+  if (!EFI_ERROR (Status)) {
+    Status = MmcEraseTestAddSuite (Framework);
+  }
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework != NULL) {
+    FreeUnitTestFramework (Framework);
+  }
+  SimImageClose ();
+  return Status;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UefiTestMain ((argc > 1) ? argv[1] : NULL);
+}
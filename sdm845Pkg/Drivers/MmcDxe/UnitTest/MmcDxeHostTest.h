@@ -0,0 +1,361 @@
+/** @file
+  Host-based tests of the MMC DXE driver
+
+  The driver runs unmodified against MMC_SIM, an eMMC behind a simulated
+  EFI_MMC_HOST_PROTOCOL. The user area of the card is kept in a disk image
+  file, the card registers (OCR, CID, CSD, ECSD), its state machine and its
+  busy periods are modelled closely enough for the identification, the data
+  path, the partitions and the erase paths of the driver to run as on a
+  board. Time is simulated: every command, data transfer and delay advances
+  a clock that also drives the timer events of the fake boot services.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __MMC_DXE_HOST_TEST_H__
+#define __MMC_DXE_HOST_TEST_H__
+
+#include <Uefi.h>
+
+#include <Library/UnitTestLib.h>
+
+#include "../Mmc.h"
+
+#define UNIT_TEST_APP_NAME        "MMC DXE Host Tests"
+#define UNIT_TEST_APP_VERSION     "1.0"
+
+//
+// Size of the disk image, and of the user area of the default card
+//
+#define MMC_SIM_IMAGE_BLOCKS      (SIZE_64MB / 512)
+
+//
+// Card states, as reported in bits [12:9] of the R1 response
+//
+typedef enum {
+  MmcSimIdle = 0,
+  MmcSimReady,
+  MmcSimIdent,
+  MmcSimStandBy,
+  MmcSimTransfer,
+  MmcSimSendData,
+  MmcSimReceiveData,
+  MmcSimProgramming,
+  MmcSimDisconnect
+} MMC_SIM_STATE;
+
+//
+// Card status bits of the R1 response
+//
+#define MMC_SIM_R1_OUT_OF_RANGE       BIT31
+#define MMC_SIM_R1_ADDRESS_MISALIGN   BIT30
+#define MMC_SIM_R1_BLOCK_LEN_ERROR    BIT29
+#define MMC_SIM_R1_ERASE_SEQ_ERROR    BIT28
+#define MMC_SIM_R1_ERASE_PARAM        BIT27
+#define MMC_SIM_R1_WP_VIOLATION       BIT26
+#define MMC_SIM_R1_ILLEGAL_COMMAND    BIT22
+#define MMC_SIM_R1_READY_FOR_DATA     BIT8
+#define MMC_SIM_R1_SWITCH_ERROR       BIT7
+
+#define MMC_SIM_LOG_SIZE              1024
+
+typedef struct {
+  UINT32                    Index;
+  UINT32                    Argument;
+  UINT64                    Time;               // When the command was sent, in ns
+} MMC_SIM_LOG_ENTRY;
+
+#define MMC_SIM_SIGNATURE             SIGNATURE_32('m', 's', 'i', 'm')
+#define MMC_SIM_FROM_HOST(a)          CR (a, MMC_SIM, Host, MMC_SIM_SIGNATURE)
+#define MMC_SIM_FROM_HOST_EXT(a)      CR (a, MMC_SIM, HostExt, MMC_SIM_SIGNATURE)
+
+typedef struct {
+  UINTN                     Signature;
+  EFI_MMC_HOST_PROTOCOL     Host;
+  MMC_HOST_EXT_PROTOCOL     HostExt;
+  EFI_HANDLE                Controller;
+
+  //
+  // Card model. MmcSimCreate() describes a 64MB eMMC 5.1, the tests change
+  // these before the driver is started.
+  //
+  UINT64                    Blocks;             // User area, in 512 byte blocks
+  BOOLEAN                   SectorAddressing;   // OCR access mode, byte addressed otherwise
+  BOOLEAN                   PermWriteProtect;   // CSD PERM_WRITE_PROTECT
+  UINT8                     EraseGroupSize;     // CSD ERASE_GRP_SIZE
+  UINT8                     EraseGroupMult;     // CSD ERASE_GRP_MULT
+  ECSD                      Ecsd;               // Reset values of the EXT_CSD
+  UINT32                    PowerUpUs;          // OCR busy after CMD0
+  UINT32                    SwitchUs;           // Busy after CMD6
+  UINT32                    FlushUs;            // Busy after a cache flush
+  UINT32                    ProgramUs;          // Busy after a write, per command
+  UINT32                    ProgramBlockUs;     // and per block written
+  UINT32                    ReadLatencyUs;      // Until the first block of a read
+  UINT32                    EraseGroupUs;       // Busy after CMD38, per erase group
+  UINT32                    TrimBlockUs;        // or per block trimmed or discarded
+
+  //
+  // Host model
+  //
+  BOOLEAN                   Present;
+  BOOLEAN                   MultiBlock;
+  BOOLEAN                   HasWaitBusy;        // Otherwise the driver has to poll CMD13
+  UINT32                    TimingModes;        // EMMCHS* modes SetIos() accepts
+  UINT32                    HostOverheadUs;     // Controller cost of every command
+  EFI_EVENT                 CardDetectEvent;    // From RegisterCardDetect()
+
+  //
+  // Card state
+  //
+  MMC_SIM_STATE             State;
+  UINT16                    Rca;
+  ECSD                      ExtCsd;
+  UINT32                    Status;             // Error bits of the next R1
+  UINT64                    PowerUpEnd;
+  UINT64                    BusyEnd;
+  UINT32                    BlockCount;         // Set by CMD23, 0 for open-ended
+  UINT32                    DataCmd;            // Of the pending data phase
+  UINT64                    DataLba;
+  UINT32                    DataBlocks;         // Left in the data phase, 0 for open-ended
+  BOOLEAN                   EraseStartSet;
+  BOOLEAN                   EraseEndSet;
+  UINT64                    EraseStart;
+  UINT64                    EraseEnd;
+  BOOLEAN                   SecureTrimMarked;   // By secure trim step 1
+  UINT64                    SecureTrimStart;
+  UINT64                    SecureTrimEnd;
+  UINT32                    Response[4];
+  UINT8                     *Boot[2];           // Boot partitions
+  UINT64                    DirtyStart;         // User area blocks changed,
+  UINT64                    DirtyEnd;           // restored by MmcTestStop()
+
+  //
+  // Bus state, as set by NotifyState() and SetIos()
+  //
+  UINT32                    BusClock;
+  UINT32                    BusWidth;
+  UINT32                    TimingMode;
+
+  //
+  // Counters, cleared by MmcSimResetCounters()
+  //
+  UINT64                    Commands[64];       // By command index
+  UINT64                    BytesRead;
+  UINT64                    BytesWritten;
+  UINT64                    BlocksErased;
+  UINTN                     LogCount;           // The first MMC_SIM_LOG_SIZE are kept
+  MMC_SIM_LOG_ENTRY         Log[MMC_SIM_LOG_SIZE];
+
+  //
+  // Error injection: the next FailCount commands of index FailIndex fail
+  // with FailStatus, in their data phase when FailData is set
+  //
+  UINT32                    FailIndex;
+  UINT32                    FailCount;
+  BOOLEAN                   FailData;
+  EFI_STATUS                FailStatus;
+} MMC_SIM;
+
+//
+// A test case runs against the driver started on a fresh MMC_SIM, which
+// Configure may change first.
+//
+typedef struct _MMC_TEST_CONTEXT MMC_TEST_CONTEXT;
+
+typedef
+VOID
+(*MMC_TEST_CONFIGURE) (
+  IN OUT MMC_SIM            *Sim
+  );
+
+struct _MMC_TEST_CONTEXT {
+  MMC_TEST_CONFIGURE        Configure;
+  BOOLEAN                   ExpectNoMedia;      // The identification is meant to fail
+  MMC_SIM                   *Sim;
+  MMC_HOST_INSTANCE         *Instance;
+};
+
+//
+// Clock and timer events, BootServicesSim.c. The clock counts nanoseconds
+// since the start of the test.
+//
+UINT64
+SimNow (
+  VOID
+  );
+
+VOID
+SimAdvance (
+  IN UINT64                 Nanoseconds
+  );
+
+UINTN
+SimRunTimers (
+  IN UINT64                 Microseconds
+  );
+
+VOID
+SimInitializeBootServices (
+  VOID
+  );
+
+VOID *
+SimGetProtocol (
+  IN EFI_HANDLE             Handle,
+  IN EFI_GUID               *Protocol
+  );
+
+//
+// Simulated host and card, MmcHostSim.c
+//
+MMC_SIM *
+MmcSimCreate (
+  VOID
+  );
+
+VOID
+MmcSimDestroy (
+  IN MMC_SIM                *Sim
+  );
+
+VOID
+MmcSimResetCounters (
+  IN MMC_SIM                *Sim
+  );
+
+UINT64
+MmcSimCommandCount (
+  IN MMC_SIM                *Sim
+  );
+
+UINTN
+MmcSimFindCommand (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Index,
+  IN UINTN                  Start
+  );
+
+BOOLEAN
+MmcSimReadImage (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  OUT VOID                  *Buffer
+  );
+
+BOOLEAN
+MmcSimWriteImage (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  CONST VOID            *Buffer
+  );
+
+VOID
+MmcSimFillPattern (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  UINT32                Seed,
+  OUT VOID                  *Buffer
+  );
+
+//
+// Disk image, MmcHostSimImage.c. Kept apart as it is the only part of the
+// test built against the C library headers.
+//
+BOOLEAN
+SimImageOpen (
+  IN CONST CHAR8            *Path OPTIONAL,
+  IN UINT64                 Size
+  );
+
+VOID
+SimImageClose (
+  VOID
+  );
+
+BOOLEAN
+SimImageRead (
+  IN  UINT64                Offset,
+  IN  UINTN                 Length,
+  OUT VOID                  *Buffer
+  );
+
+BOOLEAN
+SimImageWrite (
+  IN  UINT64                Offset,
+  IN  UINTN                 Length,
+  IN  CONST VOID            *Buffer
+  );
+
+//
+// Driver under test, MmcDxeHostTest.c
+//
+extern EFI_DRIVER_BINDING_PROTOCOL gMmcDriverBinding;
+
+EFI_STATUS
+EFIAPI
+MmcDxeInitialize (
+  IN EFI_HANDLE             ImageHandle,
+  IN EFI_SYSTEM_TABLE       *SystemTable
+  );
+
+UNIT_TEST_STATUS
+EFIAPI
+MmcTestStart (
+  IN UNIT_TEST_CONTEXT      Context
+  );
+
+VOID
+EFIAPI
+MmcTestStop (
+  IN UNIT_TEST_CONTEXT      Context
+  );
+
+UINT64
+MmcTestElapsedUs (
+  IN UINT64                 Start
+  );
+
+BOOLEAN
+MmcTestCheckPattern (
+  IN CONST VOID             *Buffer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN UINT32                 Seed
+  );
+
+//
+// Test suites, one file each
+//
+EFI_STATUS
+MmcIdentifyTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+EFI_STATUS
+MmcDataTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+EFI_STATUS
+MmcTransferTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+EFI_STATUS
+MmcBlockIo2TestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+EFI_STATUS
+MmcEraseTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  );
+
+#endif
@@ -0,0 +1,498 @@
+/** @file
+  Erase Block Protocol against the simulated card
+
+  The simulated card erases whole erase groups for a CMD38 erase, like a
+  real one, so an erase range that is not aligned to the groups clears the
+  blocks around it. The cases check that only the blocks asked for read as
+  erased and that the blocks next to them keep their content.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "MmcDxeHostTest.h"
+
+#define ERASE_TEST_LBA            0x8000
+
+// CMD38 arguments
+#define ERASE_TEST_ARG_ERASE      0
+#define ERASE_TEST_ARG_TRIM       1
+#define ERASE_TEST_ARG_DISCARD    3
+#define ERASE_TEST_ARG_SECURE     0x80000000
+#define ERASE_TEST_ARG_STRIM1     0x80000001
+#define ERASE_TEST_ARG_STRIM2     0x80008000
+
+STATIC
+EFI_STATUS
+EraseTestErase (
+  IN MMC_TEST_CONTEXT       *Test,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks
+  )
+{
+  EFI_ERASE_BLOCK_PROTOCOL  *EraseBlock;
+
+  EraseBlock = &Test->Instance->EraseBlock;
+  MmcSimResetCounters (Test->Sim);
+  return EraseBlock->EraseBlocks (EraseBlock, Test->Instance->BlockIo.Media->MediaId, Lba, NULL, Blocks * 512);
+}
+
+/**
+  Check that the image holds zeros, or the seed 0 pattern when Erased is
+  FALSE, over Blocks blocks from Lba.
+**/
+STATIC
+BOOLEAN
+EraseTestCheckImage (
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN BOOLEAN                Erased
+  )
+{
+  UINT8                     *Buffer;
+  BOOLEAN                   Match;
+
+  if (Blocks == 0) {
+    return TRUE;
+  }
+  Buffer = AllocatePool (Blocks * 512);
+  if (Buffer == NULL) {
+    return FALSE;
+  }
+  Match = MmcSimReadImage (Lba, Blocks, Buffer);
+  if (Match && Erased) {
+    Match = IsZeroBuffer (Buffer, Blocks * 512);
+  } else if (Match) {
+    Match = MmcTestCheckPattern (Buffer, Lba, Blocks, 0);
+  }
+  FreePool (Buffer);
+  return Match;
+}
+
+STATIC
+UINT32
+EraseTestArgument (
+  IN MMC_SIM                *Sim,
+  IN EFI_LBA                Lba
+  )
+{
+  return (UINT32)(Sim->SectorAddressing ? Lba : Lba * 512);
+}
+
+/**
+  Check that the Entry-th CMD35, CMD36, CMD38 sequence of the log erases
+  Blocks blocks from Lba with Argument.
+**/
+STATIC
+UNIT_TEST_STATUS
+EraseTestCheckCommands (
+  IN MMC_SIM                *Sim,
+  IN UINTN                  Entry,
+  IN EFI_LBA                Lba,
+  IN UINT64                 Blocks,
+  IN UINT32                 Argument
+  )
+{
+  UINTN                     Cmd35;
+  UINTN                     Index;
+
+  Cmd35 = MmcSimFindCommand (Sim, 35, 0);
+  for (Index = 0; (Index < Entry) && (Cmd35 != MAX_UINTN); Index++) {
+    Cmd35 = MmcSimFindCommand (Sim, 35, Cmd35 + 1);
+  }
+  UT_ASSERT_NOT_EQUAL (Cmd35, MAX_UINTN);
+  UT_ASSERT_TRUE (Cmd35 + 2 < Sim->LogCount);
+  UT_ASSERT_EQUAL (Sim->Log[Cmd35].Argument, EraseTestArgument (Sim, Lba));
+  UT_ASSERT_EQUAL (Sim->Log[Cmd35 + 1].Index, 36);
+  UT_ASSERT_EQUAL (Sim->Log[Cmd35 + 1].Argument, EraseTestArgument (Sim, Lba + Blocks - 1));
+  UT_ASSERT_EQUAL (Sim->Log[Cmd35 + 2].Index, 38);
+  UT_ASSERT_EQUAL (Sim->Log[Cmd35 + 2].Argument, Argument);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Erase a range that starts Head blocks before a group boundary and ends
+  Tail blocks after one, with Groups whole groups between, and check the
+  commands and the image. The edges are trimmed with EdgeArgument, or
+  written with zeros when it is MAX_UINT32.
+**/
+STATIC
+UNIT_TEST_STATUS
+EraseTestUnaligned (
+  IN MMC_TEST_CONTEXT       *Test,
+  IN UINTN                  Head,
+  IN UINTN                  Groups,
+  IN UINTN                  Tail,
+  IN UINT32                 EdgeArgument
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  UINTN                     Group;
+  EFI_LBA                   Lba;
+  UINTN                     Blocks;
+  UINTN                     Entry;
+
+  Group = Test->Instance->EraseBlock.EraseLengthGranularity;
+  Lba = ERASE_TEST_LBA + Group - Head;
+  Blocks = Head + Groups * Group + Tail;
+
+  Status = EraseTestErase (Test, Lba, Blocks);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  // The whole groups with one erase, then the edges
+  Entry = 0;
+  if (Groups > 0) {
+    Result = EraseTestCheckCommands (Test->Sim, Entry++, ERASE_TEST_LBA + Group, Groups * Group, ERASE_TEST_ARG_ERASE);
+    UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  }
+  if (EdgeArgument != MAX_UINT32) {
+    if (Head > 0) {
+      Result = EraseTestCheckCommands (Test->Sim, Entry++, Lba, Head, EdgeArgument);
+      UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+    }
+    if (Tail > 0) {
+      Result = EraseTestCheckCommands (Test->Sim, Entry++, Lba + Blocks - Tail, Tail, EdgeArgument);
+      UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+    }
+  } else {
+    UT_ASSERT_EQUAL (Test->Sim->BytesWritten, (Head + Tail) * 512);
+  }
+  UT_ASSERT_EQUAL (Test->Sim->Commands[38], Entry);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[17] + Test->Sim->Commands[18], 0);
+
+  // A discard leaves the edges undetermined, the rest reads as erased
+  if (EdgeArgument == ERASE_TEST_ARG_DISCARD) {
+    UT_ASSERT_TRUE (EraseTestCheckImage (Lba + Head, Groups * Group, TRUE));
+  } else {
+    UT_ASSERT_TRUE (EraseTestCheckImage (Lba, Blocks, TRUE));
+  }
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA, Group - Head, FALSE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (Lba + Blocks, Group - Tail, FALSE));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  An aligned range is one erase of whole groups.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseAligned (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+
+  Test = Context;
+  // HC_ERASE_GRP_SIZE of 512KB
+  UT_ASSERT_EQUAL (Test->Instance->EraseBlock.EraseLengthGranularity, 1024);
+  return EraseTestUnaligned (Test, 0, 4, 0, ERASE_TEST_ARG_TRIM);
+}
+
+/**
+  The partial groups at either end of an unaligned range are trimmed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseUnalignedTrim (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return EraseTestUnaligned (Context, 100, 3, 300, ERASE_TEST_ARG_TRIM);
+}
+
+/**
+  A range inside a single group is only trimmed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseWithinGroup (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+
+  Test = Context;
+  Status = EraseTestErase (Test, ERASE_TEST_LBA + 10, 20);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[38], 1);
+  Result = EraseTestCheckCommands (Test->Sim, 0, ERASE_TEST_LBA + 10, 20, ERASE_TEST_ARG_TRIM);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA, 10, FALSE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA + 10, 20, TRUE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA + 30, 1024 - 30, FALSE));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A secure erase purges the whole groups, the edges are marked by secure trim
+  step 1 and purged by step 2.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseSecure (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  EFI_LBA                   Lba;
+
+  Test = Context;
+  Test->Instance->SecureErase = TRUE;
+  Lba = ERASE_TEST_LBA + 1024 - 100;
+  Status = EraseTestErase (Test, Lba, 100 + 2 * 1024 + 300);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_EQUAL (Test->Sim->Commands[38], 5);
+  Result = EraseTestCheckCommands (Test->Sim, 0, ERASE_TEST_LBA + 1024, 2 * 1024, ERASE_TEST_ARG_SECURE);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = EraseTestCheckCommands (Test->Sim, 1, Lba, 100, ERASE_TEST_ARG_STRIM1);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = EraseTestCheckCommands (Test->Sim, 2, Lba, 100, ERASE_TEST_ARG_STRIM2);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = EraseTestCheckCommands (Test->Sim, 3, ERASE_TEST_LBA + 3 * 1024, 300, ERASE_TEST_ARG_STRIM1);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  Result = EraseTestCheckCommands (Test->Sim, 4, ERASE_TEST_LBA + 3 * 1024, 300, ERASE_TEST_ARG_STRIM2);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_FALSE (Test->Sim->SecureTrimMarked);
+
+  UT_ASSERT_TRUE (EraseTestCheckImage (Lba, 100 + 2 * 1024 + 300, TRUE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA, 1024 - 100, FALSE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA + 3 * 1024 + 300, 1024 - 300, FALSE));
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureSecureEraseOnly (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  // Secure erase without TRIM
+  Sim->Ecsd.SECURE_FEATURE_SUPPORT = BIT0;
+}
+
+/**
+  A card that can not secure trim gets the edges of a secure erase written
+  with zeros rather than discarded.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseSecureZeros (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  EFI_LBA                   Lba;
+
+  Test = Context;
+  Test->Instance->SecureErase = TRUE;
+  Lba = ERASE_TEST_LBA + 1024 - 200;
+  Status = EraseTestErase (Test, Lba, 200 + 1024 + 40);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_EQUAL (Test->Sim->Commands[38], 1);
+  Result = EraseTestCheckCommands (Test->Sim, 0, ERASE_TEST_LBA + 1024, 1024, ERASE_TEST_ARG_SECURE);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (Test->Sim->BytesWritten, (200 + 40) * 512);
+
+  UT_ASSERT_TRUE (EraseTestCheckImage (Lba, 200 + 1024 + 40, TRUE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA, 1024 - 200, FALSE));
+  UT_ASSERT_TRUE (EraseTestCheckImage (ERASE_TEST_LBA + 2 * 1024 + 40, 1024 - 40, FALSE));
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureDiscard (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->Ecsd.SECURE_FEATURE_SUPPORT = 0;
+}
+
+/**
+  A card without TRIM discards the edges.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseUnalignedDiscard (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return EraseTestUnaligned (Context, 1000, 2, 24, ERASE_TEST_ARG_DISCARD);
+}
+
+STATIC
+VOID
+ConfigureEraseOnly (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  // eMMC 4.41, before discard
+  Sim->Ecsd.SECURE_FEATURE_SUPPORT = 0;
+  Sim->Ecsd.EXT_CSD_REV = 5;
+}
+
+/**
+  A card that can neither trim nor discard gets the edges written with
+  zeros.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseUnalignedZeros (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return EraseTestUnaligned (Context, 300, 1, 700, MAX_UINT32);
+}
+
+STATIC
+VOID
+ConfigureCsdGroup (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->Ecsd.ERASE_GROUP_DEF = 0;
+  Sim->EraseGroupSize = 7;
+  Sim->EraseGroupMult = 15;
+}
+
+/**
+  Without ERASE_GROUP_DEF the group is the one of the CSD.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseCsdGroup (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+
+  Test = Context;
+  UT_ASSERT_EQUAL (Test->Instance->EraseBlock.EraseLengthGranularity, 8 * 16);
+  return EraseTestUnaligned (Test, 5, 7, 127, ERASE_TEST_ARG_TRIM);
+}
+
+STATIC
+VOID
+ConfigureByteMode (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->SectorAddressing = FALSE;
+}
+
+/**
+  A byte addressed card gets the erase range in bytes.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseByteMode (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  return EraseTestUnaligned (Context, 1, 1, 1, ERASE_TEST_ARG_TRIM);
+}
+
+/**
+  Blocks read before the erase are not served from the cache afterwards,
+  and a range past the end of the card is refused.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+EraseCacheAndLimits (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  EFI_BLOCK_IO_PROTOCOL     *BlockIo;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+
+  Test = Context;
+  BlockIo = &Test->Instance->BlockIo;
+  Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, ERASE_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, ERASE_TEST_LBA, sizeof (Buffer) / 512, 0));
+
+  Status = EraseTestErase (Test, ERASE_TEST_LBA, 1024);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, ERASE_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (IsZeroBuffer (Buffer, sizeof (Buffer)));
+
+  Status = EraseTestErase (Test, BlockIo->Media->LastBlock, 2);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (MmcSimCommandCount (Test->Sim), 0);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC MMC_TEST_CONTEXT  mEraseDefault    = { NULL,               FALSE };
+STATIC MMC_TEST_CONTEXT  mEraseDiscard    = { ConfigureDiscard,   FALSE };
+STATIC MMC_TEST_CONTEXT  mEraseOnly       = { ConfigureEraseOnly, FALSE };
+STATIC MMC_TEST_CONTEXT  mEraseCsdGroup   = { ConfigureCsdGroup,  FALSE };
+STATIC MMC_TEST_CONTEXT  mEraseByteMode   = { ConfigureByteMode,  FALSE };
+STATIC MMC_TEST_CONTEXT  mEraseSecureOnly = { ConfigureSecureEraseOnly, FALSE };
+
+EFI_STATUS
+MmcEraseTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Erase group alignment", "MmcDxe.Erase", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Aligned range", "Aligned",
+    EraseAligned, MmcTestStart, MmcTestStop, &mEraseDefault);
+  AddTestCase (Suite, "Unaligned range with trimmed edges", "UnalignedTrim",
+    EraseUnalignedTrim, MmcTestStart, MmcTestStop, &mEraseDefault);
+  AddTestCase (Suite, "Range within one group", "WithinGroup",
+    EraseWithinGroup, MmcTestStart, MmcTestStop, &mEraseDefault);
+  AddTestCase (Suite, "Unaligned range with discarded edges", "UnalignedDiscard",
+    EraseUnalignedDiscard, MmcTestStart, MmcTestStop, &mEraseDiscard);
+  AddTestCase (Suite, "Unaligned range with zeroed edges", "UnalignedZeros",
+    EraseUnalignedZeros, MmcTestStart, MmcTestStop, &mEraseOnly);
+  AddTestCase (Suite, "Erase group of the CSD", "CsdGroup",
+    EraseCsdGroup, MmcTestStart, MmcTestStop, &mEraseCsdGroup);
+  AddTestCase (Suite, "Byte addressed card", "ByteMode",
+    EraseByteMode, MmcTestStart, MmcTestStop, &mEraseByteMode);
+  AddTestCase (Suite, "Secure erase and secure trim", "Secure",
+    EraseSecure, MmcTestStart, MmcTestStop, &mEraseDefault);
+  AddTestCase (Suite, "Secure erase with zeroed edges", "SecureZeros",
+    EraseSecureZeros, MmcTestStart, MmcTestStop, &mEraseSecureOnly);
+  AddTestCase (Suite, "Cache and range limits", "CacheAndLimits",
+    EraseCacheAndLimits, MmcTestStart, MmcTestStop, &mEraseDefault);
+  return EFI_SUCCESS;
+}
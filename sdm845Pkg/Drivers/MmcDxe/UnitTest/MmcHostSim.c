@@ -0,0 +1,1243 @@
+/** @file
+  Simulated MMC host with an eMMC attached
+
+  The host implements EFI_MMC_HOST_PROTOCOL and MMC_HOST_EXT_PROTOCOL the way
+  the controller drivers of the package do, the card answers the commands of
+  the eMMC 5.1 specification that MmcDxe sends. Busy periods are not waited
+  for: the card records when they end and leaves the programming state once
+  the simulated clock passes that point, so a driver polling too little or
+  too much shows in the command counts and in the elapsed time.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "MmcDxeHostTest.h"
+
+// Command, response and the turnaround between them, in bus clocks
+#define SIM_COMMAND_CLOCKS        136
+// Blocks of the CMD21 sequence a host runs to tune for HS200
+#define SIM_TUNING_BLOCKS         40
+#define SIM_TUNING_BLOCK_SIZE     128
+
+#define SIM_RCA(Argument)         ((UINT16)((Argument) >> 16))
+
+// Bits of the R1 response that fail the command that caused them
+#define SIM_R1_ERRORS             (MMC_SIM_R1_OUT_OF_RANGE | MMC_SIM_R1_ADDRESS_MISALIGN |   \
+                                   MMC_SIM_R1_BLOCK_LEN_ERROR | MMC_SIM_R1_ERASE_SEQ_ERROR | \
+                                   MMC_SIM_R1_ERASE_PARAM | MMC_SIM_R1_WP_VIOLATION |        \
+                                   MMC_SIM_R1_ILLEGAL_COMMAND)
+
+#define SIM_DEVICE_TYPE_HS        (EMMCHS26 | EMMCHS52)
+#define SIM_DEVICE_TYPE_DDR       (EMMCHS52DDR1V8 | EMMCHS52DDR1V2)
+#define SIM_DEVICE_TYPE_HS200     (EMMCHS200SDR1V8 | EMMCHS200SDR1V2)
+#define SIM_DEVICE_TYPE_HS400     (EMMCHS400DDR1V8 | EMMCHS400DDR1V2)
+
+STATIC CONST EFI_GUID  mMmcSimDevicePathGuid = {
+  0x5d0b5a31, 0x8c1e, 0x4d7f, { 0x9b, 0x3e, 0x6a, 0x2f, 0x41, 0xc8, 0x0e, 0x97 }
+};
+
+// Manufacturer 0x15, "SIMMC", revision 1.0, serial 0x12345678, 10/2020
+STATIC CONST UINT32  mMmcSimCid[4] = { 0x5678a401, 0x10123456, 0x494d4d43, 0x15010053 };
+
+/**
+  Time the bus takes for Clocks clock cycles, in nanoseconds.
+**/
+STATIC
+UINT64
+SimBusTime (
+  IN MMC_SIM                *Sim,
+  IN UINT64                 Clocks
+  )
+{
+  return DivU64x32 (MultU64x32 (Clocks, 1000000000), MAX (Sim->BusClock, 1));
+}
+
+/**
+  Width of the data bus selected in the EXT_CSD, and whether it is DDR.
+**/
+STATIC
+UINT32
+SimCardBusWidth (
+  IN  MMC_SIM               *Sim,
+  OUT BOOLEAN               *Ddr
+  )
+{
+  *Ddr = (Sim->ExtCsd.BUS_WIDTH >= 5);
+  switch (Sim->ExtCsd.BUS_WIDTH) {
+  case 1:
+  case 5:
+    return 4;
+  case 2:
+  case 6:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+/**
+  Time the bus takes to move Length bytes of data, in nanoseconds.
+**/
+STATIC
+UINT64
+SimDataTime (
+  IN MMC_SIM                *Sim,
+  IN UINTN                  Length
+  )
+{
+  BOOLEAN                   Ddr;
+  UINT64                    BitsPerSecond;
+
+  SimCardBusWidth (Sim, &Ddr);
+  BitsPerSecond = MultU64x32 (MAX (Sim->BusClock, 1), Sim->BusWidth * (Ddr ? 2 : 1));
+  return DivU64x64Remainder (MultU64x32 (Length, 8 * 1000000000U), BitsPerSecond, NULL);
+}
+
+/**
+  Fastest clock the card accepts in the timing selected by HS_TIMING.
+**/
+STATIC
+UINT32
+SimMaxClock (
+  IN MMC_SIM                *Sim
+  )
+{
+  switch (Sim->ExtCsd.HS_TIMING & 0xF) {
+  case 0:
+    return 26000000;
+  case 1:
+    return 52000000;
+  default:
+    return 200000000;
+  }
+}
+
+/**
+  Size in blocks of the partition selected by PARTITION_CONFIG.
+**/
+STATIC
+UINT64
+SimPartitionBlocks (
+  IN MMC_SIM                *Sim
+  )
+{
+  switch (Sim->ExtCsd.PARTITION_CONFIG & EMMC_PARTITION_MASK) {
+  case EMMC_PARTITION_USER:
+    return Sim->Blocks;
+  case EMMC_PARTITION_BOOT1:
+  case EMMC_PARTITION_BOOT2:
+    return Sim->ExtCsd.BOOT_SIZE_MULTI * (SIZE_128KB / 512);
+  default:
+    return 0;
+  }
+}
+
+/**
+  Move blocks between the selected partition and a buffer, the user area
+  lives in the disk image and the boot partitions in memory.
+**/
+STATIC
+BOOLEAN
+SimAccess (
+  IN     MMC_SIM            *Sim,
+  IN     BOOLEAN            Write,
+  IN     UINT64             Lba,
+  IN     UINTN              Blocks,
+  IN OUT VOID               *Buffer
+  )
+{
+  UINT8                     Access;
+  UINT8                     **Boot;
+
+  Access = Sim->ExtCsd.PARTITION_CONFIG & EMMC_PARTITION_MASK;
+  if (Access == EMMC_PARTITION_USER) {
+    if (Write) {
+      Sim->DirtyStart = MIN (Sim->DirtyStart, Lba);
+      Sim->DirtyEnd = MAX (Sim->DirtyEnd, Lba + Blocks);
+      return SimImageWrite (MultU64x32 (Lba, 512), Blocks * 512, Buffer);
+    }
+    return SimImageRead (MultU64x32 (Lba, 512), Blocks * 512, Buffer);
+  }
+
+  Boot = &Sim->Boot[Access - EMMC_PARTITION_BOOT1];
+  if (*Boot == NULL) {
+    *Boot = AllocateZeroPool ((UINTN)SimPartitionBlocks (Sim) * 512);
+    if (*Boot == NULL) {
+      return FALSE;
+    }
+  }
+  if (Write) {
+    CopyMem (*Boot + Lba * 512, Buffer, Blocks * 512);
+  } else {
+    CopyMem (Buffer, *Boot + Lba * 512, Blocks * 512);
+  }
+  return TRUE;
+}
+
+/**
+  Hold the card busy in the programming state for Us microseconds.
+**/
+STATIC
+VOID
+SimBusy (
+  IN MMC_SIM                *Sim,
+  IN UINT64                 Us
+  )
+{
+  Sim->State = MmcSimProgramming;
+  Sim->BusyEnd = SimNow () + MultU64x32 (Us, 1000);
+}
+
+/**
+  Apply the state changes due by now.
+**/
+STATIC
+VOID
+SimUpdate (
+  IN MMC_SIM                *Sim
+  )
+{
+  if ((Sim->State == MmcSimProgramming) && (SimNow () >= Sim->BusyEnd)) {
+    Sim->State = MmcSimTransfer;
+  }
+}
+
+/**
+  CMD0, back to the idle state with the EXT_CSD reset.
+**/
+STATIC
+VOID
+SimReset (
+  IN MMC_SIM                *Sim
+  )
+{
+  CopyMem (&Sim->ExtCsd, &Sim->Ecsd, sizeof (ECSD));
+  Sim->ExtCsd.SECTOR_COUNT = (UINT32)Sim->Blocks;
+  Sim->State = MmcSimIdle;
+  Sim->Rca = 0;
+  Sim->Status = 0;
+  Sim->BlockCount = 0;
+  Sim->EraseStartSet = FALSE;
+  Sim->EraseEndSet = FALSE;
+  Sim->SecureTrimMarked = FALSE;
+  Sim->PowerUpEnd = SimNow () + MultU64x32 (Sim->PowerUpUs, 1000);
+}
+
+/**
+  The CSD as four response words, bits [31:0] first.
+**/
+STATIC
+VOID
+SimSetCsdBits (
+  IN OUT UINT32             *Csd,
+  IN     UINTN              Low,
+  IN     UINTN              Width,
+  IN     UINT32             Value
+  )
+{
+  UINTN                     Bit;
+
+  for (Bit = 0; Bit < Width; Bit++) {
+    if ((Value >> Bit) & 1) {
+      Csd[(Low + Bit) / 32] |= 1U << ((Low + Bit) % 32);
+    }
+  }
+}
+
+STATIC
+VOID
+SimBuildCsd (
+  IN  MMC_SIM               *Sim,
+  OUT UINT32                *Csd
+  )
+{
+  ZeroMem (Csd, 4 * sizeof (UINT32));
+  SimSetCsdBits (Csd, 126, 2, 3);       // CSD_STRUCTURE, version in the EXT_CSD
+  SimSetCsdBits (Csd, 122, 4, 4);       // SPEC_VERS
+  SimSetCsdBits (Csd, 112, 8, 0x27);    // TAAC
+  SimSetCsdBits (Csd, 104, 8, 1);       // NSAC
+  SimSetCsdBits (Csd, 96, 8, 0x32);     // TRAN_SPEED, 26MHz
+  SimSetCsdBits (Csd, 84, 12, 0x8F5);   // CCC
+  SimSetCsdBits (Csd, 80, 4, 9);        // READ_BL_LEN
+  SimSetCsdBits (Csd, 62, 12, 0xFFF);   // C_SIZE, the size is in the EXT_CSD
+  SimSetCsdBits (Csd, 42, 5, Sim->EraseGroupSize);
+  SimSetCsdBits (Csd, 37, 5, Sim->EraseGroupMult);
+  SimSetCsdBits (Csd, 26, 3, 2);        // R2W_FACTOR
+  SimSetCsdBits (Csd, 22, 4, 9);        // WRITE_BL_LEN
+  SimSetCsdBits (Csd, 13, 1, Sim->PermWriteProtect);
+  SimSetCsdBits (Csd, 0, 1, 1);
+}
+
+/**
+  Block addressed by the argument of a data or erase command.
+**/
+STATIC
+UINT64
+SimBlockAddress (
+  IN     MMC_SIM            *Sim,
+  IN     UINT32             Argument,
+  IN OUT UINT32             *Error
+  )
+{
+  if (Sim->SectorAddressing) {
+    return Argument;
+  }
+  if ((Argument % 512) != 0) {
+    *Error |= MMC_SIM_R1_ADDRESS_MISALIGN;
+  }
+  return Argument / 512;
+}
+
+/**
+  Erase group of the user area, as set by ERASE_GROUP_DEF.
+**/
+STATIC
+UINT64
+SimEraseGroupBlocks (
+  IN MMC_SIM                *Sim
+  )
+{
+  if ((Sim->ExtCsd.ERASE_GROUP_DEF & BIT0) && (Sim->ExtCsd.HC_ERASE_GRP_SIZE != 0)) {
+    return Sim->ExtCsd.HC_ERASE_GRP_SIZE * (SIZE_512KB / 512);
+  }
+  return (Sim->EraseGroupSize + 1) * (Sim->EraseGroupMult + 1);
+}
+
+/**
+  CMD6 writing a byte of the EXT_CSD. Returns the status bits the next R1
+  reports, the switch itself is acknowledged before the card checks it.
+**/
+STATIC
+UINT32
+SimSwitch (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Argument
+  )
+{
+  UINT8                     Index;
+  UINT8                     Value;
+  UINT8                     DeviceType;
+  UINT32                    CacheSize;
+  BOOLEAN                   Valid;
+
+  Index = (UINT8)(Argument >> 16);
+  Value = (UINT8)(Argument >> 8);
+  DeviceType = Sim->ExtCsd.DEVICE_TYPE;
+  CacheSize = Sim->ExtCsd.CACHE_SIZE[0] | (Sim->ExtCsd.CACHE_SIZE[1] << 8) |
+              (Sim->ExtCsd.CACHE_SIZE[2] << 16) | (Sim->ExtCsd.CACHE_SIZE[3] << 24);
+
+  // Only the write byte access is modelled
+  if (((Argument >> 24) & 0x3) != 3) {
+    return MMC_SIM_R1_SWITCH_ERROR;
+  }
+
+  switch (Index) {
+  case OFFSET_OF (ECSD, FLUSH_CACHE):
+    if (Value != 1) {
+      return MMC_SIM_R1_SWITCH_ERROR;
+    }
+    SimBusy (Sim, (Sim->ExtCsd.CACHE_CTRL & BIT0) ? Sim->FlushUs : Sim->SwitchUs);
+    return 0;
+  case OFFSET_OF (ECSD, CACHE_CTRL):
+    Valid = (Value == 0) || ((Value == 1) && (CacheSize != 0));
+    break;
+  case OFFSET_OF (ECSD, ERASE_GROUP_DEF):
+    Valid = (Value <= 1);
+    break;
+  case OFFSET_OF (ECSD, PARTITION_CONFIG):
+    switch (Value & EMMC_PARTITION_MASK) {
+    case EMMC_PARTITION_USER:
+      Valid = TRUE;
+      break;
+    case EMMC_PARTITION_BOOT1:
+    case EMMC_PARTITION_BOOT2:
+      Valid = (Sim->ExtCsd.BOOT_SIZE_MULTI != 0);
+      break;
+    default:
+      Valid = FALSE;
+      break;
+    }
+    break;
+  case OFFSET_OF (ECSD, BUS_WIDTH):
+    if (Value <= 2) {
+      Valid = TRUE;
+    } else if ((Value == 5) || (Value == 6)) {
+      // DDR needs the card in high speed timing first
+      Valid = ((DeviceType & (SIM_DEVICE_TYPE_DDR | SIM_DEVICE_TYPE_HS400)) != 0) &&
+              (Sim->ExtCsd.HS_TIMING == 1);
+    } else {
+      Valid = FALSE;
+    }
+    break;
+  case OFFSET_OF (ECSD, HS_TIMING):
+    switch (Value & 0xF) {
+    case 0:
+      Valid = TRUE;
+      break;
+    case 1:
+      Valid = (DeviceType & SIM_DEVICE_TYPE_HS) != 0;
+      break;
+    case 2:
+      Valid = ((DeviceType & SIM_DEVICE_TYPE_HS200) != 0) &&
+              ((Sim->ExtCsd.BUS_WIDTH == 1) || (Sim->ExtCsd.BUS_WIDTH == 2));
+      break;
+    case 3:
+      Valid = ((DeviceType & SIM_DEVICE_TYPE_HS400) != 0) && (Sim->ExtCsd.BUS_WIDTH == 6);
+      break;
+    default:
+      Valid = FALSE;
+      break;
+    }
+    break;
+  default:
+    Valid = FALSE;
+    break;
+  }
+
+  if (!Valid) {
+    return MMC_SIM_R1_SWITCH_ERROR;
+  }
+  ((UINT8 *)&Sim->ExtCsd)[Index] = Value;
+  SimBusy (Sim, Sim->SwitchUs);
+  return 0;
+}
+
+/**
+  CMD17, CMD18, CMD24 or CMD25, the card enters its data state.
+**/
+STATIC
+UINT32
+SimStartData (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Index,
+  IN UINT32                 Argument
+  )
+{
+  UINT32                    Error;
+  UINT64                    Lba;
+  UINT32                    Blocks;
+  BOOLEAN                   Write;
+
+  Error = 0;
+  Write = (Index == 24) || (Index == 25);
+  Blocks = ((Index == 17) || (Index == 24)) ? 1 : Sim->BlockCount;
+  Sim->BlockCount = 0;
+  if (Sim->State != MmcSimTransfer) {
+    return MMC_SIM_R1_ILLEGAL_COMMAND;
+  }
+
+  Lba = SimBlockAddress (Sim, Argument, &Error);
+  if ((Lba >= SimPartitionBlocks (Sim)) || (Lba + Blocks > SimPartitionBlocks (Sim))) {
+    Error |= MMC_SIM_R1_OUT_OF_RANGE;
+  }
+  if (Write && Sim->PermWriteProtect) {
+    Error |= MMC_SIM_R1_WP_VIOLATION;
+  }
+  if (Error != 0) {
+    return Error;
+  }
+
+  Sim->DataCmd = Index;
+  Sim->DataLba = Lba;
+  Sim->DataBlocks = Blocks;
+  Sim->State = Write ? MmcSimReceiveData : MmcSimSendData;
+  return 0;
+}
+
+/**
+  CMD38, erase, trim or discard the range set by CMD35 and CMD36. Secure
+  trim marks the range in step 1 and clears it in step 2.
+**/
+STATIC
+UINT32
+SimErase (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Argument
+  )
+{
+  UINT64                    Start;
+  UINT64                    End;
+  UINT64                    Group;
+  UINT64                    BusyUs;
+  UINT64                    Lba;
+  UINTN                     Count;
+  VOID                      *Zeros;
+  BOOLEAN                   Clear;
+
+  if (Sim->State != MmcSimTransfer) {
+    return MMC_SIM_R1_ILLEGAL_COMMAND;
+  }
+  if (!Sim->EraseStartSet || !Sim->EraseEndSet) {
+    return MMC_SIM_R1_ERASE_SEQ_ERROR;
+  }
+  Sim->EraseStartSet = FALSE;
+  Sim->EraseEndSet = FALSE;
+
+  Start = Sim->EraseStart;
+  End = Sim->EraseEnd;
+  if (End < Start) {
+    return MMC_SIM_R1_ERASE_PARAM;
+  }
+  if (Sim->PermWriteProtect) {
+    return MMC_SIM_R1_WP_VIOLATION;
+  }
+
+  switch (Argument) {
+  case 0x80000000:
+    if ((Sim->ExtCsd.SECURE_FEATURE_SUPPORT & BIT0) == 0) {
+      return MMC_SIM_R1_ERASE_PARAM;
+    }
+    // Fall through
+  case 0:
+    // Whole erase groups, including the ones the range only touches
+    Group = SimEraseGroupBlocks (Sim);
+    Start -= Start % Group;
+    End = MIN (End - End % Group + Group - 1, SimPartitionBlocks (Sim) - 1);
+    BusyUs = MultU64x32 ((End - Start + 1) / Group, Sim->EraseGroupUs);
+    Clear = TRUE;
+    break;
+  case 1:
+    if ((Sim->ExtCsd.SECURE_FEATURE_SUPPORT & BIT4) == 0) {
+      return MMC_SIM_R1_ERASE_PARAM;
+    }
+    BusyUs = MultU64x32 (End - Start + 1, Sim->TrimBlockUs);
+    Clear = TRUE;
+    break;
+  case 3:
+    // The content of discarded blocks is undetermined, the model keeps it
+    if (Sim->ExtCsd.EXT_CSD_REV < 6) {
+      return MMC_SIM_R1_ERASE_PARAM;
+    }
+    BusyUs = MultU64x32 (End - Start + 1, Sim->TrimBlockUs);
+    Clear = FALSE;
+    break;
+  case 0x80000001:
+    if ((Sim->ExtCsd.SECURE_FEATURE_SUPPORT & (BIT0 | BIT4)) != (BIT0 | BIT4)) {
+      return MMC_SIM_R1_ERASE_PARAM;
+    }
+    Sim->SecureTrimMarked = TRUE;
+    Sim->SecureTrimStart = Start;
+    Sim->SecureTrimEnd = End;
+    BusyUs = MultU64x32 (End - Start + 1, Sim->TrimBlockUs);
+    Clear = FALSE;
+    break;
+  case 0x80008000:
+    if (!Sim->SecureTrimMarked) {
+      return MMC_SIM_R1_ERASE_SEQ_ERROR;
+    }
+    Sim->SecureTrimMarked = FALSE;
+    Start = Sim->SecureTrimStart;
+    End = Sim->SecureTrimEnd;
+    BusyUs = MultU64x32 (End - Start + 1, Sim->TrimBlockUs);
+    Clear = TRUE;
+    break;
+  default:
+    return MMC_SIM_R1_ERASE_PARAM;
+  }
+
+  if (Clear) {
+    Zeros = AllocateZeroPool (256 * 512);
+    if (Zeros == NULL) {
+      return MMC_SIM_R1_ERASE_PARAM;
+    }
+    for (Lba = Start; Lba <= End; Lba += Count) {
+      Count = (UINTN)MIN (End - Lba + 1, 256);
+      SimAccess (Sim, TRUE, Lba, Count, Zeros);
+    }
+    FreePool (Zeros);
+  }
+
+  Sim->BlocksErased += End - Start + 1;
+  SimBusy (Sim, MAX (BusyUs, 1));
+  return 0;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimSendCommand (
+  IN EFI_MMC_HOST_PROTOCOL  *This,
+  IN MMC_CMD                Cmd,
+  IN UINT32                 Argument
+  )
+{
+  MMC_SIM                   *Sim;
+  MMC_SIM_STATE             OldState;
+  UINT32                    Index;
+  UINT32                    Error;
+  UINT32                    Deferred;
+  UINT64                    Lba;
+
+  Sim = MMC_SIM_FROM_HOST (This);
+  Index = MMC_GET_INDX (Cmd);
+
+  SimAdvance (MultU64x32 (Sim->HostOverheadUs, 1000) + SimBusTime (Sim, SIM_COMMAND_CLOCKS));
+  Sim->Commands[Index % ARRAY_SIZE (Sim->Commands)]++;
+  if (Sim->LogCount < MMC_SIM_LOG_SIZE) {
+    Sim->Log[Sim->LogCount].Index = Index;
+    Sim->Log[Sim->LogCount].Argument = Argument;
+    Sim->Log[Sim->LogCount].Time = SimNow ();
+  }
+  Sim->LogCount++;
+  SimUpdate (Sim);
+
+  if (!Sim->Present) {
+    return EFI_TIMEOUT;
+  }
+  // The card samples garbage on a clock faster than its timing allows
+  if (Sim->BusClock > SimMaxClock (Sim)) {
+    return EFI_CRC_ERROR;
+  }
+  if ((Sim->FailCount > 0) && !Sim->FailData && (Sim->FailIndex == Index)) {
+    Sim->FailCount--;
+    return Sim->FailStatus;
+  }
+
+  OldState = Sim->State;
+  Error = 0;
+  Deferred = 0;
+  switch (Index) {
+  case 0:
+    SimReset (Sim);
+    return EFI_SUCCESS;
+
+  case 1:
+    if ((Sim->State != MmcSimIdle) && (Sim->State != MmcSimReady)) {
+      return EFI_TIMEOUT;
+    }
+    Sim->Response[0] = EMMC_CMD1_CAPACITY_LESS_THAN_2GB;
+    if (Sim->SectorAddressing) {
+      Sim->Response[0] |= BIT30;
+    }
+    if (SimNow () >= Sim->PowerUpEnd) {
+      Sim->Response[0] |= MMC_OCR_POWERUP;
+      Sim->State = MmcSimReady;
+    }
+    return EFI_SUCCESS;
+
+  case 2:
+    if (Sim->State != MmcSimReady) {
+      return EFI_TIMEOUT;
+    }
+    CopyMem (Sim->Response, mMmcSimCid, sizeof (mMmcSimCid));
+    Sim->State = MmcSimIdent;
+    return EFI_SUCCESS;
+
+  case 3:
+    if (Sim->State != MmcSimIdent) {
+      return EFI_TIMEOUT;
+    }
+    Sim->Rca = SIM_RCA (Argument);
+    Sim->State = MmcSimStandBy;
+    break;
+
+  case 9:
+    if ((Sim->State != MmcSimStandBy) || (SIM_RCA (Argument) != Sim->Rca)) {
+      return EFI_TIMEOUT;
+    }
+    SimBuildCsd (Sim, Sim->Response);
+    return EFI_SUCCESS;
+
+  case 7:
+    if (SIM_RCA (Argument) != Sim->Rca) {
+      // Deselected by the address of another card, which answers instead
+      if (Sim->State == MmcSimTransfer) {
+        Sim->State = MmcSimStandBy;
+      } else if (Sim->State == MmcSimProgramming) {
+        Sim->State = MmcSimDisconnect;
+      }
+      return EFI_TIMEOUT;
+    }
+    if (Sim->State == MmcSimStandBy) {
+      Sim->State = MmcSimTransfer;
+    } else if (Sim->State != MmcSimTransfer) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+    }
+    break;
+
+  case 13:
+    if ((Sim->State < MmcSimStandBy) || (SIM_RCA (Argument) != Sim->Rca)) {
+      return EFI_TIMEOUT;
+    }
+    break;
+
+  case 6:
+    if (Sim->State != MmcSimTransfer) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+      break;
+    }
+    Deferred = SimSwitch (Sim, Argument);
+    break;
+
+  case 8:
+    // SEND_IF_COND of SD cards, an eMMC in idle state does not answer it
+    if (Sim->State < MmcSimStandBy) {
+      return EFI_TIMEOUT;
+    }
+    if ((Sim->State != MmcSimTransfer) || (SIM_RCA (Argument) != Sim->Rca)) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+      break;
+    }
+    Sim->DataCmd = 8;
+    Sim->DataBlocks = 1;
+    Sim->State = MmcSimSendData;
+    break;
+
+  case 12:
+    if (Sim->State == MmcSimSendData) {
+      Sim->State = MmcSimTransfer;
+    } else if (Sim->State == MmcSimReceiveData) {
+      // Programming started with the data, the busy end is already set
+      Sim->State = MmcSimProgramming;
+      SimUpdate (Sim);
+    } else {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+    }
+    break;
+
+  case 16:
+    if (Sim->State != MmcSimTransfer) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+    } else if (Argument != 512) {
+      Error |= MMC_SIM_R1_BLOCK_LEN_ERROR;
+    }
+    break;
+
+  case 23:
+    if (Sim->State != MmcSimTransfer) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+    } else {
+      Sim->BlockCount = Argument & 0xFFFF;
+    }
+    break;
+
+  case 17:
+  case 18:
+  case 24:
+  case 25:
+    Error |= SimStartData (Sim, Index, Argument);
+    break;
+
+  case 35:
+  case 36:
+    if (Sim->State != MmcSimTransfer) {
+      Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+      break;
+    }
+    Lba = SimBlockAddress (Sim, Argument, &Error);
+    if (Lba >= SimPartitionBlocks (Sim)) {
+      Error |= MMC_SIM_R1_OUT_OF_RANGE;
+    }
+    if (Error != 0) {
+      break;
+    }
+    if (Index == 35) {
+      Sim->EraseStart = Lba;
+      Sim->EraseStartSet = TRUE;
+    } else {
+      Sim->EraseEnd = Lba;
+      Sim->EraseEndSet = Sim->EraseStartSet;
+    }
+    break;
+
+  case 38:
+    Error |= SimErase (Sim, Argument);
+    break;
+
+  default:
+    // CMD5, CMD55 and the other SD and SDIO commands
+    if (Sim->State < MmcSimStandBy) {
+      return EFI_TIMEOUT;
+    }
+    Error |= MMC_SIM_R1_ILLEGAL_COMMAND;
+    break;
+  }
+
+  Sim->Response[0] = Sim->Status | Error | (OldState << 9);
+  if ((OldState != MmcSimProgramming) && (OldState != MmcSimReceiveData)) {
+    Sim->Response[0] |= MMC_SIM_R1_READY_FOR_DATA;
+  }
+  Sim->Status = Deferred;
+
+  // The host checks the error bits of the response to the command
+  if ((Error & SIM_R1_ERRORS) != 0) {
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimReceiveResponse (
+  IN EFI_MMC_HOST_PROTOCOL  *This,
+  IN MMC_RESPONSE_TYPE      Type,
+  IN UINT32                 *Buffer
+  )
+{
+  MMC_SIM                   *Sim;
+
+  Sim = MMC_SIM_FROM_HOST (This);
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Type == MMC_RESPONSE_TYPE_R2) {
+    CopyMem (Buffer, Sim->Response, sizeof (Sim->Response));
+  } else {
+    Buffer[0] = Sim->Response[0];
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Data phase of the pending data command.
+**/
+STATIC
+EFI_STATUS
+SimTransferData (
+  IN     MMC_SIM            *Sim,
+  IN     BOOLEAN            Write,
+  IN     UINTN              Length,
+  IN OUT VOID               *Buffer
+  )
+{
+  UINT32                    CardWidth;
+  BOOLEAN                   CardDdr;
+  BOOLEAN                   HostDdr;
+  UINTN                     Blocks;
+
+  SimUpdate (Sim);
+  if (!Sim->Present) {
+    return EFI_NO_MEDIA;
+  }
+  if (Sim->State != (Write ? MmcSimReceiveData : MmcSimSendData)) {
+    return EFI_DEVICE_ERROR;
+  }
+  if ((Sim->FailCount > 0) && Sim->FailData && (Sim->FailIndex == Sim->DataCmd)) {
+    // The card stays in its data state until the host stops it
+    Sim->FailCount--;
+    SimAdvance (SimDataTime (Sim, 512));
+    return Sim->FailStatus;
+  }
+
+  // Both ends have to agree on the bus, or the CRC of every block fails
+  CardWidth = SimCardBusWidth (Sim, &CardDdr);
+  HostDdr = (Sim->TimingMode & (SIM_DEVICE_TYPE_DDR | SIM_DEVICE_TYPE_HS400)) != 0;
+  if ((CardWidth != Sim->BusWidth) || (CardDdr != HostDdr)) {
+    SimAdvance (SimDataTime (Sim, 512));
+    return EFI_CRC_ERROR;
+  }
+
+  if (Sim->DataCmd == 8) {
+    if (Length != sizeof (ECSD)) {
+      return EFI_BAD_BUFFER_SIZE;
+    }
+    SimAdvance (MultU64x32 (Sim->ReadLatencyUs, 1000) + SimDataTime (Sim, Length));
+    CopyMem (Buffer, &Sim->ExtCsd, sizeof (ECSD));
+    Sim->BytesRead += Length;
+    Sim->State = MmcSimTransfer;
+    return EFI_SUCCESS;
+  }
+
+  if ((Length % 512) != 0) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+  Blocks = Length / 512;
+  if ((Sim->DataBlocks != 0) && (Blocks > Sim->DataBlocks)) {
+    return EFI_DEVICE_ERROR;
+  }
+  if (Sim->DataLba + Blocks > SimPartitionBlocks (Sim)) {
+    // Open-ended transfers only find out at the end of the partition
+    Sim->Status |= MMC_SIM_R1_OUT_OF_RANGE;
+    Sim->State = MmcSimTransfer;
+    return EFI_DEVICE_ERROR;
+  }
+
+  if (Write) {
+    SimAdvance (SimDataTime (Sim, Length));
+    if (!SimAccess (Sim, TRUE, Sim->DataLba, Blocks, Buffer)) {
+      return EFI_DEVICE_ERROR;
+    }
+    Sim->BytesWritten += Length;
+    Sim->BusyEnd = SimNow () + MultU64x32 (Sim->ProgramUs + Blocks * Sim->ProgramBlockUs, 1000);
+  } else {
+    SimAdvance (MultU64x32 (Sim->ReadLatencyUs, 1000) + SimDataTime (Sim, Length));
+    if (!SimAccess (Sim, FALSE, Sim->DataLba, Blocks, Buffer)) {
+      return EFI_DEVICE_ERROR;
+    }
+    Sim->BytesRead += Length;
+  }
+  Sim->DataLba += Blocks;
+
+  // With a block count, the card leaves the data state after the last block
+  if (Sim->DataBlocks != 0) {
+    Sim->DataBlocks -= (UINT32)Blocks;
+    if (Sim->DataBlocks == 0) {
+      Sim->State = Write ? MmcSimProgramming : MmcSimTransfer;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimReadBlockData (
+  IN  EFI_MMC_HOST_PROTOCOL *This,
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Length,
+  OUT UINT32                *Buffer
+  )
+{
+  return SimTransferData (MMC_SIM_FROM_HOST (This), FALSE, Length, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimWriteBlockData (
+  IN  EFI_MMC_HOST_PROTOCOL *This,
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Length,
+  IN  UINT32                *Buffer
+  )
+{
+  return SimTransferData (MMC_SIM_FROM_HOST (This), TRUE, Length, Buffer);
+}
+
+BOOLEAN
+EFIAPI
+MmcSimIsCardPresent (
+  IN EFI_MMC_HOST_PROTOCOL  *This
+  )
+{
+  return MMC_SIM_FROM_HOST (This)->Present;
+}
+
+BOOLEAN
+EFIAPI
+MmcSimIsReadOnly (
+  IN EFI_MMC_HOST_PROTOCOL  *This
+  )
+{
+  return FALSE;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimBuildDevicePath (
+  IN  EFI_MMC_HOST_PROTOCOL     *This,
+  OUT EFI_DEVICE_PATH_PROTOCOL  **DevicePath
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL      *NewDevicePathNode;
+
+  NewDevicePathNode = CreateDeviceNode (HARDWARE_DEVICE_PATH, HW_VENDOR_DP, sizeof (VENDOR_DEVICE_PATH));
+  if (NewDevicePathNode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CopyMem (&((VENDOR_DEVICE_PATH *)NewDevicePathNode)->Guid, &mMmcSimDevicePathGuid, sizeof (EFI_GUID));
+  *DevicePath = NewDevicePathNode;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimNotifyState (
+  IN EFI_MMC_HOST_PROTOCOL  *This,
+  IN MMC_STATE              State
+  )
+{
+  MMC_SIM                   *Sim;
+
+  Sim = MMC_SIM_FROM_HOST (This);
+  if (State == MmcHwInitializationState) {
+    Sim->BusClock = 400000;
+    Sim->BusWidth = 1;
+    Sim->TimingMode = EMMCBACKWARD;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimSetIos (
+  IN EFI_MMC_HOST_PROTOCOL  *This,
+  IN UINT32                 BusClockFreq,
+  IN UINT32                 BusWidth,
+  IN UINT32                 TimingMode
+  )
+{
+  MMC_SIM                   *Sim;
+
+  Sim = MMC_SIM_FROM_HOST (This);
+  if ((TimingMode & ~Sim->TimingModes) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+  if ((BusWidth != 1) && (BusWidth != 4) && (BusWidth != 8)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (BusClockFreq != 0) {
+    Sim->BusClock = BusClockFreq;
+  }
+  Sim->BusWidth = BusWidth;
+  Sim->TimingMode = TimingMode;
+
+  // The host tunes its sample point with CMD21, which only a card in HS200
+  // answers, and HS400 keeps the point found in HS200
+  if ((TimingMode & SIM_DEVICE_TYPE_HS200) != 0) {
+    SimAdvance (MultU64x32 (SimBusTime (Sim, SIM_COMMAND_CLOCKS) + SimDataTime (Sim, SIM_TUNING_BLOCK_SIZE),
+                  SIM_TUNING_BLOCKS));
+    if ((Sim->ExtCsd.HS_TIMING & 0xF) != 2) {
+      return EFI_DEVICE_ERROR;
+    }
+  }
+  if (((TimingMode & SIM_DEVICE_TYPE_HS400) != 0) && ((Sim->ExtCsd.HS_TIMING & 0xF) != 3)) {
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+BOOLEAN
+EFIAPI
+MmcSimIsMultiBlock (
+  IN EFI_MMC_HOST_PROTOCOL  *This
+  )
+{
+  return MMC_SIM_FROM_HOST (This)->MultiBlock;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSimRegisterCardDetect (
+  IN  MMC_HOST_EXT_PROTOCOL *This,
+  IN  EFI_EVENT             Event
+  )
+{
+  MMC_SIM_FROM_HOST_EXT (This)->CardDetectEvent = Event;
+  return EFI_SUCCESS;
+}
+
+/**
+  DAT0 stays low until the card leaves the programming state.
+**/
+EFI_STATUS
+EFIAPI
+MmcSimWaitBusy (
+  IN  MMC_HOST_EXT_PROTOCOL *This,
+  IN  UINT64                TimeoutUs
+  )
+{
+  MMC_SIM                   *Sim;
+  UINT64                    Timeout;
+
+  Sim = MMC_SIM_FROM_HOST_EXT (This);
+  SimUpdate (Sim);
+  if (Sim->State != MmcSimProgramming) {
+    return EFI_SUCCESS;
+  }
+
+  Timeout = MultU64x32 (TimeoutUs, 1000);
+  if (Sim->BusyEnd - SimNow () > Timeout) {
+    SimAdvance (Timeout);
+    return EFI_TIMEOUT;
+  }
+  SimAdvance (Sim->BusyEnd - SimNow ());
+  SimUpdate (Sim);
+  return EFI_SUCCESS;
+}
+
+/**
+  Create a host with a 64MB eMMC 5.1 of the disk image inserted. The card
+  supports HS400 and has a write cache, TRIM and two 512KB boot partitions.
+**/
+MMC_SIM *
+MmcSimCreate (
+  VOID
+  )
+{
+  MMC_SIM                   *Sim;
+
+  Sim = AllocateZeroPool (sizeof (MMC_SIM));
+  if (Sim == NULL) {
+    return NULL;
+  }
+
+  Sim->Signature = MMC_SIM_SIGNATURE;
+  Sim->Host.Revision = MMC_HOST_PROTOCOL_REVISION;
+  Sim->Host.IsCardPresent = MmcSimIsCardPresent;
+  Sim->Host.IsReadOnly = MmcSimIsReadOnly;
+  Sim->Host.BuildDevicePath = MmcSimBuildDevicePath;
+  Sim->Host.NotifyState = MmcSimNotifyState;
+  Sim->Host.SendCommand = MmcSimSendCommand;
+  Sim->Host.ReceiveResponse = MmcSimReceiveResponse;
+  Sim->Host.ReadBlockData = MmcSimReadBlockData;
+  Sim->Host.WriteBlockData = MmcSimWriteBlockData;
+  Sim->Host.SetIos = MmcSimSetIos;
+  Sim->Host.IsMultiBlock = MmcSimIsMultiBlock;
+
+  Sim->HostExt.Revision = MMC_HOST_EXT_PROTOCOL_REVISION;
+  Sim->HostExt.Capabilities = MMC_HOST_EXT_CAP_SET_BLOCK_COUNT | MMC_HOST_EXT_CAP_NON_REMOVABLE;
+  Sim->HostExt.MaxBlockCount = 1024;
+  Sim->HostExt.RegisterCardDetect = MmcSimRegisterCardDetect;
+  Sim->HostExt.WaitBusy = MmcSimWaitBusy;
+
+  Sim->Present = TRUE;
+  Sim->MultiBlock = TRUE;
+  Sim->HasWaitBusy = TRUE;
+  Sim->TimingModes = EMMCHS26 | EMMCHS52 | EMMCHS52DDR1V8 | EMMCHS200SDR1V8 | EMMCHS400DDR1V8;
+  Sim->HostOverheadUs = 5;
+
+  Sim->Blocks = MMC_SIM_IMAGE_BLOCKS;
+  Sim->SectorAddressing = TRUE;
+  Sim->EraseGroupSize = 15;
+  Sim->EraseGroupMult = 31;
+  Sim->PowerUpUs = 20000;
+  Sim->SwitchUs = 100;
+  Sim->FlushUs = 5000;
+  Sim->ProgramUs = 200;
+  Sim->ProgramBlockUs = 2;
+  Sim->ReadLatencyUs = 60;
+  Sim->EraseGroupUs = 1000;
+  Sim->TrimBlockUs = 1;
+
+  Sim->Ecsd.EXT_CSD_REV = 8;
+  Sim->Ecsd.CSD_STRUCTURE = 2;
+  Sim->Ecsd.DEVICE_TYPE = EMMCHS26 | EMMCHS52 | EMMCHS52DDR1V8 | EMMCHS200SDR1V8 | EMMCHS400DDR1V8;
+  Sim->Ecsd.CACHE_SIZE[1] = 0x02;                 // 512KB
+  Sim->Ecsd.HC_ERASE_GRP_SIZE = 1;
+  Sim->Ecsd.HC_WP_GRP_SIZE = 1;
+  Sim->Ecsd.ERASE_GROUP_DEF = 1;
+  Sim->Ecsd.ERASE_TIMEOUT_MULT = 1;
+  Sim->Ecsd.TRIM_MULT = 1;
+  Sim->Ecsd.SECURE_FEATURE_SUPPORT = 0x55;
+  Sim->Ecsd.BOOT_SIZE_MULTI = 4;
+  Sim->Ecsd.PARTITION_SWITCH_TIME = 1;
+  Sim->Ecsd.GENERIC_CMD6_TIME = 1;
+  Sim->Ecsd.S_CMD_SET = 1;
+
+  Sim->BusClock = 400000;
+  Sim->BusWidth = 1;
+  Sim->DirtyStart = MAX_UINT64;
+  return Sim;
+}
+
+VOID
+MmcSimDestroy (
+  IN MMC_SIM                *Sim
+  )
+{
+  if (Sim->Boot[0] != NULL) {
+    FreePool (Sim->Boot[0]);
+  }
+  if (Sim->Boot[1] != NULL) {
+    FreePool (Sim->Boot[1]);
+  }
+  FreePool (Sim);
+}
+
+VOID
+MmcSimResetCounters (
+  IN MMC_SIM                *Sim
+  )
+{
+  ZeroMem (Sim->Commands, sizeof (Sim->Commands));
+  Sim->BytesRead = 0;
+  Sim->BytesWritten = 0;
+  Sim->BlocksErased = 0;
+  Sim->LogCount = 0;
+}
+
+UINT64
+MmcSimCommandCount (
+  IN MMC_SIM                *Sim
+  )
+{
+  UINT64                    Count;
+  UINTN                     Index;
+
+  Count = 0;
+  for (Index = 0; Index < ARRAY_SIZE (Sim->Commands); Index++) {
+    Count += Sim->Commands[Index];
+  }
+  return Count;
+}
+
+/**
+  Position in the log of the first command Index sent at or after Start, or
+  MAX_UINTN.
+**/
+UINTN
+MmcSimFindCommand (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Index,
+  IN UINTN                  Start
+  )
+{
+  UINTN                     Entry;
+
+  for (Entry = Start; Entry < MIN (Sim->LogCount, MMC_SIM_LOG_SIZE); Entry++) {
+    if (Sim->Log[Entry].Index == Index) {
+      return Entry;
+    }
+  }
+  return MAX_UINTN;
+}
+
+/**
+  Access the user area directly, to set up or check what the driver sees.
+**/
+BOOLEAN
+MmcSimReadImage (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  OUT VOID                  *Buffer
+  )
+{
+  return SimImageRead (MultU64x32 (Lba, 512), Blocks * 512, Buffer);
+}
+
+BOOLEAN
+MmcSimWriteImage (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  CONST VOID            *Buffer
+  )
+{
+  return SimImageWrite (MultU64x32 (Lba, 512), Blocks * 512, Buffer);
+}
+
+/**
+  Content that tells apart every word of every block, and the writes made
+  with different seeds.
+**/
+VOID
+MmcSimFillPattern (
+  IN  EFI_LBA               Lba,
+  IN  UINTN                 Blocks,
+  IN  UINT32                Seed,
+  OUT VOID                  *Buffer
+  )
+{
+  UINT32                    *Word;
+  UINTN                     Index;
+  UINT32                    Value;
+
+  Word = Buffer;
+  for (Index = 0; Index < Blocks * 128; Index++) {
+    Value = (UINT32)(Lba * 128 + Index) ^ (Seed * 0x9E3779B9);
+    Value ^= Value >> 16;
+    Value *= 0x85EBCA6B;
+    Value ^= Value >> 13;
+    Word[Index] = Value;
+  }
+}
@@ -0,0 +1,89 @@
+/** @file
+  Disk image holding the user area of the simulated card
+
+  The image is a plain file, given on the command line or created in the
+  temporary directory, so that a test run can start from a real partition
+  layout and the content left by the tests can be examined afterwards.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <stdio.h>
+
+#include "MmcDxeHostTest.h"
+
+STATIC FILE  *mSimImage;
+
+/**
+  Open the image, or create a temporary one of Size bytes when Path is NULL.
+  An image shorter than Size is extended with zeros.
+**/
+BOOLEAN
+SimImageOpen (
+  IN CONST CHAR8            *Path OPTIONAL,
+  IN UINT64                 Size
+  )
+{
+  if (Path != NULL) {
+    mSimImage = fopen (Path, "r+b");
+  } else {
+    mSimImage = tmpfile ();
+  }
+  if (mSimImage == NULL) {
+    return FALSE;
+  }
+
+  if ((fseeko (mSimImage, 0, SEEK_END) != 0) || (ftello (mSimImage) < (off_t)Size)) {
+    if ((fseeko (mSimImage, (off_t)Size - 1, SEEK_SET) != 0) ||
+        (fputc (0, mSimImage) == EOF)) {
+      fclose (mSimImage);
+      mSimImage = NULL;
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+VOID
+SimImageClose (
+  VOID
+  )
+{
+  if (mSimImage != NULL) {
+    fclose (mSimImage);
+    mSimImage = NULL;
+  }
+}
+
+BOOLEAN
+SimImageRead (
+  IN  UINT64                Offset,
+  IN  UINTN                 Length,
+  OUT VOID                  *Buffer
+  )
+{
+  if (fseeko (mSimImage, (off_t)Offset, SEEK_SET) != 0) {
+    return FALSE;
+  }
+  return fread (Buffer, 1, Length, mSimImage) == Length;
+}
+
+BOOLEAN
+SimImageWrite (
+  IN  UINT64                Offset,
+  IN  UINTN                 Length,
+  IN  CONST VOID            *Buffer
+  )
+{
+  if (fseeko (mSimImage, (off_t)Offset, SEEK_SET) != 0) {
+    return FALSE;
+  }
+  return fwrite (Buffer, 1, Length, mSimImage) == Length;
+}
@@ -0,0 +1,291 @@
+/** @file
+  Card identification against the simulated host
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+
+#include "MmcDxeHostTest.h"
+
+#define IDENTIFY_TEST_LBA         0x10000
+
+/**
+  The default card comes up in HS400 with its cache on, its boot partitions
+  published and the erase granularity of its high capacity erase group.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyDefaultCard (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_HOST_INSTANCE         *Instance;
+  EFI_BLOCK_IO_MEDIA        *Media;
+  UINT64                    IdentifyUs;
+
+  Test = Context;
+  Instance = Test->Instance;
+  Media = Instance->BlockIo.Media;
+
+  UT_ASSERT_TRUE (Media->MediaPresent);
+  UT_ASSERT_FALSE (Media->ReadOnly);
+  UT_ASSERT_EQUAL (Media->BlockSize, 512);
+  UT_ASSERT_EQUAL (Media->LastBlock, MMC_SIM_IMAGE_BLOCKS - 1);
+  UT_ASSERT_NOT_NULL (SimGetProtocol (Instance->MmcHandle, &gEfiBlockIo2ProtocolGuid));
+  UT_ASSERT_NOT_NULL (SimGetProtocol (Instance->MmcHandle, &gEfiEraseBlockProtocolGuid));
+
+  UT_ASSERT_EQUAL (Test->Sim->TimingMode, EMMCHS400DDR1V8);
+  UT_ASSERT_EQUAL (Test->Sim->BusClock, 200000000);
+  UT_ASSERT_EQUAL (Test->Sim->BusWidth, 8);
+  UT_ASSERT_EQUAL (Test->Sim->ExtCsd.HS_TIMING, 3);
+  UT_ASSERT_EQUAL (Test->Sim->ExtCsd.CACHE_CTRL, 1);
+  UT_ASSERT_TRUE (Media->WriteCaching);
+
+  UT_ASSERT_NOT_NULL (Instance->Partitions[0]);
+  UT_ASSERT_NOT_NULL (Instance->Partitions[1]);
+  UT_ASSERT_EQUAL (Instance->Partitions[0]->Media.LastBlock, 4 * (SIZE_128KB / 512) - 1);
+  UT_ASSERT_EQUAL (Instance->EraseBlock.EraseLengthGranularity, SIZE_512KB / 512);
+
+  // Dominated by the power-up of the card, polled once per timer tick
+  IdentifyUs = DivU64x32 (GetTimeInNanoSecond (Instance->Stats.IdentifyTicks), 1000);
+  UT_LOG_INFO ("BENCH identify_us=%ld commands=%ld\n", IdentifyUs, MmcSimCommandCount (Test->Sim));
+  UT_ASSERT_TRUE (IdentifyUs >= Test->Sim->PowerUpUs);
+  UT_ASSERT_TRUE (IdentifyUs < Test->Sim->PowerUpUs + 10000);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureByteMode (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->SectorAddressing = FALSE;
+}
+
+/**
+  A card of 2GB or less is byte addressed, the data commands carry the
+  offset of the block.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyByteMode (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_HOST_INSTANCE         *Instance;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+  UINTN                     Entry;
+
+  Test = Context;
+  Instance = Test->Instance;
+  MmcSimResetCounters (Test->Sim);
+
+  Status = Instance->BlockIo.ReadBlocks (&Instance->BlockIo, Instance->BlockIo.Media->MediaId,
+                                          IDENTIFY_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, IDENTIFY_TEST_LBA, sizeof (Buffer) / 512, 0));
+
+  Entry = MmcSimFindCommand (Test->Sim, 18, 0);
+  if (Entry == MAX_UINTN) {
+    Entry = MmcSimFindCommand (Test->Sim, 17, 0);
+  }
+  UT_ASSERT_NOT_EQUAL (Entry, MAX_UINTN);
+  UT_ASSERT_EQUAL (Test->Sim->Log[Entry].Argument, IDENTIFY_TEST_LBA * 512);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureWriteProtected (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->PermWriteProtect = TRUE;
+}
+
+/**
+  A permanently write protected card is published read-only and never sees
+  a write command.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyWriteProtected (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_HOST_INSTANCE         *Instance;
+  UINT8                     Buffer[512];
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Instance = Test->Instance;
+  UT_ASSERT_TRUE (Instance->BlockIo.Media->ReadOnly);
+
+  MmcSimResetCounters (Test->Sim);
+  ZeroMem (Buffer, sizeof (Buffer));
+  Status = Instance->BlockIo.WriteBlocks (&Instance->BlockIo, Instance->BlockIo.Media->MediaId,
+                                           IDENTIFY_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_STATUS_EQUAL (Status, EFI_WRITE_PROTECTED);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[24] + Test->Sim->Commands[25], 0);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureNoHs200 (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->TimingModes = EMMCHS26 | EMMCHS52 | EMMCHS52DDR1V8;
+}
+
+/**
+  A host without HS200 leaves the card in DDR52 on an 8 bit bus, with the
+  card and the host agreeing on the timing.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyNoHs200 (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_HOST_INSTANCE         *Instance;
+  UINT8                     Buffer[SIZE_4KB];
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Instance = Test->Instance;
+  UT_ASSERT_EQUAL (Test->Sim->TimingMode, EMMCHS52DDR1V8);
+  UT_ASSERT_EQUAL (Test->Sim->BusClock, 52000000);
+  UT_ASSERT_EQUAL (Test->Sim->ExtCsd.HS_TIMING, 1);
+  UT_ASSERT_EQUAL (Test->Sim->ExtCsd.BUS_WIDTH, 6);
+
+  Status = Instance->BlockIo.ReadBlocks (&Instance->BlockIo, Instance->BlockIo.Media->MediaId,
+                                          IDENTIFY_TEST_LBA, sizeof (Buffer), Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, IDENTIFY_TEST_LBA, sizeof (Buffer) / 512, 0));
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureRev5 (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->Ecsd.EXT_CSD_REV = 5;
+}
+
+/**
+  The cache only exists from eMMC 4.5, the driver must not try to turn it
+  on for an older card.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyNoCache (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINTN                     Entry;
+
+  Test = Context;
+  UT_ASSERT_EQUAL (Test->Sim->ExtCsd.CACHE_CTRL, 0);
+  UT_ASSERT_FALSE (Test->Instance->BlockIo.Media->WriteCaching);
+  for (Entry = MmcSimFindCommand (Test->Sim, 6, 0); Entry != MAX_UINTN;
+       Entry = MmcSimFindCommand (Test->Sim, 6, Entry + 1)) {
+    UT_ASSERT_NOT_EQUAL ((Test->Sim->Log[Entry].Argument >> 16) & 0xFF, OFFSET_OF (ECSD, CACHE_CTRL));
+  }
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureSlowPowerUp (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->PowerUpUs = 2000000;
+}
+
+/**
+  A card that stays busy in power-up fails the identification once the
+  retries run out, and nothing is published for it.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IdentifyPowerUpTimeout (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  MMC_HOST_INSTANCE         *Instance;
+
+  Test = Context;
+  Instance = Test->Instance;
+  UT_ASSERT_EQUAL (Instance->IdentifyStep, MmcIdentifyFailed);
+  UT_ASSERT_FALSE (Instance->BlockIo.Media->MediaPresent);
+  UT_ASSERT_FALSE (Instance->BlockIoInstalled);
+  UT_ASSERT_TRUE (SimGetProtocol (Instance->MmcHandle, &gEfiBlockIoProtocolGuid) == NULL);
+  UT_ASSERT_TRUE (Test->Sim->Commands[1] >= 1000);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[2], 0);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC MMC_TEST_CONTEXT  mIdentifyDefault  = { NULL,                    FALSE };
+STATIC MMC_TEST_CONTEXT  mIdentifyByte     = { ConfigureByteMode,       FALSE };
+STATIC MMC_TEST_CONTEXT  mIdentifyWp       = { ConfigureWriteProtected, FALSE };
+STATIC MMC_TEST_CONTEXT  mIdentifyNoHs200  = { ConfigureNoHs200,        FALSE };
+STATIC MMC_TEST_CONTEXT  mIdentifyRev5     = { ConfigureRev5,           FALSE };
+STATIC MMC_TEST_CONTEXT  mIdentifySlow     = { ConfigureSlowPowerUp,    TRUE  };
+
+EFI_STATUS
+MmcIdentifyTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Card identification", "MmcDxe.Identify", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Default card in HS400 with cache and boot partitions", "Default",
+    IdentifyDefaultCard, MmcTestStart, MmcTestStop, &mIdentifyDefault);
+  AddTestCase (Suite, "Byte addressed card", "ByteMode",
+    IdentifyByteMode, MmcTestStart, MmcTestStop, &mIdentifyByte);
+  AddTestCase (Suite, "Permanently write protected card", "WriteProtected",
+    IdentifyWriteProtected, MmcTestStart, MmcTestStop, &mIdentifyWp);
+  AddTestCase (Suite, "Host without HS200 falls back to DDR52", "NoHs200",
+    IdentifyNoHs200, MmcTestStart, MmcTestStop, &mIdentifyNoHs200);
+  AddTestCase (Suite, "No cache before EXT_CSD revision 6", "NoCache",
+    IdentifyNoCache, MmcTestStart, MmcTestStop, &mIdentifyRev5);
+  AddTestCase (Suite, "Card stuck in power-up", "PowerUpTimeout",
+    IdentifyPowerUpTimeout, MmcTestStart, MmcTestStop, &mIdentifySlow);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,460 @@
+/** @file
+  Commands the driver sends per data transfer
+
+  With CMD23 a multi-block transfer is CMD23 and one CMD18 or CMD25, with no
+  CMD12 and no CMD13 ahead of it. The cases check the command sequence on
+  the simulated card and report the commands per MB for a range of request
+  sizes.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include "MmcDxeHostTest.h"
+
+#define TRANSFER_TEST_LBA         0x8000
+#define TRANSFER_TEST_SIZE        SIZE_8MB
+
+/**
+  Move Size bytes from Lba with a single BlockIo request, after a read that
+  leaves the card in the transfer state, so that only the commands of the
+  request itself are counted.
+**/
+STATIC
+EFI_STATUS
+TransferTestIo (
+  IN     MMC_TEST_CONTEXT   *Test,
+  IN     BOOLEAN            Write,
+  IN     EFI_LBA            Lba,
+  IN     UINTN              Size,
+  IN OUT VOID               *Buffer
+  )
+{
+  EFI_BLOCK_IO_PROTOCOL     *BlockIo;
+  EFI_STATUS                Status;
+  VOID                      *Scratch;
+
+  BlockIo = &Test->Instance->BlockIo;
+  if (!Test->Instance->TransferReady) {
+    Scratch = AllocatePool (SIZE_512KB);
+    if (Scratch == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Status = BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, 0, SIZE_512KB, Scratch);
+    FreePool (Scratch);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  MmcSimResetCounters (Test->Sim);
+  if (Write) {
+    return BlockIo->WriteBlocks (BlockIo, BlockIo->Media->MediaId, Lba, Size, Buffer);
+  }
+  return BlockIo->ReadBlocks (BlockIo, BlockIo->Media->MediaId, Lba, Size, Buffer);
+}
+
+STATIC
+UINT32
+TransferTestArgument (
+  IN MMC_SIM                *Sim,
+  IN EFI_LBA                Lba
+  )
+{
+  return (UINT32)(Sim->SectorAddressing ? Lba : Lba * 512);
+}
+
+/**
+  Check that the log holds Count pairs of CMD23 and Cmd covering Blocks
+  blocks from Lba, split at MaxBlocks.
+**/
+STATIC
+UNIT_TEST_STATUS
+TransferTestCheckPairs (
+  IN MMC_SIM                *Sim,
+  IN UINT32                 Cmd,
+  IN EFI_LBA                Lba,
+  IN UINTN                  Blocks,
+  IN UINTN                  MaxBlocks
+  )
+{
+  UINTN                     Entry;
+  UINTN                     Count;
+
+  for (Entry = 0; Blocks > 0; Entry += 2, Lba += Count, Blocks -= Count) {
+    Count = MIN (Blocks, MaxBlocks);
+    UT_ASSERT_TRUE (Entry + 1 < Sim->LogCount);
+    UT_ASSERT_EQUAL (Sim->Log[Entry].Index, 23);
+    UT_ASSERT_EQUAL (Sim->Log[Entry].Argument, Count);
+    UT_ASSERT_EQUAL (Sim->Log[Entry + 1].Index, Cmd);
+    UT_ASSERT_EQUAL (Sim->Log[Entry + 1].Argument, TransferTestArgument (Sim, Lba));
+  }
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A 512KB read is CMD23 and CMD18, nothing else.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferReadSetBlockCount (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+
+  Test = Context;
+  Buffer = AllocatePool (SIZE_512KB);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = TransferTestIo (Test, FALSE, TRANSFER_TEST_LBA, SIZE_512KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, SIZE_512KB / 512, 0));
+  FreePool (Buffer);
+
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 2);
+  Result = TransferTestCheckPairs (Test->Sim, 18, TRANSFER_TEST_LBA, SIZE_512KB / 512, SIZE_512KB / 512);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_TRUE (Test->Instance->TransferReady);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A 512KB write is CMD23 and CMD25, then the CMD13 that finds the card
+  back in the transfer state after the busy wait.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferWriteSetBlockCount (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+
+  Test = Context;
+  Buffer = AllocatePool (SIZE_512KB);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  MmcSimFillPattern (TRANSFER_TEST_LBA, SIZE_512KB / 512, 1, Buffer);
+  Status = TransferTestIo (Test, TRUE, TRANSFER_TEST_LBA, SIZE_512KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 3);
+  Result = TransferTestCheckPairs (Test->Sim, 25, TRANSFER_TEST_LBA, SIZE_512KB / 512, SIZE_512KB / 512);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (Test->Sim->Log[2].Index, 13);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[12], 0);
+
+  UT_ASSERT_TRUE (MmcSimReadImage (TRANSFER_TEST_LBA, SIZE_512KB / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, SIZE_512KB / 512, 1));
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A request larger than the host moves at once is split at MaxBlockCount,
+  one CMD23 and CMD18 pair per piece.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferSplitAtMaxBlockCount (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  UINTN                     Blocks;
+
+  Test = Context;
+  Blocks = SIZE_4MB / 512 + 8;
+  Buffer = AllocatePool (Blocks * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = TransferTestIo (Test, FALSE, TRANSFER_TEST_LBA, Blocks * 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, Blocks, 0));
+  FreePool (Buffer);
+
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 2 * 9);
+  Result = TransferTestCheckPairs (Test->Sim, 18, TRANSFER_TEST_LBA, Blocks, Test->Sim->HostExt.MaxBlockCount);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A request one block longer than the host moves at once ends in a single
+  block, read with CMD17: CMD18 would need a CMD23 or CMD12 the driver does
+  not send for one block, and leave the card in the data state.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferSingleBlockTail (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  UINTN                     Blocks;
+
+  Test = Context;
+  Blocks = Test->Sim->HostExt.MaxBlockCount + 1;
+  Buffer = AllocatePool (Blocks * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = TransferTestIo (Test, FALSE, TRANSFER_TEST_LBA, Blocks * 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, Blocks, 0));
+
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 3);
+  Result = TransferTestCheckPairs (Test->Sim, 18, TRANSFER_TEST_LBA, Blocks - 1, Blocks - 1);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  UT_ASSERT_EQUAL (Test->Sim->Log[2].Index, 17);
+  UT_ASSERT_EQUAL (Test->Sim->Log[2].Argument, TransferTestArgument (Test->Sim, TRANSFER_TEST_LBA + Blocks - 1));
+  UT_ASSERT_EQUAL (Test->Sim->State, MmcSimTransfer);
+
+  // The card takes the next command
+  Status = Test->Instance->BlockIo.ReadBlocks (&Test->Instance->BlockIo, Test->Instance->BlockIo.Media->MediaId,
+                                     TRANSFER_TEST_LBA, 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The same for a write, split where CMD23 can no longer count it: the last
+  block is written with CMD24.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferSingleBlockTailWrite (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UINTN                     Blocks;
+
+  Test = Context;
+  Blocks = MMC_CMD23_MAX_BLOCK_COUNT + 1;
+  Buffer = AllocatePool (Blocks * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  MmcSimFillPattern (0, Blocks, 3, Buffer);
+  Status = TransferTestIo (Test, TRUE, 0, Blocks * 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[23], 1);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[25], 1);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[24], 1);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[12], 0);
+
+  UT_ASSERT_TRUE (MmcSimReadImage (0, Blocks, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, 0, Blocks, 3));
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureUnlimited (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->HostExt.MaxBlockCount = 0;
+}
+
+/**
+  Without a host limit a request is only split where the block count no
+  longer fits the CMD23 argument.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferSplitAtCmd23Limit (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UNIT_TEST_STATUS          Result;
+  UINTN                     Blocks;
+
+  Test = Context;
+  Blocks = SIZE_32MB / 512 + 1024;
+  Buffer = AllocatePool (Blocks * 512);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = TransferTestIo (Test, FALSE, 0, Blocks * 512, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, 0, Blocks, 0));
+  FreePool (Buffer);
+
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 4);
+  Result = TransferTestCheckPairs (Test->Sim, 18, 0, Blocks, MMC_CMD23_MAX_BLOCK_COUNT);
+  UT_ASSERT_EQUAL (Result, UNIT_TEST_PASSED);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC
+VOID
+ConfigureOpenEnded (
+  IN OUT MMC_SIM            *Sim
+  )
+{
+  Sim->HostExt.Capabilities &= ~MMC_HOST_EXT_CAP_SET_BLOCK_COUNT;
+}
+
+/**
+  A host without CMD23 support stops every multi-block transfer with CMD12.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferOpenEnded (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+
+  Test = Context;
+  Buffer = AllocatePool (SIZE_512KB);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  Status = TransferTestIo (Test, FALSE, TRANSFER_TEST_LBA, SIZE_512KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, SIZE_512KB / 512, 0));
+  UT_ASSERT_EQUAL (Test->Sim->LogCount, 2);
+  UT_ASSERT_EQUAL (Test->Sim->Log[0].Index, 18);
+  UT_ASSERT_EQUAL (Test->Sim->Log[0].Argument, TransferTestArgument (Test->Sim, TRANSFER_TEST_LBA));
+  UT_ASSERT_EQUAL (Test->Sim->Log[1].Index, 12);
+
+  MmcSimFillPattern (TRANSFER_TEST_LBA, SIZE_512KB / 512, 2, Buffer);
+  Status = TransferTestIo (Test, TRUE, TRANSFER_TEST_LBA, SIZE_512KB, Buffer);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Test->Sim->Commands[23], 0);
+  UT_ASSERT_EQUAL (Test->Sim->Log[0].Index, 25);
+  UT_ASSERT_EQUAL (Test->Sim->Log[1].Index, 12);
+
+  UT_ASSERT_TRUE (MmcSimReadImage (TRANSFER_TEST_LBA, SIZE_512KB / 512, Buffer));
+  UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, SIZE_512KB / 512, 2));
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Read TRANSFER_TEST_SIZE in requests from 128KB to 8MB and report the
+  commands per MB. Every request that fits the host is one data command,
+  plus CMD23 or CMD12.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TransferCommandsPerMb (
+  IN UNIT_TEST_CONTEXT      Context
+  )
+{
+  MMC_TEST_CONTEXT          *Test;
+  UINT8                     *Buffer;
+  EFI_STATUS                Status;
+  UINTN                     RequestSize;
+  UINTN                     Offset;
+  UINTN                     Pieces;
+  UINTN                     MaxSize;
+  UINT64                    Commands;
+
+  Test = Context;
+  Buffer = AllocatePool (TRANSFER_TEST_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+
+  MaxSize = TRANSFER_TEST_SIZE;
+  if (Test->Sim->HostExt.MaxBlockCount != 0) {
+    MaxSize = MIN (MaxSize, Test->Sim->HostExt.MaxBlockCount * 512);
+  }
+  for (RequestSize = SIZE_128KB; RequestSize <= TRANSFER_TEST_SIZE; RequestSize *= 4) {
+    Status = TransferTestIo (Test, FALSE, TRANSFER_TEST_LBA, RequestSize, Buffer);
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    for (Offset = RequestSize; Offset < TRANSFER_TEST_SIZE; Offset += RequestSize) {
+      Status = Test->Instance->BlockIo.ReadBlocks (&Test->Instance->BlockIo, Test->Instance->BlockIo.Media->MediaId,
+                                         TRANSFER_TEST_LBA + Offset / 512, RequestSize, Buffer + Offset);
+      UT_ASSERT_NOT_EFI_ERROR (Status);
+    }
+    UT_ASSERT_TRUE (MmcTestCheckPattern (Buffer, TRANSFER_TEST_LBA, TRANSFER_TEST_SIZE / 512, 0));
+
+    Commands = MmcSimCommandCount (Test->Sim);
+    Pieces = (TRANSFER_TEST_SIZE / RequestSize) * ((RequestSize + MaxSize - 1) / MaxSize);
+    UT_LOG_INFO ("BENCH transfer request_kb=%d commands=%ld commands_per_mb=%ld.%02ld\n",
+      (UINT32)(RequestSize / SIZE_1KB), Commands, Commands / (TRANSFER_TEST_SIZE / SIZE_1MB),
+      (Commands * 100 / (TRANSFER_TEST_SIZE / SIZE_1MB)) % 100);
+    UT_ASSERT_EQUAL (Commands, 2 * Pieces);
+    UT_ASSERT_EQUAL (Test->Sim->Commands[13], 0);
+  }
+
+  FreePool (Buffer);
+  return UNIT_TEST_PASSED;
+}
+
+STATIC MMC_TEST_CONTEXT  mTransferDefault    = { NULL,               FALSE };
+STATIC MMC_TEST_CONTEXT  mTransferUnlimited  = { ConfigureUnlimited, FALSE };
+STATIC MMC_TEST_CONTEXT  mTransferOpenEnded  = { ConfigureOpenEnded, FALSE };
+
+EFI_STATUS
+MmcTransferTestAddSuite (
+  IN UNIT_TEST_FRAMEWORK_HANDLE Framework
+  )
+{
+  EFI_STATUS                Status;
+  UNIT_TEST_SUITE_HANDLE    Suite;
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "Multi-block transfers", "MmcDxe.Transfer", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AddTestCase (Suite, "Read with CMD23", "ReadSetBlockCount",
+    TransferReadSetBlockCount, MmcTestStart, MmcTestStop, &mTransferDefault);
+  AddTestCase (Suite, "Write with CMD23", "WriteSetBlockCount",
+    TransferWriteSetBlockCount, MmcTestStart, MmcTestStop, &mTransferDefault);
+  AddTestCase (Suite, "Split at the host MaxBlockCount", "SplitAtMaxBlockCount",
+    TransferSplitAtMaxBlockCount, MmcTestStart, MmcTestStop, &mTransferDefault);
+  AddTestCase (Suite, "Split at the CMD23 block count limit", "SplitAtCmd23Limit",
+    TransferSplitAtCmd23Limit, MmcTestStart, MmcTestStop, &mTransferUnlimited);
+  AddTestCase (Suite, "Single block after a split at MaxBlockCount", "SingleBlockTail",
+    TransferSingleBlockTail, MmcTestStart, MmcTestStop, &mTransferDefault);
+  AddTestCase (Suite, "Single block after a split at the CMD23 limit", "SingleBlockTailWrite",
+    TransferSingleBlockTailWrite, MmcTestStart, MmcTestStop, &mTransferUnlimited);
+  AddTestCase (Suite, "Open-ended transfers stopped by CMD12", "OpenEnded",
+    TransferOpenEnded, MmcTestStart, MmcTestStop, &mTransferOpenEnded);
+  AddTestCase (Suite, "Commands per MB with CMD23", "CommandsPerMb",
+    TransferCommandsPerMb, MmcTestStart, MmcTestStop, &mTransferUnlimited);
+  AddTestCase (Suite, "Commands per MB without CMD23", "CommandsPerMbOpenEnded",
+    TransferCommandsPerMb, MmcTestStart, MmcTestStop, &mTransferOpenEnded);
+  return EFI_SUCCESS;
+}
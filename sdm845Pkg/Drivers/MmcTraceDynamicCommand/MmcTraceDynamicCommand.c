@@ -0,0 +1,225 @@
+/** @file
+  Shell command printing the MMC command trace
+
+  mmctrace lists the commands recorded by every MMC_TRACE_PROTOCOL instance,
+  with their start time relative to the oldest entry and their duration.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+
+#include <Protocol/DevicePath.h>
+#include <Protocol/MmcTrace.h>
+#include <Protocol/ShellDynamicCommand.h>
+#include <Protocol/ShellParameters.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+STATIC CONST CHAR16 mMmcTraceHelp[] =
+  L".TH mmctrace 0 \"Print the MMC command trace.\"\r\n"
+  L".SH NAME\r\n"
+  L"Print the commands recorded by the MMC driver.\r\n"
+  L".SH SYNOPSIS\r\n"
+  L"mmctrace [-n count] [-r]\r\n"
+  L".SH OPTIONS\r\n"
+  L"  -n count  Only print the last count commands of every card.\r\n"
+  L"  -r        Clear the trace once it is printed.\r\n"
+  L".SH DESCRIPTION\r\n"
+  L"Every line gives the start of the command relative to the oldest one\r\n"
+  L"and its duration in microseconds, the command index, its argument, the\r\n"
+  L"first block, the bytes moved (blocks for an erase), the eMMC hardware\r\n"
+  L"partition and the status.\r\n";
+
+STATIC
+UINT64
+MmcTraceTicksToUs (
+  IN MMC_TRACE_PROTOCOL     *Trace,
+  IN UINT64                 Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000), Trace->Frequency, NULL);
+}
+
+STATIC
+VOID
+MmcTracePrint (
+  IN EFI_HANDLE             Handle,
+  IN MMC_TRACE_PROTOCOL     *Trace,
+  IN UINTN                  MaxCount,
+  IN BOOLEAN                Reset
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  MMC_TRACE_ENTRY           *Entries;
+  MMC_TRACE_ENTRY           *Entry;
+  CHAR16                    *Text;
+  EFI_STATUS                Status;
+  UINT64                    Recorded;
+  UINT64                    BusyUs;
+  UINT64                    Bytes;
+  UINTN                     Count;
+  UINTN                     Index;
+
+  Text = NULL;
+  DevicePath = DevicePathFromHandle (Handle);
+  if (DevicePath != NULL) {
+    Text = ConvertDevicePathToText (DevicePath, TRUE, TRUE);
+  }
+  Print (L"%s\n", (Text != NULL) ? Text : L"MMC");
+  if (Text != NULL) {
+    FreePool (Text);
+  }
+
+  Entries = AllocatePool (Trace->Capacity * sizeof (MMC_TRACE_ENTRY));
+  if (Entries == NULL) {
+    Print (L"  Out of resources\n");
+    return;
+  }
+
+  Count = MIN (MaxCount, Trace->Capacity);
+  Status = Trace->GetEntries (Trace, &Count, Entries, &Recorded);
+  if (EFI_ERROR (Status)) {
+    Print (L"  Failed to read the trace: %r\n", Status);
+    FreePool (Entries);
+    return;
+  }
+
+  Print (L"  %ld commands recorded, last %d shown\n", Recorded, Count);
+  if (Count != 0) {
+    Print (L"     Start(us)   Time(us) Cmd  Argument          Lba     Length Part Status\n");
+  }
+
+  BusyUs = 0;
+  Bytes = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Entry = &Entries[Index];
+    Print (L"  %12ld %10ld %3d  %08x %12ld %10d %4d %r\n",
+      MmcTraceTicksToUs (Trace, Entry->StartTicks - Entries[0].StartTicks),
+      MmcTraceTicksToUs (Trace, Entry->EndTicks - Entry->StartTicks),
+      Entry->Command,
+      Entry->Argument,
+      Entry->Lba,
+      Entry->Length,
+      Entry->Partition,
+      Entry->Status);
+    BusyUs += MmcTraceTicksToUs (Trace, Entry->EndTicks - Entry->StartTicks);
+    if ((Entry->Command != 6) && (Entry->Command != 38)) {
+      Bytes += Entry->Length;
+    }
+  }
+
+  if (Count != 0) {
+    Print (L"  %ldKB moved, card busy for %ldus\n", DivU64x32 (Bytes, SIZE_1KB), BusyUs);
+  }
+
+  if (Reset) {
+    Trace->Reset (Trace);
+  }
+  FreePool (Entries);
+}
+
+STATIC
+SHELL_STATUS
+EFIAPI
+MmcTraceCommandHandler (
+  IN EFI_SHELL_DYNAMIC_COMMAND_PROTOCOL    *This,
+  IN EFI_SYSTEM_TABLE                      *SystemTable,
+  IN EFI_SHELL_PARAMETERS_PROTOCOL         *ShellParameters,
+  IN EFI_SHELL_PROTOCOL                    *Shell
+  )
+{
+  MMC_TRACE_PROTOCOL      *Trace;
+  EFI_HANDLE              *Handles;
+  EFI_STATUS              Status;
+  UINTN                   HandleCount;
+  UINTN                   MaxCount;
+  UINTN                   Index;
+  BOOLEAN                 Reset;
+
+  MaxCount = MAX_UINTN;
+  Reset = FALSE;
+  for (Index = 1; Index < ShellParameters->Argc; Index++) {
+    if (StrCmp (ShellParameters->Argv[Index], L"-r") == 0) {
+      Reset = TRUE;
+    } else if ((StrCmp (ShellParameters->Argv[Index], L"-n") == 0) &&
+               (Index + 1 < ShellParameters->Argc)) {
+      MaxCount = StrDecimalToUintn (ShellParameters->Argv[++Index]);
+    } else {
+      Print (L"mmctrace: Invalid argument - '%s'\n", ShellParameters->Argv[Index]);
+      return SHELL_INVALID_PARAMETER;
+    }
+  }
+
+  Status = gBS->LocateHandleBuffer (ByProtocol, &gMmcTraceProtocolGuid, NULL, &HandleCount, &Handles);
+  if (EFI_ERROR (Status)) {
+    Print (L"mmctrace: No MMC trace, is PcdMmcTraceEnable set?\n");
+    return SHELL_NOT_FOUND;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (Handles[Index], &gMmcTraceProtocolGuid, (VOID **)&Trace);
+    if (!EFI_ERROR (Status)) {
+      MmcTracePrint (Handles[Index], Trace, MaxCount, Reset);
+    }
+  }
+
+  FreePool (Handles);
+  return SHELL_SUCCESS;
+}
+
+STATIC
+CHAR16 *
+EFIAPI
+MmcTraceCommandGetHelp (
+  IN EFI_SHELL_DYNAMIC_COMMAND_PROTOCOL    *This,
+  IN CONST CHAR8                           *Language
+  )
+{
+  return AllocateCopyPool (sizeof (mMmcTraceHelp), mMmcTraceHelp);
+}
+
+STATIC EFI_SHELL_DYNAMIC_COMMAND_PROTOCOL mMmcTraceDynamicCommand = {
+  L"mmctrace",
+  MmcTraceCommandHandler,
+  MmcTraceCommandGetHelp
+};
+
+EFI_STATUS
+EFIAPI
+MmcTraceCommandInitialize (
+  IN EFI_HANDLE         ImageHandle,
+  IN EFI_SYSTEM_TABLE   *SystemTable
+  )
+{
+  return gBS->InstallMultipleProtocolInterfaces (
+                &ImageHandle,
+                &gEfiShellDynamicCommandProtocolGuid,&mMmcTraceDynamicCommand,
+                NULL
+                );
+}
+
+EFI_STATUS
+EFIAPI
+MmcTraceCommandUnload (
+  IN EFI_HANDLE         ImageHandle
+  )
+{
+  return gBS->UninstallMultipleProtocolInterfaces (
+                ImageHandle,
+                &gEfiShellDynamicCommandProtocolGuid,&mMmcTraceDynamicCommand,
+                NULL
+                );
+}
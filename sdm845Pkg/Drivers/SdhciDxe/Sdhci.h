@@ -0,0 +1,170 @@
+/** @file
+*
+*  Register definitions of the SD Host Controller Interface 3.0 and of the
+*  RK3399 eMMC PHY that sits in front of the Arasan SDHCI 5.1 core.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+
+#ifndef __SDHCI_H__
+#define __SDHCI_H__
+
+// SDHCI registers, offsets from the base of the controller
+#define SDHCI_SDMA_ADDRESS                      0x000
+#define SDHCI_BLOCK_SIZE                        0x004
+#define SDHCI_BLOCK_COUNT                       0x006
+#define SDHCI_ARGUMENT                          0x008
+#define SDHCI_TRANSFER_MODE                     0x00c
+#define SDHCI_COMMAND                           0x00e
+#define SDHCI_RESPONSE0                         0x010
+#define SDHCI_RESPONSE1                         0x014
+#define SDHCI_RESPONSE2                         0x018
+#define SDHCI_RESPONSE3                         0x01c
+#define SDHCI_BUFFER                            0x020
+#define SDHCI_PRESENT_STATE                     0x024
+#define SDHCI_HOST_CONTROL                      0x028
+#define SDHCI_POWER_CONTROL                     0x029
+#define SDHCI_CLOCK_CONTROL                     0x02c
+#define SDHCI_TIMEOUT_CONTROL                   0x02e
+#define SDHCI_SOFTWARE_RESET                    0x02f
+#define SDHCI_INT_STATUS                        0x030
+#define SDHCI_INT_ENABLE                        0x034
+#define SDHCI_SIGNAL_ENABLE                     0x038
+#define SDHCI_HOST_CONTROL2                     0x03e
+#define SDHCI_CAPABILITIES                      0x040
+#define SDHCI_CAPABILITIES1                     0x044
+#define SDHCI_ADMA_ERROR                        0x054
+#define SDHCI_ADMA_ADDRESS                      0x058
+#define SDHCI_HOST_VERSION                      0x0fe
+
+/* bits in TRANSFER_MODE */
+#define SDHCI_TRNS_DMA                          (1 << 0)
+#define SDHCI_TRNS_BLK_CNT_EN                   (1 << 1)
+#define SDHCI_TRNS_READ                         (1 << 4)
+#define SDHCI_TRNS_MULTI                        (1 << 5)
+
+/* bits in COMMAND */
+#define SDHCI_CMD_RESP_NONE                     (0 << 0)
+#define SDHCI_CMD_RESP_136                      (1 << 0)
+#define SDHCI_CMD_RESP_48                       (2 << 0)
+#define SDHCI_CMD_RESP_48_BUSY                  (3 << 0)
+#define SDHCI_CMD_RESP_MASK                     (3 << 0)
+#define SDHCI_CMD_CRC                           (1 << 3)
+#define SDHCI_CMD_INDEX                         (1 << 4)
+#define SDHCI_CMD_DATA                          (1 << 5)
+#define SDHCI_CMD_ABORT                         (3 << 6)
+#define SDHCI_MAKE_CMD(Index, Flags)            ((((Index) & 0x3f) << 8) | (Flags))
+
+/* bits in PRESENT_STATE */
+#define SDHCI_CMD_INHIBIT                       (1 << 0)
+#define SDHCI_DATA_INHIBIT                      (1 << 1)
+#define SDHCI_DAT0_LEVEL                        (1 << 20)
+
+/* bits in HOST_CONTROL */
+#define SDHCI_CTRL_4BITBUS                      (1 << 1)
+#define SDHCI_CTRL_HISPD                        (1 << 2)
+#define SDHCI_CTRL_ADMA32                       (2 << 3)
+#define SDHCI_CTRL_DMA_MASK                     (3 << 3)
+#define SDHCI_CTRL_8BITBUS                      (1 << 5)
+
+/* bits in POWER_CONTROL */
+#define SDHCI_POWER_ON                          (1 << 0)
+#define SDHCI_POWER_180                         (5 << 1)
+#define SDHCI_POWER_330                         (7 << 1)
+
+/* bits in CLOCK_CONTROL */
+#define SDHCI_CLOCK_INT_EN                      (1 << 0)
+#define SDHCI_CLOCK_INT_STABLE                  (1 << 1)
+#define SDHCI_CLOCK_CARD_EN                     (1 << 2)
+#define SDHCI_CLOCK_DIVIDER(x)                  ((((x) & 0xff) << 8) | ((((x) >> 8) & 0x3) << 6))
+#define SDHCI_MAX_DIVIDER                       1023
+
+/* bits in SOFTWARE_RESET */
+#define SDHCI_RESET_ALL                         (1 << 0)
+#define SDHCI_RESET_CMD                         (1 << 1)
+#define SDHCI_RESET_DATA                        (1 << 2)
+
+/* bits in INT_STATUS */
+#define SDHCI_INT_CMD_COMPLETE                  (1 << 0)
+#define SDHCI_INT_XFER_COMPLETE                 (1 << 1)
+#define SDHCI_INT_DMA                           (1 << 3)
+#define SDHCI_INT_BUF_WR_READY                  (1 << 4)
+#define SDHCI_INT_BUF_RD_READY                  (1 << 5)
+#define SDHCI_INT_ERROR                         (1 << 15)
+#define SDHCI_INT_CMD_TIMEOUT                   (1 << 16)
+#define SDHCI_INT_CMD_CRC                       (1 << 17)
+#define SDHCI_INT_CMD_END_BIT                   (1 << 18)
+#define SDHCI_INT_CMD_INDEX                     (1 << 19)
+#define SDHCI_INT_DATA_TIMEOUT                  (1 << 20)
+#define SDHCI_INT_DATA_CRC                      (1 << 21)
+#define SDHCI_INT_DATA_END_BIT                  (1 << 22)
+#define SDHCI_INT_ADMA                          (1 << 25)
+#define SDHCI_INT_CMD_ERROR                     (SDHCI_INT_CMD_TIMEOUT | SDHCI_INT_CMD_CRC | \
+                                                 SDHCI_INT_CMD_END_BIT | SDHCI_INT_CMD_INDEX)
+#define SDHCI_INT_DATA_ERROR                    (SDHCI_INT_DATA_TIMEOUT | SDHCI_INT_DATA_CRC | \
+                                                 SDHCI_INT_DATA_END_BIT | SDHCI_INT_ADMA)
+#define SDHCI_INT_ERROR_MASK                    0xffff0000
+#define SDHCI_INT_ALL                           0xffffffff
+
+/* bits in HOST_CONTROL2 */
+#define SDHCI_CTRL_UHS_SDR12                    0x0
+#define SDHCI_CTRL_UHS_SDR104                   0x3
+#define SDHCI_CTRL_UHS_DDR50                    0x4
+#define SDHCI_CTRL_HS400                        0x5     /* Arasan specific */
+#define SDHCI_CTRL_UHS_MASK                     0x7
+#define SDHCI_CTRL_VDD_180                      (1 << 3)
+#define SDHCI_CTRL_EXEC_TUNING                  (1 << 6)
+#define SDHCI_CTRL_TUNED_CLK                    (1 << 7)
+
+/* bits in CAPABILITIES */
+#define SDHCI_CAN_VDD_330                       (1 << 24)
+#define SDHCI_CAN_VDD_180                       (1 << 26)
+#define SDHCI_GET_BASE_CLOCK_MHZ(x)             (((x) >> 8) & 0xff)
+
+/* ADMA2 descriptor attributes */
+#define SDHCI_ADMA2_VALID                       (1 << 0)
+#define SDHCI_ADMA2_END                         (1 << 1)
+#define SDHCI_ADMA2_INT                         (1 << 2)
+#define SDHCI_ADMA2_ACT_TRAN                    (2 << 4)
+
+//
+// Arasan core configuration and eMMC PHY, both in the GRF. The GRF registers
+// take a write mask in their upper half word.
+//
+#define SDHCI_GRF_UPDATE(Mask, Value)           (((Mask) << 16) | (Value))
+
+#define SDHCI_CORECFG_BASECLKFREQ               GRF_EMMCCORE_CON(0)
+#define SDHCI_CORECFG_BASECLKFREQ_SHIFT         8
+#define SDHCI_CORECFG_CLOCKMULTIPLIER           GRF_EMMCCORE_CON(11)
+
+#define SDHCI_PHY_CON0                          GRF_EMMCPHY_CON(0)
+#define SDHCI_PHY_OTAPDLYSEL_SHIFT              7
+#define SDHCI_PHY_OTAPDLYSEL_MASK               (0xf << 7)
+#define SDHCI_PHY_OTAPDLYENA                    (1 << 11)
+#define SDHCI_PHY_FREQSEL_SHIFT                 12
+#define SDHCI_PHY_FREQSEL_MASK                  (0x3 << 12)
+#define SDHCI_PHY_FREQSEL_200M                  0
+#define SDHCI_PHY_FREQSEL_50M                   1
+#define SDHCI_PHY_FREQSEL_100M                  2
+#define SDHCI_PHY_FREQSEL_150M                  3
+
+#define SDHCI_PHY_CON6                          GRF_EMMCPHY_CON(6)
+#define SDHCI_PHY_PDB                           (1 << 0)
+#define SDHCI_PHY_ENDLL                         (1 << 1)
+#define SDHCI_PHY_DR_TY_SHIFT                   4
+#define SDHCI_PHY_DR_TY_MASK                    (0x7 << 4)
+#define SDHCI_PHY_DR_TY_50OHM                   0
+
+#define SDHCI_PHY_STATUS                        GRF_EMMCPHY_STATUS
+#define SDHCI_PHY_DLLRDY                        (1 << 5)
+#define SDHCI_PHY_CALDONE                       (1 << 6)
+
+#endif  // __SDHCI_H__
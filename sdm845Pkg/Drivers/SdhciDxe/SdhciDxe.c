@@ -0,0 +1,1204 @@
+/** @file
+  This file implement the MMC Host Protocol for the Arasan SDHCI 5.1
+  controller that drives the eMMC of the RK3399.
+
+  Block data is moved with 32-bit ADMA2 descriptors, the eMMC PHY in the
+  GRF is powered up for every card clock above the identification rate.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DmaBounceLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/CRULib.h>
+
+#include <Protocol/MmcHost.h>
+#include <Protocol/MmcHostExt.h>
+
+#include <Rk3399/Rk3399.h>
+#include <Rk3399/Rk3399Grf.h>
+#include "Sdhci.h"
+
+#define SDHCI_DBG                       DEBUG_BLKIO
+
+#define SDHCI_DATA_BLOCK_SIZE           512
+// A 16-bit length of 0 stands for 64KB
+#define SDHCI_ADMA2_MAX_LENGTH          SIZE_64KB
+#define SDHCI_ADMA2_DESC_PAGES          1
+#define SDHCI_ADMA2_MAX_DESC            (EFI_PAGES_TO_SIZE (SDHCI_ADMA2_DESC_PAGES) / \
+                                         sizeof (SDHCI_ADMA2_DESCRIPTOR))
+// Staging area for the parts of a buffer the ADMA2 engine can not reach in place
+#define SDHCI_BOUNCE_PAGES              32
+// One data command never covers more than the block count register, nor more
+// than the descriptor table once the staged head and tail took theirs
+#define SDHCI_MAX_BLOCK_COUNT           MIN ((SDHCI_ADMA2_MAX_DESC - (DMA_BOUNCE_MAX_SEGMENTS - 1)) * \
+                                             (SDHCI_ADMA2_MAX_LENGTH / SDHCI_DATA_BLOCK_SIZE), \
+                                             MAX_UINT16)
+
+#define SDHCI_CMD_TIMEOUT_US            1000000
+#define SDHCI_BUSY_TIMEOUT_US           2000000
+#define SDHCI_RESET_TIMEOUT_US          100000
+#define SDHCI_CLOCK_TIMEOUT_US          20000
+#define SDHCI_TUNING_TIMEOUT_US         50000
+#define SDHCI_TUNING_LOOPS              40
+
+// The PHY is left off at the identification clock
+#define SDHCI_PHY_MIN_CLOCK             400000
+// The DLL is only waited for at the rates it is specified to lock at
+#define SDHCI_PHY_DLL_MIN_CLOCK         50000000
+#define SDHCI_PHY_CALDONE_TIMEOUT_US    50
+#define SDHCI_PHY_DLLRDY_TIMEOUT_US     50000
+// Output tap delay used by the vendor kernel for the RK3399 eMMC
+#define SDHCI_PHY_OTAPDLY               4
+
+#define SDHCI_HOST_SIGNATURE            SIGNATURE_32 ('s', 'd', 'h', 'c')
+
+typedef struct {
+  UINT16                        Attributes;
+  UINT16                        Length;
+  UINT32                        Address;
+} SDHCI_ADMA2_DESCRIPTOR;
+
+//
+// State of one controller. Every protocol the driver installs is embedded
+// here so that the functions can get back to their controller from This.
+//
+typedef struct {
+  UINT32                        Signature;
+  EFI_HANDLE                    Handle;
+  UINTN                         Base;
+  // Clock fed to the controller by the CRU
+  UINT32                        ClockFrequency;
+  // Clock the SDHCI divider works from, as reported by the capabilities
+  UINT32                        BaseClock;
+  UINT32                        CardClock;
+
+  EFI_MMC_HOST_PROTOCOL         MmcHost;
+  MMC_HOST_EXT_PROTOCOL         MmcHostExt;
+
+  SDHCI_ADMA2_DESCRIPTOR        *AdmaDesc;
+  // SDHCI_BOUNCE_PAGES below 4GB, the head of a transfer is staged in the
+  // first cache line and its tail in the second one
+  UINT8                         *Bounce;
+  // Data command held back until the buffer is known
+  UINT16                        Command;
+  UINT32                        Argument;
+  // The card left the identification state, CMD8 reads EXT_CSD from now on
+  BOOLEAN                       CardSelected;
+} SDHCI_HOST;
+
+#define SDHCI_HOST_FROM_MMC_HOST(a) \
+  CR (a, SDHCI_HOST, MmcHost, SDHCI_HOST_SIGNATURE)
+#define SDHCI_HOST_FROM_MMC_HOST_EXT(a) \
+  CR (a, SDHCI_HOST, MmcHostExt, SDHCI_HOST_SIGNATURE)
+
+/**
+  Convert a timeout into a performance counter value to poll against.
+
+**/
+STATIC
+UINT64
+SdhciGetDeadline (
+  IN UINT64                    TimeoutUs
+  )
+{
+  UINT64 Frequency;
+
+  Frequency = GetPerformanceCounterProperties (NULL, NULL);
+  return GetPerformanceCounter () + DivU64x32 (MultU64x64 (TimeoutUs, Frequency), 1000000);
+}
+
+BOOLEAN
+SdhciIsCardPresent (
+  IN EFI_MMC_HOST_PROTOCOL     *This
+  )
+{
+  // The eMMC is soldered down
+  return TRUE;
+}
+
+BOOLEAN
+SdhciIsReadOnly (
+  IN EFI_MMC_HOST_PROTOCOL     *This
+  )
+{
+  return FALSE;
+}
+
+EFI_STATUS
+SdhciBuildDevicePath (
+  IN EFI_MMC_HOST_PROTOCOL      *This,
+  IN EFI_DEVICE_PATH_PROTOCOL   **DevicePath
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL *NewDevicePathNode;
+  SDHCI_HOST               *Host;
+
+  Host = SDHCI_HOST_FROM_MMC_HOST (This);
+
+  NewDevicePathNode = CreateDeviceNode (HARDWARE_DEVICE_PATH, HW_VENDOR_DP,
+                        sizeof (VENDOR_DEVICE_PATH) + sizeof (UINT64));
+  if (NewDevicePathNode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CopyGuid (& ((VENDOR_DEVICE_PATH*)NewDevicePathNode)->Guid, &gEfiCallerIdGuid);
+  WriteUnaligned64 ((UINT64 *)((VENDOR_DEVICE_PATH*)NewDevicePathNode + 1), Host->Base);
+
+  *DevicePath = NewDevicePathNode;
+  return EFI_SUCCESS;
+}
+
+/**
+  Reset parts of the controller and wait for the reset to complete.
+
+  @param[in]  Host        The controller.
+  @param[in]  Mask        SDHCI_RESET_* bits to reset.
+
+**/
+STATIC
+EFI_STATUS
+SdhciReset (
+  IN SDHCI_HOST                *Host,
+  IN UINT8                     Mask
+  )
+{
+  UINT64 Deadline;
+
+  MmioWrite8 (Host->Base + SDHCI_SOFTWARE_RESET, Mask);
+  Deadline = SdhciGetDeadline (SDHCI_RESET_TIMEOUT_US);
+  while (MmioRead8 (Host->Base + SDHCI_SOFTWARE_RESET) & Mask) {
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a(): timeout, mask 0x%x\n", __func__, Mask));
+      return EFI_TIMEOUT;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Wait until the controller can take a new command.
+
+  @param[in]  Host        The controller.
+  @param[in]  WaitData    Also wait for the data lines, including a card
+                          holding DAT0 low.
+  @param[in]  TimeoutUs   How long to wait in microseconds.
+
+**/
+STATIC
+EFI_STATUS
+SdhciWaitIdle (
+  IN SDHCI_HOST                *Host,
+  IN BOOLEAN                   WaitData,
+  IN UINT64                    TimeoutUs
+  )
+{
+  UINT64 Deadline;
+  UINT32 Mask;
+
+  Mask = SDHCI_CMD_INHIBIT;
+  if (WaitData) {
+    Mask |= SDHCI_DATA_INHIBIT;
+  }
+  if (!(MmioRead32 (Host->Base + SDHCI_PRESENT_STATE) & Mask)) {
+    return EFI_SUCCESS;
+  }
+
+  Deadline = SdhciGetDeadline (TimeoutUs);
+  do {
+    if (!(MmioRead32 (Host->Base + SDHCI_PRESENT_STATE) & Mask)) {
+      return EFI_SUCCESS;
+    }
+  } while (GetPerformanceCounter () < Deadline);
+
+  DEBUG ((DEBUG_ERROR, "%a(): timeout, SDHCI_PRESENT_STATE=0x%x\n",
+    __func__, MmioRead32 (Host->Base + SDHCI_PRESENT_STATE)));
+  return EFI_TIMEOUT;
+}
+
+/**
+  Wait for any of the bits in Mask to show up in the interrupt status.
+
+  The bits found are cleared, errors are cleared and reported as well.
+
+  @param[in]  Host        The controller.
+  @param[in]  Mask        SDHCI_INT_* bits to wait for.
+  @param[in]  TimeoutUs   How long to wait in microseconds.
+  @param[out] IntStatus   The interrupt status that ended the wait.
+
+**/
+STATIC
+EFI_STATUS
+SdhciWaitInterrupt (
+  IN  SDHCI_HOST               *Host,
+  IN  UINT32                   Mask,
+  IN  UINT64                   TimeoutUs,
+  OUT UINT32                   *IntStatus OPTIONAL
+  )
+{
+  UINT64 Deadline;
+  UINT32 Data;
+
+  Deadline = SdhciGetDeadline (TimeoutUs);
+  for (;;) {
+    Data = MmioRead32 (Host->Base + SDHCI_INT_STATUS);
+    if (Data & (SDHCI_INT_ERROR | Mask)) {
+      break;
+    }
+    if (GetPerformanceCounter () >= Deadline) {
+      Data = MmioRead32 (Host->Base + SDHCI_INT_STATUS);
+      break;
+    }
+  }
+  if (IntStatus != NULL) {
+    *IntStatus = Data;
+  }
+
+  if (Data & SDHCI_INT_ERROR) {
+    MmioWrite32 (Host->Base + SDHCI_INT_STATUS, Data & SDHCI_INT_ERROR_MASK);
+    return EFI_DEVICE_ERROR;
+  }
+  if (!(Data & Mask)) {
+    return EFI_TIMEOUT;
+  }
+  MmioWrite32 (Host->Base + SDHCI_INT_STATUS, Data & Mask);
+  return EFI_SUCCESS;
+}
+
+/**
+  Bring the command and data state machines back after a failed command.
+
+**/
+STATIC
+VOID
+SdhciRecover (
+  IN SDHCI_HOST                *Host
+  )
+{
+  SdhciReset (Host, SDHCI_RESET_CMD);
+  SdhciReset (Host, SDHCI_RESET_DATA);
+  MmioWrite32 (Host->Base + SDHCI_INT_STATUS, SDHCI_INT_ALL);
+}
+
+/**
+  Power the eMMC PHY down.
+
+**/
+STATIC
+VOID
+SdhciPhyPowerOff (
+  VOID
+  )
+{
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_PDB | SDHCI_PHY_ENDLL, 0), SDHCI_PHY_CON6);
+}
+
+/**
+  Calibrate the eMMC PHY I/O pads and lock its DLL to the card clock.
+
+  @param[in]  CardClock   The card clock the PHY has to follow, in Hz.
+
+**/
+STATIC
+EFI_STATUS
+SdhciPhyPowerOn (
+  IN UINT32                    CardClock
+  )
+{
+  UINT32 FreqSel;
+  UINT64 Deadline;
+
+  if (CardClock < 75000000) {
+    FreqSel = SDHCI_PHY_FREQSEL_50M;
+  } else if (CardClock < 125000000) {
+    FreqSel = SDHCI_PHY_FREQSEL_100M;
+  } else if (CardClock < 175000000) {
+    FreqSel = SDHCI_PHY_FREQSEL_150M;
+  } else {
+    FreqSel = SDHCI_PHY_FREQSEL_200M;
+  }
+
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_PDB | SDHCI_PHY_ENDLL, 0), SDHCI_PHY_CON6);
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_DR_TY_MASK,
+               SDHCI_PHY_DR_TY_50OHM << SDHCI_PHY_DR_TY_SHIFT), SDHCI_PHY_CON6);
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_FREQSEL_MASK | SDHCI_PHY_OTAPDLYENA | SDHCI_PHY_OTAPDLYSEL_MASK,
+               (FreqSel << SDHCI_PHY_FREQSEL_SHIFT) | SDHCI_PHY_OTAPDLYENA |
+               (SDHCI_PHY_OTAPDLY << SDHCI_PHY_OTAPDLYSEL_SHIFT)), SDHCI_PHY_CON0);
+
+  // The pad calibration cycle takes a couple of microseconds
+  MicroSecondDelay (3);
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_PDB, SDHCI_PHY_PDB), SDHCI_PHY_CON6);
+  Deadline = SdhciGetDeadline (SDHCI_PHY_CALDONE_TIMEOUT_US);
+  while (!(GrfReadl (SDHCI_PHY_STATUS) & SDHCI_PHY_CALDONE)) {
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a(): pad calibration timeout\n", __func__));
+      return EFI_TIMEOUT;
+    }
+  }
+
+  GrfWritel (SDHCI_GRF_UPDATE (SDHCI_PHY_ENDLL, SDHCI_PHY_ENDLL), SDHCI_PHY_CON6);
+  if (CardClock < SDHCI_PHY_DLL_MIN_CLOCK) {
+    return EFI_SUCCESS;
+  }
+  Deadline = SdhciGetDeadline (SDHCI_PHY_DLLRDY_TIMEOUT_US);
+  while (!(GrfReadl (SDHCI_PHY_STATUS) & SDHCI_PHY_DLLRDY)) {
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a(): DLL lock timeout at %dHz\n", __func__, CardClock));
+      return EFI_TIMEOUT;
+    }
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Program the SDHCI divider for a card clock no faster than ClockFreq.
+
+**/
+STATIC
+EFI_STATUS
+SdhciSetClock (
+  IN SDHCI_HOST                *Host,
+  IN UINT32                    ClockFreq
+  )
+{
+  UINT32 Divider;
+  UINT64 Deadline;
+
+  MmioWrite16 (Host->Base + SDHCI_CLOCK_CONTROL, 0);
+  Host->CardClock = 0;
+  if (ClockFreq == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // The card clock is BaseClock / (2 * Divider), or BaseClock for 0
+  if (Host->BaseClock <= ClockFreq) {
+    Divider = 0;
+  } else {
+    Divider = (Host->BaseClock + 2 * ClockFreq - 1) / (2 * ClockFreq);
+    if (Divider > SDHCI_MAX_DIVIDER) {
+      return EFI_NOT_FOUND;
+    }
+  }
+
+  MmioWrite16 (Host->Base + SDHCI_CLOCK_CONTROL, SDHCI_CLOCK_DIVIDER (Divider) | SDHCI_CLOCK_INT_EN);
+  Deadline = SdhciGetDeadline (SDHCI_CLOCK_TIMEOUT_US);
+  while (!(MmioRead16 (Host->Base + SDHCI_CLOCK_CONTROL) & SDHCI_CLOCK_INT_STABLE)) {
+    if (GetPerformanceCounter () >= Deadline) {
+      DEBUG ((DEBUG_ERROR, "%a(): internal clock never stabilised\n", __func__));
+      return EFI_DEVICE_ERROR;
+    }
+  }
+  MmioOr16 (Host->Base + SDHCI_CLOCK_CONTROL, SDHCI_CLOCK_CARD_EN);
+
+  Host->CardClock = (Divider == 0) ? Host->BaseClock : Host->BaseClock / (2 * Divider);
+  DEBUG ((SDHCI_DBG, "%a(): card clock %d\n", __func__, Host->CardClock));
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdhciNotifyState (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN MMC_STATE                 State
+  )
+{
+  SDHCI_HOST  *Host;
+  UINT32      Caps;
+  UINT32      Rate;
+  EFI_STATUS  Status;
+
+  Host = SDHCI_HOST_FROM_MMC_HOST (This);
+  switch (State) {
+  case MmcInvalidState:
+    return EFI_INVALID_PARAMETER;
+  case MmcHwInitializationState:
+    SdhciPhyPowerOff ();
+    Rate = rk3399_mmc_set_clk (SCLK_EMMC, Host->ClockFrequency);
+    if (Rate != 0) {
+      Host->ClockFrequency = Rate;
+    }
+
+    //
+    // The core samples its configuration from the GRF on reset: report the
+    // input clock as base clock and keep the programmable clock mode off.
+    //
+    GrfWritel (SDHCI_GRF_UPDATE (0xff << SDHCI_CORECFG_BASECLKFREQ_SHIFT,
+                 (Host->ClockFrequency / 1000000) << SDHCI_CORECFG_BASECLKFREQ_SHIFT),
+               SDHCI_CORECFG_BASECLKFREQ);
+    GrfWritel (SDHCI_GRF_UPDATE (0xff, 0), SDHCI_CORECFG_CLOCKMULTIPLIER);
+
+    Status = SdhciReset (Host, SDHCI_RESET_ALL);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Host->CardSelected = FALSE;
+
+    Caps = MmioRead32 (Host->Base + SDHCI_CAPABILITIES);
+    Host->BaseClock = SDHCI_GET_BASE_CLOCK_MHZ (Caps) * 1000000;
+    if (Host->BaseClock == 0) {
+      Host->BaseClock = Host->ClockFrequency;
+    }
+
+    if (Caps & SDHCI_CAN_VDD_330) {
+      MmioWrite8 (Host->Base + SDHCI_POWER_CONTROL, SDHCI_POWER_330 | SDHCI_POWER_ON);
+    } else {
+      MmioWrite8 (Host->Base + SDHCI_POWER_CONTROL, SDHCI_POWER_180 | SDHCI_POWER_ON);
+    }
+
+    // Status is polled, nothing is signaled
+    MmioWrite32 (Host->Base + SDHCI_INT_ENABLE, SDHCI_INT_ALL);
+    MmioWrite32 (Host->Base + SDHCI_SIGNAL_ENABLE, 0);
+    MmioWrite32 (Host->Base + SDHCI_INT_STATUS, SDHCI_INT_ALL);
+    MmioWrite8 (Host->Base + SDHCI_TIMEOUT_CONTROL, 0xe);
+    MmioWrite8 (Host->Base + SDHCI_HOST_CONTROL, SDHCI_CTRL_ADMA32);
+    MmioWrite16 (Host->Base + SDHCI_HOST_CONTROL2, 0);
+
+    // Setup clock that could not be higher than 400KHz.
+    Status = SdhciSetClock (Host, 400000);
+    ASSERT (!EFI_ERROR (Status));
+    // Wait clock stable
+    MicroSecondDelay (100);
+    break;
+  case MmcIdleState:
+    break;
+  case MmcReadyState:
+    break;
+  case MmcIdentificationState:
+    break;
+  case MmcStandByState:
+    break;
+  case MmcTransferState:
+    break;
+  case MmcSendingDataState:
+    break;
+  case MmcReceiveDataState:
+    break;
+  case MmcProgrammingState:
+    break;
+  case MmcDisconnectState:
+    break;
+  default:
+    return EFI_INVALID_PARAMETER;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Issue a command and wait for its response.
+
+  Commands with a busy response also wait for the card to release DAT0.
+  The data phase of a data command is left to the caller.
+
+  @param[in]  Host        The controller.
+  @param[in]  Command     Value of the COMMAND register.
+  @param[in]  Argument    Command argument.
+  @param[in]  Mode        Value of the TRANSFER_MODE register.
+
+**/
+STATIC
+EFI_STATUS
+SdhciIssueCommand (
+  IN SDHCI_HOST                 *Host,
+  IN UINT16                     Command,
+  IN UINT32                     Argument,
+  IN UINT16                     Mode
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Busy;
+  BOOLEAN     WaitData;
+  UINT32      IntStatus;
+
+  DEBUG ((SDHCI_DBG, "%a(): CMD%d, Argument 0x%x\n", __func__, Command >> 8, Argument));
+
+  Busy = (Command & SDHCI_CMD_RESP_MASK) == SDHCI_CMD_RESP_48_BUSY;
+  // An abort goes out while the data lines are still in use
+  WaitData = (Busy || (Command & SDHCI_CMD_DATA) != 0) &&
+             ((Command & SDHCI_CMD_ABORT) != SDHCI_CMD_ABORT);
+  Status = SdhciWaitIdle (Host, WaitData, SDHCI_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  MmioWrite32 (Host->Base + SDHCI_INT_STATUS, SDHCI_INT_ALL);
+  MmioWrite32 (Host->Base + SDHCI_ARGUMENT, Argument);
+  // Mode and command go out in one write, the command write starts the transfer
+  MmioWrite32 (Host->Base + SDHCI_TRANSFER_MODE, ((UINT32)Command << 16) | Mode);
+
+  Status = SdhciWaitInterrupt (Host, SDHCI_INT_CMD_COMPLETE, SDHCI_CMD_TIMEOUT_US, &IntStatus);
+  if (!EFI_ERROR (Status) && Busy) {
+    Status = SdhciWaitInterrupt (Host, SDHCI_INT_XFER_COMPLETE, SDHCI_BUSY_TIMEOUT_US, &IntStatus);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a(): CMD%d, Argument 0x%x: %r, SDHCI_INT_STATUS=0x%x\n",
+      __func__, Command >> 8, Argument, Status, IntStatus));
+    SdhciRecover (Host);
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdhciSendCommand (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN MMC_CMD                    MmcCmd,
+  IN UINT32                     Argument
+  )
+{
+  SDHCI_HOST   *Host;
+  UINT32       Index;
+  UINT16       Flags;
+  BOOLEAN      Data;
+
+  Host = SDHCI_HOST_FROM_MMC_HOST (This);
+  Index = MMC_GET_INDX (MmcCmd);
+  Data = FALSE;
+
+  switch (Index) {
+  case MMC_INDX(0):
+    Flags = SDHCI_CMD_RESP_NONE;
+    Host->CardSelected = FALSE;
+    break;
+  case MMC_INDX(1):
+  case MMC_INDX(41):
+    Flags = SDHCI_CMD_RESP_48;
+    break;
+  case MMC_INDX(2):
+  case MMC_INDX(9):
+  case MMC_INDX(10):
+    Flags = SDHCI_CMD_RESP_136 | SDHCI_CMD_CRC;
+    break;
+  case MMC_INDX(6):
+    if (((Argument >> 31) & 0x1) == 0x1) {
+      // SD SWITCH_FUNC returns the function status as data
+      Flags = SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+      Data = TRUE;
+    } else {
+      Flags = SDHCI_CMD_RESP_48_BUSY | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    }
+    break;
+  case MMC_INDX(7):
+    if (Argument) {
+      Flags = SDHCI_CMD_RESP_48_BUSY | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+      Host->CardSelected = TRUE;
+    } else {
+      Flags = SDHCI_CMD_RESP_NONE;
+      Host->CardSelected = FALSE;
+    }
+    break;
+  case MMC_INDX(8):
+    //
+    // CMD8 is SEND_EXT_CSD for a selected eMMC, and SEND_IF_COND while an
+    // SD card is still being identified.
+    //
+    Flags = SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    Data = Host->CardSelected;
+    break;
+  case MMC_INDX(12):
+    Flags = SDHCI_CMD_RESP_48_BUSY | SDHCI_CMD_CRC | SDHCI_CMD_INDEX | SDHCI_CMD_ABORT;
+    break;
+  case MMC_INDX(17):
+  case MMC_INDX(18):
+  case MMC_INDX(24):
+  case MMC_INDX(25):
+  case MMC_INDX(30):
+  case MMC_INDX(51):
+    Flags = SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    Data = TRUE;
+    break;
+  case MMC_INDX(5):
+  case MMC_INDX(28):
+  case MMC_INDX(29):
+    Flags = SDHCI_CMD_RESP_48_BUSY | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    break;
+  case MMC_INDX(38):
+    //
+    // An erase can keep the card busy far longer than the controller waits,
+    // the bus driver waits for it with the erase timeout of the card.
+    //
+    Flags = SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    break;
+  default:
+    Flags = SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX;
+    break;
+  }
+
+  if (Data) {
+    Host->Command = SDHCI_MAKE_CMD (Index, Flags | SDHCI_CMD_DATA);
+    Host->Argument = Argument;
+    return EFI_SUCCESS;
+  }
+  return SdhciIssueCommand (Host, SDHCI_MAKE_CMD (Index, Flags), Argument, 0);
+}
+
+EFI_STATUS
+SdhciReceiveResponse (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN MMC_RESPONSE_TYPE          Type,
+  IN UINT32*                    Buffer
+  )
+{
+  SDHCI_HOST   *Host;
+  UINT32       Response[4];
+
+  if (Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  Host = SDHCI_HOST_FROM_MMC_HOST (This);
+
+  if (   (Type == MMC_RESPONSE_TYPE_R1)
+      || (Type == MMC_RESPONSE_TYPE_R1b)
+      || (Type == MMC_RESPONSE_TYPE_R3)
+      || (Type == MMC_RESPONSE_TYPE_R6)
+      || (Type == MMC_RESPONSE_TYPE_R7))
+  {
+    Buffer[0] = MmioRead32 (Host->Base + SDHCI_RESPONSE0);
+  } else if (Type == MMC_RESPONSE_TYPE_R2) {
+    //
+    // The controller strips the CRC of long responses, put the register
+    // back where the MMC layer expects it.
+    //
+    Response[0] = MmioRead32 (Host->Base + SDHCI_RESPONSE0);
+    Response[1] = MmioRead32 (Host->Base + SDHCI_RESPONSE1);
+    Response[2] = MmioRead32 (Host->Base + SDHCI_RESPONSE2);
+    Response[3] = MmioRead32 (Host->Base + SDHCI_RESPONSE3);
+    Buffer[0] = Response[0] << 8;
+    Buffer[1] = (Response[1] << 8) | (Response[0] >> 24);
+    Buffer[2] = (Response[2] << 8) | (Response[1] >> 24);
+    Buffer[3] = (Response[3] << 8) | (Response[2] >> 24);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Map a data transfer for the ADMA2 engine.
+
+  32-bit descriptors only take 32-bit, word aligned buffer addresses. Only
+  whole cache lines of the buffer are handed to the engine, so that cache
+  maintenance can not corrupt data sharing a line with the buffer: the
+  partial lines at its ends are staged in the bounce pages and the rest is
+  moved in place. A buffer the engine can not reach is staged as a whole
+  when it fits in the bounce pages. Anything else goes through the buffer
+  data port.
+
+  @param[in]  Host         The controller.
+  @param[in]  Length       Length of the transfer in bytes.
+  @param[in]  Buffer       Source or destination buffer.
+  @param[in]  IsRead       TRUE if the data is moved from the card.
+  @param[out] Map          The transfer buffer as the engine sees it.
+
+  @retval TRUE             The transfer can be handed to the ADMA2 engine.
+  @retval FALSE            The transfer has to go through the data port.
+
+**/
+STATIC
+BOOLEAN
+SdhciDmaMap (
+  IN  SDHCI_HOST                *Host,
+  IN  UINTN                     Length,
+  IN  UINT32*                   Buffer,
+  IN  BOOLEAN                   IsRead,
+  OUT DMA_BOUNCE_MAP            *Map
+  )
+{
+  if (!FeaturePcdGet (PcdSdhciDxeUseAdma) || (Host->AdmaDesc == NULL)) {
+    return FALSE;
+  }
+  if ((Length == 0) || ((Length % SDHCI_DATA_BLOCK_SIZE) != 0)) {
+    return FALSE;
+  }
+  // The staged parts may each take a descriptor of their own
+  if ((Length + SDHCI_ADMA2_MAX_LENGTH - 1) / SDHCI_ADMA2_MAX_LENGTH + DMA_BOUNCE_MAX_SEGMENTS - 1 >
+      SDHCI_ADMA2_MAX_DESC) {
+    return FALSE;
+  }
+
+  return DmaBounceMap (Buffer, Length, IsRead, MAX_UINT32, Host->Bounce,
+           EFI_PAGES_TO_SIZE (SDHCI_BOUNCE_PAGES), Map);
+}
+
+/**
+  Build the ADMA2 descriptor table describing a data transfer.
+
+**/
+STATIC
+VOID
+SdhciPrepareAdma (
+  IN SDHCI_HOST                 *Host,
+  IN DMA_BOUNCE_MAP             *Map
+  )
+{
+  UINTN   Count;
+  UINTN   Segment;
+  UINT32  Address;
+  UINT32  Remaining;
+  UINT32  Chunk;
+
+  Count = 0;
+  for (Segment = 0; Segment < Map->SegmentCount; Segment++) {
+    Address = (UINT32)Map->Segments[Segment].Address;
+    Remaining = (UINT32)Map->Segments[Segment].Length;
+    while (Remaining > 0) {
+      Chunk = MIN (Remaining, SDHCI_ADMA2_MAX_LENGTH);
+      Host->AdmaDesc[Count].Attributes = SDHCI_ADMA2_VALID | SDHCI_ADMA2_ACT_TRAN;
+      Host->AdmaDesc[Count].Length = (UINT16)Chunk;
+      Host->AdmaDesc[Count].Address = Address;
+      Address += Chunk;
+      Remaining -= Chunk;
+      Count++;
+    }
+  }
+  Host->AdmaDesc[Count - 1].Attributes |= SDHCI_ADMA2_END;
+
+  WriteBackDataCacheRange (Host->AdmaDesc, Count * sizeof (SDHCI_ADMA2_DESCRIPTOR));
+  MmioWrite32 (Host->Base + SDHCI_ADMA_ADDRESS, (UINT32)(UINTN)Host->AdmaDesc);
+}
+
+/**
+  Run the pending data command and move its data.
+
+  @param[in]  Host         The controller.
+  @param[in]  Length       Length of the transfer in bytes.
+  @param[in]  Buffer       Source or destination buffer.
+  @param[in]  IsRead       TRUE if the data is moved from the card.
+
+**/
+STATIC
+EFI_STATUS
+SdhciTransfer (
+  IN SDHCI_HOST                 *Host,
+  IN UINTN                      Length,
+  IN UINT32*                    Buffer,
+  IN BOOLEAN                    IsRead
+  )
+{
+  EFI_STATUS     Status;
+  DMA_BOUNCE_MAP  Map;
+  BOOLEAN        Dma;
+  UINTN          BlockSize;
+  UINTN          BlockCount;
+  UINTN          Block;
+  UINTN          Index;
+  UINT16         Mode;
+  UINT32         IntStatus;
+
+  if ((Host->Command & SDHCI_CMD_DATA) == 0) {
+    DEBUG ((DEBUG_ERROR, "%a(): no data command pending\n", __func__));
+    return EFI_NOT_READY;
+  }
+
+  BlockSize = MIN (Length, SDHCI_DATA_BLOCK_SIZE);
+  BlockCount = Length / BlockSize;
+  if ((BlockCount > SDHCI_MAX_BLOCK_COUNT) || ((Length % BlockSize) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  IntStatus = 0;
+  Mode = SDHCI_TRNS_BLK_CNT_EN;
+  if (BlockCount > 1) {
+    Mode |= SDHCI_TRNS_MULTI;
+  }
+  if (IsRead) {
+    Mode |= SDHCI_TRNS_READ;
+  }
+
+  Dma = SdhciDmaMap (Host, Length, Buffer, IsRead, &Map);
+  if (Dma) {
+    SdhciPrepareAdma (Host, &Map);
+    Mode |= SDHCI_TRNS_DMA;
+  }
+
+  Status = SdhciWaitIdle (Host, TRUE, SDHCI_BUSY_TIMEOUT_US);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+  MmioWrite16 (Host->Base + SDHCI_BLOCK_SIZE, (UINT16)BlockSize);
+  MmioWrite16 (Host->Base + SDHCI_BLOCK_COUNT, (UINT16)BlockCount);
+  Status = SdhciIssueCommand (Host, Host->Command, Host->Argument, Mode);
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  if (!Dma) {
+    for (Block = 0; Block < BlockCount; Block++) {
+      Status = SdhciWaitInterrupt (Host,
+                 IsRead ? SDHCI_INT_BUF_RD_READY : SDHCI_INT_BUF_WR_READY,
+                 SDHCI_CMD_TIMEOUT_US, &IntStatus);
+      if (EFI_ERROR (Status)) {
+        goto Exit;
+      }
+      for (Index = 0; Index < BlockSize / 4; Index++) {
+        if (IsRead) {
+          *Buffer++ = MmioRead32 (Host->Base + SDHCI_BUFFER);
+        } else {
+          MmioWrite32 (Host->Base + SDHCI_BUFFER, *Buffer++);
+        }
+      }
+    }
+  }
+
+  //
+  // Allow for a card that moves at least 4MB/s on top of the 1s data timeout.
+  //
+  Status = SdhciWaitInterrupt (Host, SDHCI_INT_XFER_COMPLETE,
+             SDHCI_CMD_TIMEOUT_US + Length / 4, &IntStatus);
+
+Exit:
+  Host->Command = 0;
+  if (Dma) {
+    DmaBounceUnmap (&Map);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a(): %r, SDHCI_INT_STATUS=0x%x SDHCI_ADMA_ERROR=0x%x Length=%d\n",
+      __func__, Status, IntStatus, MmioRead32 (Host->Base + SDHCI_ADMA_ERROR), Length));
+    SdhciRecover (Host);
+    return EFI_DEVICE_ERROR;
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdhciReadBlockData (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN EFI_LBA                    Lba,
+  IN UINTN                      Length,
+  IN UINT32*                    Buffer
+  )
+{
+  return SdhciTransfer (SDHCI_HOST_FROM_MMC_HOST (This), Length, Buffer, TRUE);
+}
+
+EFI_STATUS
+SdhciWriteBlockData (
+  IN EFI_MMC_HOST_PROTOCOL     *This,
+  IN EFI_LBA                    Lba,
+  IN UINTN                      Length,
+  IN UINT32*                    Buffer
+  )
+{
+  return SdhciTransfer (SDHCI_HOST_FROM_MMC_HOST (This), Length, Buffer, FALSE);
+}
+
+/**
+  Let the controller find the sample point for HS200 by sending CMD21
+  until it reports the tuning as done.
+
+  @param[in]  Host        The controller.
+  @param[in]  BusWidth    Current bus width, 4 or 8.
+
+**/
+STATIC
+EFI_STATUS
+SdhciExecuteTuning (
+  IN SDHCI_HOST                 *Host,
+  IN UINT32                     BusWidth
+  )
+{
+  UINTN       Loop;
+  UINT16      Ctrl2;
+  EFI_STATUS  Status;
+
+  MmioAnd16 (Host->Base + SDHCI_HOST_CONTROL2, (UINT16)~SDHCI_CTRL_TUNED_CLK);
+  MmioOr16 (Host->Base + SDHCI_HOST_CONTROL2, SDHCI_CTRL_EXEC_TUNING);
+
+  for (Loop = 0; Loop < SDHCI_TUNING_LOOPS; Loop++) {
+    Status = SdhciWaitIdle (Host, TRUE, SDHCI_TUNING_TIMEOUT_US);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    MmioWrite16 (Host->Base + SDHCI_BLOCK_SIZE, (BusWidth == 8) ? 128 : 64);
+    MmioWrite16 (Host->Base + SDHCI_BLOCK_COUNT, 1);
+    MmioWrite32 (Host->Base + SDHCI_INT_STATUS, SDHCI_INT_ALL);
+    MmioWrite32 (Host->Base + SDHCI_ARGUMENT, 0);
+    MmioWrite32 (Host->Base + SDHCI_TRANSFER_MODE,
+      ((UINT32)SDHCI_MAKE_CMD (21, SDHCI_CMD_RESP_48 | SDHCI_CMD_CRC | SDHCI_CMD_INDEX | SDHCI_CMD_DATA) << 16) |
+      SDHCI_TRNS_READ);
+
+    // The controller compares the block itself, only wait for it
+    Status = SdhciWaitInterrupt (Host, SDHCI_INT_BUF_RD_READY, SDHCI_TUNING_TIMEOUT_US, NULL);
+    if (Status == EFI_TIMEOUT) {
+      break;
+    }
+    if (EFI_ERROR (Status)) {
+      // A failing sample point, the controller moves on to the next one
+      SdhciReset (Host, SDHCI_RESET_CMD);
+    }
+    Ctrl2 = MmioRead16 (Host->Base + SDHCI_HOST_CONTROL2);
+    if (!(Ctrl2 & SDHCI_CTRL_EXEC_TUNING)) {
+      if (Ctrl2 & SDHCI_CTRL_TUNED_CLK) {
+        DEBUG ((DEBUG_INFO, "%a(): tuned after %d blocks\n", __func__, Loop + 1));
+        return EFI_SUCCESS;
+      }
+      break;
+    }
+  }
+
+  DEBUG ((DEBUG_ERROR, "%a(): no working sample point\n", __func__));
+  MmioAnd16 (Host->Base + SDHCI_HOST_CONTROL2,
+    (UINT16)~(SDHCI_CTRL_EXEC_TUNING | SDHCI_CTRL_TUNED_CLK));
+  SdhciRecover (Host);
+  return EFI_DEVICE_ERROR;
+}
+
+EFI_STATUS
+SdhciSetIos (
+  IN EFI_MMC_HOST_PROTOCOL      *This,
+  IN  UINT32                    BusClockFreq,
+  IN  UINT32                    BusWidth,
+  IN  UINT32                    TimingMode
+  )
+{
+  SDHCI_HOST  *Host;
+  EFI_STATUS  Status;
+  UINT8       Ctrl;
+  UINT16      Ctrl2;
+  BOOLEAN     Tuning;
+
+  Host = SDHCI_HOST_FROM_MMC_HOST (This);
+  Tuning = FALSE;
+
+  Ctrl = MmioRead8 (Host->Base + SDHCI_HOST_CONTROL);
+  Ctrl &= ~(SDHCI_CTRL_4BITBUS | SDHCI_CTRL_8BITBUS);
+  switch (BusWidth) {
+  case 1:
+    break;
+  case 4:
+    Ctrl |= SDHCI_CTRL_4BITBUS;
+    break;
+  case 8:
+    Ctrl |= SDHCI_CTRL_8BITBUS;
+    break;
+  default:
+    return EFI_UNSUPPORTED;
+  }
+
+  Ctrl2 = MmioRead16 (Host->Base + SDHCI_HOST_CONTROL2);
+  if (TimingMode != EMMCBACKWARD) {
+    Ctrl |= SDHCI_CTRL_HISPD;
+    Ctrl2 &= ~(SDHCI_CTRL_UHS_MASK | SDHCI_CTRL_VDD_180);
+    switch (TimingMode) {
+    case EMMCHS26:
+      Ctrl &= ~SDHCI_CTRL_HISPD;
+      break;
+    case EMMCHS52:
+      break;
+    case EMMCHS52DDR1V8:
+      Ctrl2 |= SDHCI_CTRL_VDD_180;
+      // Fall through
+    case EMMCHS52DDR1V2:
+      Ctrl2 |= SDHCI_CTRL_UHS_DDR50;
+      break;
+    case EMMCHS200SDR1V8:
+      Ctrl2 |= SDHCI_CTRL_VDD_180;
+      // Fall through
+    case EMMCHS200SDR1V2:
+      Ctrl2 |= SDHCI_CTRL_UHS_SDR104;
+      Tuning = TRUE;
+      break;
+    case EMMCHS400DDR1V8:
+      Ctrl2 |= SDHCI_CTRL_VDD_180;
+      // Fall through
+    case EMMCHS400DDR1V2:
+      // The sample point found in HS200 is kept, HS400 latches on the data strobe
+      Ctrl2 |= SDHCI_CTRL_HS400;
+      break;
+    default:
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  if (BusClockFreq == 0) {
+    MmioWrite8 (Host->Base + SDHCI_HOST_CONTROL, Ctrl);
+    return EFI_SUCCESS;
+  }
+
+  //
+  // The timing may only change with the card clock stopped, and the PHY has
+  // to be recalibrated for the new clock.
+  //
+  SdhciPhyPowerOff ();
+  MmioAnd16 (Host->Base + SDHCI_CLOCK_CONTROL, (UINT16)~SDHCI_CLOCK_CARD_EN);
+  MmioWrite8 (Host->Base + SDHCI_HOST_CONTROL, Ctrl);
+  MmioWrite16 (Host->Base + SDHCI_HOST_CONTROL2, Ctrl2);
+  Status = SdhciSetClock (Host, BusClockFreq);
+  if (!EFI_ERROR (Status) && (Host->CardClock > SDHCI_PHY_MIN_CLOCK)) {
+    Status = SdhciPhyPowerOn (Host->CardClock);
+  }
+  if (!EFI_ERROR (Status) && Tuning) {
+    Status = SdhciExecuteTuning (Host, BusWidth);
+  }
+  if (EFI_ERROR (Status)) {
+    // Drop back to the default clock, the caller picks a slower mode
+    SdhciPhyPowerOff ();
+    MmioAnd8 (Host->Base + SDHCI_HOST_CONTROL, (UINT8)~SDHCI_CTRL_HISPD);
+    MmioAnd16 (Host->Base + SDHCI_HOST_CONTROL2, (UINT16)~SDHCI_CTRL_UHS_MASK);
+    SdhciSetClock (Host, 400000);
+  }
+  return Status;
+}
+
+BOOLEAN
+SdhciIsMultiBlock (
+  IN EFI_MMC_HOST_PROTOCOL      *This
+  )
+{
+  return TRUE;
+}
+
+EFI_STATUS
+EFIAPI
+SdhciRegisterCardDetect (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  EFI_EVENT                 Event
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+EFIAPI
+SdhciWaitBusy (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  UINT64                    TimeoutUs
+  )
+{
+  SDHCI_HOST  *Host;
+  UINT64      Deadline;
+
+  Host = SDHCI_HOST_FROM_MMC_HOST_EXT (This);
+  if (MmioRead32 (Host->Base + SDHCI_PRESENT_STATE) & SDHCI_DAT0_LEVEL) {
+    return EFI_SUCCESS;
+  }
+
+  Deadline = SdhciGetDeadline (TimeoutUs);
+  do {
+    if (MmioRead32 (Host->Base + SDHCI_PRESENT_STATE) & SDHCI_DAT0_LEVEL) {
+      return EFI_SUCCESS;
+    }
+  } while (GetPerformanceCounter () < Deadline);
+  return EFI_TIMEOUT;
+}
+
+STATIC CONST MMC_HOST_EXT_PROTOCOL mSdhciHostExtTemplate = {
+  MMC_HOST_EXT_PROTOCOL_REVISION,
+  MMC_HOST_EXT_CAP_SET_BLOCK_COUNT | MMC_HOST_EXT_CAP_NON_REMOVABLE,
+  SDHCI_MAX_BLOCK_COUNT,
+  SdhciRegisterCardDetect,
+  SdhciWaitBusy
+};
+
+STATIC CONST EFI_MMC_HOST_PROTOCOL mSdhciHostTemplate = {
+  MMC_HOST_PROTOCOL_REVISION,
+  SdhciIsCardPresent,
+  SdhciIsReadOnly,
+  SdhciBuildDevicePath,
+  SdhciNotifyState,
+  SdhciSendCommand,
+  SdhciReceiveResponse,
+  SdhciReadBlockData,
+  SdhciWriteBlockData,
+  SdhciSetIos,
+  SdhciIsMultiBlock
+};
+
+/**
+  Create the context of one controller and publish its protocols on a new
+  handle.
+
+  @param[in]  Base            Base address of the controller registers.
+  @param[in]  ClockFrequency  Clock to feed the controller with, in Hz.
+
+**/
+STATIC
+EFI_STATUS
+SdhciCreateHost (
+  IN UINTN                      Base,
+  IN UINT32                     ClockFrequency
+  )
+{
+  EFI_STATUS            Status;
+  SDHCI_HOST            *Host;
+  EFI_PHYSICAL_ADDRESS  DescAddress;
+  EFI_PHYSICAL_ADDRESS  BounceAddress;
+
+  Host = AllocateZeroPool (sizeof (SDHCI_HOST));
+  if (Host == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Host->Signature = SDHCI_HOST_SIGNATURE;
+  Host->Base = Base;
+  Host->ClockFrequency = ClockFrequency;
+  CopyMem (&Host->MmcHost, &mSdhciHostTemplate, sizeof (EFI_MMC_HOST_PROTOCOL));
+  CopyMem (&Host->MmcHostExt, &mSdhciHostExtTemplate, sizeof (MMC_HOST_EXT_PROTOCOL));
+
+  //
+  // 32-bit ADMA2 can only follow 32-bit descriptor addresses.
+  //
+  DescAddress = MAX_UINT32;
+  Status = gBS->AllocatePages (AllocateMaxAddress, EfiBootServicesData,
+                  SDHCI_ADMA2_DESC_PAGES, &DescAddress);
+  if (EFI_ERROR (Status)) {
+    FreePool (Host);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Host->AdmaDesc = (SDHCI_ADMA2_DESCRIPTOR *)(UINTN)DescAddress;
+
+  //
+  // Without bounce pages only cache line aligned buffers below 4GB can be
+  // moved by ADMA2, the data port moves the others.
+  //
+  BounceAddress = MAX_UINT32;
+  Status = gBS->AllocatePages (AllocateMaxAddress, EfiBootServicesData,
+                  SDHCI_BOUNCE_PAGES, &BounceAddress);
+  if (!EFI_ERROR (Status)) {
+    Host->Bounce = (UINT8 *)(UINTN)BounceAddress;
+  }
+
+  DEBUG ((DEBUG_BLKIO, "%a(): controller at 0x%lx\n", __func__, (UINT64)Base));
+
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Host->Handle,
+                  &gEmbeddedMmcHostProtocolGuid,         &Host->MmcHost,
+                  &gMmcHostExtProtocolGuid,              &Host->MmcHostExt,
+                  NULL
+                  );
+  if (EFI_ERROR (Status)) {
+    if (Host->Bounce != NULL) {
+      gBS->FreePages (BounceAddress, SDHCI_BOUNCE_PAGES);
+    }
+    gBS->FreePages (DescAddress, SDHCI_ADMA2_DESC_PAGES);
+    FreePool (Host);
+  }
+  return Status;
+}
+
+EFI_STATUS
+SdhciDxeInitialize (
+  IN EFI_HANDLE         ImageHandle,
+  IN EFI_SYSTEM_TABLE   *SystemTable
+  )
+{
+  EFI_STATUS            Status;
+
+  DEBUG ((DEBUG_BLKIO, "SdhciDxeInitialize()\n"));
+
+  Status = SdhciCreateHost (PcdGet32 (PcdSdhciDxeBaseAddress),
+             PcdGet32 (PcdSdhciDxeClockFrequencyInHz));
+  ASSERT_EFI_ERROR (Status);
+
+  return Status;
+}
@@ -6,6 +6,24 @@
 
 #define PRELOADER_HEADER SIGNATURE_32('B', 'S', 'E', 'N')
 
+// Crc32 is the CRC-32 (IEEE 802.3) of the environment up to the Crc32 field.
+//
+// UefiDisplayInfo describes the framebuffer the preloader left running.
+// Preloaders that do not fill it leave it unsigned, it is only read when
+// the first entry holds the signature below and the environment passes its
+// CRC. The stride is in pixels, 0 for tightly packed lines. The bpp is 16
+// (RGB565), 24 or 32 (BGRA8888).
+#define PRELOADER_DISPLAY_INFO_SIGNATURE_VALUE SIGNATURE_32('D', 'I', 'S', 'P')
+#define PRELOADER_DISPLAY_INFO_VERSION_1       1
+
+#define PRELOADER_DISPLAY_INFO_SIGNATURE 0
+#define PRELOADER_DISPLAY_INFO_VERSION   1
+#define PRELOADER_DISPLAY_INFO_BASE      2
+#define PRELOADER_DISPLAY_INFO_WIDTH     3
+#define PRELOADER_DISPLAY_INFO_HEIGHT    4
+#define PRELOADER_DISPLAY_INFO_STRIDE    5
+#define PRELOADER_DISPLAY_INFO_BPP       6
+
 typedef struct _PRELOADER_ENVIRONMENT {
   UINT32   Header;
   UINT32   PreloaderVersion;
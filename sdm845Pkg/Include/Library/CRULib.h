@@ -52,6 +52,9 @@ UINT32 rk3399_vop_set_clk(UINT32 clk_id, UINT32 hz);
 void rk3399_vio_set_clk(UINT32 hz);
 void rk3399_hdcp_set_clk(UINT32 hz);
 
+UINT32 rk3399_mmc_get_clk(UINT32 clk_id);
+UINT32 rk3399_mmc_set_clk(UINT32 clk_id, UINT32 hz);
+
 /* core clocks */
 #define PLL_PPLL        0
 #define PLL_APLLL       1
@@ -0,0 +1,43 @@
+/** @file
+  Geometry of the framebuffer the console and the GOP driver draw to.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _DISPLAY_INFO_LIB_H_
+#define _DISPLAY_INFO_LIB_H_
+
+typedef struct _DISPLAY_INFO {
+  UINTN   FrameBufferBase;
+  UINT32  Width;
+  UINT32  Height;
+  // Pixels from the start of one line to the start of the next
+  UINT32  Stride;
+  // 16 (RGB565), 24 or 32 (BGRA8888)
+  UINT32  Bpp;
+} DISPLAY_INFO;
+
+/**
+  Describe the framebuffer the preloader left running, or the one of the
+  platform PCDs when the preloader environment does not validate.
+
+  @param[out] Info        The framebuffer geometry.
+
+  @retval TRUE            Info comes from the preloader environment.
+  @retval FALSE           Info comes from the PCDs.
+
+**/
+BOOLEAN
+EFIAPI
+GetDisplayInfo (
+  OUT DISPLAY_INFO          *Info
+  );
+
+#endif /* _DISPLAY_INFO_LIB_H_ */
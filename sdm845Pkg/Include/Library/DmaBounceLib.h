@@ -0,0 +1,95 @@
+/** @file
+  Map transfer buffers for DMA engines that only reach part of memory,
+  through a bounce area the caller allocates below the engine's limit.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _DMA_BOUNCE_LIB_H_
+#define _DMA_BOUNCE_LIB_H_
+
+// The partial cache lines at both ends and the aligned part in between
+#define DMA_BOUNCE_MAX_SEGMENTS         3
+
+typedef struct {
+  UINTN                         Address;
+  UINTN                         Length;
+} DMA_BOUNCE_SEGMENT;
+
+//
+// A transfer buffer as the engine sees it. The cache line aligned part of
+// a buffer the engine reaches is moved in place, HeadLength and TailLength
+// bytes at its ends are staged in the first and second cache line of the
+// bounce area. A buffer that can not be moved in place is staged as a
+// whole, HeadLength then covers all of it.
+//
+typedef struct {
+  UINT8                         *Buffer;
+  UINTN                         Length;
+  BOOLEAN                       IsRead;
+  UINT8                         *Bounce;
+  UINTN                         HeadLength;
+  UINTN                         TailLength;
+  UINTN                         SegmentCount;
+  DMA_BOUNCE_SEGMENT            Segments[DMA_BOUNCE_MAX_SEGMENTS];
+} DMA_BOUNCE_MAP;
+
+/**
+  Map a data transfer for a DMA engine.
+
+  Only whole cache lines of the buffer are handed to the engine, so that
+  cache maintenance can not corrupt data sharing a line with the buffer:
+  the partial lines at its ends are staged in the bounce area and the rest
+  is moved in place. A buffer the engine can not reach is staged as a whole
+  when it fits in the bounce area. The segments are cleaned to memory for
+  a write and invalidated for a read.
+
+  @param[in]  Buffer        Source or destination buffer.
+  @param[in]  Length        Length of the transfer in bytes.
+  @param[in]  IsRead        TRUE if the engine writes to memory.
+  @param[in]  AddressLimit  Highest address the engine reaches.
+  @param[in]  Bounce        Bounce area below AddressLimit, at least two
+                            cache lines, or NULL.
+  @param[in]  BounceSize    Size of the bounce area in bytes.
+  @param[out] Map           The transfer buffer as the engine sees it.
+
+  @retval TRUE              The segments of Map can be handed to the engine.
+  @retval FALSE             The buffer can not be moved by the engine.
+
+**/
+BOOLEAN
+EFIAPI
+DmaBounceMap (
+  IN  VOID                      *Buffer,
+  IN  UINTN                     Length,
+  IN  BOOLEAN                   IsRead,
+  IN  UINTN                     AddressLimit,
+  IN  UINT8                     *Bounce OPTIONAL,
+  IN  UINTN                     BounceSize,
+  OUT DMA_BOUNCE_MAP            *Map
+  );
+
+/**
+  Hand a buffer mapped by DmaBounceMap() back to the CPU once the engine
+  is done with it.
+
+  Drops the lines the CPU may have fetched while the engine was writing to
+  memory, and copies the staged parts of a read to the caller's buffer.
+
+  @param[in]  Map           The transfer buffer, as mapped by DmaBounceMap().
+
+**/
+VOID
+EFIAPI
+DmaBounceUnmap (
+  IN DMA_BOUNCE_MAP             *Map
+  );
+
+#endif /* _DMA_BOUNCE_LIB_H_ */
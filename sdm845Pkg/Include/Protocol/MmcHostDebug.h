@@ -0,0 +1,91 @@
+/** @file
+  Debug interface of the MMC host controller drivers.
+
+  The host driver installs it next to the EFI_MMC_HOST_PROTOCOL and keeps a
+  latency histogram for every command index it issues to the card.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __MMC_HOST_DEBUG_H__
+#define __MMC_HOST_DEBUG_H__
+
+#define MMC_HOST_DEBUG_PROTOCOL_GUID \
+  { 0x9c77e264, 0xba43, 0x49ed, { 0xaf, 0xec, 0xc8, 0xe7, 0xdf, 0x1f, 0x9b, 0x6c } }
+
+#define MMC_HOST_DEBUG_PROTOCOL_REVISION    0x00010000
+
+#define MMC_HOST_DEBUG_MAX_COMMANDS         64
+//
+// Bucket N counts the commands that completed in less than 2^N microseconds,
+// the last bucket also takes everything slower than that.
+//
+#define MMC_HOST_DEBUG_LATENCY_BUCKETS      16
+
+typedef struct _MMC_HOST_DEBUG_PROTOCOL MMC_HOST_DEBUG_PROTOCOL;
+
+typedef struct {
+  UINT64                  Count;
+  UINT64                  Errors;
+  UINT64                  TotalUs;
+  UINT64                  MaxUs;
+  UINT32                  Buckets[MMC_HOST_DEBUG_LATENCY_BUCKETS];
+} MMC_HOST_COMMAND_LATENCY;
+
+/**
+  Return the latency statistics of one command index.
+
+  @param[in]  This          The protocol instance.
+  @param[in]  CommandIndex  The MMC command index, from 0 to 63.
+  @param[out] Latency       The statistics collected since the last reset.
+
+  @retval EFI_SUCCESS            The statistics were returned.
+  @retval EFI_INVALID_PARAMETER  CommandIndex is out of range or Latency is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_HOST_DEBUG_GET_COMMAND_LATENCY) (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This,
+  IN  UINT32                    CommandIndex,
+  OUT MMC_HOST_COMMAND_LATENCY  *Latency
+  );
+
+/**
+  Clear the statistics of all command indexes.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_HOST_DEBUG_RESET_LATENCY) (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This
+  );
+
+/**
+  Print the statistics of every command that was issued since the last reset
+  to the debug output.
+
+**/
+typedef
+VOID
+(EFIAPI *MMC_HOST_DEBUG_DUMP_LATENCY) (
+  IN  MMC_HOST_DEBUG_PROTOCOL   *This
+  );
+
+struct _MMC_HOST_DEBUG_PROTOCOL {
+  UINT32                              Revision;
+  MMC_HOST_DEBUG_GET_COMMAND_LATENCY  GetCommandLatency;
+  MMC_HOST_DEBUG_RESET_LATENCY        ResetLatency;
+  MMC_HOST_DEBUG_DUMP_LATENCY         DumpLatency;
+};
+
+extern EFI_GUID gMmcHostDebugProtocolGuid;
+
+#endif /* __MMC_HOST_DEBUG_H__ */
@@ -0,0 +1,97 @@
+/** @file
+  Extension of the MMC host controller interface.
+
+  The host driver installs it next to the EFI_MMC_HOST_PROTOCOL to describe
+  what the controller can do beyond the base protocol, so that the MMC bus
+  driver can shape its requests to the controller.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __MMC_HOST_EXT_H__
+#define __MMC_HOST_EXT_H__
+
+#define MMC_HOST_EXT_PROTOCOL_GUID \
+  { 0xe1075fb7, 0xdc37, 0x4f9b, { 0xbb, 0xcd, 0x93, 0xd4, 0xf3, 0x93, 0xb4, 0x56 } }
+
+#define MMC_HOST_EXT_PROTOCOL_REVISION      0x00010002
+
+//
+// The host can send CMD23 ahead of CMD18/CMD25 and does not issue an
+// automatic CMD12 at the end of the data phase.
+//
+#define MMC_HOST_EXT_CAP_SET_BLOCK_COUNT    BIT0
+//
+// The card is soldered down, IsCardPresent() never changes.
+//
+#define MMC_HOST_EXT_CAP_NON_REMOVABLE      BIT1
+
+typedef struct _MMC_HOST_EXT_PROTOCOL MMC_HOST_EXT_PROTOCOL;
+
+/**
+  Ask the host to signal an event whenever the card-detect state changes.
+
+  The event may be signaled from interrupt context and more than once per
+  insertion or removal, the caller is expected to debounce it and then call
+  IsCardPresent().
+
+  @param[in]  This          The protocol instance.
+  @param[in]  Event         The event to signal, NULL to stop notifications.
+
+  @retval EFI_SUCCESS       The event will be signaled on card-detect changes.
+  @retval EFI_UNSUPPORTED   The host can not detect changes by itself, the
+                            caller has to poll IsCardPresent().
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_HOST_EXT_REGISTER_CARD_DETECT) (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  EFI_EVENT                 Event
+  );
+
+/**
+  Wait for the card to release DAT0, which it holds low while it is busy
+  programming after a write or after a command with an R1b response.
+
+  @param[in]  This          The protocol instance.
+  @param[in]  TimeoutUs     How long to wait in microseconds.
+
+  @retval EFI_SUCCESS       The card is no longer busy.
+  @retval EFI_TIMEOUT       The card is still busy.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_HOST_EXT_WAIT_BUSY) (
+  IN  MMC_HOST_EXT_PROTOCOL     *This,
+  IN  UINT64                    TimeoutUs
+  );
+
+struct _MMC_HOST_EXT_PROTOCOL {
+  UINT32                              Revision;
+  UINT32                              Capabilities;
+  //
+  // Largest number of blocks the host moves with a single data command.
+  //
+  UINT32                              MaxBlockCount;
+  MMC_HOST_EXT_REGISTER_CARD_DETECT   RegisterCardDetect;
+  //
+  // Since revision 0x00010002.
+  //
+  MMC_HOST_EXT_WAIT_BUSY              WaitBusy;
+};
+
+#define MMC_HOST_EXT_HAS_WAIT_BUSY(Host)    \
+  (((Host)->Revision >= 0x00010002) && ((Host)->WaitBusy != NULL))
+
+extern EFI_GUID gMmcHostExtProtocolGuid;
+
+#endif /* __MMC_HOST_EXT_H__ */
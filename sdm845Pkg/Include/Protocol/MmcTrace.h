@@ -0,0 +1,102 @@
+/** @file
+  Command trace of the MMC bus driver.
+
+  The MMC bus driver installs it next to the BlockIo protocol of every card
+  when PcdMmcTraceEnable is set. It records the data, switch and erase
+  commands sent to the card in a fixed size ring, so that the storage
+  accesses of a boot can be profiled without a debug build.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __MMC_TRACE_H__
+#define __MMC_TRACE_H__
+
+#define MMC_TRACE_PROTOCOL_GUID \
+  { 0x9241a471, 0x736c, 0x4255, { 0xb2, 0xe5, 0xff, 0x54, 0x23, 0x85, 0xbe, 0x47 } }
+
+#define MMC_TRACE_PROTOCOL_REVISION         0x00010000
+
+typedef struct _MMC_TRACE_PROTOCOL MMC_TRACE_PROTOCOL;
+
+typedef struct {
+  //
+  // Performance counter when the command was sent and when it completed,
+  // including the data phase and the wait for the card to be ready again.
+  //
+  UINT64                  StartTicks;
+  UINT64                  EndTicks;
+  EFI_LBA                 Lba;
+  EFI_STATUS              Status;
+  UINT32                  Argument;
+  //
+  // Bytes moved by the command, blocks erased for an erase.
+  //
+  UINT32                  Length;
+  UINT8                   Command;
+  //
+  // eMMC hardware partition the command was addressed to, 0 for the user area.
+  //
+  UINT8                   Partition;
+  UINT8                   Reserved[6];
+} MMC_TRACE_ENTRY;
+
+/**
+  Copy the most recent entries of the trace, oldest first.
+
+  @param[in]      This          The protocol instance.
+  @param[in, out] EntryCount    On input the number of entries Entries can
+                                hold, on output the number of entries copied.
+  @param[out]     Entries       The buffer receiving the entries.
+  @param[out]     Recorded      Optional, the number of commands recorded
+                                since the last reset. The entries older than
+                                the last EntryCount ones are lost.
+
+  @retval EFI_SUCCESS            The entries were copied.
+  @retval EFI_INVALID_PARAMETER  EntryCount is NULL, or Entries is NULL while
+                                 *EntryCount is not 0.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_TRACE_GET_ENTRIES) (
+  IN     MMC_TRACE_PROTOCOL   *This,
+  IN OUT UINTN                *EntryCount,
+  OUT    MMC_TRACE_ENTRY      *Entries,
+  OUT    UINT64               *Recorded OPTIONAL
+  );
+
+/**
+  Drop every entry of the trace.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_TRACE_RESET) (
+  IN  MMC_TRACE_PROTOCOL      *This
+  );
+
+struct _MMC_TRACE_PROTOCOL {
+  UINT32                  Revision;
+  //
+  // Number of entries the ring holds.
+  //
+  UINT32                  Capacity;
+  //
+  // Frequency of the counter the timestamps are taken from, in Hz.
+  //
+  UINT64                  Frequency;
+  MMC_TRACE_GET_ENTRIES   GetEntries;
+  MMC_TRACE_RESET         Reset;
+};
+
+extern EFI_GUID gMmcTraceProtocolGuid;
+
+#endif /* __MMC_TRACE_H__ */
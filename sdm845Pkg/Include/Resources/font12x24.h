@@ -0,0 +1,433 @@
+/*
+ * Glyphs 32 to 127 of DejaVu Sans Mono, rasterized to a 12x24 bitmap.
+ * One halfword per row, bit 0 is the leftmost pixel.
+ *
+ * Bitstream Vera Fonts Copyright (c) 2003 by Bitstream, Inc. All Rights
+ * Reserved. Bitstream Vera is a trademark of Bitstream, Inc.
+ * DejaVu changes are in public domain.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of the fonts accompanying this license ("Fonts") and associated
+ * documentation files (the "Font Software"), to reproduce and distribute
+ * the Font Software, including without limitation the rights to use, copy,
+ * merge, publish, distribute, and/or sell copies of the Font Software, and
+ * to permit persons to whom the Font Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright and trademark notices and this permission notice
+ * shall be included in all copies of one or more of the Font Software
+ * typefaces.
+ *
+ * The Font Software may be modified, altered, or added to, and in
+ * particular the designs of glyphs or characters in the Fonts may be
+ * modified and additional glyphs or characters may be added to the Fonts,
+ * only if the fonts are renamed to names not containing either the words
+ * "Bitstream" or the word "Vera".
+ *
+ * The Font Software may not be sold by itself.
+ *
+ * THE FONT SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO ANY WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF
+ * COPYRIGHT, PATENT, TRADEMARK, OR OTHER RIGHT. IN NO EVENT SHALL
+ * BITSTREAM OR THE GNOME FOUNDATION BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, INCLUDING ANY GENERAL, SPECIAL, INDIRECT, INCIDENTAL,
+ * OR CONSEQUENTIAL DAMAGES, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF THE USE OR INABILITY TO USE THE FONT
+ * SOFTWARE OR FROM OTHER DEALINGS IN THE FONT SOFTWARE.
+ */
+
+#ifndef _FONT_12X24_DATA_
+#define _FONT_12X24_DATA_
+
+#define FONT12X24_WIDTH		12
+#define FONT12X24_HEIGHT	24
+
+unsigned short font12x24[] = {
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* ' ' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060, /* '!' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x000, 0x000, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x198, 0x198, /* '"' */
+    0x198, 0x198, 0x198, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x660, 0x220, /* '#' */
+    0x330, 0x330, 0xffe, 0xffe, 0x110, 0x198,
+    0x198, 0x7ff, 0x7ff, 0x0cc, 0x0cc, 0x044,
+    0x044, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x040, 0x040, /* '$' */
+    0x1f0, 0x3f8, 0x25c, 0x04c, 0x04c, 0x058,
+    0x1f0, 0x340, 0x640, 0x640, 0x744, 0x3fc,
+    0x1f8, 0x040, 0x040, 0x040, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x01e, 0x033, /* '%' */
+    0x033, 0x033, 0x033, 0x31e, 0x0c0, 0x060,
+    0x018, 0x3c6, 0x660, 0x660, 0x660, 0x660,
+    0x3c0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1f0, 0x1f8, /* '&' */
+    0x018, 0x018, 0x018, 0x030, 0x030, 0x07c,
+    0xcec, 0xcc6, 0xd86, 0x786, 0x30e, 0x6fc,
+    0xe78, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060, /* "'" */
+    0x060, 0x060, 0x060, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0c0, 0x040, /* '(' */
+    0x060, 0x060, 0x020, 0x030, 0x030, 0x030,
+    0x030, 0x030, 0x030, 0x030, 0x030, 0x060,
+    0x060, 0x060, 0x040, 0x0c0, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x030, 0x020, /* ')' */
+    0x060, 0x060, 0x060, 0x0c0, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x060,
+    0x060, 0x060, 0x020, 0x030, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x020, 0x020, /* '*' */
+    0x222, 0x1ac, 0x070, 0x070, 0x1ac, 0x222,
+    0x020, 0x020, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '+' */
+    0x000, 0x000, 0x060, 0x060, 0x060, 0x060,
+    0x7fe, 0x7fe, 0x060, 0x060, 0x060, 0x060,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* ',' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060,
+    0x060, 0x060, 0x030, 0x030, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '-' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x0f8, 0x0f8, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '.' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x600, 0x300, /* '/' */
+    0x300, 0x180, 0x180, 0x0c0, 0x0c0, 0x060,
+    0x060, 0x030, 0x030, 0x018, 0x018, 0x00c,
+    0x00c, 0x006, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x078, 0x1fc, /* '0' */
+    0x18c, 0x38e, 0x306, 0x306, 0x366, 0x366,
+    0x306, 0x306, 0x306, 0x38e, 0x18c, 0x1fc,
+    0x078, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0e0, 0x0f8, /* '1' */
+    0x0d8, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x7f8,
+    0x7f8, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0fc, 0x1fe, /* '2' */
+    0x382, 0x300, 0x300, 0x300, 0x380, 0x180,
+    0x0c0, 0x060, 0x030, 0x018, 0x00c, 0x3fe,
+    0x3fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0fc, 0x1fe, /* '3' */
+    0x382, 0x300, 0x300, 0x380, 0x1f0, 0x0f0,
+    0x180, 0x300, 0x300, 0x300, 0x382, 0x1fe,
+    0x0fc, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1c0, 0x1c0, /* '4' */
+    0x1e0, 0x1a0, 0x1b0, 0x190, 0x198, 0x18c,
+    0x18c, 0x186, 0x7fe, 0x7fe, 0x180, 0x180,
+    0x180, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1fc, 0x1fc, /* '5' */
+    0x00c, 0x00c, 0x00c, 0x0fc, 0x1fc, 0x384,
+    0x300, 0x300, 0x300, 0x300, 0x182, 0x1fe,
+    0x07c, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f0, 0x1f8, /* '6' */
+    0x11c, 0x00c, 0x006, 0x006, 0x0f6, 0x1fe,
+    0x38e, 0x306, 0x306, 0x306, 0x38c, 0x1fc,
+    0x0f8, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x3fe, 0x3fe, /* '7' */
+    0x180, 0x180, 0x180, 0x0c0, 0x0c0, 0x0c0,
+    0x060, 0x060, 0x060, 0x030, 0x030, 0x030,
+    0x018, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f8, 0x1fc, /* '8' */
+    0x38e, 0x306, 0x306, 0x18c, 0x0f8, 0x1fc,
+    0x18c, 0x306, 0x306, 0x306, 0x38e, 0x1fc,
+    0x0f8, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f8, 0x1fc, /* '9' */
+    0x18e, 0x306, 0x306, 0x306, 0x38e, 0x3fc,
+    0x378, 0x300, 0x300, 0x180, 0x1c4, 0x0fc,
+    0x078, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* ':' */
+    0x000, 0x000, 0x000, 0x060, 0x060, 0x060,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* ';' */
+    0x000, 0x000, 0x000, 0x060, 0x060, 0x060,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060,
+    0x060, 0x060, 0x030, 0x030, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '<' */
+    0x000, 0x000, 0x400, 0x780, 0x1e0, 0x078,
+    0x00e, 0x00e, 0x078, 0x1e0, 0x780, 0x400,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '=' */
+    0x000, 0x000, 0x000, 0x000, 0x7fe, 0x7fe,
+    0x000, 0x000, 0x7fe, 0x7fe, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '>' */
+    0x000, 0x000, 0x002, 0x01e, 0x078, 0x1e0,
+    0x700, 0x700, 0x1e0, 0x078, 0x01e, 0x002,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1f0, 0x3f8, /* '?' */
+    0x708, 0x600, 0x600, 0x700, 0x380, 0x1c0,
+    0x0e0, 0x060, 0x060, 0x060, 0x000, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x1e0, /* '@' */
+    0x318, 0x60c, 0x60c, 0x7c4, 0x646, 0x666,
+    0x666, 0x666, 0x666, 0x666, 0x646, 0x7cc,
+    0x00c, 0x018, 0x038, 0x1e0, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060, /* 'A' */
+    0x0f0, 0x0f0, 0x0f0, 0x1f8, 0x198, 0x198,
+    0x198, 0x39c, 0x3fc, 0x3fc, 0x30c, 0x606,
+    0x606, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0fe, 0x1fe, /* 'B' */
+    0x386, 0x306, 0x306, 0x386, 0x1fe, 0x1fe,
+    0x306, 0x606, 0x606, 0x606, 0x706, 0x3fe,
+    0x1fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x3e0, 0x7f8, /* 'C' */
+    0x41c, 0x00c, 0x006, 0x006, 0x006, 0x006,
+    0x006, 0x006, 0x006, 0x00c, 0x41c, 0x7f8,
+    0x3e0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x07e, 0x1fe, /* 'D' */
+    0x386, 0x306, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x606, 0x606, 0x306, 0x386, 0x1fe,
+    0x07e, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x7fe, 0x7fe, /* 'E' */
+    0x006, 0x006, 0x006, 0x006, 0x7fe, 0x7fe,
+    0x006, 0x006, 0x006, 0x006, 0x006, 0x7fe,
+    0x7fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x7fe, 0x7fe, /* 'F' */
+    0x006, 0x006, 0x006, 0x006, 0x3fe, 0x3fe,
+    0x006, 0x006, 0x006, 0x006, 0x006, 0x006,
+    0x006, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1f0, 0x3f8, /* 'G' */
+    0x21c, 0x00c, 0x006, 0x006, 0x006, 0x786,
+    0x786, 0x606, 0x606, 0x60c, 0x61c, 0x7f8,
+    0x1f0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x606, 0x606, /* 'H' */
+    0x606, 0x606, 0x606, 0x606, 0x7fe, 0x7fe,
+    0x606, 0x606, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x3fc, 0x3fc, /* 'I' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x3fc,
+    0x3fc, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1f8, 0x1f8, /* 'J' */
+    0x180, 0x180, 0x180, 0x180, 0x180, 0x180,
+    0x180, 0x180, 0x180, 0x180, 0x1c2, 0x0fe,
+    0x07c, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x606, 0x306, /* 'K' */
+    0x186, 0x0c6, 0x066, 0x036, 0x03e, 0x07e,
+    0x06e, 0x0c6, 0x1c6, 0x186, 0x306, 0x706,
+    0x606, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x006, 0x006, /* 'L' */
+    0x006, 0x006, 0x006, 0x006, 0x006, 0x006,
+    0x006, 0x006, 0x006, 0x006, 0x006, 0x7fe,
+    0x7fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x70e, 0x70e, /* 'M' */
+    0x70e, 0x79e, 0x696, 0x696, 0x6f6, 0x666,
+    0x666, 0x666, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x60e, 0x60e, /* 'N' */
+    0x61e, 0x61e, 0x636, 0x636, 0x626, 0x666,
+    0x646, 0x6c6, 0x6c6, 0x786, 0x786, 0x706,
+    0x706, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f0, 0x3fc, /* 'O' */
+    0x30c, 0x70e, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x606, 0x606, 0x70e, 0x30c, 0x3fc,
+    0x0f0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1fe, 0x3fe, /* 'P' */
+    0x706, 0x606, 0x606, 0x606, 0x706, 0x3fe,
+    0x1fe, 0x006, 0x006, 0x006, 0x006, 0x006,
+    0x006, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f0, 0x3fc, /* 'Q' */
+    0x30c, 0x70e, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x606, 0x606, 0x70e, 0x30c, 0x1f8,
+    0x0f0, 0x180, 0x300, 0x100, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1fe, 0x3fe, /* 'R' */
+    0x706, 0x606, 0x606, 0x706, 0x3fe, 0x1fe,
+    0x386, 0x306, 0x706, 0x606, 0xe06, 0xc06,
+    0xc06, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1f8, 0x3fc, /* 'S' */
+    0x20e, 0x006, 0x006, 0x00e, 0x07c, 0x1f8,
+    0x380, 0x600, 0x600, 0x600, 0x702, 0x3fe,
+    0x1fc, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0xfff, 0xfff, /* 'T' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x606, 0x606, /* 'U' */
+    0x606, 0x606, 0x606, 0x606, 0x606, 0x606,
+    0x606, 0x606, 0x606, 0x606, 0x70e, 0x3fc,
+    0x1f8, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x606, 0x606, /* 'V' */
+    0x30c, 0x30c, 0x30c, 0x30c, 0x198, 0x198,
+    0x198, 0x1f8, 0x0f0, 0x0f0, 0x0f0, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0xc03, 0xc03, /* 'W' */
+    0xc03, 0x606, 0x666, 0x666, 0x6f6, 0x6f6,
+    0x696, 0x696, 0x39c, 0x39c, 0x39c, 0x30c,
+    0x30c, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x70e, 0x30c, /* 'X' */
+    0x39c, 0x198, 0x0f0, 0x0f0, 0x060, 0x060,
+    0x0f0, 0x0f0, 0x1d8, 0x198, 0x38c, 0x30c,
+    0x706, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0xe07, 0x606, /* 'Y' */
+    0x30c, 0x30c, 0x198, 0x1f8, 0x0f0, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x7fe, 0x7fe, /* 'Z' */
+    0x300, 0x380, 0x180, 0x0c0, 0x0e0, 0x060,
+    0x070, 0x030, 0x018, 0x01c, 0x00c, 0x7fe,
+    0x7fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x1e0, 0x1e0, /* '[' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x1e0, 0x1e0, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x006, 0x00c, /* '\\' */
+    0x00c, 0x018, 0x018, 0x030, 0x030, 0x060,
+    0x060, 0x0c0, 0x0c0, 0x180, 0x180, 0x300,
+    0x300, 0x600, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0f0, 0x0f0, /* ']' */
+    0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0f0, 0x0f0, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0e0, 0x1b0, /* '^' */
+    0x318, 0x60c, 0xc06, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '_' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0xfff, 0xfff,
+    0x000, 0x000, 0x000, 0x018, 0x030, 0x060, /* '`' */
+    0x0c0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'a' */
+    0x000, 0x000, 0x0f8, 0x1fc, 0x384, 0x300,
+    0x3f8, 0x3fc, 0x30e, 0x306, 0x386, 0x3fe,
+    0x378, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x006, 0x006, /* 'b' */
+    0x006, 0x006, 0x0f6, 0x1fe, 0x18e, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x18e, 0x1fe,
+    0x0f6, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'c' */
+    0x000, 0x000, 0x0f0, 0x1fc, 0x10c, 0x006,
+    0x006, 0x006, 0x006, 0x006, 0x10c, 0x1fc,
+    0x0f0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x300, 0x300, /* 'd' */
+    0x300, 0x300, 0x378, 0x3fc, 0x38c, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x38c, 0x3fc,
+    0x378, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'e' */
+    0x000, 0x000, 0x0f0, 0x1fc, 0x38c, 0x306,
+    0x3fe, 0x3fe, 0x006, 0x006, 0x20c, 0x3fc,
+    0x1f0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x7c0, 0x7e0, /* 'f' */
+    0x060, 0x060, 0x7fc, 0x7fc, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'g' */
+    0x000, 0x000, 0x378, 0x3fc, 0x38c, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x38c, 0x3fc,
+    0x378, 0x300, 0x384, 0x1fc, 0x0f8, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x006, 0x006, /* 'h' */
+    0x006, 0x006, 0x0e6, 0x1fe, 0x38e, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x306, 0x306,
+    0x306, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060, /* 'i' */
+    0x000, 0x000, 0x07c, 0x07c, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x7fe,
+    0x7fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x0c0, 0x0c0, /* 'j' */
+    0x000, 0x000, 0x0f8, 0x0f8, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0, 0x0c0,
+    0x0c0, 0x0c0, 0x0c0, 0x07c, 0x03c, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x006, 0x006, /* 'k' */
+    0x006, 0x006, 0x386, 0x1c6, 0x0e6, 0x076,
+    0x03e, 0x03e, 0x06e, 0x0e6, 0x0c6, 0x186,
+    0x386, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x03f, 0x03f, /* 'l' */
+    0x030, 0x030, 0x030, 0x030, 0x030, 0x030,
+    0x030, 0x030, 0x030, 0x030, 0x070, 0x3e0,
+    0x3c0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'm' */
+    0x000, 0x000, 0x3b6, 0x7fe, 0x666, 0x666,
+    0x666, 0x666, 0x666, 0x666, 0x666, 0x666,
+    0x666, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'n' */
+    0x000, 0x000, 0x0e6, 0x1fe, 0x38e, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x306, 0x306,
+    0x306, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'o' */
+    0x000, 0x000, 0x0f8, 0x1fc, 0x18c, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x18c, 0x1fc,
+    0x0f8, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'p' */
+    0x000, 0x000, 0x0f6, 0x1fe, 0x18e, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x18e, 0x1fe,
+    0x0f6, 0x006, 0x006, 0x006, 0x006, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'q' */
+    0x000, 0x000, 0x378, 0x3fc, 0x38c, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x38c, 0x3fc,
+    0x378, 0x300, 0x300, 0x300, 0x300, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'r' */
+    0x000, 0x000, 0x730, 0xfb0, 0x8f0, 0x070,
+    0x030, 0x030, 0x030, 0x030, 0x030, 0x030,
+    0x030, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 's' */
+    0x000, 0x000, 0x1f8, 0x3fc, 0x206, 0x006,
+    0x0fe, 0x1f8, 0x380, 0x300, 0x382, 0x1fe,
+    0x0fc, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x030, /* 't' */
+    0x030, 0x030, 0x3fe, 0x3fe, 0x030, 0x030,
+    0x030, 0x030, 0x030, 0x030, 0x030, 0x3f0,
+    0x3e0, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'u' */
+    0x000, 0x000, 0x306, 0x306, 0x306, 0x306,
+    0x306, 0x306, 0x306, 0x306, 0x38e, 0x3fc,
+    0x338, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'v' */
+    0x000, 0x000, 0x306, 0x38e, 0x18c, 0x18c,
+    0x1dc, 0x0d8, 0x0d8, 0x0d8, 0x070, 0x070,
+    0x070, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'w' */
+    0x000, 0x000, 0xc03, 0xc03, 0x606, 0x666,
+    0x666, 0x666, 0x3fc, 0x39c, 0x39c, 0x39c,
+    0x30c, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'x' */
+    0x000, 0x000, 0x38e, 0x18c, 0x0d8, 0x0f8,
+    0x070, 0x070, 0x070, 0x0f8, 0x0d8, 0x18c,
+    0x38e, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'y' */
+    0x000, 0x000, 0x306, 0x18c, 0x18c, 0x18c,
+    0x0d8, 0x0d8, 0x0f8, 0x070, 0x070, 0x060,
+    0x030, 0x030, 0x030, 0x01c, 0x01c, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* 'z' */
+    0x000, 0x000, 0x3fe, 0x3fe, 0x1c0, 0x0c0,
+    0x0e0, 0x070, 0x038, 0x018, 0x00c, 0x3fe,
+    0x3fe, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x3c0, 0x3e0, /* '{' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x03c, 0x03c, 0x070, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x3e0, 0x3c0, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x060, 0x060, /* '|' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x000, 0x000, 0x000, 0x000, 0x03c, 0x07c, /* '}' */
+    0x060, 0x060, 0x060, 0x060, 0x060, 0x060,
+    0x3c0, 0x3c0, 0x0e0, 0x060, 0x060, 0x060,
+    0x060, 0x060, 0x07c, 0x03c, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* '~' */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x43c,
+    0x7fe, 0x3c2, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000, /* DEL */
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+    0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+};
+
+#endif
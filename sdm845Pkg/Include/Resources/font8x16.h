@@ -0,0 +1,241 @@
+/*
+ * Glyphs 32 to 127 of DejaVu Sans Mono, rasterized to a 8x16 bitmap.
+ * One byte per row, bit 0 is the leftmost pixel.
+ *
+ * Bitstream Vera Fonts Copyright (c) 2003 by Bitstream, Inc. All Rights
+ * Reserved. Bitstream Vera is a trademark of Bitstream, Inc.
+ * DejaVu changes are in public domain.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of the fonts accompanying this license ("Fonts") and associated
+ * documentation files (the "Font Software"), to reproduce and distribute
+ * the Font Software, including without limitation the rights to use, copy,
+ * merge, publish, distribute, and/or sell copies of the Font Software, and
+ * to permit persons to whom the Font Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright and trademark notices and this permission notice
+ * shall be included in all copies of one or more of the Font Software
+ * typefaces.
+ *
+ * The Font Software may be modified, altered, or added to, and in
+ * particular the designs of glyphs or characters in the Fonts may be
+ * modified and additional glyphs or characters may be added to the Fonts,
+ * only if the fonts are renamed to names not containing either the words
+ * "Bitstream" or the word "Vera".
+ *
+ * The Font Software may not be sold by itself.
+ *
+ * THE FONT SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO ANY WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF
+ * COPYRIGHT, PATENT, TRADEMARK, OR OTHER RIGHT. IN NO EVENT SHALL
+ * BITSTREAM OR THE GNOME FOUNDATION BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, INCLUDING ANY GENERAL, SPECIAL, INDIRECT, INCIDENTAL,
+ * OR CONSEQUENTIAL DAMAGES, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF THE USE OR INABILITY TO USE THE FONT
+ * SOFTWARE OR FROM OTHER DEALINGS IN THE FONT SOFTWARE.
+ */
+
+#ifndef _FONT_8X16_DATA_
+#define _FONT_8X16_DATA_
+
+#define FONT8X16_WIDTH		8
+#define FONT8X16_HEIGHT	16
+
+unsigned char font8x16[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* ' ' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, /* '!' */
+    0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x28, 0x28, 0x28, 0x28, 0x00, 0x00, /* '"' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x48, 0x48, 0x68, 0xfe, 0x24, 0x24, /* '#' */
+    0x7f, 0x14, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x10, 0x10, 0x7c, 0x92, 0x12, 0x16, 0x7c, /* '$' */
+    0xd0, 0x90, 0x92, 0x7c, 0x10, 0x10, 0x00, 0x00,
+    0x00, 0x00, 0x06, 0x09, 0x09, 0x46, 0x30, 0x0c, /* '%' */
+    0x62, 0x90, 0x90, 0x60, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x38, 0x04, 0x04, 0x0c, 0x0c, 0x92, /* '&' */
+    0xa2, 0xa2, 0x46, 0xbc, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, /* "'" */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x30, 0x10, 0x10, 0x08, 0x08, 0x08, 0x08, /* '(' */
+    0x08, 0x08, 0x10, 0x10, 0x20, 0x00, 0x00, 0x00,
+    0x00, 0x0c, 0x08, 0x08, 0x10, 0x10, 0x10, 0x10, /* ')' */
+    0x10, 0x10, 0x08, 0x08, 0x04, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x92, 0x7c, 0x38, 0xd6, 0x10, /* '*' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0xfe, /* '+' */
+    0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* ',' */
+    0x00, 0x00, 0x18, 0x18, 0x08, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* '-' */
+    0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* '.' */
+    0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x40, 0x20, 0x20, 0x20, 0x10, 0x10, /* '/' */
+    0x08, 0x08, 0x04, 0x04, 0x04, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x38, 0x44, 0x82, 0x82, 0x92, 0x82, /* '0' */
+    0x82, 0x82, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x18, 0x14, 0x10, 0x10, 0x10, 0x10, /* '1' */
+    0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7c, 0xc2, 0x80, 0x80, 0x40, 0x60, /* '2' */
+    0x30, 0x08, 0x04, 0xfe, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7c, 0x82, 0x80, 0xc0, 0x38, 0xc0, /* '3' */
+    0x80, 0x80, 0xc2, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x60, 0x50, 0x58, 0x48, 0x44, 0x42, /* '4' */
+    0xfe, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7e, 0x02, 0x02, 0x3e, 0x42, 0x80, /* '5' */
+    0x80, 0x80, 0x42, 0x3c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0x8c, 0x06, 0x02, 0x7a, 0xc6, /* '6' */
+    0x82, 0x82, 0xc4, 0x78, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfe, 0xc0, 0x40, 0x20, 0x20, 0x10, /* '7' */
+    0x10, 0x08, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7c, 0x82, 0x82, 0x82, 0x7c, 0xc6, /* '8' */
+    0x82, 0x82, 0xc6, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x3c, 0x46, 0x82, 0x82, 0xc6, 0xbc, /* '9' */
+    0x80, 0xc0, 0x62, 0x3c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, /* ':' */
+    0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, /* ';' */
+    0x00, 0x00, 0x18, 0x18, 0x08, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x80, 0x70, 0x1c, 0x02, /* '<' */
+    0x1c, 0x70, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xfe, 0x00, 0x00, /* '=' */
+    0xfe, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x02, 0x1c, 0x70, 0x80, /* '>' */
+    0x70, 0x1c, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x1c, 0x22, 0x20, 0x30, 0x18, 0x08, /* '?' */
+    0x08, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0xcc, 0x84, 0xe2, 0x92, 0x92, /* '@' */
+    0x92, 0x92, 0xe2, 0x04, 0x0c, 0x70, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x28, 0x28, 0x28, 0x28, 0x44, /* 'A' */
+    0x7c, 0x44, 0x82, 0x82, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7e, 0x82, 0x82, 0x82, 0x7e, 0xc2, /* 'B' */
+    0x82, 0x82, 0xc2, 0x7e, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0x84, 0x02, 0x02, 0x02, 0x02, /* 'C' */
+    0x02, 0x02, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x3e, 0x42, 0x82, 0x82, 0x82, 0x82, /* 'D' */
+    0x82, 0x82, 0x42, 0x3e, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfe, 0x02, 0x02, 0x02, 0xfe, 0x02, /* 'E' */
+    0x02, 0x02, 0x02, 0xfe, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfe, 0x02, 0x02, 0x02, 0xfe, 0x02, /* 'F' */
+    0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0x84, 0x02, 0x02, 0x02, 0xc2, /* 'G' */
+    0x82, 0x82, 0x84, 0x78, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x82, 0x82, 0x82, 0x82, 0xfe, 0x82, /* 'H' */
+    0x82, 0x82, 0x82, 0x82, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, /* 'I' */
+    0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0x40, 0x40, 0x40, 0x40, 0x40, /* 'J' */
+    0x40, 0x40, 0x62, 0x3c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x42, 0x22, 0x12, 0x0a, 0x0e, 0x12, /* 'K' */
+    0x32, 0x22, 0x42, 0x82, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, /* 'L' */
+    0x02, 0x02, 0x02, 0xfe, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xc6, 0xc6, 0xaa, 0xaa, 0xaa, 0x92, /* 'M' */
+    0x82, 0x82, 0x82, 0x82, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x86, 0x86, 0x8a, 0x8a, 0x92, 0x92, /* 'N' */
+    0xa2, 0xa2, 0xc2, 0xc2, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x38, 0x44, 0x82, 0x82, 0x82, 0x82, /* 'O' */
+    0x82, 0x82, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x7e, 0xc2, 0x82, 0x82, 0xc2, 0x7e, /* 'P' */
+    0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x38, 0x44, 0x82, 0x82, 0x82, 0x82, /* 'Q' */
+    0x82, 0x82, 0x44, 0x78, 0x60, 0x40, 0x00, 0x00,
+    0x00, 0x00, 0x7e, 0xc2, 0x82, 0x82, 0xc2, 0x3e, /* 'R' */
+    0x42, 0x82, 0x82, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x78, 0x86, 0x02, 0x02, 0x0c, 0x70, /* 'S' */
+    0x80, 0x80, 0xc2, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfe, 0x10, 0x10, 0x10, 0x10, 0x10, /* 'T' */
+    0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, /* 'U' */
+    0x82, 0x82, 0xc6, 0x7c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x82, 0x82, 0x44, 0x44, 0x44, 0x28, /* 'V' */
+    0x28, 0x28, 0x28, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x81, 0x81, 0x81, 0x99, 0x5a, 0x5a, /* 'W' */
+    0x5a, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x82, 0x44, 0x28, 0x28, 0x10, 0x28, /* 'X' */
+    0x28, 0x44, 0x44, 0x82, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x82, 0x44, 0x44, 0x28, 0x38, 0x10, /* 'Y' */
+    0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfe, 0xc0, 0x40, 0x20, 0x10, 0x10, /* 'Z' */
+    0x08, 0x04, 0x06, 0xfe, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, /* '[' */
+    0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x04, 0x04, 0x04, 0x08, 0x08, /* '\\' */
+    0x10, 0x10, 0x20, 0x20, 0x20, 0x40, 0x00, 0x00,
+    0x00, 0x1c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, /* ']' */
+    0x10, 0x10, 0x10, 0x10, 0x1c, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x28, 0x44, 0xc6, 0x00, 0x00, /* '^' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* '_' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00,
+    0x0c, 0x08, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, /* '`' */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x40, 0x7c, /* 'a' */
+    0x42, 0x42, 0x62, 0x5c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x02, 0x02, 0x02, 0x3e, 0x26, 0x42, 0x42, /* 'b' */
+    0x42, 0x42, 0x26, 0x3a, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x02, 0x02, /* 'c' */
+    0x02, 0x02, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x40, 0x40, 0x40, 0x7c, 0x64, 0x42, 0x42, /* 'd' */
+    0x42, 0x42, 0x64, 0x5c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3c, 0x64, 0x42, 0x7e, /* 'e' */
+    0x02, 0x02, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x70, 0x08, 0x08, 0x7e, 0x08, 0x08, 0x08, /* 'f' */
+    0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x5c, 0x64, 0x42, 0x42, /* 'g' */
+    0x42, 0x42, 0x64, 0x5c, 0x40, 0x44, 0x38, 0x00,
+    0x00, 0x02, 0x02, 0x02, 0x3a, 0x46, 0x42, 0x42, /* 'h' */
+    0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x10, 0x10, 0x00, 0x1c, 0x10, 0x10, 0x10, /* 'i' */
+    0x10, 0x10, 0x10, 0xfe, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x10, 0x10, 0x00, 0x1c, 0x10, 0x10, 0x10, /* 'j' */
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0e, 0x00,
+    0x00, 0x02, 0x02, 0x02, 0x22, 0x12, 0x0a, 0x0e, /* 'k' */
+    0x12, 0x12, 0x22, 0x42, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x0f, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, /* 'l' */
+    0x08, 0x08, 0x08, 0x70, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x7e, 0x92, 0x92, 0x92, /* 'm' */
+    0x92, 0x92, 0x92, 0x92, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3a, 0x46, 0x42, 0x42, /* 'n' */
+    0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, /* 'o' */
+    0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3a, 0x26, 0x42, 0x42, /* 'p' */
+    0x42, 0x42, 0x26, 0x3e, 0x02, 0x02, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x5c, 0x64, 0x42, 0x42, /* 'q' */
+    0x42, 0x42, 0x64, 0x5c, 0x40, 0x40, 0x40, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3c, 0x4c, 0x04, 0x04, /* 'r' */
+    0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3c, 0x42, 0x02, 0x0e, /* 's' */
+    0x70, 0x40, 0x42, 0x3c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x08, 0x08, 0x7e, 0x08, 0x08, 0x08, /* 't' */
+    0x08, 0x08, 0x08, 0x70, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, /* 'u' */
+    0x42, 0x42, 0x62, 0x5c, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x24, 0x24, /* 'v' */
+    0x24, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0x5a, 0x5a, /* 'w' */
+    0x5a, 0x5a, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x42, 0x24, 0x18, 0x18, /* 'x' */
+    0x18, 0x24, 0x24, 0x42, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x42, 0x44, 0x24, 0x24, /* 'y' */
+    0x28, 0x18, 0x10, 0x10, 0x10, 0x08, 0x0c, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x7e, 0x40, 0x20, 0x10, /* 'z' */
+    0x08, 0x04, 0x02, 0x7e, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x60, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0c, /* '{' */
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x60, 0x00, 0x00,
+    0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, /* '|' */
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00,
+    0x00, 0x0c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x60, /* '}' */
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x0c, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9c, /* '~' */
+    0x62, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* DEL */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+#endif
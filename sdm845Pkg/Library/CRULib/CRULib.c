@@ -899,6 +899,107 @@ rk3399_vop_set_clk(UINT32 clk_id, UINT32 hz)
 	return hz;
 }
 
+/*
+ * The sdmmc/sdio controllers divide their input clock by two internally,
+ * so rates here are the ones seen by the controller, i.e. half of the
+ * CRU output for SCLK_SDMMC. GPLL is read back rather than assumed, the
+ * earlier boot stages do not always leave it at GPLL_HZ.
+ */
+UINT32
+rk3399_mmc_get_clk(
+  IN  UINT32 clk_id
+  )
+{
+  UINT32 div, con;
+
+  switch (clk_id) {
+  case HCLK_SDMMC:
+  case SCLK_SDMMC:
+    con = MmioRead32((UINTN) &cru->clksel_con[16]);
+    div = 2;
+    break;
+  case SCLK_EMMC:
+    con = MmioRead32((UINTN) &cru->clksel_con[22]);
+    div = 1;
+    break;
+  default:
+    return 0;
+  }
+
+  div *= ((con & CLK_EMMC_DIV_CON_MASK) >> CLK_EMMC_DIV_CON_SHIFT) + 1;
+  if ((con & CLK_EMMC_PLL_MASK) >> CLK_EMMC_PLL_SHIFT == CLK_EMMC_PLL_SEL_24M) {
+    return OSC_HZ / div;
+  }
+  return rk3399_pll_get_rate(PLL_GPLL) / div;
+}
+
+UINT32
+rk3399_mmc_set_clk(
+  IN  UINT32 clk_id,
+  IN  UINT32 hz
+  )
+{
+  UINT32 src_clk_div;
+  UINT32 aclk_emmc = 200 * MHz;
+  UINT32 gpll_hz;
+
+  if (hz == 0) {
+    return 0;
+  }
+
+  gpll_hz = rk3399_pll_get_rate(PLL_GPLL);
+
+  switch (clk_id) {
+  case HCLK_SDMMC:
+  case SCLK_SDMMC:
+    /* Provide twice the rate, the controller halves it. */
+    src_clk_div = DIV_ROUND_UP(gpll_hz / 2, hz);
+    if (src_clk_div > 128) {
+      /* use 24MHz source for the 400KHz identification clock */
+      src_clk_div = DIV_ROUND_UP(OSC_HZ / 2, hz);
+      ASSERT(src_clk_div - 1 < 128);
+      rk_clrsetreg(&cru->clksel_con[16],
+                   CLK_EMMC_PLL_MASK | CLK_EMMC_DIV_CON_MASK,
+                   CLK_EMMC_PLL_SEL_24M << CLK_EMMC_PLL_SHIFT |
+                   (src_clk_div - 1) << CLK_EMMC_DIV_CON_SHIFT);
+    } else {
+      rk_clrsetreg(&cru->clksel_con[16],
+                   CLK_EMMC_PLL_MASK | CLK_EMMC_DIV_CON_MASK,
+                   CLK_EMMC_PLL_SEL_GPLL << CLK_EMMC_PLL_SHIFT |
+                   (src_clk_div - 1) << CLK_EMMC_DIV_CON_SHIFT);
+    }
+    break;
+  case SCLK_EMMC:
+    /* aclk_emmc has to keep up with the 200MHz HS200/HS400 card clock */
+    src_clk_div = DIV_ROUND_UP(gpll_hz, aclk_emmc);
+    ASSERT(src_clk_div - 1 < 32);
+    rk_clrsetreg(&cru->clksel_con[21],
+                 ACLK_EMMC_PLL_SEL_MASK | ACLK_EMMC_DIV_CON_MASK,
+                 ACLK_EMMC_PLL_SEL_GPLL << ACLK_EMMC_PLL_SEL_SHIFT |
+                 (src_clk_div - 1) << ACLK_EMMC_DIV_CON_SHIFT);
+
+    src_clk_div = DIV_ROUND_UP(gpll_hz, hz);
+    if (src_clk_div > 128) {
+      src_clk_div = DIV_ROUND_UP(OSC_HZ, hz);
+      ASSERT(src_clk_div - 1 < 128);
+      rk_clrsetreg(&cru->clksel_con[22],
+                   CLK_EMMC_PLL_MASK | CLK_EMMC_DIV_CON_MASK,
+                   CLK_EMMC_PLL_SEL_24M << CLK_EMMC_PLL_SHIFT |
+                   (src_clk_div - 1) << CLK_EMMC_DIV_CON_SHIFT);
+    } else {
+      rk_clrsetreg(&cru->clksel_con[22],
+                   CLK_EMMC_PLL_MASK | CLK_EMMC_DIV_CON_MASK,
+                   CLK_EMMC_PLL_SEL_GPLL << CLK_EMMC_PLL_SHIFT |
+                   (src_clk_div - 1) << CLK_EMMC_DIV_CON_SHIFT);
+    }
+    break;
+  default:
+    return 0;
+  }
+
+  return rk3399_mmc_get_clk(clk_id);
+}
+
 UINT32
 rk3399_clk_get_rate(
   UINTN id
@@ -914,10 +1015,10 @@ rk3399_clk_get_rate(
   case PLL_NPLL:
   case PLL_VPLL:
     return rk3399_pll_get_rate(id);
-  /* case HCLK_SDMMC: */
-  /* case SCLK_SDMMC: */
-  /* case SCLK_EMMC: */
-  /*   return rk3399_mmc_get_clk(id); */
+  case HCLK_SDMMC:
+  case SCLK_SDMMC:
+  case SCLK_EMMC:
+    return rk3399_mmc_get_clk(id);
   /* case SCLK_I2C1: */
   /* case SCLK_I2C2: */
   /* case SCLK_I2C3: */
@@ -0,0 +1,132 @@
+/** @file
+  Geometry of the framebuffer the console and the GOP driver draw to.
+
+  The preloader may leave the panel running with another mode than the one
+  the platform PCDs describe, and then reports it in UefiDisplayInfo of its
+  environment. Both consumers of the framebuffer take the geometry from here
+  so that they never disagree about it.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Base.h>
+#include <Uefi/UefiBaseType.h>
+
+#include <Library/DisplayInfoLib.h>
+#include <Library/PcdLib.h>
+
+#include <Configuration/Hob.h>
+
+/**
+  CRC-32 (IEEE 802.3) of a buffer, as the preloader computes it.
+
+  Bitwise so that it does not need a table, the environment is small and is
+  only checked once per consumer.
+**/
+STATIC
+UINT32
+DisplayInfoCrc32 (
+  IN CONST VOID             *Buffer,
+  IN UINTN                  Length
+  )
+{
+  CONST UINT8             *Bytes;
+  UINT32                  Crc;
+  UINTN                   Bit;
+
+  Bytes = Buffer;
+  Crc = MAX_UINT32;
+  while (Length-- > 0) {
+    Crc ^= *Bytes++;
+    for (Bit = 0; Bit < 8; Bit++) {
+      Crc = (Crc >> 1) ^ (0xEDB88320 & (0 - (Crc & 1)));
+    }
+  }
+  return ~Crc;
+}
+
+/**
+  Read the framebuffer geometry from the preloader environment.
+
+  @retval TRUE            The environment is intact and describes a usable
+                          framebuffer.
+  @retval FALSE           Info was not touched.
+**/
+STATIC
+BOOLEAN
+DisplayInfoFromPreloader (
+  OUT DISPLAY_INFO          *Info
+  )
+{
+  PPRELOADER_ENVIRONMENT  Env;
+  UINT32                  *Entries;
+  UINT32                  Stride;
+
+  Env = (PPRELOADER_ENVIRONMENT)(UINTN)PRELOADER_ENV_ADDR;
+  if ((Env->Header != PRELOADER_HEADER) ||
+      (Env->PreloaderVersion < PRELOADER_VERSION_MIN)) {
+    return FALSE;
+  }
+  if (DisplayInfoCrc32 (Env, OFFSET_OF (PRELOADER_ENVIRONMENT, Crc32)) != Env->Crc32) {
+    return FALSE;
+  }
+
+  // Older preloaders leave the entries free, only a signed block is trusted
+  Entries = Env->UefiDisplayInfo;
+  if ((Entries[PRELOADER_DISPLAY_INFO_SIGNATURE] != PRELOADER_DISPLAY_INFO_SIGNATURE_VALUE) ||
+      (Entries[PRELOADER_DISPLAY_INFO_VERSION] < PRELOADER_DISPLAY_INFO_VERSION_1)) {
+    return FALSE;
+  }
+
+  if ((Entries[PRELOADER_DISPLAY_INFO_BASE] == 0) ||
+      (Entries[PRELOADER_DISPLAY_INFO_WIDTH] == 0) ||
+      (Entries[PRELOADER_DISPLAY_INFO_HEIGHT] == 0)) {
+    return FALSE;
+  }
+  if ((Entries[PRELOADER_DISPLAY_INFO_BPP] != 16) &&
+      (Entries[PRELOADER_DISPLAY_INFO_BPP] != 24) &&
+      (Entries[PRELOADER_DISPLAY_INFO_BPP] != 32)) {
+    return FALSE;
+  }
+
+  // Tightly packed lines when the stride is not reported
+  Stride = Entries[PRELOADER_DISPLAY_INFO_STRIDE];
+  if (Stride == 0) {
+    Stride = Entries[PRELOADER_DISPLAY_INFO_WIDTH];
+  }
+  if (Stride < Entries[PRELOADER_DISPLAY_INFO_WIDTH]) {
+    return FALSE;
+  }
+
+  Info->FrameBufferBase = Entries[PRELOADER_DISPLAY_INFO_BASE];
+  Info->Width = Entries[PRELOADER_DISPLAY_INFO_WIDTH];
+  Info->Height = Entries[PRELOADER_DISPLAY_INFO_HEIGHT];
+  Info->Stride = Stride;
+  Info->Bpp = Entries[PRELOADER_DISPLAY_INFO_BPP];
+  return TRUE;
+}
+
+BOOLEAN
+EFIAPI
+GetDisplayInfo (
+  OUT DISPLAY_INFO          *Info
+  )
+{
+  if (DisplayInfoFromPreloader (Info)) {
+    return TRUE;
+  }
+
+  Info->FrameBufferBase = FixedPcdGet32 (PcdMipiFrameBufferAddress);
+  Info->Width = FixedPcdGet32 (PcdMipiFrameBufferWidth);
+  Info->Height = FixedPcdGet32 (PcdMipiFrameBufferHeight);
+  Info->Stride = FixedPcdGet32 (PcdMipiFrameBufferWidth);
+  Info->Bpp = FixedPcdGet32 (PcdMipiFrameBufferPixelBpp);
+  return FALSE;
+}
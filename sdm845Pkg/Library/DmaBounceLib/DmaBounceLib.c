@@ -0,0 +1,113 @@
+/** @file
+  Map transfer buffers for DMA engines that only reach part of memory.
+
+  The DesignWare MMC IDMAC and the SDHCI ADMA2 engine both take 32-bit
+  buffer addresses and are fed by descriptors of their own format. This
+  library splits a buffer into the segments those descriptors describe and
+  does the cache maintenance and the staging for them.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Base.h>
+
+#include <Library/ArmLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DmaBounceLib.h>
+
+BOOLEAN
+EFIAPI
+DmaBounceMap (
+  IN  VOID                      *Buffer,
+  IN  UINTN                     Length,
+  IN  BOOLEAN                   IsRead,
+  IN  UINTN                     AddressLimit,
+  IN  UINT8                     *Bounce OPTIONAL,
+  IN  UINTN                     BounceSize,
+  OUT DMA_BOUNCE_MAP            *Map
+  )
+{
+  UINTN  LineSize;
+  UINTN  Start;
+  UINTN  End;
+  UINTN  Index;
+
+  if (Length == 0) {
+    return FALSE;
+  }
+
+  LineSize = ArmDataCacheLineLength ();
+  Start = ALIGN_VALUE ((UINTN)Buffer, LineSize);
+  End = ((UINTN)Buffer + Length) & ~(LineSize - 1);
+
+  Map->Buffer = (UINT8 *)Buffer;
+  Map->Length = Length;
+  Map->IsRead = IsRead;
+  Map->Bounce = Bounce;
+  Map->SegmentCount = 0;
+
+  if ((((UINTN)Buffer & (sizeof (UINT32) - 1)) == 0) &&
+      (((UINTN)Buffer + Length - 1) <= AddressLimit) && (Start < End) &&
+      ((Bounce != NULL) || ((Start == (UINTN)Buffer) && (End == (UINTN)Buffer + Length)))) {
+    Map->HeadLength = Start - (UINTN)Buffer;
+    Map->TailLength = (UINTN)Buffer + Length - End;
+    if (Map->HeadLength != 0) {
+      Map->Segments[Map->SegmentCount].Address = (UINTN)Bounce;
+      Map->Segments[Map->SegmentCount++].Length = Map->HeadLength;
+    }
+    Map->Segments[Map->SegmentCount].Address = Start;
+    Map->Segments[Map->SegmentCount++].Length = End - Start;
+    if (Map->TailLength != 0) {
+      Map->Segments[Map->SegmentCount].Address = (UINTN)(Bounce + LineSize);
+      Map->Segments[Map->SegmentCount++].Length = Map->TailLength;
+    }
+  } else if ((Bounce != NULL) && (Length <= BounceSize)) {
+    Map->HeadLength = Length;
+    Map->TailLength = 0;
+    Map->Segments[0].Address = (UINTN)Bounce;
+    Map->Segments[0].Length = Length;
+    Map->SegmentCount = 1;
+  } else {
+    return FALSE;
+  }
+
+  if (!IsRead) {
+    CopyMem (Bounce, Map->Buffer, Map->HeadLength);
+    CopyMem (Bounce + LineSize, Map->Buffer + Length - Map->TailLength, Map->TailLength);
+  }
+  for (Index = 0; Index < Map->SegmentCount; Index++) {
+    if (IsRead) {
+      InvalidateDataCacheRange ((VOID *)Map->Segments[Index].Address, Map->Segments[Index].Length);
+    } else {
+      WriteBackDataCacheRange ((VOID *)Map->Segments[Index].Address, Map->Segments[Index].Length);
+    }
+  }
+  return TRUE;
+}
+
+VOID
+EFIAPI
+DmaBounceUnmap (
+  IN DMA_BOUNCE_MAP             *Map
+  )
+{
+  UINTN  Index;
+
+  if (!Map->IsRead) {
+    return;
+  }
+  for (Index = 0; Index < Map->SegmentCount; Index++) {
+    InvalidateDataCacheRange ((VOID *)Map->Segments[Index].Address, Map->Segments[Index].Length);
+  }
+  CopyMem (Map->Buffer, Map->Bounce, Map->HeadLength);
+  CopyMem (Map->Buffer + Map->Length - Map->TailLength,
+    Map->Bounce + ArmDataCacheLineLength (), Map->TailLength);
+}
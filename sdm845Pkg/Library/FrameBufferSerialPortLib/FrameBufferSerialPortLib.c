@@ -1,11 +1,15 @@
 #include <PiDxe.h>
 
 #include <Library/ArmLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/CacheMaintenanceLib.h>
+#include <Library/DisplayInfoLib.h>
 #include <Library/HobLib.h>
 #include <Library/SerialPortLib.h>
 
 #include <Resources/font5x12.h>
+#include <Resources/font8x16.h>
+#include <Resources/font12x24.h>
 #include <Resources/FbColor.h>
 
 #include "FrameBufferSerialPortLib.h"
@@ -15,17 +19,94 @@ FBCON_POSITION m_MaxPosition;
 FBCON_COLOR m_Color;
 BOOLEAN m_Initialized = FALSE;
 
+// Geometry of the framebuffer, replaced by the one the preloader set up
+// when it reports it. gStride is in pixels.
+char *gFrameBuffer = (char*)FixedPcdGet32(PcdMipiFrameBufferAddress);
 UINTN gWidth = FixedPcdGet32(PcdMipiFrameBufferWidth);
 // Reserve half screen for output
 UINTN gHeight = FixedPcdGet32(PcdMipiFrameBufferHeight);
+UINTN gStride = FixedPcdGet32(PcdMipiFrameBufferWidth);
 UINTN gBpp = FixedPcdGet32(PcdMipiFrameBufferPixelBpp);
 
+// Stores a color, given as BGRA8888, in the format of the framebuffer.
+// Chosen once by FbConReset().
+typedef void (*FBCON_STORE_PIXEL)(unsigned char *pixel, UINTN color);
+FBCON_STORE_PIXEL m_StorePixel;
+
+// Font of the console, see PcdFrameBufferFont, and its integer scale.
+#define FBCON_FONT_5X12		0
+#define FBCON_FONT_8X16		1
+#define FBCON_FONT_12X24	2
+#define FBCON_FONT			FixedPcdGet32(PcdFrameBufferFont)
+#define FBCON_SCALE			FixedPcdGet32(PcdFrameBufferFontScale)
+
+// Glyph box, font5x12 gets a spacing column the others already have.
+#define FBCON_GLYPH_WIDTH	(FBCON_FONT == FBCON_FONT_12X24 ? FONT12X24_WIDTH : \
+							 FBCON_FONT == FBCON_FONT_8X16 ? FONT8X16_WIDTH : FONT_WIDTH + 1)
+#define FBCON_GLYPH_HEIGHT	(FBCON_FONT == FBCON_FONT_12X24 ? FONT12X24_HEIGHT : \
+							 FBCON_FONT == FBCON_FONT_8X16 ? FONT8X16_HEIGHT : FONT_HEIGHT)
+#define FBCON_GLYPHS		96
+
+// Glyphs of the selected font, one packed row per scanline, bit 0 being the
+// leftmost pixel. Built once by FbConReset() whatever the source format.
+UINT16 m_Atlas[FBCON_GLYPHS][FBCON_GLYPH_HEIGHT];
+
+// A glyph row is drawn in chunks of FBCON_CHUNK_BITS pixels, each already
+// expanded to pixels at the scale, so that a row is a few copies and the
+// other scanlines of the row are copies of the first one. The table is
+// indexed by the bits of a chunk and rebuilt whenever the colors change.
+#define FBCON_CHUNK_BITS	(FBCON_GLYPH_WIDTH % 4 == 0 ? 4 : FBCON_GLYPH_WIDTH)
+UINT32 m_GlyphChunks[1 << FBCON_CHUNK_BITS][FBCON_CHUNK_BITS * FBCON_SCALE];
+FBCON_COLOR m_GlyphChunksColor;
+
+// Text shadow of the console. Writes only store characters in the cells,
+// which are rasterized later by FbConRender() with interrupts enabled.
+// Sized for the PCD geometry, a larger mode only uses its top left part.
+#define FBCON_CELL_WIDTH	(FBCON_GLYPH_WIDTH * FBCON_SCALE)
+#define FBCON_CELL_HEIGHT	(FBCON_GLYPH_HEIGHT * FBCON_SCALE)
+#define FBCON_MAX_COLUMNS	(FixedPcdGet32(PcdMipiFrameBufferWidth) / FBCON_CELL_WIDTH)
+#define FBCON_MAX_ROWS		(FixedPcdGet32(PcdMipiFrameBufferHeight) / FBCON_CELL_HEIGHT)
+#define FBCON_ROW_CLEAN		MAX_UINT16
+
+FBCON_CELL m_Cells[FBCON_MAX_ROWS][FBCON_MAX_COLUMNS];
+// Columns of every row holding text, and the first one changed since the
+// row was last rendered, FBCON_ROW_CLEAN if none
+UINT16 m_RowLength[FBCON_MAX_ROWS];
+UINT16 m_RowDirty[FBCON_MAX_ROWS];
+// Columns drawn on every row of the screen, only touched by the renderer
+UINT16 m_RowDrawn[FBCON_MAX_ROWS];
+// Lines the text scrolled up by since the pixels were last moved
+UINTN m_PendingScroll = 0;
+BOOLEAN m_RenderPending = FALSE;
+BOOLEAN m_Rendering = FALSE;
+
+// Foreground of the cells, by FbConMsgType
+UINTN m_MsgColors[] = {
+	FB_BGRA8888_WHITE,
+	FB_BGRA8888_WHITE,
+	FB_BGRA8888_WHITE,
+	FB_BGRA8888_SILVER,
+	FB_BGRA8888_YELLOW,
+	FB_BGRA8888_ORANGE,
+	FB_BGRA8888_RED,
+	FB_BGRA8888_GREEN,
+	FB_BGRA8888_WHITE,
+};
+
+// Pixels drawn since the last flush, empty while m_DirtyTop >= m_DirtyBottom.
+// Only these are cleaned from the cache, not the whole framebuffer.
+UINTN m_DirtyLeft = 0;
+UINTN m_DirtyRight = 0;
+UINTN m_DirtyTop = 0;
+UINTN m_DirtyBottom = 0;
+// Characters written since the last rendering
+UINTN m_PendingChars = 0;
+
 // Module-used internal routine
-void FbConPutCharWithFactor
+void FbConPutChar
 (
 	char c,
-	int type,
-	unsigned scale_factor
+	int type
 );
 
 void FbConDrawglyph
@@ -33,12 +114,40 @@ void FbConDrawglyph
 	char *pixels,
 	unsigned stride,
 	unsigned bpp,
-	unsigned *glyph,
-	unsigned scale_factor
+	UINT16 *glyph
+);
+
+void FbConBuildGlyphChunks
+(
+	unsigned bpp
 );
 
+void FbConDrawCells
+(
+	UINTN row,
+	UINTN column,
+	FBCON_CELL *cells,
+	UINTN count
+);
+
+void FbConMarkDirty
+(
+	UINTN x,
+	UINTN y,
+	UINTN width,
+	UINTN height
+);
+
+void FbConStorePixel16(unsigned char *pixel, UINTN color);
+void FbConStorePixel32(unsigned char *pixel, UINTN color);
+void FbConStorePixelBytes(unsigned char *pixel, UINTN color);
+
+void FbConLoadGeometry(void);
+void FbConBuildAtlas(void);
 void FbConReset(void);
-void FbConScrollUp(void);
+void FbConNewLine(void);
+void FbConScrollUp(UINTN rows);
+void FbConRender(void);
 void FbConFlush(void);
 
 RETURN_STATUS
@@ -70,71 +179,168 @@ SerialPortInitialize
 void ResetFb(void)
 {
 	// Clear current screen.
-	char* Pixels = (void*)FixedPcdGet32(PcdMipiFrameBufferAddress);
-	UINTN BgColor = FB_BGRA8888_BLACK;
+	char* Pixels = gFrameBuffer;
+	UINTN LineBytes = gStride * (gBpp / 8);
 
-	// Set to black color.
+	if (!m_Initialized) return;
+
+	// Set the first line to black color, then replicate it.
 	for (UINTN i = 0; i < gWidth; i++)
 	{
-		for (UINTN j = 0; j < gHeight; j++)
-		{
-			BgColor = FB_BGRA8888_BLACK;
-			// Set pixel bit
-			for (UINTN p = 0; p < (gBpp / 8); p++)
-			{
-				*Pixels = (unsigned char)BgColor;
-				BgColor = BgColor >> 8;
-				Pixels++;
-			}
-		}
+		m_StorePixel((unsigned char *)Pixels + i * (gBpp / 8), FB_BGRA8888_BLACK);
+	}
+	for (UINTN j = 1; j < gHeight; j++)
+	{
+		CopyMem(Pixels + j * LineBytes, Pixels, gWidth * (gBpp / 8));
+	}
+
+	FbConMarkDirty(0, 0, gWidth, gHeight);
+
+	// The text is drawn again by the next rendering
+	for (INTN y = 0; y < m_MaxPosition.y; y++)
+	{
+		m_RowDrawn[y] = 0;
+		m_RowDirty[y] = 0;
+	}
+}
+
+void FbConStorePixel16(unsigned char *pixel, UINTN color)
+{
+	// RGB565
+	*(UINT16 *)pixel = (UINT16)(((color >> 8) & 0xf800) |
+		((color >> 5) & 0x07e0) |
+		((color >> 3) & 0x001f));
+}
+
+void FbConStorePixel32(unsigned char *pixel, UINTN color)
+{
+	*(UINT32 *)pixel = (UINT32)color;
+}
+
+void FbConStorePixelBytes(unsigned char *pixel, UINTN color)
+{
+	for (UINTN k = 0; k < (gBpp / 8); k++)
+	{
+		pixel[k] = (unsigned char)(color >> (k * 8));
 	}
 }
 
+/* Takes the framebuffer the GOP driver uses as well, see DisplayInfoLib */
+void FbConLoadGeometry(void)
+{
+	DISPLAY_INFO Info;
+
+	GetDisplayInfo(&Info);
+	gFrameBuffer = (char*)Info.FrameBufferBase;
+	gWidth = Info.Width;
+	gHeight = Info.Height;
+	gStride = Info.Stride;
+	gBpp = Info.Bpp;
+}
+
 void FbConReset(void)
 {
+	INTN y;
+
+	FbConLoadGeometry();
+
+	// Pick the pixel writer once.
+	if (gBpp == 32)
+	{
+		m_StorePixel = FbConStorePixel32;
+	}
+	else if (gBpp == 16)
+	{
+		m_StorePixel = FbConStorePixel16;
+	}
+	else
+	{
+		m_StorePixel = FbConStorePixelBytes;
+	}
+
 	// Reset position.
 	m_Position.x = 0;
 	m_Position.y = 0;
 
-	// Calc max position.
-	m_MaxPosition.x = gWidth / (FONT_WIDTH + 1);
-	m_MaxPosition.y = (gHeight - 1) / FONT_HEIGHT;
+	// Nothing drawn yet.
+	m_DirtyTop = m_DirtyBottom = 0;
+	m_PendingChars = 0;
+	m_PendingScroll = 0;
+	m_RenderPending = FALSE;
+
+	// Calc max position, in cells.
+	m_MaxPosition.x = MIN(gWidth / FBCON_CELL_WIDTH, FBCON_MAX_COLUMNS);
+	m_MaxPosition.y = MIN(gHeight / FBCON_CELL_HEIGHT, FBCON_MAX_ROWS);
+
+	for (y = 0; y < m_MaxPosition.y; y++)
+	{
+		m_RowLength[y] = 0;
+		m_RowDrawn[y] = 0;
+		m_RowDirty[y] = FBCON_ROW_CLEAN;
+	}
 
 	// Reset color.
 	m_Color.Foreground = FB_BGRA8888_WHITE;
 	m_Color.Background = FB_BGRA8888_BLACK;
+
+	// Expand the font once.
+	FbConBuildAtlas();
+	FbConBuildGlyphChunks(gBpp / 8);
+}
+
+void FbConBuildAtlas(void)
+{
+	unsigned c, y;
+
+	for (c = 0; c < FBCON_GLYPHS; c++)
+	{
+		for (y = 0; y < FBCON_GLYPH_HEIGHT; y++)
+		{
+			if (FBCON_FONT == FBCON_FONT_12X24)
+			{
+				m_Atlas[c][y] = font12x24[c * FONT12X24_HEIGHT + y];
+			}
+			else if (FBCON_FONT == FBCON_FONT_8X16)
+			{
+				m_Atlas[c][y] = font8x16[c * FONT8X16_HEIGHT + y];
+			}
+			else
+			{
+				// Each word of the glyph holds half of its rows, FONT_WIDTH bits each
+				m_Atlas[c][y] = (font5x12[c * 2 + y / (FONT_HEIGHT / 2)] >>
+					((y % (FONT_HEIGHT / 2)) * FONT_WIDTH)) & ((1 << FONT_WIDTH) - 1);
+			}
+		}
+	}
 }
 
-void FbConPutCharWithFactor
+/* Stores a character in the shadow at the cursor. Called with interrupts
+ * disabled, nothing is drawn here. */
+void FbConPutChar
 (
 	char c,
-	int type,
-	unsigned scale_factor
+	int type
 )
 {
-	char* Pixels;
+	FBCON_CELL *cell;
+	UINTN x;
+	UINTN y;
 
 	if (!m_Initialized) return;
 
-paint:
-
 	if ((unsigned char)c > 127) return;
 
 	if ((unsigned char)c < 32)
 	{
 		if (c == '\n')
 		{
-			goto newline;
+			FbConNewLine();
 		}
 		else if (c == '\r')
 		{
 			m_Position.x = 0;
-			return;
-		}
-		else
-		{
-			return;
 		}
+		return;
 	}
 
 	// Save some space
@@ -143,45 +349,89 @@ paint:
 		type != FBCON_TITLE_MSG)
 		return;
 
-	BOOLEAN intstate = ArmGetInterruptState();
-	ArmDisableInterrupts();
+	x = m_Position.x;
+	y = m_Position.y;
+	cell = &m_Cells[y][x];
 
-	Pixels = (void*)FixedPcdGet32(PcdMipiFrameBufferAddress);
-	Pixels += m_Position.y * ((gBpp / 8) * FONT_HEIGHT * gWidth);
-	Pixels += m_Position.x * scale_factor * ((gBpp / 8) * (FONT_WIDTH + 1));
-
-	FbConDrawglyph(
-		Pixels,
-		gWidth,
-		(gBpp / 8),
-		font5x12 + (c - 32) * 2,
-		scale_factor);
+	// Rewriting what is already there, e.g. after a '\r', draws nothing
+	if (x >= m_RowLength[y] || cell->Char != c || cell->Attr != type)
+	{
+		cell->Char = c;
+		cell->Attr = (UINT8)type;
+		m_RowDirty[y] = (UINT16)MIN(m_RowDirty[y], x);
+		m_RowLength[y] = (UINT16)MAX(m_RowLength[y], x + 1);
+		m_PendingChars++;
+	}
 
 	m_Position.x++;
 
-	if (m_Position.x >= (int)(m_MaxPosition.x / scale_factor)) goto newline;
+	if (m_Position.x >= m_MaxPosition.x) FbConNewLine();
+}
 
-	if (intstate) ArmEnableInterrupts();
-	return;
+void FbConNewLine(void)
+{
+	INTN y;
 
-newline:
-	m_Position.y += scale_factor;
 	m_Position.x = 0;
-	if (m_Position.y >= m_MaxPosition.y - scale_factor)
+	m_Position.y++;
+
+	if (m_Position.y >= m_MaxPosition.y &&
+		FeaturePcdGet(PcdFrameBufferScroll))
 	{
-		ResetFb();
-		FbConFlush();
+		// Move the text up, the pixels follow when it is rendered
+		m_Position.y = m_MaxPosition.y - 1;
+		CopyMem(m_Cells[0], m_Cells[1], m_Position.y * sizeof(m_Cells[0]));
+		CopyMem(m_RowLength, m_RowLength + 1, m_Position.y * sizeof(m_RowLength[0]));
+		CopyMem(m_RowDirty, m_RowDirty + 1, m_Position.y * sizeof(m_RowDirty[0]));
+		if (m_PendingScroll < (UINTN)m_MaxPosition.y) m_PendingScroll++;
+	}
+	else if (m_Position.y >= m_MaxPosition.y)
+	{
+		// Start over on an empty page
 		m_Position.y = 0;
+		for (y = 1; y < m_MaxPosition.y; y++)
+		{
+			m_RowLength[y] = 0;
+			m_RowDirty[y] = 0;
+		}
+	}
+
+	// The new line starts empty
+	m_RowLength[m_Position.y] = 0;
+	m_RowDirty[m_Position.y] = 0;
 
-		if (intstate) ArmEnableInterrupts();
-		goto paint;
+	// Coalesce the rendering of short lines when asked to
+	if (m_PendingChars >= FixedPcdGet32(PcdFrameBufferFlushInterval))
+	{
+		m_RenderPending = TRUE;
 	}
-	else
+}
+
+void FbConBuildGlyphChunks
+(
+	unsigned bpp
+)
+{
+	unsigned char *chunk;
+	unsigned mask, x, j;
+	UINTN color;
+
+	for (mask = 0; mask < (1 << FBCON_CHUNK_BITS); mask++)
 	{
-		FbConFlush();
-		if (intstate) ArmEnableInterrupts();
+		chunk = (unsigned char *)m_GlyphChunks[mask];
+		for (x = 0; x < FBCON_CHUNK_BITS; x++)
+		{
+			// Bit 0 is the leftmost pixel
+			color = (mask & (1 << x)) ? m_Color.Foreground : m_Color.Background;
+			for (j = 0; j < FBCON_SCALE; j++)
+			{
+				m_StorePixel(chunk, color);
+				chunk += bpp;
+			}
+		}
 	}
 
+	m_GlyphChunksColor = m_Color;
 }
 
 void FbConDrawglyph
@@ -189,164 +439,242 @@ void FbConDrawglyph
 	char *pixels,
 	unsigned stride,
 	unsigned bpp,
-	unsigned *glyph,
-	unsigned scale_factor
+	UINT16 *glyph
 )
 {
-	char *bg_pixels = pixels;
-	unsigned x, y, i, j, k;
-	unsigned data, temp;
-	unsigned int fg_color = m_Color.Foreground;
-	unsigned int bg_color = m_Color.Background;
-	stride -= FONT_WIDTH * scale_factor;
-
-	for (y = 0; y < FONT_HEIGHT / 2; ++y)
+	char *line;
+	unsigned y, x, i;
+	unsigned data;
+	unsigned chunk_bytes;
+
+	if (m_Color.Foreground != m_GlyphChunksColor.Foreground ||
+		m_Color.Background != m_GlyphChunksColor.Background)
 	{
-		for (i = 0; i < scale_factor; i++)
-		{
-			for (x = 0; x < FONT_WIDTH; ++x)
-			{
-				for (j = 0; j < scale_factor; j++)
-				{
-					bg_color = m_Color.Background;
-					for (k = 0; k < bpp; k++)
-					{
-						*bg_pixels = (unsigned char)bg_color;
-						bg_color = bg_color >> 8;
-						bg_pixels++;
-					}
-				}
-			}
-			bg_pixels += (stride * bpp);
-		}
+		FbConBuildGlyphChunks(bpp);
 	}
 
-	for (y = 0; y < FONT_HEIGHT / 2; ++y)
+	chunk_bytes = FBCON_CHUNK_BITS * FBCON_SCALE * bpp;
+	for (y = 0; y < FBCON_GLYPH_HEIGHT; ++y)
 	{
-		for (i = 0; i < scale_factor; i++)
+		// Foreground and background of a chunk are stored at once
+		line = pixels;
+		data = glyph[y];
+		for (x = 0; x < FBCON_GLYPH_WIDTH; x += FBCON_CHUNK_BITS)
 		{
-			for (x = 0; x < FONT_WIDTH; ++x)
-			{
-				for (j = 0; j < scale_factor; j++)
-				{
-					bg_color = m_Color.Background;
-					for (k = 0; k < bpp; k++)
-					{
-						*bg_pixels = (unsigned char)bg_color;
-						bg_color = bg_color >> 8;
-						bg_pixels++;
-					}
-				}
-			}
-			bg_pixels += (stride * bpp);
+			CopyMem(line, m_GlyphChunks[data & ((1 << FBCON_CHUNK_BITS) - 1)], chunk_bytes);
+			line += chunk_bytes;
+			data >>= FBCON_CHUNK_BITS;
 		}
-	}
 
-	data = glyph[0];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y)
-	{
-		temp = data;
-		for (i = 0; i < scale_factor; i++)
+		for (i = 1; i < FBCON_SCALE; i++)
 		{
-			data = temp;
-			for (x = 0; x < FONT_WIDTH; ++x)
-			{
-				if (data & 1)
-				{
-					for (j = 0; j < scale_factor; j++)
-					{
-						fg_color = m_Color.Foreground;
-						for (k = 0; k < bpp; k++)
-						{
-							*pixels = (unsigned char)fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < scale_factor; j++)
-					{
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
-			}
-			pixels += (stride * bpp);
+			CopyMem(pixels + i * stride * bpp, pixels, FBCON_CELL_WIDTH * bpp);
 		}
+		pixels += FBCON_SCALE * stride * bpp;
 	}
+}
+
+/* Draws count cells of a row of the screen, NULL cells clear them */
+void FbConDrawCells
+(
+	UINTN row,
+	UINTN column,
+	FBCON_CELL *cells,
+	UINTN count
+)
+{
+	char *pixels;
+	UINTN i;
+
+	if (count == 0) return;
 
-	data = glyph[1];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y)
+	pixels = gFrameBuffer;
+	pixels += row * FBCON_CELL_HEIGHT * gStride * (gBpp / 8);
+	pixels += column * FBCON_CELL_WIDTH * (gBpp / 8);
+
+	for (i = 0; i < count; i++)
 	{
-		temp = data;
-		for (i = 0; i < scale_factor; i++)
+		if (cells == NULL)
 		{
-			data = temp;
-			for (x = 0; x < FONT_WIDTH; ++x)
-			{
-				if (data & 1)
-				{
-					for (j = 0; j < scale_factor; j++)
-					{
-						fg_color = m_Color.Foreground;
-						for (k = 0; k < bpp; k++)
-						{
-							*pixels = (unsigned char)fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < scale_factor; j++)
-					{
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
-			}
-			pixels += (stride * bpp);
+			// A space is an empty cell
+			FbConDrawglyph(pixels, gStride, (gBpp / 8), m_Atlas[0]);
+		}
+		else
+		{
+			m_Color.Foreground = m_MsgColors[cells[i].Attr];
+			FbConDrawglyph(
+				pixels,
+				gStride,
+				(gBpp / 8),
+				m_Atlas[cells[i].Char - 32]);
 		}
+		pixels += FBCON_CELL_WIDTH * (gBpp / 8);
 	}
+
+	FbConMarkDirty(
+		column * FBCON_CELL_WIDTH,
+		row * FBCON_CELL_HEIGHT,
+		count * FBCON_CELL_WIDTH,
+		FBCON_CELL_HEIGHT);
+}
+
+/* Moves the pixels of the text up by the given number of rows. The rows
+ * uncovered at the bottom keep what they showed, m_RowDrawn still holds. */
+void FbConScrollUp(UINTN rows)
+{
+	char *pixels = gFrameBuffer;
+	UINTN line_bytes = gStride * (gBpp / 8);
+	UINTN shift = rows * FBCON_CELL_HEIGHT;
+	UINTN text_rows = m_MaxPosition.y * FBCON_CELL_HEIGHT;
+
+	// Every row is drawn again anyway
+	if (rows >= (UINTN)m_MaxPosition.y) return;
+
+	// Overlapping copy, CopyMem moves whole registers at a time
+	CopyMem(pixels, pixels + shift * line_bytes, (text_rows - shift) * line_bytes);
+	CopyMem(m_RowDrawn, m_RowDrawn + rows, (m_MaxPosition.y - rows) * sizeof(m_RowDrawn[0]));
+	FbConMarkDirty(0, 0, gWidth, text_rows - shift);
 }
 
-/* TODO: Take stride into account */
-void FbConScrollUp(void)
+/* Rasterizes the cells changed since the last call and cleans them from the
+ * cache. Interrupts are only disabled while the shadow is read, a write
+ * interrupting the rendering leaves its cells to this loop. */
+void FbConRender(void)
 {
-	unsigned short *dst = (void*)FixedPcdGet32(PcdMipiFrameBufferAddress);
-	unsigned short *src = dst + (gWidth * FONT_HEIGHT);
-	unsigned count = gWidth * (gHeight - FONT_HEIGHT);
+	FBCON_CELL cells[FBCON_MAX_COLUMNS];
+	UINTN InterruptState;
+	UINTN row, from, length, drawn, scroll;
 
-	while (count--)
+	if (!m_Initialized) return;
+
+	InterruptState = ArmGetInterruptState();
+	ArmDisableInterrupts();
+
+	if (m_Rendering)
 	{
-		*dst++ = *src++;
+		if (InterruptState) ArmEnableInterrupts();
+		return;
 	}
+	m_Rendering = TRUE;
 
-	count = gWidth * FONT_HEIGHT;
-	while (count--)
+	for (;;)
 	{
-		*dst++ = m_Color.Background;
+		m_RenderPending = FALSE;
+		m_PendingChars = 0;
+
+		// The rows still on the screen move with their text
+		scroll = m_PendingScroll;
+		if (scroll != 0)
+		{
+			m_PendingScroll = 0;
+			if (InterruptState) ArmEnableInterrupts();
+			FbConScrollUp(scroll);
+			ArmDisableInterrupts();
+			continue;
+		}
+
+		for (row = 0; row < (UINTN)m_MaxPosition.y; row++)
+		{
+			if (m_RowDirty[row] != FBCON_ROW_CLEAN) break;
+		}
+
+		if (row < (UINTN)m_MaxPosition.y)
+		{
+			from = m_RowDirty[row];
+			length = m_RowLength[row];
+			drawn = m_RowDrawn[row];
+			if (from < length)
+			{
+				CopyMem(cells, &m_Cells[row][from], (length - from) * sizeof(FBCON_CELL));
+			}
+			m_RowDirty[row] = FBCON_ROW_CLEAN;
+			m_RowDrawn[row] = (UINT16)length;
+
+			if (InterruptState) ArmEnableInterrupts();
+			if (from < length)
+			{
+				FbConDrawCells(row, from, cells, length - from);
+			}
+			if (drawn > length)
+			{
+				FbConDrawCells(row, length, NULL, drawn - length);
+			}
+			ArmDisableInterrupts();
+			continue;
+		}
+
+		// Everything is drawn
+		if (m_DirtyTop >= m_DirtyBottom) break;
+
+		if (InterruptState) ArmEnableInterrupts();
+		FbConFlush();
+		ArmDisableInterrupts();
 	}
 
-	FbConFlush();
+	m_Rendering = FALSE;
+	if (InterruptState) ArmEnableInterrupts();
+}
+
+void FbConMarkDirty
+(
+	UINTN x,
+	UINTN y,
+	UINTN width,
+	UINTN height
+)
+{
+	if (m_DirtyTop >= m_DirtyBottom)
+	{
+		m_DirtyLeft = x;
+		m_DirtyRight = x + width;
+		m_DirtyTop = y;
+		m_DirtyBottom = y + height;
+		return;
+	}
+
+	m_DirtyLeft = MIN(m_DirtyLeft, x);
+	m_DirtyRight = MAX(m_DirtyRight, x + width);
+	m_DirtyTop = MIN(m_DirtyTop, y);
+	m_DirtyBottom = MAX(m_DirtyBottom, y + height);
 }
 
 void FbConFlush(void)
 {
-	unsigned total_x, total_y;
-	unsigned bytes_per_bpp;
+	char *pixels;
+	UINTN bytes_per_bpp;
+	UINTN line_bytes;
+	UINTN y;
+
+	if (m_DirtyTop >= m_DirtyBottom) return;
 
-	total_x = gWidth;
-	total_y = gHeight;
 	bytes_per_bpp = (gBpp / 8);
+	line_bytes = gStride * bytes_per_bpp;
+	pixels = gFrameBuffer;
+	pixels += m_DirtyTop * line_bytes + m_DirtyLeft * bytes_per_bpp;
 
-	WriteBackInvalidateDataCacheRange(
-		(void*)FixedPcdGet32(PcdMipiFrameBufferAddress),
-		(total_x * total_y * bytes_per_bpp)
-	);
+	if (2 * (m_DirtyRight - m_DirtyLeft) < gWidth)
+	{
+		// Narrow box, clean it scanline by scanline
+		for (y = m_DirtyTop; y < m_DirtyBottom; y++)
+		{
+			WriteBackInvalidateDataCacheRange(
+				pixels,
+				(m_DirtyRight - m_DirtyLeft) * bytes_per_bpp
+			);
+			pixels += line_bytes;
+		}
+	}
+	else
+	{
+		// Wide box, the gaps between its scanlines cost less than the calls
+		WriteBackInvalidateDataCacheRange(
+			pixels,
+			(m_DirtyBottom - m_DirtyTop - 1) * line_bytes +
+			(m_DirtyRight - m_DirtyLeft) * bytes_per_bpp
+		);
+	}
+
+	m_DirtyTop = m_DirtyBottom = 0;
 }
 
 UINTN
@@ -359,14 +687,21 @@ SerialPortWrite
 {
 	UINT8* CONST Final = &Buffer[NumberOfBytes];
 	UINTN  InterruptState = ArmGetInterruptState();
+	BOOLEAN Render;
+
 	ArmDisableInterrupts();
 
 	while (Buffer < Final)
 	{
-		FbConPutCharWithFactor(*Buffer++, FBCON_COMMON_MSG, SCALE_FACTOR);
+		FbConPutChar(*Buffer++, FBCON_COMMON_MSG);
 	}
 
+	Render = m_RenderPending;
+
 	if (InterruptState) ArmEnableInterrupts();
+
+	// Drawn once the shadow is released
+	if (Render) FbConRender();
 	return NumberOfBytes;
 }
 
@@ -379,20 +714,19 @@ SerialPortWriteCritical
 )
 {
 	UINT8* CONST Final = &Buffer[NumberOfBytes];
-	UINTN  CurrentForeground = m_Color.Foreground;
 	UINTN  InterruptState = ArmGetInterruptState();
 
 	ArmDisableInterrupts();
-	m_Color.Foreground = FB_BGRA8888_YELLOW;
 
 	while (Buffer < Final)
 	{
-		FbConPutCharWithFactor(*Buffer++, FBCON_COMMON_MSG, SCALE_FACTOR);
+		FbConPutChar(*Buffer++, FBCON_YELLOW_MSG);
 	}
 
-	m_Color.Foreground = CurrentForeground;
-
 	if (InterruptState) ArmEnableInterrupts();
+
+	// Critical messages are never left in the shadow or the cache
+	FbConRender();
 	return NumberOfBytes;
 }
 
@@ -454,6 +788,7 @@ SerialPortSetAttributes
 
 UINTN SerialPortFlush(VOID)
 {
+	FbConRender();
 	return 0;
 }
 
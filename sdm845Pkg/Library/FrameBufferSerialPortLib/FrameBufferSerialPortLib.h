@@ -11,6 +11,11 @@ typedef struct _FBCON_COLOR {
     UINTN Background;
 } FBCON_COLOR, *PFBCON_COLOR;
 
+typedef struct _FBCON_CELL {
+    CHAR8 Char;
+    UINT8 Attr;
+} FBCON_CELL, *PFBCON_CELL;
+
 enum FbConMsgType {
 	/* type for menu */
 	FBCON_COMMON_MSG = 0,
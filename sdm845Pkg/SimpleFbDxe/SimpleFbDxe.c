@@ -12,6 +12,7 @@
 #include <Library/BaseLib.h>
 #include <Library/FrameBufferBltLib.h>
 #include <Library/CacheMaintenanceLib.h>
+#include <Library/DisplayInfoLib.h>
 
 /// Defines
 /*
@@ -210,12 +211,21 @@ SimpleFbDxeInitialize
 
     EFI_STATUS          Status                  = EFI_SUCCESS;
     EFI_HANDLE          hUEFIDisplayHandle      = NULL;
+    DISPLAY_INFO        DisplayInfo;
 
-    /* Retrieve simple frame buffer from pre-SEC bootloader */
-    DEBUG((EFI_D_ERROR, "SimpleFbDxe: Retrieve MIPI FrameBuffer parameters from PCD\n"));
-    UINT32              MipiFrameBufferAddr     = FixedPcdGet32(PcdMipiFrameBufferAddress);
-    UINT32              MipiFrameBufferWidth    = FixedPcdGet32(PcdMipiFrameBufferWidth);
-    UINT32              MipiFrameBufferHeight   = FixedPcdGet32(PcdMipiFrameBufferHeight);
+    /* Retrieve simple frame buffer from pre-SEC bootloader, the console uses the same */
+    if (GetDisplayInfo(&DisplayInfo))
+    {
+        DEBUG((EFI_D_ERROR, "SimpleFbDxe: Retrieve MIPI FrameBuffer parameters from the preloader\n"));
+    }
+    else
+    {
+        DEBUG((EFI_D_ERROR, "SimpleFbDxe: Retrieve MIPI FrameBuffer parameters from PCD\n"));
+    }
+    UINT32              MipiFrameBufferAddr     = (UINT32)DisplayInfo.FrameBufferBase;
+    UINT32              MipiFrameBufferWidth    = DisplayInfo.Width;
+    UINT32              MipiFrameBufferHeight   = DisplayInfo.Height;
+    UINT32              MipiFrameBufferStride   = DisplayInfo.Stride;
 
     /* Sanity check */
     if (MipiFrameBufferAddr == 0 || MipiFrameBufferWidth == 0 || MipiFrameBufferHeight == 0)
@@ -224,6 +234,13 @@ SimpleFbDxeInitialize
         return EFI_DEVICE_ERROR;
     }
 
+    /* GOP is only offered on a8r8g8b8 */
+    if (DisplayInfo.Bpp != FB_BITS_PER_PIXEL)
+    {
+        DEBUG((EFI_D_ERROR, "SimpleFbDxe: Unsupported FrameBuffer depth %d\n", DisplayInfo.Bpp));
+        return EFI_UNSUPPORTED;
+    }
+
     /* Prepare struct */
     if (mDisplay.Mode == NULL)
     {
@@ -262,11 +279,11 @@ SimpleFbDxeInitialize
     mDisplay.Mode->Info->VerticalResolution = MipiFrameBufferHeight;
 
     /* SimpleFB runs on a8r8g8b8 (VIDEO_BPP32) for DB410c */
-    UINT32 LineLength = MipiFrameBufferWidth * VNBYTES(VIDEO_BPP32);
+    UINT32 LineLength = MipiFrameBufferStride * VNBYTES(VIDEO_BPP32);
     UINT32 FrameBufferSize = LineLength * MipiFrameBufferHeight;
     EFI_PHYSICAL_ADDRESS FrameBufferAddress = MipiFrameBufferAddr;
 
-    mDisplay.Mode->Info->PixelsPerScanLine = MipiFrameBufferWidth;
+    mDisplay.Mode->Info->PixelsPerScanLine = MipiFrameBufferStride;
     mDisplay.Mode->Info->PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
     mDisplay.Mode->SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
     mDisplay.Mode->FrameBufferBase = FrameBufferAddress;